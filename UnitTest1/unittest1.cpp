@@ -90,6 +90,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(hdr_histogram)
+        {
+            int ret = util_hdr_histogram_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(random_tester)
         {
             int ret = random_tester_test();
@@ -167,6 +174,20 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(sockloop_batch)
+        {
+            int ret = sockloop_batch_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(send_batch)
+        {
+            int ret = send_batch_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(splay)
         {
             int ret = splay_test();
@@ -223,6 +244,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(varint_bulk)
+        {
+            int ret = varint_bulk_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(sqrt_for_test)
         {
             int ret = sqrt_for_test_test();
@@ -265,6 +293,76 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(binlog_async)
+        {
+            int ret = binlog_async_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(binlog_index)
+        {
+            int ret = binlog_index_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(columnar)
+        {
+            int ret = columnar_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(log_sampling)
+        {
+            int ret = log_sampling_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(live_metrics)
+        {
+            int ret = live_metrics_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(cc_telemetry)
+        {
+            int ret = cc_telemetry_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(path_cache)
+        {
+            int ret = path_cache_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(cc_plugin)
+        {
+            int ret = cc_plugin_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(experiment_arm)
+        {
+            int ret = experiment_arm_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(cc_fixed_point)
+        {
+            int ret = cc_fixed_point_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(app_message_overflow)
         {
             int ret = app_message_overflow_test();
@@ -299,6 +397,40 @@ namespace UnitTest1
 
             Assert::AreEqual(ret, 0);
         }
+
+        TEST_METHOD(stream_by_reference)
+        {
+            int ret = stream_by_reference_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(stream_file)
+        {
+            int ret = stream_file_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(stream_delivery_latency)
+        {
+            int ret = stream_delivery_latency_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(memory_budget)
+        {
+            int ret = memory_budget_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+        TEST_METHOD(stream_reorder_stats)
+        {
+            int ret = stream_reorder_stats_test();
+
+            Assert::AreEqual(ret, 0);
+        }
         TEST_METHOD(stream_retransmit_copy)
         {
             int ret = test_copy_for_retransmit();
@@ -361,6 +493,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(ack_cache)
+        {
+            int ret = ack_cache_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(ack_of_ack)
         {
             int ret = ack_of_ack_test();
@@ -442,6 +581,13 @@ namespace UnitTest1
         {
             int ret = pacing_repeat_test();
 
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(pacing_txtime)
+        {
+            int ret = pacing_txtime_test();
+
             Assert::AreEqual(ret, 0);
         }
 
@@ -600,6 +746,27 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(datagram_queue)
+        {
+            int ret = datagram_queue_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(fec_repair)
+        {
+            int ret = fec_repair_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(fec_loss)
+        {
+            int ret = fec_loss_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(datagram_wifi)
         {
             int ret = datagram_wifi_test();
@@ -1146,6 +1313,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(cc_fixed_point_sim)
+        {
+            int ret = cc_fixed_point_sim_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(pacing_cubic)
         {
             int ret = pacing_cubic_test();
@@ -1606,6 +1780,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(crypto_offload)
+        {
+            int ret = crypto_offload_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(key_rotation_stress)
         {
             int ret = key_rotation_stress_test();
@@ -1834,6 +2015,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(selective_repeat)
+        {
+            int ret = selective_repeat_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(ready_to_send)
         {
             int ret = ready_to_send_test();
@@ -2001,6 +2189,13 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(cc_bench)
+        {
+            int ret = cc_bench_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(long_rtt)
         {
             int ret = long_rtt_test();
@@ -2573,6 +2768,18 @@ namespace UnitTest1
             Assert::AreEqual(ret, 0);
         }
 
+        TEST_METHOD(multipath_redundant) {
+            int ret = multipath_redundant_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
+        TEST_METHOD(path_scheduler) {
+            int ret = path_scheduler_test();
+
+            Assert::AreEqual(ret, 0);
+        }
+
         TEST_METHOD(simple_multipath_basic) {
             int ret = simple_multipath_basic_test();
 
@@ -0,0 +1,329 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Congestion control benchmark.
+ *
+ * Runs every combination of the selected congestion control algorithms,
+ * link profiles and flow counts over the simulated links of the test
+ * library, in parallel, and prints one line of CSV per scenario with the
+ * goodput, RTT percentiles, retransmission ratio and fairness index.
+ */
+
+#ifdef _WINDOWS
+#include "getopt.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+
+#define CCBENCH_MAX_ITEMS 16
+
+static char const* ccbench_default_algos[] = { "reno", "cubic", "dcubic", "fast", "bbr", "bbr1", "prague" };
+static const int ccbench_default_flows[] = { 1, 2, 4 };
+
+static int usage(char const* argv0)
+{
+    fprintf(stderr, "Congestion control benchmark\n\n");
+    fprintf(stderr, "Usage: %s [options]\n\n", argv0);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -S solution_dir   Directory containing the test certificates\n");
+    fprintf(stderr, "  -c alg1,alg2,...  Congestion control algorithms, default all:\n");
+    fprintf(stderr, "                    reno, cubic, dcubic, fast, bbr, bbr1, prague\n");
+    fprintf(stderr, "  -l link1,link2    Link profiles, default all predefined profiles:\n");
+    for (size_t i = 0; i < cc_bench_nb_default_links; i++) {
+        fprintf(stderr, "                    %s: %.0f Mbps, %" PRIu64 " ms RTT, %" PRIu64 " ppm loss\n",
+            cc_bench_default_links[i].name, cc_bench_default_links[i].mbps,
+            cc_bench_default_links[i].rtt / 1000, cc_bench_default_links[i].loss_ppm);
+    }
+    fprintf(stderr, "  -L name:mbps:rtt_ms:loss_ppm:buffer_ms[:period_ms:duration_ms]\n");
+    fprintf(stderr, "                    Add a link profile, with optional handovers\n");
+    fprintf(stderr, "  -f n1,n2,...      Numbers of competing flows, default 1,2,4\n");
+    fprintf(stderr, "  -s bytes          Bytes sent by each flow, default 10000000\n");
+    fprintf(stderr, "  -d seconds        Maximum simulated duration, default 60\n");
+    fprintf(stderr, "  -j threads        Number of threads, default 4\n");
+    fprintf(stderr, "  -o file           Write the results to file instead of stdout\n");
+    fprintf(stderr, "  -h                This help message\n");
+
+    return -1;
+}
+
+/* Split a comma separated list in place */
+static int ccbench_split(char* list, char** items, int items_max)
+{
+    int nb_items = 0;
+    char* next = list;
+
+    while (next != NULL && *next != 0 && nb_items < items_max) {
+        char* comma = strchr(next, ',');
+
+        items[nb_items++] = next;
+        if (comma != NULL) {
+            *comma = 0;
+            next = comma + 1;
+        }
+        else {
+            next = NULL;
+        }
+    }
+
+    return (next != NULL && *next != 0) ? -1 : nb_items;
+}
+
+static int ccbench_parse_link(char* spec, cc_bench_link_t* link)
+{
+    double mbps = 0;
+    unsigned int rtt_ms = 0;
+    unsigned int loss_ppm = 0;
+    unsigned int buffer_ms = 0;
+    unsigned int period_ms = 0;
+    unsigned int duration_ms = 0;
+    char* colon = strchr(spec, ':');
+    int nb_fields;
+
+    if (colon == NULL) {
+        return -1;
+    }
+    *colon = 0;
+    nb_fields = sscanf(colon + 1, "%lf:%u:%u:%u:%u:%u", &mbps, &rtt_ms, &loss_ppm, &buffer_ms, &period_ms, &duration_ms);
+    if ((nb_fields != 4 && nb_fields != 6) || mbps <= 0 || rtt_ms == 0) {
+        return -1;
+    }
+    memset(link, 0, sizeof(cc_bench_link_t));
+    link->name = spec;
+    link->mbps = mbps;
+    link->rtt = 1000ull * rtt_ms;
+    link->loss_ppm = loss_ppm;
+    link->buffer_delay = 1000ull * buffer_ms;
+    link->handover_period = 1000ull * period_ms;
+    link->handover_offset = link->handover_period;
+    link->handover_duration = 1000ull * duration_ms;
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = 0;
+    int opt;
+    char* algo_names[CCBENCH_MAX_ITEMS];
+    int nb_algos = 0;
+    char* link_names[CCBENCH_MAX_ITEMS];
+    int nb_link_names = 0;
+    cc_bench_link_t custom_links[CCBENCH_MAX_ITEMS];
+    int nb_custom_links = 0;
+    const cc_bench_link_t* links[2 * CCBENCH_MAX_ITEMS];
+    int nb_links = 0;
+    int flows[CCBENCH_MAX_ITEMS];
+    int nb_flows = 0;
+    size_t flow_size = 10000000;
+    uint64_t max_duration = 60000000;
+    int nb_threads = 4;
+    char const* out_file = NULL;
+    cc_bench_scenario_t* scenarios = NULL;
+    cc_bench_result_t* results = NULL;
+    size_t nb_scenarios = 0;
+
+    debug_printf_push_stream(stderr);
+
+    while (ret == 0 && (opt = getopt(argc, argv, "S:c:l:L:f:s:d:j:o:h")) != -1) {
+        switch (opt) {
+        case 'S':
+            picoquic_set_solution_dir(optarg);
+            break;
+        case 'c':
+            if ((nb_algos = ccbench_split(optarg, algo_names, CCBENCH_MAX_ITEMS)) <= 0) {
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'l':
+            if ((nb_link_names = ccbench_split(optarg, link_names, CCBENCH_MAX_ITEMS)) <= 0) {
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'L':
+            if (nb_custom_links >= CCBENCH_MAX_ITEMS || ccbench_parse_link(optarg, &custom_links[nb_custom_links]) != 0) {
+                fprintf(stderr, "Invalid link profile: %s\n", optarg);
+                ret = usage(argv[0]);
+            }
+            else {
+                nb_custom_links++;
+            }
+            break;
+        case 'f': {
+            char* items[CCBENCH_MAX_ITEMS];
+            int nb_items = ccbench_split(optarg, items, CCBENCH_MAX_ITEMS);
+
+            for (int i = 0; i < nb_items; i++) {
+                flows[i] = atoi(items[i]);
+                if (flows[i] <= 0 || flows[i] > CC_BENCH_MAX_FLOWS) {
+                    nb_items = -1;
+                    break;
+                }
+            }
+            if ((nb_flows = nb_items) <= 0) {
+                ret = usage(argv[0]);
+            }
+            break;
+        }
+        case 's':
+            flow_size = (size_t)strtoull(optarg, NULL, 10);
+            if (flow_size == 0) {
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'd':
+            max_duration = 1000000ull * (uint64_t)atoi(optarg);
+            if (max_duration == 0) {
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'j':
+            nb_threads = atoi(optarg);
+            if (nb_threads <= 0 || nb_threads > CC_BENCH_MAX_THREADS) {
+                ret = usage(argv[0]);
+            }
+            break;
+        case 'o':
+            out_file = optarg;
+            break;
+        case 'h':
+        default:
+            ret = usage(argv[0]);
+            break;
+        }
+    }
+
+    /* Default values */
+    if (ret == 0 && nb_algos == 0) {
+        for (size_t i = 0; i < sizeof(ccbench_default_algos) / sizeof(char const*); i++) {
+            algo_names[nb_algos++] = (char*)ccbench_default_algos[i];
+        }
+    }
+    if (ret == 0 && nb_flows == 0) {
+        for (size_t i = 0; i < sizeof(ccbench_default_flows) / sizeof(int); i++) {
+            flows[nb_flows++] = ccbench_default_flows[i];
+        }
+    }
+    for (int i = 0; ret == 0 && i < nb_link_names; i++) {
+        const cc_bench_link_t* link = NULL;
+
+        for (size_t j = 0; j < cc_bench_nb_default_links && link == NULL; j++) {
+            if (strcmp(link_names[i], cc_bench_default_links[j].name) == 0) {
+                link = &cc_bench_default_links[j];
+            }
+        }
+        for (int j = 0; j < nb_custom_links && link == NULL; j++) {
+            if (strcmp(link_names[i], custom_links[j].name) == 0) {
+                link = &custom_links[j];
+            }
+        }
+        if (link == NULL) {
+            fprintf(stderr, "Unknown link profile: %s\n", link_names[i]);
+            ret = usage(argv[0]);
+        }
+        else {
+            links[nb_links++] = link;
+        }
+    }
+    if (ret == 0 && nb_link_names == 0) {
+        if (nb_custom_links > 0) {
+            for (int i = 0; i < nb_custom_links; i++) {
+                links[nb_links++] = &custom_links[i];
+            }
+        }
+        else {
+            for (size_t i = 0; i < cc_bench_nb_default_links; i++) {
+                links[nb_links++] = &cc_bench_default_links[i];
+            }
+        }
+    }
+
+    /* Build the matrix */
+    if (ret == 0) {
+        size_t nb_max = (size_t)nb_algos * nb_links * nb_flows;
+
+        scenarios = (cc_bench_scenario_t*)calloc(nb_max, sizeof(cc_bench_scenario_t));
+        results = (cc_bench_result_t*)calloc(nb_max, sizeof(cc_bench_result_t));
+        if (scenarios == NULL || results == NULL) {
+            fprintf(stderr, "Could not allocate memory.\n");
+            ret = -1;
+        }
+    }
+    for (int a = 0; ret == 0 && a < nb_algos; a++) {
+        picoquic_congestion_algorithm_t const* ccalgo = picoquic_get_congestion_algorithm(algo_names[a]);
+
+        if (ccalgo == NULL) {
+            fprintf(stderr, "Unknown congestion control algorithm: %s\n", algo_names[a]);
+            ret = usage(argv[0]);
+            break;
+        }
+        for (int l = 0; l < nb_links; l++) {
+            for (int f = 0; f < nb_flows; f++) {
+                cc_bench_scenario_t* scenario = &scenarios[nb_scenarios];
+
+                scenario->ccalgo = ccalgo;
+                scenario->link = links[l];
+                scenario->nb_flows = flows[f];
+                scenario->flow_size = flow_size;
+                scenario->max_duration = max_duration;
+                /* Same seed for all algorithms, so they see the same losses */
+                scenario->seed = 0xcc0be9c000ull + (uint64_t)(l * CCBENCH_MAX_ITEMS + f);
+                nb_scenarios++;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        FILE* F = stdout;
+        int run_ret = cc_bench_run_matrix(scenarios, nb_scenarios, results, nb_threads);
+
+        if (out_file != NULL && (F = picoquic_file_open(out_file, "w")) == NULL) {
+            fprintf(stderr, "Cannot open %s\n", out_file);
+            ret = -1;
+        }
+        else {
+            cc_bench_print_header(F);
+            for (size_t i = 0; i < nb_scenarios; i++) {
+                if (results[i].ret != 0) {
+                    fprintf(stderr, "Scenario %s, %s, %d flows failed.\n", scenarios[i].ccalgo->congestion_algorithm_id,
+                        scenarios[i].link->name, scenarios[i].nb_flows);
+                }
+                cc_bench_print_result(F, &scenarios[i], &results[i]);
+            }
+            if (F != stdout) {
+                (void)picoquic_file_close(F);
+            }
+            ret = run_ret;
+        }
+    }
+
+    if (scenarios != NULL) {
+        free(scenarios);
+    }
+    if (results != NULL) {
+        free(results);
+    }
+
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,568 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_internal.h"
+#include "picoquic_binlog.h"
+#include "bytestream.h"
+#include "cidset.h"
+#include "logreader.h"
+#include "columnar.h"
+
+#define COLUMNAR_BLOCK_END 0
+#define COLUMNAR_BLOCK_ROWS_DATA 1
+#define COLUMNAR_BLOCK_CID 2
+
+#define COLUMNAR_ENCODING_DELTA 0
+#define COLUMNAR_ENCODING_DELTA_RLE 1
+
+#define COLUMNAR_VARINT_MAX 10
+/* Worst case: encoding byte, then a value and a run length per row */
+#define COLUMNAR_COLUMN_MAX (1 + 2 * COLUMNAR_VARINT_MAX * COLUMNAR_BLOCK_ROWS)
+
+typedef struct st_columnar_cnx_t {
+    picoquic_connection_id_t cid; /* Must be first, the entry is also the key in the cidset */
+    uint64_t cid_index;
+    uint64_t cwin;
+    uint64_t rtt;
+} columnar_cnx_t;
+
+typedef struct st_columnar_writer_t {
+    FILE* f;
+    const picoquic_connection_id_t* cid;
+    picohash_table* cnx_table;
+    uint64_t nb_cnx;
+    size_t nb_rows;
+    uint64_t column[columnar_column_max][COLUMNAR_BLOCK_ROWS];
+    uint8_t buffer[COLUMNAR_COLUMN_MAX];
+} columnar_writer_t;
+
+/* The values are encoded as little endian base 128 varints, which unlike
+ * QUIC varints can encode the full 64 bits range of zigzag deltas. */
+static size_t columnar_varint_encode(uint8_t* bytes, uint64_t v)
+{
+    size_t l = 0;
+
+    while (v >= 0x80) {
+        bytes[l++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    bytes[l++] = (uint8_t)v;
+
+    return l;
+}
+
+static size_t columnar_varint_len(uint64_t v)
+{
+    size_t l = 1;
+
+    while (v >= 0x80) {
+        v >>= 7;
+        l++;
+    }
+
+    return l;
+}
+
+static size_t columnar_varint_decode(const uint8_t* bytes, size_t length, uint64_t* v)
+{
+    size_t l = 0;
+    int shift = 0;
+
+    *v = 0;
+    while (l < length && l < COLUMNAR_VARINT_MAX) {
+        *v |= ((uint64_t)(bytes[l] & 0x7f)) << shift;
+        if ((bytes[l++] & 0x80) == 0) {
+            return l;
+        }
+        shift += 7;
+    }
+
+    return 0;
+}
+
+static int columnar_fread_varint(FILE* f, uint64_t* v)
+{
+    int shift = 0;
+    int c;
+
+    *v = 0;
+    while (shift < 7 * COLUMNAR_VARINT_MAX && (c = fgetc(f)) != EOF) {
+        *v |= ((uint64_t)(c & 0x7f)) << shift;
+        if ((c & 0x80) == 0) {
+            return 0;
+        }
+        shift += 7;
+    }
+
+    return -1;
+}
+
+static int columnar_fwrite_varint(FILE* f, uint64_t v)
+{
+    uint8_t bytes[COLUMNAR_VARINT_MAX];
+    size_t l = columnar_varint_encode(bytes, v);
+
+    return (fwrite(bytes, l, 1, f) == 1) ? 0 : -1;
+}
+
+static uint64_t columnar_zigzag(uint64_t v, uint64_t previous)
+{
+    int64_t delta = (int64_t)(v - previous);
+
+    return ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+}
+
+static uint64_t columnar_unzigzag(uint64_t z, uint64_t previous)
+{
+    return previous + ((z >> 1) ^ (0 - (z & 1)));
+}
+
+/* Encode a column of values as deltas, using run length encoding if that
+ * is shorter. The first value is encoded as a delta from zero, so that each
+ * block can be decoded independently. */
+static size_t columnar_encode_column(const uint64_t* values, size_t nb_values, uint8_t* bytes)
+{
+    size_t plain_length = 0;
+    size_t rle_length = 0;
+    size_t l = 1;
+    uint64_t previous = 0;
+    size_t i = 0;
+
+    while (i < nb_values) {
+        uint64_t z = columnar_zigzag(values[i], (i == 0) ? 0 : values[i - 1]);
+        size_t run = 1;
+
+        while (i + run < nb_values && columnar_zigzag(values[i + run], values[i + run - 1]) == z) {
+            run++;
+        }
+        plain_length += run * columnar_varint_len(z);
+        rle_length += columnar_varint_len(z) + columnar_varint_len(run - 1);
+        i += run;
+    }
+
+    if (rle_length < plain_length) {
+        bytes[0] = COLUMNAR_ENCODING_DELTA_RLE;
+        i = 0;
+        while (i < nb_values) {
+            uint64_t z = columnar_zigzag(values[i], previous);
+            size_t run = 1;
+
+            while (i + run < nb_values && columnar_zigzag(values[i + run], values[i + run - 1]) == z) {
+                run++;
+            }
+            l += columnar_varint_encode(bytes + l, z);
+            l += columnar_varint_encode(bytes + l, run - 1);
+            i += run;
+            previous = values[i - 1];
+        }
+    }
+    else {
+        bytes[0] = COLUMNAR_ENCODING_DELTA;
+        for (i = 0; i < nb_values; i++) {
+            l += columnar_varint_encode(bytes + l, columnar_zigzag(values[i], previous));
+            previous = values[i];
+        }
+    }
+
+    return l;
+}
+
+static int columnar_decode_column(const uint8_t* bytes, size_t length, uint64_t* values, size_t nb_values)
+{
+    int ret = (length < 1) ? -1 : 0;
+    size_t l = 1;
+    size_t i = 0;
+    uint64_t previous = 0;
+
+    while (ret == 0 && i < nb_values) {
+        uint64_t z = 0;
+        uint64_t run = 0;
+        size_t consumed = columnar_varint_decode(bytes + l, length - l, &z);
+
+        l += consumed;
+        if (consumed == 0) {
+            ret = -1;
+        }
+        else if (bytes[0] == COLUMNAR_ENCODING_DELTA) {
+            previous = values[i++] = columnar_unzigzag(z, previous);
+        }
+        else if (bytes[0] == COLUMNAR_ENCODING_DELTA_RLE &&
+            (consumed = columnar_varint_decode(bytes + l, length - l, &run)) != 0 && run < nb_values - i) {
+            l += consumed;
+            for (uint64_t j = 0; j <= run; j++) {
+                previous = values[i++] = columnar_unzigzag(z, previous);
+            }
+        }
+        else {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && l != length) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int columnar_flush_rows(columnar_writer_t* writer)
+{
+    int ret = 0;
+
+    if (writer->nb_rows > 0) {
+        ret |= columnar_fwrite_varint(writer->f, COLUMNAR_BLOCK_ROWS_DATA);
+        ret |= columnar_fwrite_varint(writer->f, writer->nb_rows);
+        for (int c = 0; ret == 0 && c < columnar_column_max; c++) {
+            size_t length = columnar_encode_column(writer->column[c], writer->nb_rows, writer->buffer);
+
+            ret |= columnar_fwrite_varint(writer->f, length);
+            if (fwrite(writer->buffer, length, 1, writer->f) != 1) {
+                ret = -1;
+            }
+        }
+        writer->nb_rows = 0;
+    }
+
+    return ret;
+}
+
+/* Find the connection in the dictionary, or add it and write the
+ * dictionary entry, which always precedes the rows that refer to it. */
+static columnar_cnx_t* columnar_get_cnx(columnar_writer_t* writer, const picoquic_connection_id_t* cid)
+{
+    columnar_cnx_t* cnx = NULL;
+    picohash_item* item = picohash_retrieve(writer->cnx_table, cid);
+
+    if (item != NULL) {
+        cnx = (columnar_cnx_t*)item->key;
+    }
+    else if ((cnx = (columnar_cnx_t*)malloc(sizeof(columnar_cnx_t))) != NULL) {
+        memset(cnx, 0, sizeof(columnar_cnx_t));
+        cnx->cid = *cid;
+        cnx->cid_index = writer->nb_cnx;
+        if (picohash_insert(writer->cnx_table, cnx) != 0) {
+            free(cnx);
+            cnx = NULL;
+        }
+        else if (columnar_fwrite_varint(writer->f, COLUMNAR_BLOCK_CID) != 0 ||
+            columnar_fwrite_varint(writer->f, cnx->cid_index) != 0 ||
+            fputc(cid->id_len, writer->f) == EOF ||
+            (cid->id_len > 0 && fwrite(cid->id, cid->id_len, 1, writer->f) != 1)) {
+            cnx = NULL;
+        }
+        else {
+            writer->nb_cnx++;
+        }
+    }
+
+    return cnx;
+}
+
+static int columnar_add_row(columnar_writer_t* writer, columnar_cnx_t* cnx, uint64_t time, uint64_t path_id,
+    uint64_t pn, uint64_t size, columnar_event_enum event_type)
+{
+    int ret = 0;
+    size_t r = writer->nb_rows++;
+
+    writer->column[columnar_column_time][r] = time;
+    writer->column[columnar_column_cid][r] = cnx->cid_index;
+    writer->column[columnar_column_path][r] = path_id;
+    writer->column[columnar_column_pn][r] = pn;
+    writer->column[columnar_column_size][r] = size;
+    writer->column[columnar_column_cwin][r] = cnx->cwin;
+    writer->column[columnar_column_rtt][r] = cnx->rtt;
+    writer->column[columnar_column_event][r] = event_type;
+
+    if (writer->nb_rows >= COLUMNAR_BLOCK_ROWS) {
+        ret = columnar_flush_rows(writer);
+    }
+
+    return ret;
+}
+
+static int columnar_event_cb(bytestream* s, void* ptr)
+{
+    columnar_writer_t* writer = (columnar_writer_t*)ptr;
+    columnar_cnx_t* cnx = NULL;
+    picoquic_connection_id_t cid;
+    uint64_t time = 0;
+    uint64_t path_id = 0;
+    uint64_t id = 0;
+    uint64_t packet_type = 0;
+    uint64_t pn = 0;
+    uint64_t size = 0;
+    int ret = 0;
+
+    ret |= byteread_cid(s, &cid);
+    ret |= byteread_vint(s, &time);
+    ret |= byteread_vint(s, &path_id);
+    ret |= byteread_vint(s, &id);
+
+    if (ret != 0 || (writer->cid != NULL && picoquic_compare_connection_id(&cid, writer->cid) != 0)) {
+        return ret;
+    }
+
+    switch (id) {
+    case picoquic_log_event_packet_recv:
+    case picoquic_log_event_packet_sent: {
+        uint8_t header_flags = 0;
+        uint64_t payload_length = 0;
+
+        ret |= byteread_vint(s, &size);
+        ret |= byteread_int8(s, &header_flags);
+        ret |= byteread_vint(s, &payload_length);
+        ret |= byteread_vint(s, &packet_type);
+        ret |= byteread_vint(s, &pn);
+        if (ret == 0 && (cnx = columnar_get_cnx(writer, &cid)) != NULL) {
+            ret = columnar_add_row(writer, cnx, time, path_id, pn, size, (id == picoquic_log_event_packet_sent) ?
+                columnar_event_packet_sent : columnar_event_packet_received);
+        }
+        break;
+    }
+    case picoquic_log_event_packet_lost: {
+        uint64_t trigger_length = 0;
+        uint8_t cid_len = 0;
+
+        ret |= byteread_vint(s, &packet_type);
+        ret |= byteread_vint(s, &pn);
+        ret |= byteread_vint(s, &trigger_length);
+        ret |= bytestream_skip(s, (size_t)trigger_length);
+        ret |= byteread_int8(s, &cid_len);
+        ret |= bytestream_skip(s, cid_len);
+        ret |= byteread_vint(s, &size);
+        if (ret == 0 && (cnx = columnar_get_cnx(writer, &cid)) != NULL) {
+            ret = columnar_add_row(writer, cnx, time, path_id, pn, size, columnar_event_packet_lost);
+        }
+        break;
+    }
+    case picoquic_log_event_packet_dropped:
+        ret |= byteread_vint(s, &packet_type);
+        ret |= byteread_vint(s, &size);
+        if (ret == 0 && (cnx = columnar_get_cnx(writer, &cid)) != NULL) {
+            ret = columnar_add_row(writer, cnx, time, path_id, 0, size, columnar_event_packet_dropped);
+        }
+        break;
+    case picoquic_log_event_cc_update: {
+        uint64_t packet_rcvd = 0;
+        uint64_t cwin = 0;
+        uint64_t skipped = 0;
+        uint64_t srtt = 0;
+
+        ret |= byteread_vint(s, &pn);
+        ret |= byteread_vint(s, &packet_rcvd);
+        if (packet_rcvd != 0) {
+            /* highest ack, high ack time, last time ack */
+            ret |= byteread_skip_vint(s);
+            ret |= byteread_skip_vint(s);
+            ret |= byteread_skip_vint(s);
+        }
+        ret |= byteread_vint(s, &cwin);
+        /* one way delay, rtt sample */
+        ret |= byteread_vint(s, &skipped);
+        ret |= byteread_vint(s, &skipped);
+        ret |= byteread_vint(s, &srtt);
+        if (ret == 0 && (cnx = columnar_get_cnx(writer, &cid)) != NULL) {
+            cnx->cwin = cwin;
+            cnx->rtt = srtt;
+            ret = columnar_add_row(writer, cnx, time, path_id, pn, 0, columnar_event_cc_update);
+        }
+        break;
+    }
+    default:
+        /* Other events are not exported */
+        return 0;
+    }
+
+    if (ret == 0 && cnx == NULL) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int columnar_convert(FILE* f_binlog, FILE* f_out, uint64_t log_time, const picoquic_connection_id_t* cid)
+{
+    int ret = 0;
+    uint8_t header[13] = { 'P', 'Q', 'C', 'L', COLUMNAR_VERSION };
+    columnar_writer_t* writer = (columnar_writer_t*)malloc(sizeof(columnar_writer_t));
+
+    if (writer == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(writer, 0, sizeof(columnar_writer_t));
+        writer->f = f_out;
+        writer->cid = cid;
+        if ((writer->cnx_table = cidset_create()) == NULL) {
+            ret = -1;
+        }
+        else {
+            picoformat_64(header + 5, log_time);
+            if (fwrite(header, sizeof(header), 1, f_out) != 1) {
+                ret = -1;
+            }
+            else if ((ret = fileread_binlog(f_binlog, columnar_event_cb, writer)) == 0 &&
+                (ret = columnar_flush_rows(writer)) == 0) {
+                ret = columnar_fwrite_varint(f_out, COLUMNAR_BLOCK_END);
+            }
+            (void)cidset_delete(writer->cnx_table);
+        }
+        free(writer);
+    }
+
+    return ret;
+}
+
+typedef struct st_columnar_reader_t {
+    picoquic_connection_id_t* cids;
+    size_t nb_cids;
+    size_t cids_size;
+    uint64_t column[columnar_column_max][COLUMNAR_BLOCK_ROWS];
+    uint8_t buffer[COLUMNAR_COLUMN_MAX];
+} columnar_reader_t;
+
+static int columnar_read_cid(FILE* f_in, columnar_reader_t* reader)
+{
+    int ret = 0;
+    uint64_t cid_index = 0;
+    int id_len;
+
+    if (columnar_fread_varint(f_in, &cid_index) != 0 || cid_index != reader->nb_cids ||
+        (id_len = fgetc(f_in)) == EOF || id_len > PICOQUIC_CONNECTION_ID_MAX_SIZE) {
+        ret = -1;
+    }
+    else {
+        if (reader->nb_cids >= reader->cids_size) {
+            size_t new_size = (reader->cids_size == 0) ? 16 : 2 * reader->cids_size;
+            picoquic_connection_id_t* new_cids = (picoquic_connection_id_t*)realloc(reader->cids,
+                new_size * sizeof(picoquic_connection_id_t));
+            if (new_cids == NULL) {
+                ret = -1;
+            }
+            else {
+                reader->cids = new_cids;
+                reader->cids_size = new_size;
+            }
+        }
+        if (ret == 0) {
+            picoquic_connection_id_t* cid = &reader->cids[reader->nb_cids];
+
+            memset(cid, 0, sizeof(picoquic_connection_id_t));
+            cid->id_len = (uint8_t)id_len;
+            if (id_len > 0 && fread(cid->id, id_len, 1, f_in) != 1) {
+                ret = -1;
+            }
+            else {
+                reader->nb_cids++;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int columnar_read_rows(FILE* f_in, columnar_reader_t* reader,
+    int (*row_cb)(const columnar_row_t* row, void* ptr), void* ptr)
+{
+    int ret = 0;
+    uint64_t nb_rows = 0;
+
+    if (columnar_fread_varint(f_in, &nb_rows) != 0 || nb_rows == 0 || nb_rows > COLUMNAR_BLOCK_ROWS) {
+        ret = -1;
+    }
+    for (int c = 0; ret == 0 && c < columnar_column_max; c++) {
+        uint64_t length = 0;
+
+        if (columnar_fread_varint(f_in, &length) != 0 || length > sizeof(reader->buffer) ||
+            fread(reader->buffer, (size_t)length, 1, f_in) != 1) {
+            ret = -1;
+        }
+        else {
+            ret = columnar_decode_column(reader->buffer, (size_t)length, reader->column[c], (size_t)nb_rows);
+        }
+    }
+    for (size_t r = 0; ret == 0 && r < nb_rows; r++) {
+        columnar_row_t row;
+
+        row.time = reader->column[columnar_column_time][r];
+        row.cid_index = reader->column[columnar_column_cid][r];
+        row.path_id = reader->column[columnar_column_path][r];
+        row.pn = reader->column[columnar_column_pn][r];
+        row.size = reader->column[columnar_column_size][r];
+        row.cwin = reader->column[columnar_column_cwin][r];
+        row.rtt = reader->column[columnar_column_rtt][r];
+        row.event_type = (columnar_event_enum)reader->column[columnar_column_event][r];
+        if (row.cid_index >= reader->nb_cids || row.event_type > columnar_event_cc_update) {
+            ret = -1;
+        }
+        else {
+            row.cid = &reader->cids[row.cid_index];
+            ret = row_cb(&row, ptr);
+        }
+    }
+
+    return ret;
+}
+
+int columnar_read(FILE* f_in, uint64_t* log_time, int (*row_cb)(const columnar_row_t* row, void* ptr), void* ptr)
+{
+    int ret = 0;
+    uint8_t header[13];
+    columnar_reader_t* reader = (columnar_reader_t*)malloc(sizeof(columnar_reader_t));
+
+    if (reader == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(reader, 0, sizeof(columnar_reader_t));
+        if (fread(header, sizeof(header), 1, f_in) != 1 || memcmp(header, "PQCL", 4) != 0 ||
+            header[4] != COLUMNAR_VERSION) {
+            ret = -1;
+        }
+        else {
+            uint64_t block_type = 0;
+
+            if (log_time != NULL) {
+                *log_time = PICOPARSE_64(header + 5);
+            }
+            while (ret == 0 && (ret = columnar_fread_varint(f_in, &block_type)) == 0 &&
+                block_type != COLUMNAR_BLOCK_END) {
+                switch (block_type) {
+                case COLUMNAR_BLOCK_ROWS_DATA:
+                    ret = columnar_read_rows(f_in, reader, row_cb, ptr);
+                    break;
+                case COLUMNAR_BLOCK_CID:
+                    ret = columnar_read_cid(f_in, reader);
+                    break;
+                default:
+                    ret = -1;
+                    break;
+                }
+            }
+        }
+        free(reader->cids);
+        free(reader);
+    }
+
+    return ret;
+}
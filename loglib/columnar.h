@@ -0,0 +1,94 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Columnar export of the packet events in a binary log.
+ *
+ * The file starts with the magic "PQCL", a version byte and the log time,
+ * followed by a sequence of blocks. Each block starts with its type:
+ * a connection ID dictionary entry, a block of rows, or the end of file.
+ * A block of rows contains up to COLUMNAR_BLOCK_ROWS events, stored as one
+ * column per field. Each column is delta encoded, and the deltas are stored
+ * either as plain varints or as run length encoded varints, whichever is
+ * shorter. Connection IDs and event types are dictionary encoded, so the
+ * per-row cost of these columns is usually a fraction of a byte.
+ */
+
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "picoquic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_BLOCK_ROWS 4096
+
+typedef enum {
+    columnar_event_packet_sent = 0,
+    columnar_event_packet_received,
+    columnar_event_packet_lost,
+    columnar_event_packet_dropped,
+    columnar_event_cc_update
+} columnar_event_enum;
+
+typedef enum {
+    columnar_column_time = 0,
+    columnar_column_cid,
+    columnar_column_path,
+    columnar_column_pn,
+    columnar_column_size,
+    columnar_column_cwin,
+    columnar_column_rtt,
+    columnar_column_event,
+    columnar_column_max
+} columnar_column_enum;
+
+/* The congestion window and smoothed RTT of packet events are the values
+ * of the most recent cc_update event of the connection. */
+typedef struct st_columnar_row_t {
+    uint64_t time;
+    uint64_t cid_index;
+    const picoquic_connection_id_t* cid;
+    uint64_t path_id;
+    uint64_t pn;
+    uint64_t size;
+    uint64_t cwin;
+    uint64_t rtt;
+    columnar_event_enum event_type;
+} columnar_row_t;
+
+/* Convert the packet and congestion control events of a binary log file
+ * in columnar format, in a single pass over the file. If cid is not NULL,
+ * only the events of that connection are exported. */
+int columnar_convert(FILE* f_binlog, FILE* f_out, uint64_t log_time, const picoquic_connection_id_t* cid);
+
+/* Read a columnar file and call row_cb for each row, in log order. */
+int columnar_read(FILE* f_in, uint64_t* log_time, int (*row_cb)(const columnar_row_t* row, void* ptr), void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COLUMNAR_H */
@@ -119,6 +119,8 @@ const char * ftype2str(picoquic_frame_type_enum_t ftype)
         return "path_available";
     case picoquic_frame_type_bdp:
         return "bdp";
+    case picoquic_frame_type_fec_repair:
+        return "fec_repair";
     case picoquic_frame_type_max_paths:
         return "max_paths";
     default:
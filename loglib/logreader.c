@@ -23,6 +23,13 @@
 #include <string.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <stdlib.h>
+#ifndef _WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "picoquic_internal.h"
 #include "bytestream.h"
@@ -336,3 +343,273 @@ FILE * picoquic_open_cc_log_file_for_read(char const * bin_cc_log_name, uint16_t
 
     return bin_log;
 }
+
+/* Memory mapped binary logs.
+ *
+ * Converting a log with many connections through fileread_binlog requires
+ * reading the whole file once per connection. Instead, the file is mapped
+ * in memory and scanned once, recording the offsets of the events of each
+ * connection. The conversion of a connection then only touches the pages
+ * that contain its events, and several connections can be converted in
+ * parallel since the map is read only.
+ */
+
+static void binlog_map_unmap(binlog_map_t* map)
+{
+#ifdef _WINDOWS
+    if (map->data != NULL) {
+        (void)UnmapViewOfFile(map->data);
+    }
+    if (map->map_handle != NULL) {
+        (void)CloseHandle(map->map_handle);
+    }
+    if (map->file_handle != INVALID_HANDLE_VALUE) {
+        (void)CloseHandle(map->file_handle);
+    }
+#else
+    if (map->data != NULL) {
+        (void)munmap((void*)map->data, map->size);
+    }
+    if (map->fd >= 0) {
+        (void)close(map->fd);
+    }
+#endif
+    map->data = NULL;
+}
+
+static int binlog_map_file(binlog_map_t* map, char const* binlog_name)
+{
+    int ret = 0;
+#ifdef _WINDOWS
+    LARGE_INTEGER file_size;
+
+    map->file_handle = CreateFileA(binlog_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (map->file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(map->file_handle, &file_size) ||
+        (uint64_t)file_size.QuadPart > (uint64_t)SIZE_MAX) {
+        ret = -1;
+    }
+    else if ((map->size = (size_t)file_size.QuadPart) > 0) {
+        map->map_handle = CreateFileMappingA(map->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map->map_handle == NULL ||
+            (map->data = (const uint8_t*)MapViewOfFile(map->map_handle, FILE_MAP_READ, 0, 0, 0)) == NULL) {
+            ret = -1;
+        }
+    }
+#else
+    struct stat st;
+
+    if ((map->fd = open(binlog_name, O_RDONLY)) < 0 || fstat(map->fd, &st) != 0 ||
+        (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        ret = -1;
+    }
+    else if ((map->size = (size_t)st.st_size) > 0) {
+        void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+        if (data == MAP_FAILED) {
+            ret = -1;
+        }
+        else {
+            map->data = (const uint8_t*)data;
+#ifdef MADV_SEQUENTIAL
+            (void)madvise(data, map->size, MADV_SEQUENTIAL);
+#endif
+        }
+    }
+#endif
+    return ret;
+}
+
+static binlog_index_entry_t* binlog_map_add_entry(binlog_map_t* map, const picoquic_connection_id_t* cid)
+{
+    binlog_index_entry_t* entry = NULL;
+
+    if (map->nb_entries >= map->entries_size) {
+        size_t new_size = (map->entries_size == 0) ? 32 : 2 * map->entries_size;
+        binlog_index_entry_t** new_entries = (binlog_index_entry_t**)realloc(map->entries,
+            new_size * sizeof(binlog_index_entry_t*));
+        if (new_entries == NULL) {
+            return NULL;
+        }
+        map->entries = new_entries;
+        map->entries_size = new_size;
+    }
+
+    entry = (binlog_index_entry_t*)malloc(sizeof(binlog_index_entry_t));
+    if (entry != NULL) {
+        memset(entry, 0, sizeof(binlog_index_entry_t));
+        entry->cid = *cid;
+        if (picohash_insert(map->cids, entry) != 0) {
+            free(entry);
+            entry = NULL;
+        }
+        else {
+            map->entries[map->nb_entries++] = entry;
+        }
+    }
+
+    return entry;
+}
+
+static int binlog_index_entry_add(binlog_index_entry_t* entry, uint64_t offset)
+{
+    int ret = 0;
+
+    if (entry->offsets_length + 8 > entry->offsets_size) {
+        size_t new_size = (entry->offsets_size == 0) ? 256 : 2 * entry->offsets_size;
+        uint8_t* new_offsets = (uint8_t*)realloc(entry->offsets, new_size);
+        if (new_offsets == NULL) {
+            ret = -1;
+        }
+        else {
+            entry->offsets = new_offsets;
+            entry->offsets_size = new_size;
+        }
+    }
+    if (ret == 0) {
+        entry->offsets_length += picoquic_varint_encode(entry->offsets + entry->offsets_length,
+            entry->offsets_size - entry->offsets_length, offset - entry->last_offset);
+        entry->last_offset = offset;
+        entry->nb_events++;
+    }
+
+    return ret;
+}
+
+static int binlog_map_build_index(binlog_map_t* map)
+{
+    int ret = 0;
+    size_t offset = 16;
+    binlog_index_entry_t* last_entry = NULL;
+
+    while (ret == 0 && offset + 4 <= map->size) {
+        const uint8_t* head = map->data + offset;
+        uint32_t len = (head[0] << 24) | (head[1] << 16) | (head[2] << 8) | head[3];
+        picoquic_connection_id_t cid;
+        bytestream stream;
+        bytestream* s;
+
+        offset += 4;
+        if (len > map->size - offset) {
+            /* Truncated event, e.g., log file of a running server */
+            break;
+        }
+        s = bytestream_ref_init(&stream, map->data + offset, len);
+        if (byteread_cid(s, &cid) == 0) {
+            /* Consecutive events usually belong to the same connection */
+            if (last_entry == NULL || picoquic_compare_connection_id(&last_entry->cid, &cid) != 0) {
+                if ((last_entry = binlog_map_find(map, &cid)) == NULL &&
+                    (last_entry = binlog_map_add_entry(map, &cid)) == NULL) {
+                    ret = -1;
+                }
+            }
+            if (ret == 0) {
+                ret = binlog_index_entry_add(last_entry, offset - 4);
+            }
+        }
+        offset += len;
+    }
+
+    return ret;
+}
+
+binlog_map_t* binlog_map_open(char const* binlog_name)
+{
+    binlog_map_t* map = (binlog_map_t*)malloc(sizeof(binlog_map_t));
+
+    if (map != NULL) {
+        int ret = 0;
+        memset(map, 0, sizeof(binlog_map_t));
+#ifdef _WINDOWS
+        map->file_handle = INVALID_HANDLE_VALUE;
+#else
+        map->fd = -1;
+#endif
+        if (binlog_map_file(map, binlog_name) != 0 || map->size < 16) {
+            DBG_PRINTF("Cannot map log file %s.\n", binlog_name);
+            ret = -1;
+        }
+        else {
+            uint32_t fcc = 0;
+            uint16_t version = 0;
+            bytestream stream;
+            bytestream* ps = bytestream_ref_init(&stream, map->data, 16);
+
+            if (byteread_int32(ps, &fcc) != 0 || fcc != FOURCC('q', 'l', 'o', 'g') ||
+                byteread_int16(ps, &map->flags) != 0 ||
+                byteread_int16(ps, &version) != 0 || version != 0x01 ||
+                byteread_int64(ps, &map->log_time) != 0) {
+                DBG_PRINTF("Invalid header for file %s.\n", binlog_name);
+                ret = -1;
+            }
+            else if ((map->cids = cidset_create()) == NULL || binlog_map_build_index(map) != 0) {
+                DBG_PRINTF("Cannot index file %s.\n", binlog_name);
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            binlog_map_close(map);
+            map = NULL;
+        }
+    }
+
+    return map;
+}
+
+void binlog_map_close(binlog_map_t* map)
+{
+    if (map != NULL) {
+        for (size_t i = 0; i < map->nb_entries; i++) {
+            if (map->entries[i]->offsets != NULL) {
+                free(map->entries[i]->offsets);
+            }
+        }
+        if (map->cids != NULL) {
+            /* Deletes the entries, which are the keys of the table */
+            picohash_delete(map->cids, 1);
+        }
+        if (map->entries != NULL) {
+            free(map->entries);
+        }
+        binlog_map_unmap(map);
+        free(map);
+    }
+}
+
+binlog_index_entry_t* binlog_map_find(const binlog_map_t* map, const picoquic_connection_id_t* cid)
+{
+    picohash_item* item = picohash_retrieve(map->cids, cid);
+    return (item == NULL) ? NULL : (binlog_index_entry_t*)item->key;
+}
+
+int binlog_map_convert(const binlog_map_t* map, const binlog_index_entry_t* entry, binlog_convert_cb_t* callbacks)
+{
+    int ret = 0;
+    size_t index_pos = 0;
+    uint64_t offset = 0;
+    convert_log_file_event_t ctx;
+
+    ctx.cid = &entry->cid;
+    ctx.callbacks = callbacks;
+
+    for (uint64_t i = 0; ret == 0 && i < entry->nb_events; i++) {
+        uint64_t delta = 0;
+        size_t l_delta = picoquic_varint_decode(entry->offsets + index_pos, entry->offsets_length - index_pos, &delta);
+
+        if (l_delta == 0) {
+            ret = -1;
+        }
+        else {
+            const uint8_t* head;
+            uint32_t len;
+            bytestream stream;
+
+            index_pos += l_delta;
+            offset += delta;
+            head = map->data + offset;
+            len = (head[0] << 24) | (head[1] << 16) | (head[2] << 8) | head[3];
+            ret = binlog_convert_event(bytestream_ref_init(&stream, head + 4, len), &ctx);
+        }
+    }
+
+    return ret;
+}
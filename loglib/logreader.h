@@ -104,6 +104,55 @@ FILE * open_outfile(const char * cid_name, const char * binlog_name, const char
 
 FILE * picoquic_open_cc_log_file_for_read(char const * bin_cc_log_name, uint16_t * flags, uint64_t * log_time);
 
+/*! \brief Events of a connection in a memory mapped binary log file.
+ *
+ *  The offsets of the events are delta encoded as varints, which typically
+ *  requires 2 or 3 bytes per event.
+ */
+typedef struct st_binlog_index_entry_t {
+    picoquic_connection_id_t cid; /*!< Must be first, the entry is also the key in the cidset */
+    uint64_t nb_events;
+    uint64_t last_offset;
+    uint8_t* offsets;
+    size_t offsets_length;
+    size_t offsets_size;
+} binlog_index_entry_t;
+
+/*! \brief Memory mapped binary log file, with an index of the events of
+ *         each connection, built in a single pass over the file.
+ */
+typedef struct st_binlog_map_t {
+    const uint8_t* data;
+    size_t size;
+    uint16_t flags;
+    uint64_t log_time;
+    picohash_table* cids;
+    binlog_index_entry_t** entries; /*!< Connections in order of their first event */
+    size_t nb_entries;
+    size_t entries_size;
+#ifdef _WINDOWS
+    HANDLE file_handle;
+    HANDLE map_handle;
+#else
+    int fd;
+#endif
+} binlog_map_t;
+
+/*! \brief Map a binary log file in memory and index the events per connection.
+ *         Returns NULL if the file cannot be mapped or is not a valid log.
+ */
+binlog_map_t* binlog_map_open(char const* binlog_name);
+
+void binlog_map_close(binlog_map_t* map);
+
+binlog_index_entry_t* binlog_map_find(const binlog_map_t* map, const picoquic_connection_id_t* cid);
+
+/*! \brief Convert the events of an indexed connection into a sequence of log
+ *         event calls, without copying the events. The map is only read, so
+ *         several connections can be converted in parallel.
+ */
+int binlog_map_convert(const binlog_map_t* map, const binlog_index_entry_t* entry, binlog_convert_cb_t* callbacks);
+
 int picoquic_cc_log_file_to_csv(char const * bin_cc_log_name, char const * csv_cc_log_name);
 
 #ifdef __cplusplus
@@ -1146,6 +1146,22 @@ void qlog_bdp_frame(FILE* f, bytestream* s)
     qlog_string(f, s, ip_len);
 }
 
+void qlog_fec_repair_frame(FILE* f, bytestream* s)
+{
+    uint64_t key = 0;
+    uint64_t first_pn = 0;
+    uint64_t nb_pn = 0;
+    uint64_t repair_length = 0;
+
+    byteread_vint(s, &key);
+    byteread_vint(s, &first_pn);
+    byteread_vint(s, &nb_pn);
+    bytestream_skip(s, (size_t)((nb_pn + 7) / 8));
+    byteread_vint(s, &repair_length);
+    fprintf(f, ", \"key\": %"PRIu64", \"first_pn\": %"PRIu64", \"nb_pn\": %"PRIu64", \"length\": %"PRIu64"",
+        key, first_pn, nb_pn, repair_length);
+}
+
 int qlog_packet_frame(bytestream * s, void * ptr)
 {
     qlog_context_t * ctx = (qlog_context_t*)ptr;
@@ -1276,6 +1292,9 @@ int qlog_packet_frame(bytestream * s, void * ptr)
     case picoquic_frame_type_bdp:
         qlog_bdp_frame(f, s);
         break;
+    case picoquic_frame_type_fec_repair:
+        qlog_fec_repair_frame(f, s);
+        break;
     case picoquic_frame_type_max_paths:
         qlog_max_paths_frame(f, s);
         break;
@@ -1534,7 +1553,10 @@ int qlog_connection_end(uint64_t time, void * ptr)
     return 0;
 }
 
-int qlog_convert(const picoquic_connection_id_t* cid, FILE* f_binlog, const char* binlog_name, const char* txt_name, const char* out_dir, uint16_t flags)
+/* Convert the events of a connection, read either from the log file or from
+ * the memory mapped and indexed log. */
+static int qlog_convert_ex(const picoquic_connection_id_t* cid, FILE* f_binlog, const binlog_map_t* map,
+    const binlog_index_entry_t* entry, const char* binlog_name, const char* txt_name, const char* out_dir, uint16_t flags)
 {
     int ret = 0;
     FILE* f_txtlog = NULL;
@@ -1583,7 +1605,12 @@ int qlog_convert(const picoquic_connection_id_t* cid, FILE* f_binlog, const char
         ctx.info_message = qlog_info_message;
         ctx.ptr = &qlog;
 
-        ret = binlog_convert(f_binlog, cid, &ctx);
+        if (map != NULL) {
+            ret = binlog_map_convert(map, entry, &ctx);
+        }
+        else {
+            ret = binlog_convert(f_binlog, cid, &ctx);
+        }
 
         if (qlog.state == 1) {
             qlog_connection_end(0, &qlog);
@@ -1594,3 +1621,13 @@ int qlog_convert(const picoquic_connection_id_t* cid, FILE* f_binlog, const char
 
     return ret;
 }
+
+int qlog_convert(const picoquic_connection_id_t* cid, FILE* f_binlog, const char* binlog_name, const char* txt_name, const char* out_dir, uint16_t flags)
+{
+    return qlog_convert_ex(cid, f_binlog, NULL, NULL, binlog_name, txt_name, out_dir, flags);
+}
+
+int qlog_convert_indexed(const binlog_map_t* map, const binlog_index_entry_t* entry, const char* binlog_name, const char* txt_name, const char* out_dir)
+{
+    return qlog_convert_ex(&entry->cid, NULL, map, entry, binlog_name, txt_name, out_dir, map->flags);
+}
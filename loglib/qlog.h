@@ -23,6 +23,7 @@
 
 #include "picoquic_internal.h"
 #include "bytestream.h"
+#include "logreader.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,7 @@ int qlog_connection_start(uint64_t time, const picoquic_connection_id_t * cid, i
 int qlog_connection_end(uint64_t time, void * ptr);
 
 int qlog_convert(const picoquic_connection_id_t* cid, FILE * f_binlog, const char * binlog_name, const char* txt_name, const char * out_dir, uint16_t flags);
+int qlog_convert_indexed(const binlog_map_t* map, const binlog_index_entry_t* entry, const char* binlog_name, const char* txt_name, const char* out_dir);
 
 #ifdef __cplusplus
 }
@@ -453,7 +453,7 @@ int picoquic_h09_server_process_data(picoquic_cnx_t* cnx,
                     picoquic_add_to_stream_with_ctx(cnx, stream_id, post_response,
                         (size_t)stream_ctx->response_length, 1, (void*)stream_ctx);
                 }
-                else {
+                else if (stream_ctx->echo_length == 0 || h3zero_queue_response_file(cnx, app_ctx, stream_ctx) != 0) {
                     picoquic_mark_active_stream(cnx, stream_ctx->stream_id, 1, stream_ctx);
                 }
             }
@@ -1082,7 +1082,9 @@ int h3zero_process_request_frame(
 			ret = picoquic_reset_stream(cnx, stream_ctx->stream_id, H3ZERO_INTERNAL_ERROR);
 		}
 		else if (stream_ctx->echo_length != 0 || response_length > sizeof(post_response)) {
-			ret = picoquic_mark_active_stream(cnx, stream_ctx->stream_id, 1, stream_ctx);
+			if (stream_ctx->echo_length == 0 || h3zero_queue_response_file(cnx, app_ctx, stream_ctx) != 0) {
+				ret = picoquic_mark_active_stream(cnx, stream_ctx->stream_id, 1, stream_ctx);
+			}
 		}
 	}
 
@@ -1460,6 +1462,36 @@ int h3zero_prepare_to_send(int client_mode, void* context, size_t space,
 	return ret;
 }
 
+/* Queue the requested file directly on the stream, so that the transport
+ * reads it from disk when formatting stream frames. Returns an error if
+ * the file cannot be opened or queued, in which case the caller can fall
+ * back to sending the data through the prepare to send callback.
+ * On success, the whole response is queued and the stream context is
+ * deleted, as is done in the prepare to send callback after the last
+ * bytes are sent.
+ */
+int h3zero_queue_response_file(picoquic_cnx_t* cnx, h3zero_callback_ctx_t* ctx, h3zero_stream_ctx_t* stream_ctx)
+{
+	int ret = -1;
+
+	if (stream_ctx->F == NULL && stream_ctx->file_path != NULL && stream_ctx->echo_sent == 0) {
+		FILE* F = picoquic_file_open(stream_ctx->file_path, "rb");
+
+		if (F != NULL) {
+			ret = picoquic_add_file_to_stream(cnx, stream_ctx->stream_id, F, 0, stream_ctx->echo_length, 1, stream_ctx);
+			if (ret == 0) {
+				stream_ctx->echo_sent = stream_ctx->echo_length;
+				h3zero_delete_stream(cnx, ctx, stream_ctx);
+			}
+			else {
+				(void)picoquic_file_close(F);
+			}
+		}
+	}
+
+	return ret;
+}
+
 int h3zero_callback_prepare_to_send(picoquic_cnx_t* cnx,
 	uint64_t stream_id, h3zero_stream_ctx_t * stream_ctx,
 	void * context, size_t space, h3zero_callback_ctx_t* ctx)
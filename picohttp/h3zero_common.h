@@ -249,6 +249,8 @@ extern "C" {
 
     int h3zero_prepare_and_send_data(void* context, size_t space, uint64_t send_total_length, uint64_t* sent_length, FILE* F);
 
+    int h3zero_queue_response_file(picoquic_cnx_t* cnx, h3zero_callback_ctx_t* ctx, h3zero_stream_ctx_t* stream_ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,7 @@
 #include "csv.h"
 #include "svg.h"
 #include "qlog.h"
+#include "columnar.h"
 #include "cidset.h"
 #include "logreader.h"
 #ifdef _WINDOWS
@@ -52,7 +53,7 @@ typedef struct app_conversion_context_st
 
 int convert_csv(const picoquic_connection_id_t * cid, void * ptr);
 int convert_svg(const picoquic_connection_id_t * cid, void * ptr);
-int convert_qlog(const picoquic_connection_id_t * cid, void * ptr);
+int convert_qlog_indexed(const app_conversion_context_t* appctx, const picoquic_connection_id_t* cid, int nb_threads);
 int filedump_binlog(FILE* bin_log, FILE* bin_dump);
 
 int usage();
@@ -82,8 +83,9 @@ int main(int argc, char ** argv)
     app_conversion_context_t appctx = { 0 };
     appctx.out_format = "csv";
 
+    int nb_threads = 1;
     int opt;
-    while ((opt = getopt(argc, argv, "o:f:t:c:h")) != -1) {
+    while ((opt = getopt(argc, argv, "o:f:t:c:j:h")) != -1) {
         switch (opt) {
         case 'o':
             appctx.out_dir = optarg;
@@ -97,6 +99,12 @@ int main(int argc, char ** argv)
         case 'c':
             cid_name = optarg;
             break;
+        case 'j':
+            if ((nb_threads = atoi(optarg)) < 1) {
+                fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+                return usage();
+            }
+            break;
         case 'h':
         default:
             return usage();
@@ -147,6 +155,28 @@ int main(int argc, char ** argv)
                 }
             }
         }
+        else if (strcmp(appctx.out_format, "columnar") == 0) {
+            char columnar_file_name[512];
+            FILE* f_columnar = NULL;
+            size_t name_len = 0;
+
+            ret = picoquic_sprintf(columnar_file_name, sizeof(columnar_file_name), &name_len, "%s.pqcl", appctx.binlog_name);
+            if (ret == 0) {
+                f_columnar = picoquic_file_open(columnar_file_name, "wb");
+                if (f_columnar == NULL) {
+                    fprintf(stderr, "Could not open columnar file %s\n", columnar_file_name);
+                    ret = -1;
+                }
+                else {
+                    ret = columnar_convert(appctx.f_binlog, f_columnar, appctx.log_time,
+                        picoquic_is_connection_id_null(&cid) ? NULL : &cid);
+                    (void)picoquic_file_close(f_columnar);
+                }
+            }
+        }
+        else if (strcmp(appctx.out_format, "qlog") == 0) {
+            ret = convert_qlog_indexed(&appctx, &cid, nb_threads);
+        }
         else {
             if (appctx.template_name != NULL) {
                 appctx.f_template = picoquic_file_open(appctx.template_name, "r");
@@ -194,9 +224,6 @@ int main(int argc, char ** argv)
                         ret = cidset_iterate(cids, convert_svg, &appctx);
                     }
                 }
-                else if (strcmp(appctx.out_format, "qlog") == 0) {
-                    ret = cidset_iterate(cids, convert_qlog, &appctx);
-                }
                 else {
                     fprintf(stderr, "Invalid output format '%s'. Valid formats are\n\n", appctx.out_format);
                     usage_formats();
@@ -224,6 +251,7 @@ int usage()
     usage_formats();
     fprintf(stderr, "  -t template-file      template file for svg format conversion\n");
     fprintf(stderr, "  -c connection-id      only convert logs of specified connection id\n");
+    fprintf(stderr, "  -j threads            number of connections converted in parallel, qlog format only\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "picolog converts binary log files into the format specified. Output files are\n");
     fprintf(stderr, "placed in the specified directory with their connection-id as file name.\n");
@@ -240,6 +268,8 @@ void usage_formats()
     fprintf(stderr, "                        -f svg  : generate svg packet flow diagram.\n");
     fprintf(stderr, "                                  requires a template specified by -t\n");
     fprintf(stderr, "                        -f qlog : generate IETF QLOG file\n");
+    fprintf(stderr, "                        -f columnar : generate a columnar file of packet\n");
+    fprintf(stderr, "                                  events for all connections, named <input>.pqcl\n");
 }
 
 int convert_csv(const picoquic_connection_id_t * cid, void * ptr)
@@ -267,10 +297,108 @@ int convert_svg(const picoquic_connection_id_t * cid, void * ptr)
     return svg_convert(cid, appctx->f_binlog, appctx->f_template, appctx->binlog_name, appctx->out_dir);
 }
 
-int convert_qlog(const picoquic_connection_id_t * cid, void * ptr)
+/* Conversion of the memory mapped log to qlog. The log is indexed in a
+ * single pass, then the connections are converted by a pool of threads,
+ * each writing its own output file.
+ */
+typedef struct st_qlog_worker_ctx_t {
+    const app_conversion_context_t* appctx;
+    const binlog_map_t* map;
+    picoquic_mutex_t mutex;
+    size_t next_entry;
+    int ret;
+} qlog_worker_ctx_t;
+
+static picoquic_thread_return_t qlog_worker(void* arg)
 {
-    const app_conversion_context_t* appctx = (const app_conversion_context_t*)ptr;
-    return qlog_convert(cid, appctx->f_binlog, appctx->binlog_name, NULL, appctx->out_dir, appctx->flags);
+    qlog_worker_ctx_t* ctx = (qlog_worker_ctx_t*)arg;
+
+    while (1) {
+        size_t i;
+        int ret;
+
+        picoquic_lock_mutex(&ctx->mutex);
+        i = ctx->next_entry++;
+        picoquic_unlock_mutex(&ctx->mutex);
+        if (i >= ctx->map->nb_entries) {
+            break;
+        }
+        if ((ret = qlog_convert_indexed(ctx->map, ctx->map->entries[i], ctx->appctx->binlog_name, NULL, ctx->appctx->out_dir)) != 0) {
+            picoquic_lock_mutex(&ctx->mutex);
+            ctx->ret = ret;
+            picoquic_unlock_mutex(&ctx->mutex);
+        }
+    }
+
+    picoquic_thread_do_return;
+}
+
+int convert_qlog_indexed(const app_conversion_context_t* appctx, const picoquic_connection_id_t* cid, int nb_threads)
+{
+    int ret = 0;
+    binlog_map_t* map = binlog_map_open(appctx->binlog_name);
+
+    if (map == NULL) {
+        fprintf(stderr, "Could not map log file %s\n", appctx->binlog_name);
+        ret = -1;
+    }
+    else {
+        fprintf(stderr, "%s contains %"PRIst" connection(s):\n\n", appctx->binlog_name, map->nb_entries);
+        cidset_print(stderr, map->cids);
+        fprintf(stderr, "\n");
+
+        if (!picoquic_is_connection_id_null(cid)) {
+            binlog_index_entry_t* entry = binlog_map_find(map, cid);
+            if (entry == NULL) {
+                fprintf(stderr, "%s does not contain the requested connection\n", appctx->binlog_name);
+                ret = -1;
+            }
+            else {
+                ret = qlog_convert_indexed(map, entry, appctx->binlog_name, NULL, appctx->out_dir);
+            }
+        }
+        else {
+            qlog_worker_ctx_t ctx;
+            picoquic_thread_t* threads = NULL;
+            int nb_started = 0;
+
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.appctx = appctx;
+            ctx.map = map;
+            if ((size_t)nb_threads > map->nb_entries) {
+                nb_threads = (int)map->nb_entries;
+            }
+            if (nb_threads > 1 && (threads = (picoquic_thread_t*)malloc(nb_threads * sizeof(picoquic_thread_t))) == NULL) {
+                nb_threads = 1;
+            }
+            if (picoquic_create_mutex(&ctx.mutex) != 0) {
+                ret = -1;
+            }
+            else {
+                for (int i = 1; i < nb_threads; i++) {
+                    if (picoquic_create_thread(&threads[nb_started], qlog_worker, &ctx) == 0) {
+                        nb_started++;
+                    }
+                }
+                /* The main thread is also a worker */
+                (void)qlog_worker(&ctx);
+                for (int i = 0; i < nb_started; i++) {
+                    (void)picoquic_wait_thread(threads[i]);
+#ifdef _WINDOWS
+                    CloseHandle(threads[i]);
+#endif
+                }
+                (void)picoquic_delete_mutex(&ctx.mutex);
+                ret = ctx.ret;
+            }
+            if (threads != NULL) {
+                free(threads);
+            }
+        }
+        binlog_map_close(map);
+    }
+
+    return ret;
 }
 
 int filedump_binlog(FILE* bin_log, FILE* bin_dump)
@@ -101,9 +101,13 @@ typedef enum {
 
 
 
-#define BBRLossThresh 0.2 /* maximum tolerated packet loss (default: 20%) */
+/* Gains and ratios are fixed point values, see PICOQUIC_CC_GAIN in cc_common.h,
+ * except BBRBeta: the double nearest to 0.7 is slightly smaller than 0.7, and
+ * the fixed point product would differ by one byte for some values. It is
+ * only applied on loss, so it stays a double. */
+#define BBRLossThresh PICOQUIC_CC_GAIN(0.2) /* maximum tolerated packet loss (default: 20%) */
 #define BBRBeta 0.7 /* Multiplicative decrease on packet loss (default: 0.7) */
-#define BBRHeadroom 0.15 /* Realive amount of headroom left for other flows. (default: 0.15). (Erroneously set to 0.85 in draft-bbr-02) */
+#define BBRHeadroom PICOQUIC_CC_GAIN(0.15) /* Realive amount of headroom left for other flows. (default: 0.15). (Erroneously set to 0.85 in draft-bbr-02) */
 #define BBRMinPipeCwnd 4 /* Default to 4*SMSS, i.e, 4*PMTU */
 
 #define BBRMaxBwFilterLen 2 /* record bw_max for previous cycle and for this one */
@@ -111,26 +115,26 @@ typedef enum {
 
 #define BBRMinRTTFilterLen 10000000 /* Length of min rtt filter -- 10 seconds. */
 #define BBRRTTJitterBufferLen 7 /* Number of RTT amples retained to filter out jitter */
-#define BBRProbeRTTCwndGain 0.5
+#define BBRProbeRTTCwndGain PICOQUIC_CC_GAIN(0.5)
 #define BBRProbeRTTDuration 200000 /* 200msec, 200000 microsecs */
 #define BBRProbeRTTInterval 5000000 /* 5 seconds */
 
-#define BBRStartupPacingGain 2.77 /* constant, 4*ln(2), approx 2.77 */
-#define BBRStartupCwndGain 2.0 /* constant */
-#define BBRStartupIncreaseThreshold 1.25
+#define BBRStartupPacingGain PICOQUIC_CC_GAIN(2.77) /* constant, 4*ln(2), approx 2.77 */
+#define BBRStartupCwndGain PICOQUIC_CC_GAIN(2.0) /* constant */
+#define BBRStartupIncreaseThreshold PICOQUIC_CC_GAIN(1.25)
 
-#define BBRStartupResumePacingGain 1.25 /* arbitrary */
-#define BBRStartupResumeCwndGain 1.25 /* arbitrary */
-#define BBRStartupResumeIncreaseThreshold 1.125
+#define BBRStartupResumePacingGain PICOQUIC_CC_GAIN(1.25) /* arbitrary */
+#define BBRStartupResumeCwndGain PICOQUIC_CC_GAIN(1.25) /* arbitrary */
+#define BBRStartupResumeIncreaseThreshold PICOQUIC_CC_GAIN(1.125)
 
-#define BBRProbeBwDownPacingGain 0.9
-#define BBRProbeBwDownCwndGain 2.0
-#define BBRProbeBwCruisePacingGain 1.0
-#define BBRProbeBwCruiseCwndGain 2.0
-#define BBRProbeBwRefillPacingGain 1.0
-#define BBRProbeBwRefillCwndGain 2.0
-#define BBRProbeBwUpPacingGain 1.25
-#define BBRProbeBwUpCwndGain 2.25
+#define BBRProbeBwDownPacingGain PICOQUIC_CC_GAIN(0.9)
+#define BBRProbeBwDownCwndGain PICOQUIC_CC_GAIN(2.0)
+#define BBRProbeBwCruisePacingGain PICOQUIC_CC_GAIN(1.0)
+#define BBRProbeBwCruiseCwndGain PICOQUIC_CC_GAIN(2.0)
+#define BBRProbeBwRefillPacingGain PICOQUIC_CC_GAIN(1.0)
+#define BBRProbeBwRefillCwndGain PICOQUIC_CC_GAIN(2.0)
+#define BBRProbeBwUpPacingGain PICOQUIC_CC_GAIN(1.25)
+#define BBRProbeBwUpCwndGain PICOQUIC_CC_GAIN(2.25)
 
 #define BBRMinRttMarginPercent 5 /* Margin factor of 20% for avoiding firing RTT Probe too often */
 #define BBRLongRttThreshold 250000
@@ -151,10 +155,10 @@ typedef struct st_picoquic_bbr_state_t {
     uint64_t send_quantum;
     uint64_t prior_cwnd;
     /* Pacing state */
-    double pacing_gain;
+    uint64_t pacing_gain; /* fixed point, see PICOQUIC_CC_GAIN */
     uint64_t next_departure_time; /* earliest departure time of next packet, per pacing conditions -- new in BBRv3 */
     /* CWND state */
-    double cwnd_gain;
+    uint64_t cwnd_gain; /* fixed point, see PICOQUIC_CC_GAIN */
     unsigned int packet_conservation : 1; /* whether BBR is using conservation dynamics */
     /*  Data Rate parameters: */
     uint64_t max_bw; /* windowed maximum recent bandwidth sample -- new in BBRv3 */
@@ -253,6 +257,7 @@ typedef struct st_picoquic_bbr_state_t {
     /* Experimental extensions, may or maynot be a good idea. */
     uint64_t wifi_shadow_rtt; /* Shadow RTT used for wifi connections. */
     double quantum_ratio; /* allow application to use a different default than 0.1% of bandwidth (or 1ms of traffic) */
+    unsigned int use_float_gains : 1; /* test option, apply gains in floating point as reference */
 
 } picoquic_bbr_state_t;
 
@@ -327,10 +332,10 @@ static void BBRUpdateMaxBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* pat
 static void BBRInitPacingRate(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x);
 static void BBRResetCongestionSignals(picoquic_bbr_state_t* bbr_state);
 static void BBRResetLowerBounds(picoquic_bbr_state_t* bbr_state);
-static uint64_t BBRInflightWithBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, double gain, uint64_t bw);
+static uint64_t BBRInflightWithBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t gain, uint64_t bw);
 static void BBRUpdateMaxInflight(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x);
 static uint64_t BBRInflightWithHeadroom(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x);
-static uint64_t BBRBDPMultiple(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, double gain);
+static uint64_t BBRBDPMultiple(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t gain);
 static void BBRAdaptUpperBounds(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, bbr_per_ack_state_t* rs, uint64_t current_time);
 static int InLossRecovery(picoquic_bbr_state_t* bbr_state);
 static int BBRHasElapsedInPhase(picoquic_bbr_state_t* bbr_state, uint64_t interval, uint64_t current_time);
@@ -438,6 +443,8 @@ static void BBROnInit(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x,
     if (bbr_state->quantum_ratio == 0) {
         bbr_state->quantum_ratio = 0.001;
     }
+    /* Test option: apply the gains in floating point, as a reference for the fixed point computations */
+    bbr_state->use_float_gains = path_x->cnx->quic->use_float_cc_gains;
 
     BBRResetCongestionSignals(bbr_state);
     BBRResetLowerBounds(bbr_state);
@@ -717,17 +724,28 @@ static void BBRCheckRecovery(picoquic_bbr_state_t* bbr_state, picoquic_path_t* p
     }
 }
 
+/* Apply a fixed point gain. The test option use_float_gains computes the
+ * same product in floating point, so that simulations can check that both
+ * paths make the same decisions. */
+static uint64_t BBRApplyGain(picoquic_bbr_state_t* bbr_state, uint64_t v, uint64_t gain)
+{
+    if (bbr_state->use_float_gains) {
+        return (uint64_t)(PICOQUIC_CC_GAIN_TO_DOUBLE(gain) * (double)v);
+    }
+    return PICOQUIC_CC_APPLY_GAIN(v, gain);
+}
+
 /* Computing the congestion window */
-static uint64_t BBRBDPMultipleWithBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, double gain, uint64_t bw)
+static uint64_t BBRBDPMultipleWithBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t gain, uint64_t bw)
 {
     if (bbr_state->min_rtt == UINT64_MAX) {
         return PICOQUIC_CWIN_INITIAL*path_x->send_mtu; /* no valid RTT samples yet */
     }
     bbr_state->bdp = (bw * bbr_state->min_rtt) / 1000000;
-    return (uint64_t)(gain * (double)bbr_state->bdp);
+    return BBRApplyGain(bbr_state, bbr_state->bdp, gain);
 }
 
-static uint64_t BBRBDPMultiple(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, double gain)
+static uint64_t BBRBDPMultiple(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t gain)
 {
     return BBRBDPMultipleWithBw(bbr_state, path_x, gain, bbr_state->bw);
 }
@@ -752,13 +770,13 @@ static uint64_t BBRQuantizationBudget(picoquic_bbr_state_t* bbr_state, picoquic_
     return inflight;
 }
 
-static uint64_t BBRInflightWithBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, double gain, uint64_t bw)
+static uint64_t BBRInflightWithBw(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t gain, uint64_t bw)
 {
     uint64_t inflight = BBRBDPMultipleWithBw(bbr_state, path_x, gain, bw);
     return BBRQuantizationBudget(bbr_state, path_x, inflight);
 }
 
-static uint64_t BBRInflight(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, double gain)
+static uint64_t BBRInflight(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t gain)
 {
     return BBRInflightWithBw(bbr_state, path_x, gain, bbr_state->bw);
 }
@@ -776,7 +794,12 @@ static void BBRUpdateMaxInflight(picoquic_bbr_state_t* bbr_state, picoquic_path_
     inflight += bbr_state->extra_acked;
 
     if (bbr_state->min_rtt < bbr_state->wifi_shadow_rtt && bbr_state->min_rtt > 0){
-        inflight = (uint64_t)(((double)inflight) * ((double)bbr_state->wifi_shadow_rtt) / ((double)bbr_state->min_rtt));
+        if (bbr_state->use_float_gains) {
+            inflight = (uint64_t)(((double)inflight) * ((double)bbr_state->wifi_shadow_rtt) / ((double)bbr_state->min_rtt));
+        }
+        else {
+            inflight = (inflight * bbr_state->wifi_shadow_rtt) / bbr_state->min_rtt;
+        }
     }
     bbr_state->max_inflight = BBRQuantizationBudget(bbr_state, path_x, inflight);
 }
@@ -790,12 +813,12 @@ static void BBRInitPacingRate(picoquic_bbr_state_t* bbr_state, picoquic_path_t*
         initial_rtt = path_x->smoothed_rtt;
     }
     double nominal_bandwidth = ((double)(1000000ull * PICOQUIC_CWIN_INITIAL)) / (double)initial_rtt;
-    bbr_state->pacing_rate = BBRStartupPacingGain * nominal_bandwidth;
+    bbr_state->pacing_rate = PICOQUIC_CC_GAIN_TO_DOUBLE(BBRStartupPacingGain) * nominal_bandwidth;
 }
 
-static void BBRSetPacingRateWithGain(picoquic_bbr_state_t* bbr_state, double pacing_gain)
+static void BBRSetPacingRateWithGain(picoquic_bbr_state_t* bbr_state, uint64_t pacing_gain)
 {
-    double rate = pacing_gain * ((double)(bbr_state->bw * (100 - BBRPacingMarginPercent))) / (double)100;
+    double rate = PICOQUIC_CC_GAIN_TO_DOUBLE(pacing_gain) * ((double)(bbr_state->bw * (100 - BBRPacingMarginPercent))) / (double)100;
 
     if (bbr_state->state == picoquic_bbr_alg_startup_resume &&
         !bbr_state->filled_pipe &&
@@ -1013,7 +1036,7 @@ static int IsInflightTooHigh(picoquic_bbr_state_t* bbr_state, picoquic_path_t *
     else {
         uint64_t rs_delivered = path_x->delivered - rs->delivered;
         if (rs_delivered > bbr_state->recovery_delivered &&
-            rs->lost > (uint64_t)(((double)rs->tx_in_flight) * BBRLossThresh) &&
+            rs->lost > BBRApplyGain(bbr_state, rs->tx_in_flight, BBRLossThresh) &&
             rs->lost > 3 * path_x->send_mtu) {
             return 1;
         }
@@ -1339,7 +1362,7 @@ static void BBRHandleProbeRTT(picoquic_bbr_state_t* bbr_state, picoquic_path_t *
 static void BBREnterProbeRTT(picoquic_bbr_state_t* bbr_state)
 {
     bbr_state->state = picoquic_bbr_alg_probe_rtt;
-    bbr_state->pacing_gain = 1.0;
+    bbr_state->pacing_gain = PICOQUIC_CC_GAIN_UNIT;
     bbr_state->cwnd_gain = BBRProbeRTTCwndGain;  /* 0.5 */
 }
 
@@ -1402,7 +1425,7 @@ static uint64_t BBRInflightWithHeadroom(picoquic_bbr_state_t* bbr_state, picoqui
     }
 
     /* This diverges from draft-bbr-02, but is correct per feedback from BBR authors. */
-    uint64_t inflight_with_headroom = (uint64_t)((1.0-BBRHeadroom) * ((double)bbr_state->inflight_hi));
+    uint64_t inflight_with_headroom = BBRApplyGain(bbr_state, bbr_state->inflight_hi, PICOQUIC_CC_GAIN_UNIT - BBRHeadroom);
     if (inflight_with_headroom < (BBRMinPipeCwnd*path_x->send_mtu)) {
         inflight_with_headroom = BBRMinPipeCwnd*path_x->send_mtu;
     }
@@ -1480,7 +1503,7 @@ static int BBRCheckTimeToCruise(picoquic_bbr_state_t* bbr_state, picoquic_path_t
     if (path_x->bytes_in_transit > BBRInflightWithHeadroom(bbr_state, path_x)) {
         return 0; /* not enough headroom */
     }
-    if (path_x->bytes_in_transit <= BBRInflightWithBw(bbr_state, path_x, 1.0, bbr_state->max_bw)) {
+    if (path_x->bytes_in_transit <= BBRInflightWithBw(bbr_state, path_x, PICOQUIC_CC_GAIN_UNIT, bbr_state->max_bw)) {
         return 1;  /* inflight <= estimated BDP */
     }
     return 0;
@@ -1704,7 +1727,7 @@ static void BBRUpdateProbeBWCyclePhase(picoquic_bbr_state_t* bbr_state, picoquic
     case picoquic_bbr_alg_probe_bw_up:
         if (BBRHasElapsedInPhase(bbr_state, bbr_state->min_rtt, current_time) &&
             (bbr_state->nb_rtt_excess > 0 ||
-            path_x->bytes_in_transit > BBRInflightWithBw(bbr_state, path_x, 1.25, bbr_state->max_bw))) {
+            path_x->bytes_in_transit > BBRInflightWithBw(bbr_state, path_x, PICOQUIC_CC_GAIN(1.25), bbr_state->max_bw))) {
             BBRStartProbeBW_DOWN(bbr_state, path_x, current_time);
         }
         break;
@@ -1726,13 +1749,13 @@ static void BBREnterDrain(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path
 {
     path_x->is_ssthresh_initialized = 1; /* Picoquic specific: notify transport that the startup phase is complete */
     bbr_state->state = picoquic_bbr_alg_drain;
-    bbr_state->pacing_gain = 1.0 / BBRStartupCwndGain;  /* pace slowly */
+    bbr_state->pacing_gain = (PICOQUIC_CC_GAIN_UNIT * PICOQUIC_CC_GAIN_UNIT) / BBRStartupCwndGain;  /* pace slowly */
     bbr_state->cwnd_gain = BBRStartupCwndGain;   /* maintain cwnd */
 }
 
 static void BBRCheckDrain(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path_x, uint64_t current_time)
 {
-    if (bbr_state->state == picoquic_bbr_alg_drain && path_x->bytes_in_transit <= BBRInflight(bbr_state, path_x, 1.0)) {
+    if (bbr_state->state == picoquic_bbr_alg_drain && path_x->bytes_in_transit <= BBRInflight(bbr_state, path_x, PICOQUIC_CC_GAIN_UNIT)) {
         BBREnterProbeBW(bbr_state, path_x, current_time);  /* we estimate that the queue is drained */
     }
 }
@@ -1740,14 +1763,21 @@ static void BBRCheckDrain(picoquic_bbr_state_t* bbr_state, picoquic_path_t* path
 
 /* Startup extension to support careful resume */
 static void BBRCheckStartupFullBandwidthGeneric(picoquic_bbr_state_t* bbr_state,
-    bbr_per_ack_state_t * rs, double threshold)
+    bbr_per_ack_state_t * rs, uint64_t threshold)
 {
     if (bbr_state->filled_pipe ||
         !bbr_state->round_start || rs->is_app_limited) {
         return;  /* no need to check for a full pipe now */
     }
 
-    if ((double)bbr_state->max_bw >= threshold*((double)bbr_state->full_bw)) {
+    int is_growing;
+    if (bbr_state->use_float_gains) {
+        is_growing = (double)bbr_state->max_bw >= PICOQUIC_CC_GAIN_TO_DOUBLE(threshold)*((double)bbr_state->full_bw);
+    }
+    else {
+        is_growing = bbr_state->max_bw * PICOQUIC_CC_GAIN_UNIT >= threshold * bbr_state->full_bw;
+    }
+    if (is_growing) {
         /* still growing? */
         bbr_state->full_bw = bbr_state->max_bw;    /* record new baseline level */
         bbr_state->full_bw_count = 0;
@@ -1773,7 +1803,7 @@ static void BBRCheckStartupResume(picoquic_bbr_state_t* bbr_state, picoquic_path
 {
     if (bbr_state->state == picoquic_bbr_alg_startup_resume) {
         BBRCheckStartupHighLoss(bbr_state, path_x, rs);
-        if (!bbr_state->filled_pipe && (double)bbr_state->max_bw > BBRStartupResumeIncreaseThreshold * bbr_state->bdp_seed) {
+        if (!bbr_state->filled_pipe && bbr_state->max_bw > BBRApplyGain(bbr_state, bbr_state->bdp_seed, BBRStartupResumeIncreaseThreshold)) {
             BBREnterStartup(bbr_state);
         }
         else {
@@ -1981,8 +2011,8 @@ static uint64_t BBRInflightHiFromLostPacket(bbr_per_ack_state_t * rs, picoquic_p
     uint64_t inflight_prev = rs->tx_in_flight - packet_size;
     /* What was lost before this packet? */
     uint64_t lost_prev = rs->lost - packet_size;
-    double lost_prefix = (BBRLossThresh *((double)(inflight_prev - lost_prev))) /
-        (1.0 - BBRLossThresh);
+    double lost_prefix = (PICOQUIC_CC_GAIN_TO_DOUBLE(BBRLossThresh) *((double)(inflight_prev - lost_prev))) /
+        (1.0 - PICOQUIC_CC_GAIN_TO_DOUBLE(BBRLossThresh));
     /* At what inflight value did losses cross BBRLossThresh? */
     uint64_t inflight = inflight_prev + (uint64_t)lost_prefix;
     return inflight;
@@ -2226,7 +2256,7 @@ static void picoquic_bbr_notify(
              * Consider removing it from the API once other CC algorithms are updated.  */
             break;
         case picoquic_congestion_notification_acknowledgement:
-            if (picoquic_check_handover(ack_state->lost_packet_sent_time)) { return; }
+            if (!path_x->cnx->skip_handover_suppression && picoquic_check_handover(ack_state->lost_packet_sent_time)) { path_x->cnx->nb_handover_suppressed++; return; }
             BBRExitLostFeedback(bbr_state, path_x);
 
             picoquic_bbr_notify_ack(bbr_state, path_x, ack_state, current_time);
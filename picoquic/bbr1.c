@@ -1264,7 +1264,7 @@ static void picoquic_bbr1_sat_aware_notify(
 {
     // Don't notify the cc algorithm during handover
     // TODO: Make this more granular (allow some types of notifications but not others)
-    if (!picoquic_check_handover()) {
+    if (cnx->skip_handover_suppression || !picoquic_check_handover(current_time)) {
         picoquic_bbr1_notify(cnx, path_x, notification, ack_state, current_time);
     }
 }
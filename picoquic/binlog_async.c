@@ -0,0 +1,291 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Asynchronous binary log writer.
+ *
+ * A QUIC context is only ever used by one network thread, so each context
+ * owns a single producer, single consumer byte ring. The network thread
+ * copies each serialized binlog event into the ring, tagged with the
+ * destination file, and never blocks on disk I/O. A background thread
+ * drains the ring and writes the events through stdio, which coalesces
+ * consecutive events into large writes.
+ *
+ * The ring has a fixed size. If an event does not fit, it is dropped and
+ * counted: events are self delimited, so the log files remain readable.
+ * File close requests are never dropped. The writer thread closes the
+ * file after writing all the events queued before the close, and the
+ * network thread waits for room in the ring if necessary.
+ *
+ * The producer only writes "write_index", the consumer only writes
+ * "read_index". Both indices increase monotonically, and are published
+ * with release/acquire semantics. The writer thread is woken up when the
+ * ring is half full or when the network thread waits for it, and polls
+ * the ring at a short interval otherwise, so that queuing an event does
+ * not require a system call.
+ */
+
+#include "picoquic_internal.h"
+#include "picoquic_binlog.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PICOQUIC_BINLOG_ASYNC_MIN_RING_SIZE 0x4000
+#define PICOQUIC_BINLOG_ASYNC_POLL_INTERVAL 10000 /* microseconds */
+#define PICOQUIC_BINLOG_ASYNC_WAIT_INTERVAL 1000 /* microseconds */
+
+#define BINLOG_ASYNC_RECORD_DATA 0
+#define BINLOG_ASYNC_RECORD_CLOSE 1
+#define BINLOG_ASYNC_RECORD_PAD 2
+
+typedef struct st_binlog_async_record_t {
+    FILE* f;
+    uint32_t length;
+    uint32_t record_type;
+} binlog_async_record_t;
+
+/* Records are aligned on the header size, so that a header never wraps
+ * around the end of the ring. */
+#define BINLOG_ASYNC_ALIGN(x) (((x) + sizeof(binlog_async_record_t) - 1) & ~((uint64_t)sizeof(binlog_async_record_t) - 1))
+
+struct st_picoquic_binlog_async_t {
+    uint8_t* ring;
+    uint64_t ring_size;
+    /* Written by the network thread */
+    uint64_t write_index;
+    uint64_t nb_dropped;
+    uint64_t is_shutdown;
+    /* Written by the writer thread */
+    uint64_t read_index;
+    picoquic_thread_t thread;
+    picoquic_event_t work_event;
+    picoquic_event_t done_event;
+};
+
+static picoquic_thread_return_t picoquic_binlog_async_writer(void* arg)
+{
+    picoquic_binlog_async_t* async = (picoquic_binlog_async_t*)arg;
+    uint64_t read_index = async->read_index;
+
+    while (1) {
+        int is_shutdown = picoquic_atomic_load_64(&async->is_shutdown) != 0;
+        uint64_t write_index = picoquic_atomic_load_64(&async->write_index);
+
+        if (read_index < write_index) {
+            while (read_index < write_index) {
+                binlog_async_record_t* record = (binlog_async_record_t*)(async->ring + (read_index & (async->ring_size - 1)));
+
+                switch (record->record_type) {
+                case BINLOG_ASYNC_RECORD_DATA:
+                    (void)fwrite((uint8_t*)(record + 1), record->length, 1, record->f);
+                    break;
+                case BINLOG_ASYNC_RECORD_CLOSE:
+                    (void)picoquic_file_close(record->f);
+                    break;
+                default:
+                    break;
+                }
+                read_index += BINLOG_ASYNC_ALIGN(sizeof(binlog_async_record_t) + record->length);
+            }
+            picoquic_atomic_store_64(&async->read_index, read_index);
+            (void)picoquic_signal_event(&async->done_event);
+        }
+        else if (is_shutdown) {
+            break;
+        }
+        else {
+            (void)picoquic_wait_for_event(&async->work_event, PICOQUIC_BINLOG_ASYNC_POLL_INTERVAL);
+        }
+    }
+
+    picoquic_thread_do_return;
+}
+
+picoquic_binlog_async_t* picoquic_binlog_async_create(size_t ring_size)
+{
+    picoquic_binlog_async_t* async = (picoquic_binlog_async_t*)malloc(sizeof(picoquic_binlog_async_t));
+    uint64_t actual_size = PICOQUIC_BINLOG_ASYNC_MIN_RING_SIZE;
+
+    while (actual_size < ring_size) {
+        actual_size <<= 1;
+    }
+
+    if (async != NULL) {
+        memset(async, 0, sizeof(picoquic_binlog_async_t));
+        async->ring_size = actual_size;
+        async->ring = (uint8_t*)malloc((size_t)actual_size);
+        if (async->ring == NULL) {
+            free(async);
+            async = NULL;
+        }
+        else if (picoquic_create_event(&async->work_event) != 0) {
+            free(async->ring);
+            free(async);
+            async = NULL;
+        }
+        else if (picoquic_create_event(&async->done_event) != 0) {
+            picoquic_delete_event(&async->work_event);
+            free(async->ring);
+            free(async);
+            async = NULL;
+        }
+        else if (picoquic_create_thread(&async->thread, picoquic_binlog_async_writer, async) != 0) {
+            DBG_PRINTF("%s", "Cannot create the binlog writer thread");
+            picoquic_delete_event(&async->done_event);
+            picoquic_delete_event(&async->work_event);
+            free(async->ring);
+            free(async);
+            async = NULL;
+        }
+    }
+
+    return async;
+}
+
+void picoquic_binlog_async_delete(picoquic_binlog_async_t* async)
+{
+    if (async != NULL) {
+        picoquic_atomic_store_64(&async->is_shutdown, 1);
+        (void)picoquic_signal_event(&async->work_event);
+        (void)picoquic_wait_thread(async->thread);
+#ifdef _WINDOWS
+        CloseHandle(async->thread);
+#endif
+        picoquic_delete_event(&async->done_event);
+        picoquic_delete_event(&async->work_event);
+        free(async->ring);
+        free(async);
+    }
+}
+
+/* Reserve space for a record of the specified length. Returns NULL if
+ * there is not enough room in the ring. When the record would straddle
+ * the end of the ring, the remaining space is filled with a padding
+ * record and the record starts at the beginning of the ring. */
+static binlog_async_record_t* picoquic_binlog_async_reserve(picoquic_binlog_async_t* async, size_t length)
+{
+    binlog_async_record_t* record = NULL;
+    uint64_t needed = BINLOG_ASYNC_ALIGN(sizeof(binlog_async_record_t) + length);
+    uint64_t read_index = picoquic_atomic_load_64(&async->read_index);
+    uint64_t offset = async->write_index & (async->ring_size - 1);
+    uint64_t pad = (offset + needed > async->ring_size) ? async->ring_size - offset : 0;
+
+    if (async->write_index + pad + needed - read_index <= async->ring_size) {
+        if (pad > 0) {
+            binlog_async_record_t* pad_record = (binlog_async_record_t*)(async->ring + offset);
+            pad_record->f = NULL;
+            pad_record->length = (uint32_t)(pad - sizeof(binlog_async_record_t));
+            pad_record->record_type = BINLOG_ASYNC_RECORD_PAD;
+            picoquic_atomic_store_64(&async->write_index, async->write_index + pad);
+            offset = 0;
+        }
+        record = (binlog_async_record_t*)(async->ring + offset);
+        record->length = (uint32_t)length;
+    }
+
+    return record;
+}
+
+static void picoquic_binlog_async_publish(picoquic_binlog_async_t* async, binlog_async_record_t* record)
+{
+    uint64_t before = async->write_index - picoquic_atomic_load_64(&async->read_index);
+    uint64_t after = before + BINLOG_ASYNC_ALIGN(sizeof(binlog_async_record_t) + record->length);
+
+    picoquic_atomic_store_64(&async->write_index, async->write_index + BINLOG_ASYNC_ALIGN(sizeof(binlog_async_record_t) + record->length));
+    /* Only wake up the writer when the ring fills up */
+    if (before < async->ring_size / 2 && after >= async->ring_size / 2) {
+        (void)picoquic_signal_event(&async->work_event);
+    }
+}
+
+/* Queue a binlog event made of a chunk header and a message. The event is
+ * dropped if the ring is full. */
+void picoquic_binlog_async_write(picoquic_binlog_async_t* async, FILE* f,
+    const uint8_t* head, size_t head_length, const uint8_t* msg, size_t msg_length)
+{
+    binlog_async_record_t* record = NULL;
+
+    if (head_length + msg_length <= async->ring_size / 4) {
+        record = picoquic_binlog_async_reserve(async, head_length + msg_length);
+    }
+    if (record == NULL) {
+        async->nb_dropped++;
+    }
+    else {
+        record->f = f;
+        record->record_type = BINLOG_ASYNC_RECORD_DATA;
+        if (head_length > 0) {
+            memcpy((uint8_t*)(record + 1), head, head_length);
+        }
+        if (msg_length > 0) {
+            memcpy((uint8_t*)(record + 1) + head_length, msg, msg_length);
+        }
+        picoquic_binlog_async_publish(async, record);
+    }
+}
+
+/* Queue the closing of a log file. The request cannot be dropped, so
+ * wait for the writer to free some space if needed. */
+void picoquic_binlog_async_close(picoquic_binlog_async_t* async, FILE* f)
+{
+    binlog_async_record_t* record;
+
+    while ((record = picoquic_binlog_async_reserve(async, 0)) == NULL) {
+        (void)picoquic_signal_event(&async->work_event);
+        (void)picoquic_wait_for_event(&async->done_event, PICOQUIC_BINLOG_ASYNC_WAIT_INTERVAL);
+    }
+    record->f = f;
+    record->record_type = BINLOG_ASYNC_RECORD_CLOSE;
+    picoquic_binlog_async_publish(async, record);
+}
+
+/* Wait until all the queued records have been processed. */
+void picoquic_binlog_async_flush(picoquic_binlog_async_t* async)
+{
+    while (picoquic_atomic_load_64(&async->read_index) < async->write_index) {
+        (void)picoquic_signal_event(&async->work_event);
+        (void)picoquic_wait_for_event(&async->done_event, PICOQUIC_BINLOG_ASYNC_WAIT_INTERVAL);
+    }
+}
+
+int picoquic_set_binlog_async(picoquic_quic_t* quic, size_t ring_size)
+{
+    int ret = 0;
+
+    if (quic->binlog_async != NULL) {
+        picoquic_binlog_async_flush(quic->binlog_async);
+        picoquic_binlog_async_delete(quic->binlog_async);
+        quic->binlog_async = NULL;
+    }
+    if (ring_size > 0) {
+        quic->binlog_async = picoquic_binlog_async_create(ring_size);
+        if (quic->binlog_async == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+    }
+
+    return ret;
+}
+
+uint64_t picoquic_get_binlog_async_dropped(picoquic_quic_t* quic)
+{
+    return (quic->binlog_async == NULL) ? 0 : quic->binlog_async->nb_dropped;
+}
@@ -31,6 +31,23 @@ extern "C" {
 #define PICOQUIC_SMOOTHED_LOSS_FACTOR (1.0/16.0)
 #define PICOQUIC_SMOOTHED_LOSS_THRESHOLD (0.15)
 
+/* Fixed point gains, used in the per ACK computations of congestion control
+ * algorithms. Gains are expressed in thousandths. For gains such as 0.2,
+ * 0.85, 1.25 or 2.25 the results are the same as the truncated floating
+ * point products; other gains, e.g., 0.7, whose nearest double is slightly
+ * below the decimal value, or 2/ln(2), which is not a whole number of
+ * thousandths, should stay in floating point. The division by a constant
+ * compiles to a multiplication. Products are exact for values below 2^52 and
+ * gains below 4; larger values saturate. PICOQUIC_CC_GAIN_TO_DOUBLE returns
+ * the same double as the decimal literal, e.g., for pacing rates.
+ */
+#define PICOQUIC_CC_GAIN_UNIT 1000
+#define PICOQUIC_CC_GAIN(x) ((uint64_t)((x) * (double)PICOQUIC_CC_GAIN_UNIT + 0.5))
+#define PICOQUIC_CC_GAIN_VALUE_MAX (UINT64_MAX >> 12)
+#define PICOQUIC_CC_APPLY_GAIN(v, g) (((v) < PICOQUIC_CC_GAIN_VALUE_MAX) ? ((v) * (g)) / PICOQUIC_CC_GAIN_UNIT : \
+    (((g) <= PICOQUIC_CC_GAIN_UNIT) ? ((v) / PICOQUIC_CC_GAIN_UNIT) * (g) : UINT64_MAX))
+#define PICOQUIC_CC_GAIN_TO_DOUBLE(g) (((double)(g)) / (double)PICOQUIC_CC_GAIN_UNIT)
+
 typedef struct st_picoquic_min_max_rtt_t {
     uint64_t last_rtt_sample_time;
     uint64_t rtt_filtered_min;
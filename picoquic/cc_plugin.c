@@ -0,0 +1,387 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Runtime loaded congestion control algorithms.
+ *
+ * Each registered plugin is wrapped in a congestion algorithm structure
+ * whose functions are the trampolines defined here. The congestion state
+ * of a path points to a small structure holding the plugin and the state
+ * returned by the plugin, so the trampolines can find the plugin from the
+ * path. The plugin only sees opaque path handles, and accesses the path
+ * through the host functions.
+ *
+ * Plugins are expected to be registered when the application starts,
+ * before the network threads run. Registered algorithms are published
+ * after being fully initialized, so they can be found by name from any
+ * thread.
+ */
+
+#include "picoquic_internal.h"
+#include "picoquic_cc_plugin.h"
+#include "cc_common.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WINDOWS
+#include <dlfcn.h>
+#endif
+
+#define PICOQUIC_CC_PLUGIN_MAX 16
+
+typedef struct st_picoquic_cc_plugin_alg_t {
+    picoquic_congestion_algorithm_t alg; /* Must be first, cnx->congestion_alg points here */
+    const picoquic_cc_plugin_t* plugin;
+    void* handle; /* Shared object, NULL if the plugin was registered directly */
+} picoquic_cc_plugin_alg_t;
+
+typedef struct st_cc_plugin_path_state_t {
+    const picoquic_cc_plugin_t* plugin;
+    void* state;
+} cc_plugin_path_state_t;
+
+static picoquic_cc_plugin_alg_t cc_plugin_registry[PICOQUIC_CC_PLUGIN_MAX];
+static uint64_t cc_plugin_nb_registered = 0;
+
+/* Host functions */
+static uint64_t cc_plugin_get_rtt_min(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->rtt_min;
+}
+
+static uint64_t cc_plugin_get_smoothed_rtt(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->smoothed_rtt;
+}
+
+static uint64_t cc_plugin_get_rtt_variant(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->rtt_variant;
+}
+
+static uint64_t cc_plugin_get_bandwidth_estimate(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->bandwidth_estimate;
+}
+
+static uint64_t cc_plugin_get_peak_bandwidth_estimate(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->peak_bandwidth_estimate;
+}
+
+static uint64_t cc_plugin_get_bytes_in_transit(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->bytes_in_transit;
+}
+
+static uint64_t cc_plugin_get_send_mtu(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->send_mtu;
+}
+
+static uint64_t cc_plugin_get_cwin(picoquic_cc_plugin_path_t* path)
+{
+    return ((picoquic_path_t*)path)->cwin;
+}
+
+static uint64_t cc_plugin_get_sequence_number(picoquic_cc_plugin_path_t* path)
+{
+    picoquic_path_t* path_x = (picoquic_path_t*)path;
+    return picoquic_cc_get_sequence_number(path_x->cnx, path_x);
+}
+
+static uint64_t cc_plugin_get_ack_number(picoquic_cc_plugin_path_t* path)
+{
+    picoquic_path_t* path_x = (picoquic_path_t*)path;
+    return picoquic_cc_get_ack_number(path_x->cnx, path_x);
+}
+
+static uint64_t cc_plugin_get_ack_sent_time(picoquic_cc_plugin_path_t* path)
+{
+    picoquic_path_t* path_x = (picoquic_path_t*)path;
+    return picoquic_cc_get_ack_sent_time(path_x->cnx, path_x);
+}
+
+static void cc_plugin_set_cwin(picoquic_cc_plugin_path_t* path, uint64_t cwin)
+{
+    ((picoquic_path_t*)path)->cwin = cwin;
+}
+
+static void cc_plugin_set_pacing_rate(picoquic_cc_plugin_path_t* path, double pacing_rate, uint64_t quantum)
+{
+    picoquic_path_t* path_x = (picoquic_path_t*)path;
+    picoquic_update_pacing_rate(path_x->cnx, path_x, pacing_rate, quantum);
+}
+
+static void cc_plugin_set_pacing_from_cwin(picoquic_cc_plugin_path_t* path, int slow_start)
+{
+    picoquic_path_t* path_x = (picoquic_path_t*)path;
+    picoquic_update_pacing_data(path_x->cnx, path_x, slow_start);
+}
+
+static const picoquic_cc_plugin_host_t cc_plugin_host = {
+    PICOQUIC_CC_PLUGIN_ABI_VERSION,
+    sizeof(picoquic_cc_plugin_host_t),
+    cc_plugin_get_rtt_min,
+    cc_plugin_get_smoothed_rtt,
+    cc_plugin_get_rtt_variant,
+    cc_plugin_get_bandwidth_estimate,
+    cc_plugin_get_peak_bandwidth_estimate,
+    cc_plugin_get_bytes_in_transit,
+    cc_plugin_get_send_mtu,
+    cc_plugin_get_cwin,
+    cc_plugin_get_sequence_number,
+    cc_plugin_get_ack_number,
+    cc_plugin_get_ack_sent_time,
+    cc_plugin_set_cwin,
+    cc_plugin_set_pacing_rate,
+    cc_plugin_set_pacing_from_cwin
+};
+
+/* Trampolines */
+static int cc_plugin_notification(picoquic_congestion_notification_t notification)
+{
+    int plugin_notification = -1;
+
+    switch (notification) {
+    case picoquic_congestion_notification_acknowledgement:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_ACKNOWLEDGEMENT;
+        break;
+    case picoquic_congestion_notification_repeat:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_REPEAT;
+        break;
+    case picoquic_congestion_notification_timeout:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_TIMEOUT;
+        break;
+    case picoquic_congestion_notification_spurious_repeat:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_SPURIOUS_REPEAT;
+        break;
+    case picoquic_congestion_notification_rtt_measurement:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_RTT_MEASUREMENT;
+        break;
+    case picoquic_congestion_notification_ecn_ec:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_ECN_EC;
+        break;
+    case picoquic_congestion_notification_cwin_blocked:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_CWIN_BLOCKED;
+        break;
+    case picoquic_congestion_notification_seed_cwin:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_SEED_CWIN;
+        break;
+    case picoquic_congestion_notification_reset:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_RESET;
+        break;
+    case picoquic_congestion_notification_lost_feedback:
+        plugin_notification = PICOQUIC_CC_PLUGIN_NOTIFICATION_LOST_FEEDBACK;
+        break;
+    default:
+        break;
+    }
+
+    return plugin_notification;
+}
+
+static void cc_plugin_init(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint64_t current_time)
+{
+    const picoquic_cc_plugin_alg_t* plugin_alg = (const picoquic_cc_plugin_alg_t*)cnx->congestion_alg;
+    cc_plugin_path_state_t* path_state = (cc_plugin_path_state_t*)malloc(sizeof(cc_plugin_path_state_t));
+
+    if (path_state != NULL) {
+        path_state->plugin = plugin_alg->plugin;
+        path_state->state = plugin_alg->plugin->create(&cc_plugin_host, (picoquic_cc_plugin_path_t*)path_x, current_time);
+    }
+    path_x->congestion_alg_state = path_state;
+}
+
+static void cc_plugin_notify(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_congestion_notification_t notification, picoquic_per_ack_state_t* ack_state, uint64_t current_time)
+{
+    cc_plugin_path_state_t* path_state = (cc_plugin_path_state_t*)path_x->congestion_alg_state;
+    int plugin_notification = cc_plugin_notification(notification);
+
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+#endif
+
+    if (path_state != NULL && plugin_notification >= 0) {
+        picoquic_cc_plugin_ack_t ack;
+
+        if (ack_state != NULL) {
+            ack.rtt_measurement = ack_state->rtt_measurement;
+            ack.one_way_delay = ack_state->one_way_delay;
+            ack.nb_bytes_acknowledged = ack_state->nb_bytes_acknowledged;
+            ack.nb_bytes_newly_lost = ack_state->nb_bytes_newly_lost;
+            ack.nb_bytes_lost_since_packet_sent = ack_state->nb_bytes_lost_since_packet_sent;
+            ack.nb_bytes_delivered_since_packet_sent = ack_state->nb_bytes_delivered_since_packet_sent;
+            ack.inflight_prior = ack_state->inflight_prior;
+            ack.lost_packet_number = ack_state->lost_packet_number;
+            ack.lost_packet_sent_time = ack_state->lost_packet_sent_time;
+            ack.is_app_limited = ack_state->is_app_limited;
+            ack.is_cwnd_limited = ack_state->is_cwnd_limited;
+        }
+        path_state->plugin->notify(path_state->state, (picoquic_cc_plugin_path_t*)path_x, plugin_notification,
+            (ack_state == NULL) ? NULL : &ack, current_time);
+    }
+}
+
+static void cc_plugin_delete(picoquic_path_t* path_x)
+{
+    cc_plugin_path_state_t* path_state = (cc_plugin_path_state_t*)path_x->congestion_alg_state;
+
+    if (path_state != NULL) {
+        path_state->plugin->release(path_state->state);
+        free(path_state);
+        path_x->congestion_alg_state = NULL;
+    }
+}
+
+static void cc_plugin_observe(picoquic_path_t* path_x, uint64_t* cc_state, uint64_t* cc_param)
+{
+    cc_plugin_path_state_t* path_state = (cc_plugin_path_state_t*)path_x->congestion_alg_state;
+
+    *cc_state = 0;
+    *cc_param = 0;
+    if (path_state != NULL && path_state->plugin->observe != NULL) {
+        path_state->plugin->observe(path_state->state, cc_state, cc_param);
+    }
+}
+
+/* Registry */
+picoquic_congestion_algorithm_t const* picoquic_cc_plugin_find(char const* alg_name)
+{
+    picoquic_congestion_algorithm_t const* alg = NULL;
+    uint64_t nb_registered = picoquic_atomic_load_64(&cc_plugin_nb_registered);
+
+    for (uint64_t i = 0; i < nb_registered && alg == NULL; i++) {
+        if (strcmp(cc_plugin_registry[i].alg.congestion_algorithm_id, alg_name) == 0) {
+            alg = &cc_plugin_registry[i].alg;
+        }
+    }
+
+    return alg;
+}
+
+static int picoquic_cc_plugin_is_valid(const picoquic_cc_plugin_t* plugin)
+{
+    int is_valid = plugin != NULL &&
+        (plugin->abi_version >> 16) == PICOQUIC_CC_PLUGIN_ABI_MAJOR &&
+        plugin->plugin_size >= PICOQUIC_CC_PLUGIN_SIZE_MIN &&
+        plugin->name != NULL && plugin->create != NULL && plugin->notify != NULL && plugin->release != NULL &&
+        plugin->algorithm_number >= PICOQUIC_CC_PLUGIN_ALGO_NUMBER_MIN && plugin->algorithm_number <= UINT8_MAX &&
+        picoquic_get_congestion_algorithm(plugin->name) == NULL;
+
+    for (uint64_t i = 0; is_valid && i < cc_plugin_nb_registered; i++) {
+        is_valid = cc_plugin_registry[i].alg.congestion_algorithm_number != plugin->algorithm_number;
+    }
+
+    return is_valid;
+}
+
+static int picoquic_cc_plugin_register_ex(picoquic_cc_plugin_entry_fn entry_fn, void* handle,
+    picoquic_congestion_algorithm_t const** alg)
+{
+    int ret = 0;
+    const picoquic_cc_plugin_t* plugin = entry_fn(&cc_plugin_host);
+
+    if (!picoquic_cc_plugin_is_valid(plugin)) {
+        DBG_PRINTF("Congestion control plugin %s is not compatible", (plugin == NULL || plugin->name == NULL) ? "?" : plugin->name);
+        ret = PICOQUIC_ERROR_CC_PLUGIN_INVALID;
+    }
+    else if (cc_plugin_nb_registered >= PICOQUIC_CC_PLUGIN_MAX) {
+        ret = PICOQUIC_ERROR_MEMORY;
+    }
+    else {
+        picoquic_cc_plugin_alg_t* plugin_alg = &cc_plugin_registry[cc_plugin_nb_registered];
+
+        plugin_alg->alg.congestion_algorithm_id = plugin->name;
+        plugin_alg->alg.congestion_algorithm_number = (uint8_t)plugin->algorithm_number;
+        plugin_alg->alg.alg_init = cc_plugin_init;
+        plugin_alg->alg.alg_notify = cc_plugin_notify;
+        plugin_alg->alg.alg_delete = cc_plugin_delete;
+        plugin_alg->alg.alg_observe = cc_plugin_observe;
+        plugin_alg->plugin = plugin;
+        plugin_alg->handle = handle;
+        picoquic_atomic_store_64(&cc_plugin_nb_registered, cc_plugin_nb_registered + 1);
+        if (alg != NULL) {
+            *alg = &plugin_alg->alg;
+        }
+    }
+
+    return ret;
+}
+
+int picoquic_cc_plugin_register(picoquic_cc_plugin_entry_fn entry_fn, picoquic_congestion_algorithm_t const** alg)
+{
+    return picoquic_cc_plugin_register_ex(entry_fn, NULL, alg);
+}
+
+static void picoquic_cc_plugin_close(void* handle)
+{
+#ifdef _WINDOWS
+    (void)FreeLibrary((HMODULE)handle);
+#else
+    (void)dlclose(handle);
+#endif
+}
+
+int picoquic_cc_plugin_load(char const* file_name, picoquic_congestion_algorithm_t const** alg)
+{
+    int ret = 0;
+    picoquic_cc_plugin_entry_fn entry_fn = NULL;
+#ifdef _WINDOWS
+    HMODULE handle = LoadLibraryA(file_name);
+
+    if (handle != NULL) {
+        entry_fn = (picoquic_cc_plugin_entry_fn)GetProcAddress(handle, PICOQUIC_CC_PLUGIN_ENTRY);
+    }
+#else
+    void* handle = dlopen(file_name, RTLD_NOW | RTLD_LOCAL);
+
+    if (handle != NULL) {
+        *(void**)(&entry_fn) = dlsym(handle, PICOQUIC_CC_PLUGIN_ENTRY);
+    }
+#endif
+
+    if (handle == NULL || entry_fn == NULL) {
+        DBG_PRINTF("Cannot load congestion control plugin from %s", file_name);
+        ret = PICOQUIC_ERROR_CC_PLUGIN_LOAD;
+    }
+    else {
+        ret = picoquic_cc_plugin_register_ex(entry_fn, (void*)handle, alg);
+    }
+    if (ret != 0 && handle != NULL) {
+        picoquic_cc_plugin_close((void*)handle);
+    }
+
+    return ret;
+}
+
+void picoquic_cc_plugin_unload_all(void)
+{
+    uint64_t nb_registered = cc_plugin_nb_registered;
+
+    picoquic_atomic_store_64(&cc_plugin_nb_registered, 0);
+    for (uint64_t i = 0; i < nb_registered; i++) {
+        if (cc_plugin_registry[i].handle != NULL) {
+            picoquic_cc_plugin_close(cc_plugin_registry[i].handle);
+        }
+        memset(&cc_plugin_registry[i], 0, sizeof(picoquic_cc_plugin_alg_t));
+    }
+}
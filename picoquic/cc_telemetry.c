@@ -0,0 +1,247 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Congestion control telemetry.
+ *
+ * All congestion control notifications go through picoquic_congestion_notify.
+ * If telemetry is enabled, the state of the path is checked after each
+ * notification, using the alg_observe function of the algorithm, and
+ * significant changes are recorded in a ring of events attached to the path.
+ *
+ * The ring has a single writer, the network thread. Each slot is protected
+ * by a sequence number, odd while the slot is being written, so readers in
+ * other threads can detect and skip the slots that were overwritten while
+ * they were copying them.
+ */
+
+#include "picoquic_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PICOQUIC_CC_TELEMETRY_MIN_EVENTS 16
+#define PICOQUIC_CC_TELEMETRY_READ_TRIES 4
+
+typedef enum {
+    picoquic_cc_value_event_index = 0,
+    picoquic_cc_value_event_time,
+    picoquic_cc_value_event_type,
+    picoquic_cc_value_algorithm_number,
+    picoquic_cc_value_notification,
+    picoquic_cc_value_cc_state,
+    picoquic_cc_value_cc_param,
+    picoquic_cc_value_cwin,
+    picoquic_cc_value_pacing_rate,
+    picoquic_cc_value_bytes_in_transit,
+    picoquic_cc_value_smoothed_rtt,
+    picoquic_cc_value_max
+} picoquic_cc_value_enum;
+
+typedef struct st_picoquic_cc_telemetry_slot_t {
+    uint64_t sequence;
+    uint64_t v[picoquic_cc_value_max];
+} picoquic_cc_telemetry_slot_t;
+
+struct st_picoquic_cc_telemetry_t {
+    uint64_t write_index;
+    uint64_t mask;
+    /* Last recorded values, only used by the network thread */
+    uint64_t last_state;
+    uint64_t last_cwin;
+    uint64_t last_pacing_rate;
+    picoquic_cc_telemetry_slot_t* slots;
+};
+
+void picoquic_set_cc_telemetry(picoquic_quic_t* quic, size_t nb_events)
+{
+    size_t size = 0;
+
+    if (nb_events > 0) {
+        size = PICOQUIC_CC_TELEMETRY_MIN_EVENTS;
+        while (size < nb_events) {
+            size <<= 1;
+        }
+    }
+    quic->cc_telemetry_size = size;
+}
+
+static picoquic_cc_telemetry_t* picoquic_cc_telemetry_create(size_t nb_events)
+{
+    picoquic_cc_telemetry_t* ring = (picoquic_cc_telemetry_t*)malloc(
+        sizeof(picoquic_cc_telemetry_t) + nb_events * sizeof(picoquic_cc_telemetry_slot_t));
+
+    if (ring != NULL) {
+        memset(ring, 0, sizeof(picoquic_cc_telemetry_t) + nb_events * sizeof(picoquic_cc_telemetry_slot_t));
+        ring->mask = nb_events - 1;
+        ring->slots = (picoquic_cc_telemetry_slot_t*)(ring + 1);
+    }
+
+    return ring;
+}
+
+static void picoquic_cc_telemetry_record(picoquic_cc_telemetry_t* ring, uint64_t* v)
+{
+    uint64_t event_index = ring->write_index;
+    picoquic_cc_telemetry_slot_t* slot = &ring->slots[event_index & ring->mask];
+
+    v[picoquic_cc_value_event_index] = event_index;
+    picoquic_atomic_store_64(&slot->sequence, slot->sequence + 1);
+    for (int i = 0; i < picoquic_cc_value_max; i++) {
+        picoquic_atomic_store_64(&slot->v[i], v[i]);
+    }
+    picoquic_atomic_store_64(&slot->sequence, slot->sequence + 1);
+    picoquic_atomic_store_64(&ring->write_index, event_index + 1);
+}
+
+static int picoquic_cc_telemetry_has_changed(uint64_t value, uint64_t last_value)
+{
+    uint64_t delta = (value > last_value) ? value - last_value : last_value - value;
+
+    return delta > last_value / 8;
+}
+
+static void picoquic_cc_telemetry_observe(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_congestion_notification_t notification, int is_handover_suppressed, uint64_t current_time)
+{
+    picoquic_cc_telemetry_t* ring = path_x->cc_telemetry;
+    int is_new = 0;
+    uint64_t v[picoquic_cc_value_max];
+
+    if (ring == NULL) {
+        if ((ring = picoquic_cc_telemetry_create(cnx->quic->cc_telemetry_size)) == NULL) {
+            return;
+        }
+        path_x->cc_telemetry = ring;
+        is_new = 1;
+    }
+
+    v[picoquic_cc_value_event_time] = current_time;
+    v[picoquic_cc_value_algorithm_number] = cnx->congestion_alg->congestion_algorithm_number;
+    v[picoquic_cc_value_notification] = notification;
+    v[picoquic_cc_value_cc_state] = 0;
+    v[picoquic_cc_value_cc_param] = 0;
+    if (cnx->congestion_alg->alg_observe != NULL) {
+        cnx->congestion_alg->alg_observe(path_x, &v[picoquic_cc_value_cc_state], &v[picoquic_cc_value_cc_param]);
+    }
+    v[picoquic_cc_value_cwin] = path_x->cwin;
+    v[picoquic_cc_value_pacing_rate] = path_x->pacing.rate;
+    v[picoquic_cc_value_bytes_in_transit] = path_x->bytes_in_transit;
+    v[picoquic_cc_value_smoothed_rtt] = path_x->smoothed_rtt;
+
+    if (is_handover_suppressed) {
+        v[picoquic_cc_value_event_type] = picoquic_cc_event_handover_suppressed;
+        picoquic_cc_telemetry_record(ring, v);
+    }
+    if (is_new || v[picoquic_cc_value_cc_state] != ring->last_state) {
+        v[picoquic_cc_value_event_type] = picoquic_cc_event_state;
+        picoquic_cc_telemetry_record(ring, v);
+        ring->last_state = v[picoquic_cc_value_cc_state];
+        ring->last_cwin = path_x->cwin;
+        ring->last_pacing_rate = path_x->pacing.rate;
+    }
+    else {
+        if (picoquic_cc_telemetry_has_changed(path_x->cwin, ring->last_cwin)) {
+            v[picoquic_cc_value_event_type] = picoquic_cc_event_cwin;
+            picoquic_cc_telemetry_record(ring, v);
+            ring->last_cwin = path_x->cwin;
+        }
+        if (picoquic_cc_telemetry_has_changed(path_x->pacing.rate, ring->last_pacing_rate)) {
+            v[picoquic_cc_value_event_type] = picoquic_cc_event_pacing;
+            picoquic_cc_telemetry_record(ring, v);
+            ring->last_pacing_rate = path_x->pacing.rate;
+        }
+    }
+}
+
+void picoquic_congestion_notify(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_congestion_notification_t notification, picoquic_per_ack_state_t* ack_state, uint64_t current_time)
+{
+    uint64_t nb_handover_suppressed = cnx->nb_handover_suppressed;
+
+    cnx->congestion_alg->alg_notify(cnx, path_x, notification, ack_state, current_time);
+
+    if (cnx->quic->cc_telemetry_size > 0 || path_x->cc_telemetry != NULL) {
+        picoquic_cc_telemetry_observe(cnx, path_x, notification,
+            cnx->nb_handover_suppressed > nb_handover_suppressed, current_time);
+    }
+}
+
+/* Copy a slot. Returns 0 if the copy is consistent. */
+static int picoquic_cc_telemetry_read_slot(picoquic_cc_telemetry_slot_t* slot, uint64_t* v)
+{
+    int ret = -1;
+
+    for (int tries = 0; ret != 0 && tries < PICOQUIC_CC_TELEMETRY_READ_TRIES; tries++) {
+        uint64_t sequence = picoquic_atomic_load_64(&slot->sequence);
+        if ((sequence & 1) == 0) {
+            for (int i = 0; i < picoquic_cc_value_max; i++) {
+                v[i] = picoquic_atomic_load_64(&slot->v[i]);
+            }
+            if (picoquic_atomic_load_64(&slot->sequence) == sequence) {
+                ret = 0;
+            }
+        }
+    }
+
+    return ret;
+}
+
+size_t picoquic_get_cc_events(picoquic_cnx_t* cnx, uint64_t unique_path_id, uint64_t* next_event_index,
+    picoquic_cc_event_t* events, size_t max_events)
+{
+    size_t nb_events = 0;
+    int path_id = picoquic_get_path_id_from_unique(cnx, unique_path_id);
+    picoquic_cc_telemetry_t* ring = (path_id >= 0) ? cnx->path[path_id]->cc_telemetry : NULL;
+
+    if (ring != NULL) {
+        uint64_t write_index = picoquic_atomic_load_64(&ring->write_index);
+        uint64_t event_index = *next_event_index;
+
+        if (write_index > ring->mask + 1 && event_index < write_index - ring->mask - 1) {
+            event_index = write_index - ring->mask - 1;
+        }
+        while (event_index < write_index && nb_events < max_events) {
+            uint64_t v[picoquic_cc_value_max];
+
+            /* Skip the events that were overwritten while reading */
+            if (picoquic_cc_telemetry_read_slot(&ring->slots[event_index & ring->mask], v) == 0 &&
+                v[picoquic_cc_value_event_index] == event_index) {
+                picoquic_cc_event_t* event = &events[nb_events++];
+
+                event->event_index = event_index;
+                event->event_time = v[picoquic_cc_value_event_time];
+                event->event_type = (picoquic_cc_event_type_t)v[picoquic_cc_value_event_type];
+                event->congestion_algorithm_number = (uint8_t)v[picoquic_cc_value_algorithm_number];
+                event->notification = (picoquic_congestion_notification_t)v[picoquic_cc_value_notification];
+                event->cc_state = v[picoquic_cc_value_cc_state];
+                event->cc_param = v[picoquic_cc_value_cc_param];
+                event->cwin = v[picoquic_cc_value_cwin];
+                event->pacing_rate = v[picoquic_cc_value_pacing_rate];
+                event->bytes_in_transit = v[picoquic_cc_value_bytes_in_transit];
+                event->smoothed_rtt = v[picoquic_cc_value_smoothed_rtt];
+            }
+            event_index++;
+        }
+        *next_event_index = event_index;
+    }
+
+    return nb_events;
+}
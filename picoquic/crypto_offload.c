@@ -0,0 +1,198 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Crypto offload.
+ *
+ * When preparing a train of 1-RTT packets, the network thread formats
+ * packet N+1 while a background thread applies AEAD and header protection
+ * to packet N. The AEAD and header protection contexts of a connection
+ * are stateful and cannot be shared between threads, so there is exactly
+ * one worker per QUIC context and the jobs are processed in order. All
+ * the jobs queued by picoquic_prepare_packet_ex are completed before
+ * that function returns, so the rest of the stack never sees a packet
+ * that is not fully protected.
+ *
+ * We do not use the picoquic_event_t primitives here, because the
+ * Linux version has no predicate and may lose signals. The job ring is
+ * protected by a lock and two condition variables.
+ */
+
+#include "picoquic_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WINDOWS
+#include <pthread.h>
+#endif
+
+#define PICOQUIC_CRYPTO_OFFLOAD_RING_SIZE 64
+
+struct st_picoquic_crypto_offload_t {
+    picoquic_protect_job_t ring[PICOQUIC_CRYPTO_OFFLOAD_RING_SIZE];
+    uint64_t nb_submitted;
+    uint64_t nb_done;
+    int is_shutdown;
+    picoquic_thread_t thread;
+#ifdef _WINDOWS
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE work_cond;
+    CONDITION_VARIABLE done_cond;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+#endif
+};
+
+#ifdef _WINDOWS
+#define OFFLOAD_LOCK(o) EnterCriticalSection(&(o)->lock)
+#define OFFLOAD_UNLOCK(o) LeaveCriticalSection(&(o)->lock)
+#define OFFLOAD_WAIT(o, c) SleepConditionVariableCS(&(o)->c, &(o)->lock, INFINITE)
+#define OFFLOAD_SIGNAL(o, c) WakeConditionVariable(&(o)->c)
+#else
+#define OFFLOAD_LOCK(o) pthread_mutex_lock(&(o)->lock)
+#define OFFLOAD_UNLOCK(o) pthread_mutex_unlock(&(o)->lock)
+#define OFFLOAD_WAIT(o, c) pthread_cond_wait(&(o)->c, &(o)->lock)
+#define OFFLOAD_SIGNAL(o, c) pthread_cond_signal(&(o)->c)
+#endif
+
+static picoquic_thread_return_t picoquic_crypto_offload_worker(void* arg)
+{
+    picoquic_crypto_offload_t* offload = (picoquic_crypto_offload_t*)arg;
+
+    OFFLOAD_LOCK(offload);
+    while (!offload->is_shutdown) {
+        if (offload->nb_done < offload->nb_submitted) {
+            /* The slot cannot be reused until nb_done is incremented,
+             * so it is safe to process it without holding the lock. */
+            picoquic_protect_job_t* job = &offload->ring[offload->nb_done % PICOQUIC_CRYPTO_OFFLOAD_RING_SIZE];
+            OFFLOAD_UNLOCK(offload);
+            picoquic_protect_job_execute(job);
+            OFFLOAD_LOCK(offload);
+            offload->nb_done++;
+            OFFLOAD_SIGNAL(offload, done_cond);
+        }
+        else {
+            OFFLOAD_WAIT(offload, work_cond);
+        }
+    }
+    OFFLOAD_UNLOCK(offload);
+
+    picoquic_thread_do_return;
+}
+
+picoquic_crypto_offload_t* picoquic_crypto_offload_create(void)
+{
+    picoquic_crypto_offload_t* offload = (picoquic_crypto_offload_t*)malloc(sizeof(picoquic_crypto_offload_t));
+
+    if (offload != NULL) {
+        memset(offload, 0, sizeof(picoquic_crypto_offload_t));
+#ifdef _WINDOWS
+        InitializeCriticalSection(&offload->lock);
+        InitializeConditionVariable(&offload->work_cond);
+        InitializeConditionVariable(&offload->done_cond);
+#else
+        pthread_mutex_init(&offload->lock, NULL);
+        pthread_cond_init(&offload->work_cond, NULL);
+        pthread_cond_init(&offload->done_cond, NULL);
+#endif
+        if (picoquic_create_thread(&offload->thread, picoquic_crypto_offload_worker, offload) != 0) {
+            DBG_PRINTF("%s", "Cannot create the crypto offload thread");
+#ifdef _WINDOWS
+            DeleteCriticalSection(&offload->lock);
+#else
+            pthread_cond_destroy(&offload->done_cond);
+            pthread_cond_destroy(&offload->work_cond);
+            pthread_mutex_destroy(&offload->lock);
+#endif
+            free(offload);
+            offload = NULL;
+        }
+    }
+
+    return offload;
+}
+
+void picoquic_crypto_offload_delete(picoquic_crypto_offload_t* offload)
+{
+    if (offload != NULL) {
+        picoquic_crypto_offload_drain(offload);
+        OFFLOAD_LOCK(offload);
+        offload->is_shutdown = 1;
+        OFFLOAD_SIGNAL(offload, work_cond);
+        OFFLOAD_UNLOCK(offload);
+        (void)picoquic_wait_thread(offload->thread);
+#ifdef _WINDOWS
+        CloseHandle(offload->thread);
+        DeleteCriticalSection(&offload->lock);
+#else
+        pthread_cond_destroy(&offload->done_cond);
+        pthread_cond_destroy(&offload->work_cond);
+        pthread_mutex_destroy(&offload->lock);
+#endif
+        free(offload);
+    }
+}
+
+/* Queue a job for the worker. If the ring is full, wait until the worker
+ * frees a slot -- processing the job in the calling thread would require
+ * using the AEAD context concurrently with the worker. */
+void picoquic_crypto_offload_submit(picoquic_crypto_offload_t* offload, const picoquic_protect_job_t* job)
+{
+    OFFLOAD_LOCK(offload);
+    while (offload->nb_submitted - offload->nb_done >= PICOQUIC_CRYPTO_OFFLOAD_RING_SIZE) {
+        OFFLOAD_WAIT(offload, done_cond);
+    }
+    offload->ring[offload->nb_submitted % PICOQUIC_CRYPTO_OFFLOAD_RING_SIZE] = *job;
+    offload->nb_submitted++;
+    OFFLOAD_SIGNAL(offload, work_cond);
+    OFFLOAD_UNLOCK(offload);
+}
+
+/* Wait until all queued jobs are complete */
+void picoquic_crypto_offload_drain(picoquic_crypto_offload_t* offload)
+{
+    OFFLOAD_LOCK(offload);
+    while (offload->nb_done < offload->nb_submitted) {
+        OFFLOAD_WAIT(offload, done_cond);
+    }
+    OFFLOAD_UNLOCK(offload);
+}
+
+int picoquic_set_crypto_offload(picoquic_quic_t* quic, int enable)
+{
+    int ret = 0;
+
+    if (enable) {
+        if (quic->crypto_offload == NULL) {
+            quic->crypto_offload = picoquic_crypto_offload_create();
+            if (quic->crypto_offload == NULL) {
+                ret = PICOQUIC_ERROR_MEMORY;
+            }
+        }
+    }
+    else if (quic->crypto_offload != NULL) {
+        picoquic_crypto_offload_delete(quic->crypto_offload);
+        quic->crypto_offload = NULL;
+    }
+
+    return ret;
+}
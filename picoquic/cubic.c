@@ -249,7 +249,7 @@ static void picoquic_cubic_notify(
             case picoquic_congestion_notification_repeat:
             case picoquic_congestion_notification_ecn_ec:
             case picoquic_congestion_notification_timeout:
-                if (picoquic_check_handover(ack_state->lost_packet_sent_time)) { return; }
+                if (!cnx->skip_handover_suppression && picoquic_check_handover(ack_state->lost_packet_sent_time)) { cnx->nb_handover_suppressed++; return; }
 
                 /* For compatibility with Linux-TCP deployments, we implement a filter so
                  * Cubic will only back off after repeated losses, not just after a single loss.
@@ -340,7 +340,7 @@ static void picoquic_cubic_notify(
             case picoquic_congestion_notification_repeat:
             case picoquic_congestion_notification_ecn_ec:
             case picoquic_congestion_notification_timeout:
-                if (picoquic_check_handover(ack_state->lost_packet_sent_time)) { return; }
+                if (!cnx->skip_handover_suppression && picoquic_check_handover(ack_state->lost_packet_sent_time)) { cnx->nb_handover_suppressed++; return; }
 
                 /* For compatibility with Linux-TCP deployments, we implement a filter so
                  * Cubic will only back off after repeated losses, not just after a single loss.
@@ -394,7 +394,7 @@ static void picoquic_cubic_notify(
             case picoquic_congestion_notification_ecn_ec:
             case picoquic_congestion_notification_timeout:
 
-                if (picoquic_check_handover(ack_state->lost_packet_sent_time)) { return; }
+                if (!cnx->skip_handover_suppression && picoquic_check_handover(ack_state->lost_packet_sent_time)) { cnx->nb_handover_suppressed++; return; }
                 /* For compatibility with Linux-TCP deployments, we implement a filter so
                  * Cubic will only back off after repeated losses, not just after a single loss.
                  */
@@ -0,0 +1,135 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Experiment arms.
+ *
+ * Connections are assigned to arms by hashing the initial connection ID,
+ * as for log sampling, but mixed with a salt so that the assignment is
+ * not correlated with the log sampling, and so that a new experiment can
+ * reshuffle the connections. Both the client and the server see the same
+ * initial connection ID, so the assignment of a connection is the same in
+ * the logs of both ends if they use the same arms and salt.
+ */
+
+#include "picoquic_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void picoquic_experiment_free_arms(picoquic_quic_t* quic)
+{
+    if (quic->experiment_arms != NULL) {
+        for (size_t i = 0; i < quic->nb_experiment_arms; i++) {
+            if (quic->experiment_arms[i].name != NULL) {
+                free((char*)quic->experiment_arms[i].name);
+            }
+        }
+        free(quic->experiment_arms);
+        quic->experiment_arms = NULL;
+    }
+    quic->nb_experiment_arms = 0;
+    quic->experiment_weight_total = 0;
+}
+
+int picoquic_set_experiment_arms(picoquic_quic_t* quic, const picoquic_experiment_arm_t* arms, size_t nb_arms, uint64_t salt)
+{
+    int ret = 0;
+    uint64_t weight_total = 0;
+
+    if (nb_arms <= PICOQUIC_EXPERIMENT_ARMS_MAX) {
+        for (size_t i = 0; i < nb_arms; i++) {
+            weight_total += arms[i].weight;
+        }
+    }
+
+    if (nb_arms > PICOQUIC_EXPERIMENT_ARMS_MAX || (nb_arms > 0 && weight_total == 0)) {
+        ret = -1;
+    }
+    else {
+        picoquic_experiment_free_arms(quic);
+        if (nb_arms > 0) {
+            quic->experiment_arms = (picoquic_experiment_arm_t*)malloc(nb_arms * sizeof(picoquic_experiment_arm_t));
+            if (quic->experiment_arms == NULL) {
+                ret = PICOQUIC_ERROR_MEMORY;
+            }
+            else {
+                memcpy(quic->experiment_arms, arms, nb_arms * sizeof(picoquic_experiment_arm_t));
+                for (size_t i = 0; i < nb_arms; i++) {
+                    if (arms[i].name != NULL) {
+                        quic->experiment_arms[i].name = picoquic_string_duplicate(arms[i].name);
+                    }
+                }
+                quic->nb_experiment_arms = nb_arms;
+                quic->experiment_weight_total = weight_total;
+                quic->experiment_salt = salt;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int picoquic_get_experiment_arm(picoquic_cnx_t* cnx)
+{
+    return (int)cnx->experiment_arm - 1;
+}
+
+char const* picoquic_get_experiment_arm_name(picoquic_quic_t* quic, int arm_index)
+{
+    return (arm_index < 0 || (size_t)arm_index >= quic->nb_experiment_arms) ? NULL : quic->experiment_arms[arm_index].name;
+}
+
+/* Select the arm of a new connection and apply its settings, except for
+ * the initial window, which is set by the caller after the congestion
+ * algorithm is initialized. Returns NULL if there is no experiment. */
+const picoquic_experiment_arm_t* picoquic_experiment_assign(picoquic_cnx_t* cnx)
+{
+    picoquic_quic_t* quic = cnx->quic;
+    const picoquic_experiment_arm_t* arm = NULL;
+
+    if (quic->nb_experiment_arms > 0) {
+        uint64_t h = picoquic_connection_id_hash(&cnx->initial_cnxid) ^ quic->experiment_salt;
+        uint64_t x;
+        size_t i = 0;
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        x = h % quic->experiment_weight_total;
+        while (i < quic->nb_experiment_arms - 1 && x >= quic->experiment_arms[i].weight) {
+            x -= quic->experiment_arms[i].weight;
+            i++;
+        }
+        arm = &quic->experiment_arms[i];
+        cnx->experiment_arm = i + 1;
+        if (arm->congestion_alg != NULL) {
+            cnx->congestion_alg = arm->congestion_alg;
+        }
+        cnx->pacing_gain = arm->pacing_gain;
+        cnx->ack_gap_limit = arm->ack_gap_max;
+        cnx->ack_delay_limit = arm->ack_delay_max;
+        cnx->skip_handover_suppression = (arm->handover_policy == picoquic_handover_policy_none);
+    }
+
+    return arm;
+}
@@ -0,0 +1,696 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Forward error correction of 1-RTT packets.
+ *
+ * FEC is used if both peers set the enable_fec transport parameter. The
+ * sender keeps a copy of the latest ack eliciting 1-RTT packets of each
+ * number space, and regularly sends FEC_REPAIR frames carrying a linear
+ * combination of a sliding window of these source packets. The source
+ * symbols are the clear text payloads of the packets, prefixed with their
+ * length, so the receiver can rebuild a lost packet and process its frames
+ * without waiting at least one RTT for the retransmission. The preemptive
+ * repeat of stream data in sender.c does not help datagrams, and costs one
+ * copy per protected packet; FEC protects any frame.
+ *
+ * The rebuilt packets are not acknowledged. The sender detects the loss
+ * as usual, so the congestion control reacts to it and the redundancy
+ * follows the actual loss rate; the repeated frames arrive as duplicates.
+ * If the lost packet was only late, the receiver acknowledges it when it
+ * arrives, without processing its frames a second time.
+ *
+ * The code is a systematic sliding window random linear code over GF(256).
+ * The coefficients are taken from a Cauchy matrix, derived from the repair
+ * key and the packet numbers. Any square submatrix of a Cauchy matrix is
+ * invertible, so N repair symbols with distinct keys recover any N losses
+ * in the window. The receiver keeps the repair symbols that combine several
+ * lost packets, and solves them by Gaussian elimination when more repair
+ * symbols or late packets arrive.
+ *
+ * The redundancy adapts to the loss rate: a repair symbol is sent after K
+ * source packets, with K about 1/(2p) for a loss rate p, between 2 and 16,
+ * p being the rate of packets declared lost and not found spurious,
+ * and covers the last 2K source packets. Close to the predicted satellite
+ * handovers, K is set to the minimum, as these are the times of burst
+ * losses. A repair symbol is also sent when the sender runs out of data,
+ * to protect the tail of the transmission.
+ *
+ * FEC_REPAIR frame {
+ *     Type (i) = 0xfec5,
+ *     Repair Key (i),
+ *     First Packet Number (i),
+ *     Number Of Packets (i),
+ *     Packet Bitmap (8 * ceil(Number Of Packets / 8)),
+ *     Repair Symbol Length (i),
+ *     Repair Symbol (..)
+ * }
+ */
+
+#include "picoquic_internal.h"
+#include "sat_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PICOQUIC_FEC_MAX_SYMBOL (PICOQUIC_MAX_PACKET_SIZE + 2)
+#define PICOQUIC_FEC_MAX_ROWS 8
+#define PICOQUIC_FEC_K_MIN 2
+#define PICOQUIC_FEC_K_MAX 16
+#define PICOQUIC_FEC_LOSS_INTERVAL 64 /* packets between updates of the loss rate */
+#define PICOQUIC_FEC_FRAME_OVERHEAD 24 /* repair frame fields before the repair symbol, at most */
+
+typedef struct st_picoquic_fec_symbol_t {
+    uint64_t pn;
+    size_t length; /* 0 if the slot is empty */
+    int is_recovered; /* rebuilt from repair symbols, not acknowledged */
+    uint8_t bytes[PICOQUIC_FEC_MAX_SYMBOL];
+} picoquic_fec_symbol_t;
+
+/* Repair symbol with unknown source symbols. The coefficients are indexed
+ * by packet number modulo the window. All unknown symbols are within the
+ * window ending at pn_max, so the index is not ambiguous. */
+typedef struct st_picoquic_fec_row_t {
+    uint8_t coef[PICOQUIC_FEC_WINDOW];
+    uint64_t pn_min; /* Lowest unknown packet number */
+    size_t length;
+    uint8_t bytes[PICOQUIC_FEC_MAX_SYMBOL];
+} picoquic_fec_row_t;
+
+struct st_picoquic_fec_ctx_t {
+    picoquic_fec_symbol_t symbol[PICOQUIC_FEC_WINDOW];
+    uint64_t pn_max;
+    /* Sender */
+    uint64_t repair_key;
+    uint64_t nb_source_since_repair;
+    uint64_t repair_interval;
+    uint64_t loss_permille;
+    uint64_t nb_sent_prior;
+    uint64_t nb_lost_prior;
+    /* Receiver */
+    int nb_rows;
+    int is_recovering;
+    picoquic_fec_row_t* row[PICOQUIC_FEC_MAX_ROWS];
+    picoquic_fec_row_t row_storage[PICOQUIC_FEC_MAX_ROWS];
+};
+
+/* GF(256) arithmetic, with the polynomial x^8 + x^4 + x^3 + x^2 + 1 */
+static uint8_t picoquic_gf256_double(uint8_t a)
+{
+    return (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1d : 0));
+}
+
+static uint8_t picoquic_gf256_mul(uint8_t a, uint8_t b)
+{
+    uint8_t r = 0;
+
+    while (b != 0) {
+        if (b & 1) {
+            r ^= a;
+        }
+        a = picoquic_gf256_double(a);
+        b >>= 1;
+    }
+
+    return r;
+}
+
+/* a^254 is the inverse of a */
+static uint8_t picoquic_gf256_inv(uint8_t a)
+{
+    uint8_t r = 1;
+
+    for (int i = 0; i < 7; i++) {
+        a = picoquic_gf256_mul(a, a);
+        r = picoquic_gf256_mul(r, a);
+    }
+
+    return r;
+}
+
+/* target += c * source, using a multiplication table for c */
+static void picoquic_gf256_add_mul(uint8_t* target, const uint8_t* source, size_t length, uint8_t c)
+{
+    if (c == 1) {
+        for (size_t i = 0; i < length; i++) {
+            target[i] ^= source[i];
+        }
+    }
+    else if (c != 0) {
+        uint8_t table[256];
+
+        table[0] = 0;
+        for (int x = 1; x < 256; x++) {
+            table[x] = (x & 1) ? table[x - 1] ^ c : picoquic_gf256_double(table[x >> 1]);
+        }
+        for (size_t i = 0; i < length; i++) {
+            target[i] ^= table[source[i]];
+        }
+    }
+}
+
+static uint8_t picoquic_fec_coef(uint64_t key, uint64_t pn)
+{
+    return picoquic_gf256_inv((uint8_t)(0x80 | (key & 0x7f)) ^ (uint8_t)(pn & 0x7f));
+}
+
+static picoquic_fec_ctx_t* picoquic_fec_ctx_get(picoquic_fec_ctx_t** p_fec_ctx)
+{
+    if (*p_fec_ctx == NULL) {
+        *p_fec_ctx = (picoquic_fec_ctx_t*)malloc(sizeof(picoquic_fec_ctx_t));
+        if (*p_fec_ctx != NULL) {
+            memset(*p_fec_ctx, 0, sizeof(picoquic_fec_ctx_t));
+            for (int i = 0; i < PICOQUIC_FEC_MAX_ROWS; i++) {
+                (*p_fec_ctx)->row[i] = &(*p_fec_ctx)->row_storage[i];
+            }
+        }
+    }
+    return *p_fec_ctx;
+}
+
+void picoquic_fec_ctx_delete(picoquic_fec_ctx_t** p_fec_ctx)
+{
+    if (*p_fec_ctx != NULL) {
+        free(*p_fec_ctx);
+        *p_fec_ctx = NULL;
+    }
+}
+
+static void picoquic_fec_store_symbol(picoquic_fec_ctx_t* fec_ctx, uint64_t pn, const uint8_t* bytes, size_t length)
+{
+    picoquic_fec_symbol_t* symbol = &fec_ctx->symbol[pn % PICOQUIC_FEC_WINDOW];
+
+    symbol->pn = pn;
+    symbol->length = length + 2;
+    symbol->is_recovered = 0;
+    symbol->bytes[0] = (uint8_t)(length >> 8);
+    symbol->bytes[1] = (uint8_t)(length & 0xff);
+    memcpy(symbol->bytes + 2, bytes, length);
+}
+
+static picoquic_fec_symbol_t* picoquic_fec_find_symbol(picoquic_fec_ctx_t* fec_ctx, uint64_t pn)
+{
+    picoquic_fec_symbol_t* symbol = &fec_ctx->symbol[pn % PICOQUIC_FEC_WINDOW];
+
+    return (symbol->length > 0 && symbol->pn == pn) ? symbol : NULL;
+}
+
+/* Sender side */
+
+void picoquic_fec_record_sent(picoquic_packet_context_t* pkt_ctx, uint64_t pn, const uint8_t* bytes, size_t length)
+{
+    picoquic_fec_ctx_t* fec_ctx;
+
+    if (length + 2 <= PICOQUIC_FEC_MAX_SYMBOL && (fec_ctx = picoquic_fec_ctx_get(&pkt_ctx->fec_ctx)) != NULL) {
+        picoquic_fec_store_symbol(fec_ctx, pn, bytes, length);
+        fec_ctx->pn_max = pn;
+        fec_ctx->nb_source_since_repair++;
+    }
+}
+
+/* Number of source packets between repair symbols */
+static uint64_t picoquic_fec_repair_interval(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_fec_ctx_t* fec_ctx, uint64_t current_time)
+{
+    uint64_t nb_sent = cnx->nb_packets_sent - fec_ctx->nb_sent_prior;
+    uint64_t k = PICOQUIC_FEC_K_MAX;
+
+    if (nb_sent >= PICOQUIC_FEC_LOSS_INTERVAL) {
+        /* The packets rebuilt by the receiver are not acknowledged, so they
+         * are counted as losses like the other ones. */
+        uint64_t nb_lost_total = cnx->nb_retransmission_total - cnx->nb_spurious;
+        uint64_t nb_lost = (nb_lost_total > fec_ctx->nb_lost_prior) ? nb_lost_total - fec_ctx->nb_lost_prior : 0;
+        uint64_t loss = (nb_lost >= nb_sent) ? 1000 : (nb_lost * 1000) / nb_sent;
+
+        fec_ctx->loss_permille = (7 * fec_ctx->loss_permille + loss) / 8;
+        fec_ctx->nb_sent_prior = cnx->nb_packets_sent;
+        fec_ctx->nb_lost_prior = nb_lost_total;
+    }
+
+    if (!cnx->skip_handover_suppression &&
+        picoquic_handover_distance(current_time) <= path_x->smoothed_rtt + MARGIN * 1000ull) {
+        k = PICOQUIC_FEC_K_MIN;
+    }
+    else if (fec_ctx->loss_permille > 0) {
+        k = 500 / fec_ctx->loss_permille;
+        if (k < PICOQUIC_FEC_K_MIN) {
+            k = PICOQUIC_FEC_K_MIN;
+        }
+        else if (k > PICOQUIC_FEC_K_MAX) {
+            k = PICOQUIC_FEC_K_MAX;
+        }
+    }
+
+    return k;
+}
+
+/* Check whether a repair symbol shall be sent. If is_tail is set, the
+ * sender has no more data to send, and the last source packets are
+ * protected immediately. */
+int picoquic_fec_is_repair_needed(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_packet_context_t* pkt_ctx,
+    int is_tail, uint64_t current_time)
+{
+    int is_needed = 0;
+    picoquic_fec_ctx_t* fec_ctx = pkt_ctx->fec_ctx;
+
+    if (fec_ctx != NULL && fec_ctx->nb_source_since_repair > 0) {
+        fec_ctx->repair_interval = picoquic_fec_repair_interval(cnx, path_x, fec_ctx, current_time);
+        is_needed = is_tail || fec_ctx->nb_source_since_repair >= fec_ctx->repair_interval;
+    }
+
+    return is_needed;
+}
+
+uint8_t* picoquic_format_fec_repair_frame(picoquic_cnx_t* cnx, picoquic_packet_context_t* pkt_ctx,
+    uint8_t* bytes, uint8_t* bytes_max, int* is_pure_ack)
+{
+    uint8_t* bytes0 = bytes;
+    picoquic_fec_ctx_t* fec_ctx = pkt_ctx->fec_ctx;
+    picoquic_fec_symbol_t* selected[PICOQUIC_FEC_WINDOW];
+    int nb_selected = 0;
+    size_t repair_length = 0;
+
+    if (fec_ctx != NULL) {
+        uint64_t nb_window = 2 * fec_ctx->repair_interval;
+        uint64_t pn = fec_ctx->pn_max;
+        size_t room = bytes_max - bytes;
+
+        if (nb_window > PICOQUIC_FEC_WINDOW || nb_window == 0) {
+            nb_window = PICOQUIC_FEC_WINDOW;
+        }
+        /* Select the most recent source symbols, newest first. Symbols that
+         * were sent with a larger MTU may not fit in the repair frame. */
+        for (int i = 0; i < PICOQUIC_FEC_WINDOW && (uint64_t)nb_selected < nb_window && pn >= (uint64_t)i; i++) {
+            picoquic_fec_symbol_t* symbol = picoquic_fec_find_symbol(fec_ctx, pn - i);
+
+            if (symbol != NULL && symbol->length + PICOQUIC_FEC_FRAME_OVERHEAD <= room) {
+                selected[nb_selected++] = symbol;
+                if (symbol->length > repair_length) {
+                    repair_length = symbol->length;
+                }
+            }
+        }
+    }
+
+    if (nb_selected > 0) {
+        uint64_t first_pn = selected[nb_selected - 1]->pn;
+        uint64_t nb_pn = selected[0]->pn - first_pn + 1;
+        size_t bitmap_length = (size_t)((nb_pn + 7) / 8);
+        uint8_t* bitmap = NULL;
+
+        if ((bytes = picoquic_frames_varint_encode(bytes, bytes_max, picoquic_frame_type_fec_repair)) != NULL &&
+            (bytes = picoquic_frames_varint_encode(bytes, bytes_max, fec_ctx->repair_key)) != NULL &&
+            (bytes = picoquic_frames_varint_encode(bytes, bytes_max, first_pn)) != NULL &&
+            (bytes = picoquic_frames_varint_encode(bytes, bytes_max, nb_pn)) != NULL &&
+            bytes + bitmap_length <= bytes_max) {
+            bitmap = bytes;
+            memset(bitmap, 0, bitmap_length);
+            bytes += bitmap_length;
+            if ((bytes = picoquic_frames_varint_encode(bytes, bytes_max, repair_length)) != NULL &&
+                bytes + repair_length > bytes_max) {
+                bytes = NULL;
+            }
+        }
+        else {
+            bytes = NULL;
+        }
+
+        if (bytes == NULL) {
+            bytes = bytes0;
+        }
+        else {
+            memset(bytes, 0, repair_length);
+            for (int i = 0; i < nb_selected; i++) {
+                uint64_t rank = selected[i]->pn - first_pn;
+
+                bitmap[rank / 8] |= (uint8_t)(0x80 >> (rank % 8));
+                picoquic_gf256_add_mul(bytes, selected[i]->bytes, selected[i]->length,
+                    picoquic_fec_coef(fec_ctx->repair_key, selected[i]->pn));
+            }
+            bytes += repair_length;
+            /* Keep the key small, only its last 7 bits are used */
+            fec_ctx->repair_key = (fec_ctx->repair_key + 1) & 0x3fff;
+            fec_ctx->nb_source_since_repair = 0;
+            cnx->nb_fec_repair_sent++;
+            *is_pure_ack = 0;
+        }
+    }
+
+    return bytes;
+}
+
+/* Receiver side */
+
+static uint64_t picoquic_fec_row_pn(picoquic_fec_ctx_t* fec_ctx, int slot)
+{
+    return fec_ctx->pn_max - ((fec_ctx->pn_max + PICOQUIC_FEC_WINDOW - (uint64_t)slot) % PICOQUIC_FEC_WINDOW);
+}
+
+static int picoquic_fec_row_nb_unknown(picoquic_fec_row_t* row, int* slot)
+{
+    int nb_unknown = 0;
+
+    for (int i = 0; i < PICOQUIC_FEC_WINDOW; i++) {
+        if (row->coef[i] != 0) {
+            nb_unknown++;
+            *slot = i;
+        }
+    }
+
+    return nb_unknown;
+}
+
+static void picoquic_fec_row_add_mul(picoquic_fec_row_t* row, const uint8_t* bytes, size_t length, uint8_t c)
+{
+    if (length > row->length) {
+        memset(row->bytes + row->length, 0, length - row->length);
+        row->length = length;
+    }
+    picoquic_gf256_add_mul(row->bytes, bytes, length, c);
+}
+
+static void picoquic_fec_delete_row(picoquic_fec_ctx_t* fec_ctx, int rank)
+{
+    picoquic_fec_row_t* row = fec_ctx->row[rank];
+
+    for (int i = rank; i < fec_ctx->nb_rows - 1; i++) {
+        fec_ctx->row[i] = fec_ctx->row[i + 1];
+    }
+    fec_ctx->nb_rows--;
+    fec_ctx->row[fec_ctx->nb_rows] = row;
+}
+
+/* Remove a symbol that just became known from the pending repair symbols */
+static void picoquic_fec_substitute(picoquic_fec_ctx_t* fec_ctx, picoquic_fec_symbol_t* symbol)
+{
+    int slot = (int)(symbol->pn % PICOQUIC_FEC_WINDOW);
+
+    for (int i = 0; i < fec_ctx->nb_rows; i++) {
+        picoquic_fec_row_t* row = fec_ctx->row[i];
+
+        if (row->coef[slot] != 0) {
+            picoquic_fec_row_add_mul(row, symbol->bytes, symbol->length, row->coef[slot]);
+            row->coef[slot] = 0;
+        }
+    }
+}
+
+/* Move the window, and forget the repair symbols that combine packets
+ * that are now out of the window. */
+static void picoquic_fec_update_window(picoquic_fec_ctx_t* fec_ctx, uint64_t pn)
+{
+    if (pn > fec_ctx->pn_max) {
+        int i = 0;
+
+        fec_ctx->pn_max = pn;
+        while (i < fec_ctx->nb_rows) {
+            if (fec_ctx->row[i]->pn_min + PICOQUIC_FEC_WINDOW <= pn) {
+                picoquic_fec_delete_row(fec_ctx, i);
+            }
+            else {
+                i++;
+            }
+        }
+    }
+}
+
+/* Gauss-Jordan elimination of the unknown symbols in the pending repair symbols */
+static void picoquic_fec_eliminate(picoquic_fec_ctx_t* fec_ctx)
+{
+    int rank = 0;
+
+    for (int slot = 0; slot < PICOQUIC_FEC_WINDOW && rank < fec_ctx->nb_rows; slot++) {
+        int pivot = rank;
+
+        while (pivot < fec_ctx->nb_rows && fec_ctx->row[pivot]->coef[slot] == 0) {
+            pivot++;
+        }
+        if (pivot < fec_ctx->nb_rows) {
+            picoquic_fec_row_t* pivot_row = fec_ctx->row[pivot];
+            uint8_t inv = picoquic_gf256_inv(pivot_row->coef[slot]);
+
+            fec_ctx->row[pivot] = fec_ctx->row[rank];
+            fec_ctx->row[rank] = pivot_row;
+            for (int i = 0; i < fec_ctx->nb_rows; i++) {
+                picoquic_fec_row_t* row = fec_ctx->row[i];
+
+                if (i != rank && row->coef[slot] != 0) {
+                    uint8_t c = picoquic_gf256_mul(row->coef[slot], inv);
+
+                    for (int j = 0; j < PICOQUIC_FEC_WINDOW; j++) {
+                        row->coef[j] ^= picoquic_gf256_mul(c, pivot_row->coef[j]);
+                    }
+                    picoquic_fec_row_add_mul(row, pivot_row->bytes, pivot_row->length, c);
+                    if (pivot_row->pn_min < row->pn_min) {
+                        row->pn_min = pivot_row->pn_min;
+                    }
+                }
+            }
+            rank++;
+        }
+    }
+}
+
+/* Process the frames of a recovered packet. The packet number is not
+ * recorded as received, so the sender still learns about the loss. */
+static int picoquic_fec_process_recovered(picoquic_cnx_t* cnx, picoquic_fec_ctx_t* fec_ctx, picoquic_path_t* path_x,
+    picoquic_local_cnxid_t* l_cid, picoquic_fec_symbol_t* symbol,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, uint64_t current_time)
+{
+    int ret = 0;
+    size_t length = symbol->length - 2;
+
+    if (!picoquic_is_pn_already_received(cnx, picoquic_packet_context_application, l_cid, symbol->pn)) {
+        fec_ctx->is_recovering = 1;
+        ret = picoquic_decode_frames(cnx, path_x, symbol->bytes + 2, length, NULL, picoquic_epoch_1rtt,
+            addr_from, addr_to, symbol->pn, 0, current_time);
+        fec_ctx->is_recovering = 0;
+        if (ret == 0) {
+            symbol->is_recovered = 1;
+            cnx->nb_fec_recovered++;
+        }
+    }
+
+    return ret;
+}
+
+/* Recover the unknown symbols that are the only unknown of a repair symbol,
+ * until no more progress is possible. */
+static int picoquic_fec_solve(picoquic_cnx_t* cnx, picoquic_fec_ctx_t* fec_ctx, picoquic_path_t* path_x,
+    picoquic_local_cnxid_t* l_cid, struct sockaddr* addr_from, struct sockaddr* addr_to, uint64_t current_time)
+{
+    int ret = 0;
+    int is_progress = 1;
+
+    while (ret == 0 && is_progress && fec_ctx->nb_rows > 0) {
+        int i = 0;
+
+        is_progress = 0;
+        picoquic_fec_eliminate(fec_ctx);
+        while (ret == 0 && i < fec_ctx->nb_rows) {
+            picoquic_fec_row_t* row = fec_ctx->row[i];
+            int slot = 0;
+            int nb_unknown = picoquic_fec_row_nb_unknown(row, &slot);
+
+            if (nb_unknown > 1) {
+                i++;
+            }
+            else {
+                if (nb_unknown == 1 && row->length > 2) {
+                    picoquic_fec_symbol_t* symbol = &fec_ctx->symbol[slot];
+                    size_t length;
+
+                    symbol->pn = picoquic_fec_row_pn(fec_ctx, slot);
+                    symbol->is_recovered = 0;
+                    memset(symbol->bytes, 0, row->length);
+                    picoquic_gf256_add_mul(symbol->bytes, row->bytes, row->length, picoquic_gf256_inv(row->coef[slot]));
+                    length = ((size_t)symbol->bytes[0] << 8) + symbol->bytes[1];
+                    picoquic_fec_delete_row(fec_ctx, i);
+                    if (length > 0 && length + 2 <= row->length) {
+                        /* The repair symbol is as long as the longest source symbol */
+                        symbol->length = length + 2;
+                        picoquic_fec_substitute(fec_ctx, symbol);
+                        ret = picoquic_fec_process_recovered(cnx, fec_ctx, path_x, l_cid, symbol,
+                            addr_from, addr_to, current_time);
+                        is_progress = 1;
+                    }
+                    else {
+                        symbol->length = 0;
+                    }
+                }
+                else {
+                    picoquic_fec_delete_row(fec_ctx, i);
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Keep a copy of a received 1-RTT packet, and use it to solve the pending
+ * repair symbols. */
+int picoquic_fec_record_received(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_local_cnxid_t* l_cid,
+    uint64_t pn, const uint8_t* bytes, size_t length,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, uint64_t current_time)
+{
+    int ret = 0;
+    picoquic_ack_context_t* ack_ctx = picoquic_ack_ctx_from_cnx_context(cnx, picoquic_packet_context_application, l_cid);
+    picoquic_fec_ctx_t* fec_ctx;
+
+    if (length + 2 <= PICOQUIC_FEC_MAX_SYMBOL && (fec_ctx = picoquic_fec_ctx_get(&ack_ctx->fec_ctx)) != NULL &&
+        pn + PICOQUIC_FEC_WINDOW > fec_ctx->pn_max) {
+        picoquic_fec_update_window(fec_ctx, pn);
+        picoquic_fec_store_symbol(fec_ctx, pn, bytes, length);
+        if (fec_ctx->nb_rows > 0) {
+            picoquic_fec_substitute(fec_ctx, &fec_ctx->symbol[pn % PICOQUIC_FEC_WINDOW]);
+            ret = picoquic_fec_solve(cnx, fec_ctx, path_x, l_cid, addr_from, addr_to, current_time);
+        }
+    }
+
+    return ret;
+}
+
+/* Check whether a packet was already rebuilt from repair symbols. A late
+ * copy of that packet shall be acknowledged, but its frames were already
+ * processed. */
+int picoquic_fec_is_recovered(picoquic_cnx_t* cnx, picoquic_local_cnxid_t* l_cid, uint64_t pn)
+{
+    picoquic_fec_ctx_t* fec_ctx = picoquic_ack_ctx_from_cnx_context(cnx, picoquic_packet_context_application, l_cid)->fec_ctx;
+    picoquic_fec_symbol_t* symbol = (fec_ctx == NULL) ? NULL : picoquic_fec_find_symbol(fec_ctx, pn);
+
+    return symbol != NULL && symbol->is_recovered;
+}
+
+/* Add a repair symbol to the pending list, after removing the known source
+ * symbols. The repair symbol is ignored if one of the source packets was
+ * received but is not available anymore. */
+static void picoquic_fec_add_row(picoquic_cnx_t* cnx, picoquic_fec_ctx_t* fec_ctx, picoquic_local_cnxid_t* l_cid,
+    uint64_t key, uint64_t first_pn, uint64_t nb_pn, const uint8_t* bitmap, const uint8_t* repair, size_t repair_length)
+{
+    picoquic_fec_row_t* row;
+    int is_valid = 1;
+
+    picoquic_fec_update_window(fec_ctx, first_pn + nb_pn - 1);
+    if (fec_ctx->nb_rows >= PICOQUIC_FEC_MAX_ROWS) {
+        picoquic_fec_delete_row(fec_ctx, 0);
+    }
+    row = fec_ctx->row[fec_ctx->nb_rows];
+    memset(row->coef, 0, sizeof(row->coef));
+    row->pn_min = UINT64_MAX;
+    row->length = repair_length;
+    memcpy(row->bytes, repair, repair_length);
+
+    for (uint64_t i = 0; is_valid && i < nb_pn; i++) {
+        if ((bitmap[i / 8] & (0x80 >> (i % 8))) != 0) {
+            uint64_t pn = first_pn + i;
+            uint8_t c = picoquic_fec_coef(key, pn);
+            picoquic_fec_symbol_t* symbol = picoquic_fec_find_symbol(fec_ctx, pn);
+
+            if (symbol != NULL) {
+                if (symbol->length > repair_length) {
+                    is_valid = 0;
+                }
+                else {
+                    picoquic_gf256_add_mul(row->bytes, symbol->bytes, symbol->length, c);
+                }
+            }
+            else if (pn + PICOQUIC_FEC_WINDOW <= fec_ctx->pn_max ||
+                picoquic_is_pn_already_received(cnx, picoquic_packet_context_application, l_cid, pn)) {
+                is_valid = 0;
+            }
+            else {
+                row->coef[pn % PICOQUIC_FEC_WINDOW] = c;
+                if (pn < row->pn_min) {
+                    row->pn_min = pn;
+                }
+            }
+        }
+    }
+
+    if (is_valid && row->pn_min != UINT64_MAX) {
+        fec_ctx->nb_rows++;
+    }
+}
+
+const uint8_t* picoquic_decode_fec_repair_frame(picoquic_cnx_t* cnx, const uint8_t* bytes, const uint8_t* bytes_max,
+    picoquic_path_t* path_x, struct sockaddr* addr_from, struct sockaddr* addr_to, uint64_t current_time)
+{
+    uint64_t key = 0;
+    uint64_t first_pn = 0;
+    uint64_t nb_pn = 0;
+    uint64_t repair_length = 0;
+    const uint8_t* bitmap = NULL;
+    const uint8_t* repair = NULL;
+
+    /* This code assumes that the frame type is already skipped */
+    if ((bytes = picoquic_frames_varint_decode(bytes, bytes_max, &key)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &first_pn)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &nb_pn)) == NULL ||
+        nb_pn == 0 || nb_pn > PICOQUIC_FEC_WINDOW || first_pn + nb_pn < first_pn ||
+        (bitmap = bytes, bytes = picoquic_frames_fixed_skip(bytes, bytes_max, (nb_pn + 7) / 8)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &repair_length)) == NULL ||
+        repair_length > PICOQUIC_FEC_MAX_SYMBOL ||
+        (repair = bytes, bytes = picoquic_frames_fixed_skip(bytes, bytes_max, repair_length)) == NULL) {
+        picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR, picoquic_frame_type_fec_repair);
+        bytes = NULL;
+    }
+    else {
+        picoquic_local_cnxid_t* l_cid = path_x->p_local_cnxid;
+        picoquic_fec_ctx_t* fec_ctx;
+
+        cnx->nb_fec_repair_received++;
+        /* Repair symbols inside recovered packets are ignored */
+        if ((l_cid != NULL || !cnx->is_multipath_enabled) &&
+            (fec_ctx = picoquic_fec_ctx_get(&picoquic_ack_ctx_from_cnx_context(cnx,
+                picoquic_packet_context_application, l_cid)->fec_ctx)) != NULL &&
+            !fec_ctx->is_recovering) {
+            picoquic_fec_add_row(cnx, fec_ctx, l_cid, key, first_pn, nb_pn, bitmap, repair, (size_t)repair_length);
+            if (picoquic_fec_solve(cnx, fec_ctx, path_x, l_cid, addr_from, addr_to, current_time) != 0) {
+                bytes = NULL;
+            }
+        }
+    }
+
+    return bytes;
+}
+
+const uint8_t* picoquic_skip_fec_repair_frame(const uint8_t* bytes, const uint8_t* bytes_max)
+{
+    uint64_t nb_pn = 0;
+
+    /* This code assumes that the frame type is already skipped */
+    if ((bytes = picoquic_frames_varint_skip(bytes, bytes_max)) != NULL &&
+        (bytes = picoquic_frames_varint_skip(bytes, bytes_max)) != NULL &&
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &nb_pn)) != NULL &&
+        (bytes = picoquic_frames_fixed_skip(bytes, bytes_max, (nb_pn + 7) / 8)) != NULL) {
+        bytes = picoquic_frames_length_data_skip(bytes, bytes_max);
+    }
+
+    return bytes;
+}
+
+void picoquic_get_fec_stats(picoquic_cnx_t* cnx, picoquic_fec_stats_t* stats)
+{
+    stats->is_enabled = cnx->is_fec_enabled;
+    stats->nb_repair_sent = cnx->nb_fec_repair_sent;
+    stats->nb_repair_received = cnx->nb_fec_repair_received;
+    stats->nb_recovered = cnx->nb_fec_recovered;
+}
@@ -237,12 +237,17 @@ uint8_t * picoquic_format_stream_reset_frame(picoquic_cnx_t* cnx, picoquic_strea
             while (stream->send_queue != NULL) {
                 picoquic_stream_queue_node_t* next = stream->send_queue->next_stream_data;
 
-                if (stream->send_queue->bytes != NULL) {
-                    free(stream->send_queue->bytes);
-                }
-                free(stream->send_queue);
+                picoquic_stream_queue_node_free(stream, stream->send_queue);
                 stream->send_queue = next;
             }
+            /* Data sent by reference will not be repeated, it can be released */
+            while (stream->release_queue != NULL) {
+                picoquic_stream_queue_node_t* next = stream->release_queue->next_stream_data;
+
+                picoquic_stream_queue_node_free(stream, stream->release_queue);
+                stream->release_queue = next;
+            }
+            stream->release_queue_last = NULL;
             (void)picoquic_delete_stream_if_closed(cnx, stream);
         }
         else {
@@ -1051,6 +1056,7 @@ void picoquic_stream_data_callback(picoquic_cnx_t* cnx, picoquic_stream_head_t*
         size_t start = (size_t)(stream->consumed_offset - data->offset);
         if (data->length >= start) {
             size_t data_length = data->length - start;
+            stream->reorder_bytes -= data_length;
             picoquic_stream_data_chunk_callback(cnx, stream, data->bytes + start, data_length);
         }
         picosplay_delete_hint(&stream->stream_data_tree, &data->stream_data_node);
@@ -1060,8 +1066,31 @@ void picoquic_stream_data_callback(picoquic_cnx_t* cnx, picoquic_stream_head_t*
     picoquic_stream_data_chunk_callback(cnx, stream, NULL, 0);
 }
 
+/* Before in sequence data is delivered up to new_consumed_offset, remove from
+ * the reorder count the queued bytes below that offset. They will be dropped
+ * from the tree by the next call to picoquic_stream_data_callback, so the
+ * walk only visits nodes that are about to be deleted.
+ */
+static void picoquic_stream_data_nodes_skip(picoquic_stream_head_t* stream, uint64_t new_consumed_offset)
+{
+    picoquic_stream_data_node_t* data = (picoquic_stream_data_node_t*)picosplay_first(&stream->stream_data_tree);
+
+    while (data != NULL && data->offset < new_consumed_offset) {
+        uint64_t data_start = (data->offset > stream->consumed_offset) ? data->offset : stream->consumed_offset;
+        uint64_t data_end = data->offset + data->length;
+
+        if (data_end > new_consumed_offset) {
+            data_end = new_consumed_offset;
+        }
+        if (data_end > data_start) {
+            stream->reorder_bytes -= data_end - data_start;
+        }
+        data = (picoquic_stream_data_node_t*)picosplay_next(&data->stream_data_node);
+    }
+}
+
 static int add_chunk_node(picoquic_quic_t * quic, picosplay_tree_t* tree, uint64_t offset,
-    size_t length, const uint8_t* bytes, int* chunk_added, picoquic_stream_data_node_t * received_data)
+    size_t length, const uint8_t* bytes, size_t* new_bytes, picoquic_stream_data_node_t * received_data)
 {
     int ret = 0;
 
@@ -1090,15 +1119,18 @@ static int add_chunk_node(picoquic_quic_t * quic, picosplay_tree_t* tree, uint64
 
     if (node != NULL){
         picosplay_insert(tree, node);
-        *chunk_added = 1;
+        *new_bytes += length;
     }
 
     return ret;
 }
 
-/* Common code to data stream and crypto hs stream */
+/* Common code to data stream and crypto hs stream.
+ * The number of bytes actually added to the tree, after removing the parts
+ * already consumed or already received, is added to *new_bytes.
+ */
 int picoquic_queue_network_input(picoquic_quic_t * quic, picosplay_tree_t* tree, uint64_t consumed_offset,
-    uint64_t frame_data_offset, const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data, int* new_data_available)
+    uint64_t frame_data_offset, const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data, size_t* new_bytes)
 {
     const uint64_t input_begin = frame_data_offset;
     const uint64_t input_end = frame_data_offset + length;
@@ -1138,7 +1170,7 @@ int picoquic_queue_network_input(picoquic_quic_t * quic, picosplay_tree_t* tree,
 
             if (chunk_len > 0) {
                 /* There is a gap between previous and next frame, and it will be at least partially filled */
-                ret = add_chunk_node(quic, tree, chunk_ofs, (size_t)chunk_len, bytes + frame_data_offset - input_begin, new_data_available, received_data);
+                ret = add_chunk_node(quic, tree, chunk_ofs, (size_t)chunk_len, bytes + frame_data_offset - input_begin, new_bytes, received_data);
             }
 
             frame_data_offset = next->offset + next->length;
@@ -1149,7 +1181,7 @@ int picoquic_queue_network_input(picoquic_quic_t * quic, picosplay_tree_t* tree,
         if (ret == 0 && frame_data_offset < input_end) {
             const uint64_t chunk_ofs = frame_data_offset;
             const uint64_t chunk_len = input_end - frame_data_offset;
-            ret = add_chunk_node(quic, tree, chunk_ofs, (size_t)chunk_len, bytes + frame_data_offset - input_begin, new_data_available, received_data);
+            ret = add_chunk_node(quic, tree, chunk_ofs, (size_t)chunk_len, bytes + frame_data_offset - input_begin, new_bytes, received_data);
         }
     }
 
@@ -1214,23 +1246,26 @@ static int picoquic_stream_network_input(picoquic_cnx_t* cnx, uint64_t stream_id
                 uint64_t delivered_index = stream->consumed_offset - offset;
                 uint64_t data_length = length - delivered_index;
 
+                picoquic_stream_data_nodes_skip(stream, new_fin_offset);
                 /* Ugly cast, but the callback requires a non-const pointer */
                 picoquic_stream_data_chunk_callback(cnx, stream, (uint8_t *)bytes + delivered_index, (size_t)data_length);
                 /* Adjust the tree if needed */
                 picoquic_stream_data_callback(cnx, stream);
+                picoquic_stream_data_nodes_account(stream, current_time);
             }
             else {
                 /* Nothing to do with these incoming data, they are duplicate */
             }
         } else {
-            int new_data_available = 0;
+            size_t new_bytes = 0;
 
             ret = picoquic_queue_network_input(cnx->quic, &stream->stream_data_tree, stream->consumed_offset,
-                offset, bytes, length, received_data, &new_data_available);
+                offset, bytes, length, received_data, &new_bytes);
+            stream->reorder_bytes += new_bytes;
             if (ret != 0) {
                 ret = picoquic_connection_error(cnx, (int64_t)ret, 0);
             }
-            else if (new_data_available) {
+            else if (new_bytes > 0) {
                 should_notify = 1;
                 cnx->latest_receive_time = current_time;
             }
@@ -1239,6 +1274,7 @@ static int picoquic_stream_network_input(picoquic_cnx_t* cnx, uint64_t stream_id
                 /* check how much data there is to send */
                 picoquic_stream_data_callback(cnx, stream);
             }
+            picoquic_stream_data_nodes_account(stream, current_time);
         }
     }
 
@@ -1579,6 +1615,31 @@ uint8_t* picoquic_format_stream_frame_header(uint8_t* bytes, uint8_t* bytes_max,
     return bytes;
 }
 
+/* Read the next bytes of a file queued on a stream directly into the packet,
+ * and request readahead of the next part of the file when the reads come
+ * close to the end of the previously requested range.
+ */
+static int picoquic_stream_queue_node_read_file(picoquic_stream_queue_node_t* stream_data, uint8_t* bytes, size_t length)
+{
+    uint64_t read_offset = stream_data->file_offset + stream_data->offset;
+
+    if (read_offset + length + PICOQUIC_FILE_READAHEAD_SIZE / 2 > stream_data->readahead_offset) {
+        uint64_t file_end = stream_data->file_offset + stream_data->length;
+        uint64_t readahead_start = (stream_data->readahead_offset > read_offset) ? stream_data->readahead_offset : read_offset;
+        uint64_t readahead_length = PICOQUIC_FILE_READAHEAD_SIZE;
+
+        if (readahead_start + readahead_length > file_end) {
+            readahead_length = file_end - readahead_start;
+        }
+        if (readahead_length > 0) {
+            picoquic_file_readahead(stream_data->F, readahead_start, readahead_length);
+            stream_data->readahead_offset = readahead_start + readahead_length;
+        }
+    }
+
+    return picoquic_file_read_at(stream_data->F, read_offset, bytes, length);
+}
+
 uint8_t * picoquic_format_stream_frame(picoquic_cnx_t* cnx, picoquic_stream_head_t* stream,
     uint8_t* bytes, uint8_t* bytes_max, int * more_data, int * is_pure_ack, int* is_still_active, int * ret)
 {
@@ -1715,15 +1776,25 @@ uint8_t * picoquic_format_stream_frame(picoquic_cnx_t* cnx, picoquic_stream_head
 
                 byte_index = picoquic_encode_length_of_stream_frame(bytes0, byte_index, byte_space, length, &start_index);
 
-                if (length > 0 && stream->send_queue != NULL && stream->send_queue->bytes != NULL) {
-                    memcpy(&bytes0[byte_index], stream->send_queue->bytes + stream->send_queue->offset, length);
+                if (length > 0 && stream->send_queue != NULL && stream->send_queue->F != NULL &&
+                    picoquic_stream_queue_node_read_file(stream->send_queue, &bytes0[byte_index], length) != 0) {
+                    picoquic_log_app_message(cnx, "Cannot read file queued on stream %" PRIu64, stream->stream_id);
+                    *ret = picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_INTERNAL_ERROR, 0);
+                    length = 0;
+                    byte_index = 0;
+                }
+                else if (length > 0 && stream->send_queue != NULL &&
+                    (stream->send_queue->bytes != NULL || stream->send_queue->F != NULL)) {
+                    if (stream->send_queue->F == NULL) {
+                        memcpy(&bytes0[byte_index], stream->send_queue->bytes + stream->send_queue->offset, length);
+                    }
                     byte_index += length;
 
                     stream->send_queue->offset += length;
                     if (stream->send_queue->offset >= stream->send_queue->length) {
                         picoquic_stream_queue_node_t* next = stream->send_queue->next_stream_data;
-                        free(stream->send_queue->bytes);
-                        free(stream->send_queue);
+                        stream->send_queue->stream_offset_end = stream->sent_offset + length;
+                        picoquic_stream_queue_node_sent(stream, stream->send_queue);
                         stream->send_queue = next;
                     }
 
@@ -2224,9 +2295,9 @@ const uint8_t* picoquic_decode_crypto_hs_frame(picoquic_cnx_t* cnx, const uint8_
         picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR, picoquic_frame_type_crypto_hs);
     } else {
         picoquic_stream_head_t* stream = &cnx->tls_stream[epoch];
-        int new_data_available;
+        size_t new_bytes = 0;
         int ret = picoquic_queue_network_input(cnx->quic, &stream->stream_data_tree, stream->consumed_offset,
-            offset, data_bytes, (size_t)data_length, received_data, &new_data_available);
+            offset, data_bytes, (size_t)data_length, received_data, &new_bytes);
         if (ret != 0) {
             picoquic_connection_error(cnx, (int64_t)ret, picoquic_frame_type_crypto_hs);
             bytes = NULL;
@@ -2490,7 +2561,7 @@ picoquic_packet_t* picoquic_check_spurious_retransmission(picoquic_cnx_t* cnx,
                 if (cnx->congestion_alg != NULL) {
                     picoquic_per_ack_state_t ack_state = { 0 };
                     ack_state.lost_packet_number = p->sequence_number;
-                    cnx->congestion_alg->alg_notify(cnx, old_path, picoquic_congestion_notification_spurious_repeat,
+                    picoquic_congestion_notify(cnx, old_path, picoquic_congestion_notification_spurious_repeat,
                        &ack_state, current_time);
                 }
             }
@@ -2796,6 +2867,14 @@ void picoquic_compute_ack_gap_and_delay(picoquic_cnx_t* cnx, uint64_t rtt, uint6
             }
         }
     }
+
+    /* Limits set by the experiment arm of the connection */
+    if (cnx->ack_gap_limit > 0 && *ack_gap > cnx->ack_gap_limit) {
+        *ack_gap = cnx->ack_gap_limit;
+    }
+    if (cnx->ack_delay_limit > 0 && *ack_delay_max > cnx->ack_delay_limit) {
+        *ack_delay_max = (cnx->ack_delay_limit < remote_min_ack_delay) ? remote_min_ack_delay : cnx->ack_delay_limit;
+    }
 }
 
 /* In a multipath environment, a packet can carry acknowledgements for multiple paths.
@@ -2886,7 +2965,7 @@ void process_decoded_packet_data(picoquic_cnx_t* cnx, picoquic_path_t * path_x,
             ack_state.is_app_limited = packet_data->path_ack[i].rs_is_path_limited;
             ack_state.is_cwnd_limited = packet_data->path_ack[i].rs_is_cwnd_limited;
             packet_data->path_ack[i].acked_path->is_lost_feedback_notified = 0;
-            cnx->congestion_alg->alg_notify(cnx, packet_data->path_ack[i].acked_path,
+            picoquic_congestion_notify(cnx, packet_data->path_ack[i].acked_path,
                 picoquic_congestion_notification_acknowledgement,
                 &ack_state, current_time);
         }
@@ -3289,6 +3368,8 @@ int picoquic_check_frame_needs_repeat(picoquic_cnx_t* cnx, const uint8_t* bytes,
                 case picoquic_frame_type_ack_mp:
                 case picoquic_frame_type_ack_mp_ecn:
                 case picoquic_frame_type_time_stamp:
+                case picoquic_frame_type_fec_repair:
+                    /* Repair symbols are only useful if they arrive before the lost packets are repeated */
                     *no_need_to_repeat = 1;
                     break;
                 case picoquic_frame_type_path_abandon:
@@ -3346,6 +3427,23 @@ int picoquic_process_ack_of_stream_frame(picoquic_cnx_t* cnx, uint8_t* bytes,
             (void)picoquic_update_sack_list(&stream->sack_list,
                 offset, offset + data_length - ((fin) ? 0 : 1), 0);
 
+            if (stream->release_queue != NULL) {
+                picoquic_stream_release_acked_data(stream);
+            }
+
+            if (stream->is_delivery_probe_set) {
+                picoquic_sack_item_t* first_sack = picoquic_sack_first_item(&stream->sack_list);
+                if (first_sack != NULL && first_sack->start_of_sack_range == 0 &&
+                    first_sack->end_of_sack_range >= stream->delivery_probe_offset) {
+                    /* The delivery latency is reported on the default path */
+                    stream->is_delivery_probe_set = 0;
+                    if (cnx->quic->latency_hist != NULL) {
+                        picoquic_latency_record(cnx, cnx->path[0], picoquic_latency_stream_delivery,
+                            picoquic_get_quic_time(cnx->quic) - stream->delivery_probe_time);
+                    }
+                }
+            }
+
             picoquic_delete_stream_if_closed(cnx, stream);
         }
     }
@@ -3563,6 +3661,36 @@ static int picoquic_process_ack_range(
     return ret;
 }
 
+/* The ranges and gaps of ACK frames are decoded in batches, with
+ * picoquic_frames_varint_decode_n, before being processed one by one. */
+#define PICOQUIC_ACK_RANGE_BATCH 32
+
+typedef struct st_picoquic_ack_range_reader_t {
+    uint64_t values[PICOQUIC_ACK_RANGE_BATCH];
+    size_t nb_values;
+    size_t index;
+    uint64_t nb_remaining;
+} picoquic_ack_range_reader_t;
+
+static const uint8_t* picoquic_ack_range_next(const uint8_t* bytes, const uint8_t* bytes_max,
+    picoquic_ack_range_reader_t* reader, uint64_t* value)
+{
+    if (reader->index >= reader->nb_values) {
+        size_t nb_values = (reader->nb_remaining < PICOQUIC_ACK_RANGE_BATCH) ?
+            (size_t)reader->nb_remaining : PICOQUIC_ACK_RANGE_BATCH;
+
+        if (nb_values == 0 || (bytes = picoquic_frames_varint_decode_n(bytes, bytes_max, reader->values, nb_values)) == NULL) {
+            return NULL;
+        }
+        reader->nb_values = nb_values;
+        reader->index = 0;
+        reader->nb_remaining -= nb_values;
+    }
+    *value = reader->values[reader->index++];
+
+    return bytes;
+}
+
 const uint8_t* picoquic_decode_ack_frame(picoquic_cnx_t* cnx, const uint8_t* bytes,
     const uint8_t* bytes_max, uint64_t current_time, int epoch, int is_ecn, int has_path_id, picoquic_packet_data_t* packet_data)
 {
@@ -3626,13 +3754,22 @@ const uint8_t* picoquic_decode_ack_frame(picoquic_cnx_t* cnx, const uint8_t* byt
                 if (packet_data != NULL) {
                     packet_data->last_ack_delay = ack_delay;
                 }
+                if (cnx->quic->latency_hist != NULL) {
+                    picoquic_latency_record(cnx, ack_path, picoquic_latency_ack_delay, ack_delay);
+                }
             }
 
+            picoquic_ack_range_reader_t range_reader;
+
+            range_reader.nb_values = 0;
+            range_reader.index = 0;
+            range_reader.nb_remaining = 2 * num_block + 1;
+
             do {
                 uint64_t range;
                 uint64_t block_to_block;
 
-                if ((bytes = picoquic_frames_varint_decode(bytes, bytes_max, &range)) == NULL) {
+                if ((bytes = picoquic_ack_range_next(bytes, bytes_max, &range_reader, &range)) == NULL) {
                     DBG_PRINTF("Malformed ACK RANGE, %d blocks remain.\n", (int)num_block);
                     picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR, first_byte);
                     bytes = NULL;
@@ -3661,7 +3798,7 @@ const uint8_t* picoquic_decode_ack_frame(picoquic_cnx_t* cnx, const uint8_t* byt
                     break;
 
                 /* Skip the gap */
-                if ((bytes = picoquic_frames_varint_decode(bytes, bytes_max, &block_to_block)) == NULL) {
+                if ((bytes = picoquic_ack_range_next(bytes, bytes_max, &range_reader, &block_to_block)) == NULL) {
                     DBG_PRINTF("    Malformed ACK GAP, %d blocks remain.\n", (int)num_block);
                     picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR, first_byte);
                     bytes = NULL;
@@ -3703,7 +3840,7 @@ const uint8_t* picoquic_decode_ack_frame(picoquic_cnx_t* cnx, const uint8_t* byt
             picoquic_per_ack_state_t ack_state = { 0 };
             ack_state.lost_packet_number = largest_in_path;
             pkt_ctx->ecn_ce_total_remote = ecnx3[2];
-            cnx->congestion_alg->alg_notify(cnx, ack_path,
+            picoquic_congestion_notify(cnx, ack_path,
                 picoquic_congestion_notification_ecn_ec,
                 &ack_state, current_time);
         }
@@ -3713,6 +3850,61 @@ const uint8_t* picoquic_decode_ack_frame(picoquic_cnx_t* cnx, const uint8_t* byt
 }
 
 
+/* Incremental encoding of ACK ranges.
+ * When ACKs are sent continuously, only the largest acknowledged and the
+ * first range usually change. After a full encoding, the blocks encoded
+ * after the first range are kept in the ACK context, and copied as is in
+ * the next ACK as long as the SACK list below the top range did not change
+ * and the range selection would pick the same ranges. This is the case
+ * when all the recent ranges fit in the frame: none is skipped, and ranges
+ * are only dropped after being sent PICOQUIC_MAX_ACK_RANGE_REPEAT times.
+ * The cost of sending an ACK then only depends on the number of ranges
+ * still being repeated, not on the size of the SACK list.
+ */
+static int picoquic_ack_cache_is_valid(picoquic_ack_context_t* ack_ctx, picoquic_sack_item_t* last_sack, int is_opportunistic)
+{
+    picoquic_ack_cache_t* cache = ack_ctx->ack_cache;
+    int is_valid = (cache != NULL && cache->is_valid &&
+        cache->sack_change_count == ack_ctx->sack_list.change_count &&
+        cache->top_sack == last_sack && cache->is_opportunistic == is_opportunistic);
+
+    for (int i = 0; is_valid && i < cache->nb_blocks; i++) {
+        /* Ranges sent more often than the repeat limit are not selected anymore */
+        is_valid = picoquic_sack_item_nb_times_sent(cache->blocks[i], is_opportunistic) <= PICOQUIC_MAX_ACK_RANGE_REPEAT;
+    }
+
+    return is_valid;
+}
+
+static uint8_t* picoquic_ack_cache_encode(picoquic_ack_context_t* ack_ctx, uint8_t* bytes, uint8_t* bytes_max,
+    uint64_t lowest_acknowledged, int is_opportunistic)
+{
+    picoquic_ack_cache_t* cache = ack_ctx->ack_cache;
+
+    if (cache->nb_blocks > 0) {
+        /* The gap before the first block depends on the start of the top range */
+        uint64_t ack_gap = lowest_acknowledged - picoquic_sack_item_range_end(cache->blocks[0]) - 2;
+
+        if ((bytes = picoquic_frames_varint_encode(bytes, bytes_max, ack_gap)) != NULL) {
+            if (bytes + cache->tail_length > bytes_max) {
+                bytes = NULL;
+            }
+            else {
+                memcpy(bytes, cache->tail, cache->tail_length);
+                bytes += cache->tail_length;
+                for (int i = 0; i < cache->nb_blocks; i++) {
+                    picoquic_sack_item_record_sent(&ack_ctx->sack_list, cache->blocks[i], is_opportunistic);
+                }
+            }
+        }
+    }
+    if (bytes != NULL) {
+        cache->nb_reused++;
+    }
+
+    return bytes;
+}
+
 uint8_t* picoquic_format_ack_frame_in_context(picoquic_cnx_t* cnx, uint8_t* bytes, uint8_t* bytes_max,
     int* more_data, uint64_t current_time, picoquic_ack_context_t* ack_ctx, int* need_time_stamp,
     uint64_t multipath_sequence, int is_opportunistic)
@@ -3765,19 +3957,47 @@ uint8_t* picoquic_format_ack_frame_in_context(picoquic_cnx_t* cnx, uint8_t* byte
             int nb_sent_max_acked = 0;
             int nb_sent_max_skip = 0;
             picoquic_sack_item_t* next_sack = picoquic_sack_previous_item(last_sack);
+            picoquic_ack_cache_t* cache = ack_ctx->ack_cache;
+            uint8_t* tail_start = NULL;
+            uint8_t* bytes_first_block = bytes;
+            int is_cacheable = 0;
 
             /* Update send count for the top range */
             picoquic_sack_item_record_sent(&ack_ctx->sack_list, last_sack, is_opportunistic);
 
-            /* Find the parameters of range selection: max number of repeats, 
-             * highest range splits required.
-             */
-            picoquic_sack_select_ack_ranges(&ack_ctx->sack_list, last_sack, 32, 
-                is_opportunistic, &nb_sent_max_acked, &nb_sent_max_skip);
-
             /* Set the lowest acknowledged */
             lowest_acknowledged = picoquic_sack_item_range_start(last_sack);
-            while (num_block < 32 && next_sack != NULL) {
+
+            /* Reuse the blocks encoded in the previous ACK if possible */
+            if (picoquic_ack_cache_is_valid(ack_ctx, last_sack, is_opportunistic) &&
+                (bytes = picoquic_ack_cache_encode(ack_ctx, bytes, bytes_max, lowest_acknowledged, is_opportunistic)) != NULL) {
+                num_block = cache->nb_blocks;
+                next_sack = NULL;
+            }
+            else {
+                bytes = bytes_first_block;
+                if (cache != NULL) {
+                    cache->is_valid = 0;
+                }
+                /* Find the parameters of range selection: max number of repeats,
+                 * highest range splits required.
+                 */
+                picoquic_sack_select_ack_ranges(&ack_ctx->sack_list, last_sack, PICOQUIC_MAX_ACK_BLOCKS,
+                    is_opportunistic, &nb_sent_max_acked, &nb_sent_max_skip);
+                /* The selection is stable if all the recent ranges fit in the frame */
+                if (nb_sent_max_acked == PICOQUIC_MAX_ACK_RANGE_REPEAT && nb_sent_max_skip == 0) {
+                    if (cache == NULL) {
+                        cache = (picoquic_ack_cache_t*)malloc(sizeof(picoquic_ack_cache_t));
+                        if (cache != NULL) {
+                            memset(cache, 0, sizeof(picoquic_ack_cache_t));
+                            ack_ctx->ack_cache = cache;
+                        }
+                    }
+                    is_cacheable = (cache != NULL);
+                }
+            }
+
+            while (num_block < PICOQUIC_MAX_ACK_BLOCKS && next_sack != NULL) {
                 if (picoquic_sack_item_nb_times_sent(next_sack, is_opportunistic) <= nb_sent_max_acked) {
                     if (picoquic_sack_item_nb_times_sent(next_sack, is_opportunistic) == nb_sent_max_acked &&
                         nb_sent_max_skip > 0) {
@@ -3797,6 +4017,13 @@ uint8_t* picoquic_format_ack_frame_in_context(picoquic_cnx_t* cnx, uint8_t* byte
                         else {
                             picoquic_sack_item_record_sent(&ack_ctx->sack_list, next_sack, is_opportunistic);
                             lowest_acknowledged = picoquic_sack_item_range_start(next_sack);
+                            if (num_block == 0) {
+                                /* The cached blocks start after the first gap */
+                                tail_start = bytes_start_range + picoquic_varint_skip(bytes_start_range);
+                            }
+                            if (is_cacheable) {
+                                cache->blocks[num_block] = next_sack;
+                            }
                             num_block++;
                         }
                     }
@@ -3806,6 +4033,19 @@ uint8_t* picoquic_format_ack_frame_in_context(picoquic_cnx_t* cnx, uint8_t* byte
             /* When numbers are lower than 64, varint encoding fits on one byte */
             *num_block_byte = (uint8_t)num_block;
 
+            /* Keep the encoded blocks if all the selected ranges were encoded */
+            if (is_cacheable && next_sack == NULL) {
+                cache->sack_change_count = ack_ctx->sack_list.change_count;
+                cache->top_sack = last_sack;
+                cache->nb_blocks = (int)num_block;
+                cache->is_opportunistic = is_opportunistic;
+                cache->tail_length = (num_block == 0) ? 0 : bytes - tail_start;
+                if (cache->tail_length > 0) {
+                    memcpy(cache->tail, tail_start, cache->tail_length);
+                }
+                cache->is_valid = 1;
+            }
+
             /* Remember the ACK value and time */
             if (!is_opportunistic) {
                 ack_ctx->act[0].highest_ack_sent = picoquic_sack_list_last(&ack_ctx->sack_list);
@@ -4839,39 +5079,154 @@ uint8_t * picoquic_format_datagram_frame(uint8_t* bytes, uint8_t* bytes_max, int
     return bytes;
 }
 
-int picoquic_queue_datagram_frame(picoquic_cnx_t * cnx, size_t length, const uint8_t * src)
+/* Remove a datagram from the queue, and count it if it was dropped */
+static void picoquic_delete_queued_datagram(picoquic_cnx_t* cnx, picoquic_misc_frame_header_t* datagram, uint64_t* nb_dropped)
 {
-    int ret;
+    picoquic_delete_misc_or_dg(&cnx->first_datagram, &cnx->last_datagram, datagram);
+    cnx->nb_datagrams_queued--;
+    (*nb_dropped)++;
+}
+
+int picoquic_queue_datagram_frame_ex(picoquic_cnx_t* cnx, size_t length, const uint8_t* src,
+    uint8_t priority, uint64_t expiry_time)
+{
+    int ret = 0;
+    picoquic_misc_frame_header_t* datagram = NULL;
+
     if (length > PICOQUIC_DATAGRAM_QUEUE_MAX_LENGTH) {
         ret = PICOQUIC_ERROR_DATAGRAM_TOO_LONG;
     }
-    else {
+    else if (cnx->datagram_queue_max > 0 && cnx->nb_datagrams_queued >= cnx->datagram_queue_max) {
+        /* Make room by dropping the least urgent datagram, i.e., the last one */
+        picoquic_misc_frame_header_t* least_urgent = cnx->last_datagram;
+
+        while (least_urgent != NULL && !least_urgent->is_datagram) {
+            least_urgent = least_urgent->previous_misc_frame;
+        }
+        if (least_urgent != NULL && least_urgent->priority > priority) {
+            picoquic_delete_queued_datagram(cnx, least_urgent, &cnx->nb_datagrams_dropped);
+        }
+        else {
+            cnx->nb_datagrams_dropped++;
+            ret = PICOQUIC_ERROR_DATAGRAM_QUEUE_FULL;
+        }
+    }
+
+    if (ret == 0) {
         size_t consumed = 0;
         uint8_t frame_buffer[PICOQUIC_MAX_PACKET_SIZE];
         int more_data = 0;
         int is_pure_ack = 1;
         uint8_t* bytes_next = picoquic_format_datagram_frame(frame_buffer, frame_buffer + sizeof(frame_buffer), &more_data, &is_pure_ack, length, src);
 
-        if ((consumed = bytes_next - frame_buffer) > 0) {
-            ret = picoquic_queue_misc_or_dg_frame(cnx, &cnx->first_datagram, &cnx->last_datagram,
-                frame_buffer, consumed, 0);
+        if ((consumed = bytes_next - frame_buffer) == 0) {
+            ret = PICOQUIC_ERROR_FRAME_BUFFER_TOO_SMALL;
+        }
+        else if ((datagram = picoquic_create_misc_frame(frame_buffer, consumed, 0)) == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
         }
         else {
-            ret = PICOQUIC_ERROR_FRAME_BUFFER_TOO_SMALL;
+            /* Insert after the last datagram of the same or more urgent class.
+             * Other frames in the queue are not passed. */
+            picoquic_misc_frame_header_t* previous = cnx->last_datagram;
+
+            datagram->priority = priority;
+            datagram->expiry_time = expiry_time;
+            datagram->is_datagram = 1;
+            while (previous != NULL && previous->is_datagram && previous->priority > priority) {
+                previous = previous->previous_misc_frame;
+            }
+            datagram->previous_misc_frame = previous;
+            if (previous == NULL) {
+                datagram->next_misc_frame = cnx->first_datagram;
+                cnx->first_datagram = datagram;
+            }
+            else {
+                datagram->next_misc_frame = previous->next_misc_frame;
+                previous->next_misc_frame = datagram;
+            }
+            if (datagram->next_misc_frame == NULL) {
+                cnx->last_datagram = datagram;
+            }
+            else {
+                datagram->next_misc_frame->previous_misc_frame = datagram;
+            }
+            cnx->nb_datagrams_queued++;
+            if (expiry_time != 0 && (cnx->datagram_expiry_next == 0 || expiry_time < cnx->datagram_expiry_next)) {
+                cnx->datagram_expiry_next = expiry_time;
+            }
+            picoquic_reinsert_by_wake_time(cnx->quic, cnx, picoquic_get_quic_time(cnx->quic));
         }
     }
     return ret;
 }
 
-uint8_t * picoquic_format_first_datagram_frame(picoquic_cnx_t* cnx, uint8_t* bytes,
-    uint8_t *bytes_max, int * more_data, int * is_pure_ack)
+int picoquic_queue_datagram_frame(picoquic_cnx_t * cnx, size_t length, const uint8_t * src)
+{
+    uint8_t priority = (cnx->datagram_priority > UINT8_MAX) ? UINT8_MAX : (uint8_t)cnx->datagram_priority;
+
+    return picoquic_queue_datagram_frame_ex(cnx, length, src, priority, 0);
+}
+
+void picoquic_set_datagram_queue_max(picoquic_cnx_t* cnx, size_t max_datagrams)
+{
+    cnx->datagram_queue_max = max_datagrams;
+}
+
+void picoquic_get_datagram_queue_stats(picoquic_cnx_t* cnx, picoquic_datagram_queue_stats_t* stats)
+{
+    stats->nb_queued = cnx->nb_datagrams_queued;
+    stats->nb_sent = cnx->nb_datagrams_queue_sent;
+    stats->nb_expired = cnx->nb_datagrams_expired;
+    stats->nb_dropped = cnx->nb_datagrams_dropped;
+    stats->nb_late = cnx->nb_datagrams_late;
+}
+
+/* Drop the queued datagrams whose expiry time has passed. The queue is
+ * only scanned when the earliest expiry time is reached, and that time is
+ * then recomputed. */
+void picoquic_purge_expired_datagrams(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    if (cnx->datagram_expiry_next != 0 && cnx->datagram_expiry_next <= current_time) {
+        picoquic_misc_frame_header_t* datagram = cnx->first_datagram;
+
+        cnx->datagram_expiry_next = 0;
+        while (datagram != NULL) {
+            picoquic_misc_frame_header_t* next = datagram->next_misc_frame;
+
+            if (datagram->is_datagram && datagram->expiry_time != 0) {
+                if (datagram->expiry_time <= current_time) {
+                    picoquic_delete_queued_datagram(cnx, datagram, &cnx->nb_datagrams_expired);
+                }
+                else if (cnx->datagram_expiry_next == 0 || datagram->expiry_time < cnx->datagram_expiry_next) {
+                    cnx->datagram_expiry_next = datagram->expiry_time;
+                }
+            }
+            datagram = next;
+        }
+    }
+}
+
+uint8_t * picoquic_format_first_datagram_frame(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint8_t* bytes,
+    uint8_t *bytes_max, int * more_data, int * is_pure_ack, uint64_t current_time)
 {
     if (bytes + cnx->first_datagram->length > bytes_max) {
         *more_data = 1;
     }
     else {
+        uint8_t* bytes0 = bytes;
+        uint64_t expiry_time = cnx->first_datagram->expiry_time;
+        int is_datagram = cnx->first_datagram->is_datagram;
+
         bytes = picoquic_format_first_misc_or_dg_frame(bytes, bytes_max, more_data, is_pure_ack, 
             &cnx->first_datagram, &cnx->last_datagram);
+        if (bytes > bytes0 && is_datagram) {
+            cnx->nb_datagrams_queued--;
+            cnx->nb_datagrams_queue_sent++;
+            if (expiry_time != 0 && current_time + path_x->smoothed_rtt / 2 > expiry_time) {
+                cnx->nb_datagrams_late++;
+            }
+        }
     }
 
     return bytes;
@@ -5949,6 +6304,16 @@ int picoquic_decode_frames(picoquic_cnx_t* cnx, picoquic_path_t * path_x, const
                         bytes = picoquic_decode_bdp_frame(cnx, bytes, bytes_max, current_time, addr_from, path_x);
                         ack_needed = 1;
                         break;
+                    case picoquic_frame_type_fec_repair:
+                        if (epoch != picoquic_epoch_1rtt || !cnx->is_fec_enabled) {
+                            DBG_PRINTF("FEC repair frame (0x%x) not expected", first_byte);
+                            picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_PROTOCOL_VIOLATION, frame_id64);
+                            bytes = NULL;
+                            break;
+                        }
+                        bytes = picoquic_decode_fec_repair_frame(cnx, bytes, bytes_max, path_x, addr_from, addr_to, current_time);
+                        ack_needed = 1;
+                        break;
                     default:
                         /* Not implemented yet! */
                         picoquic_connection_error(cnx, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR, frame_id64);
@@ -6254,6 +6619,10 @@ int picoquic_skip_frame(const uint8_t* bytes, size_t bytes_maxsize, size_t* cons
                     bytes = picoquic_skip_bdp_frame(bytes, bytes_max);
                     *pure_ack = 0;
                     break;
+                case picoquic_frame_type_fec_repair:
+                    bytes = picoquic_skip_fec_repair_frame(bytes, bytes_max);
+                    *pure_ack = 0;
+                    break;
                 case picoquic_frame_type_mp_new_connection_id:
                     bytes = picoquic_skip_new_connection_id_frame(bytes_before_type, bytes_max, 1);
                     *pure_ack = 0;
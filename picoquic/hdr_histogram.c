@@ -0,0 +1,212 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* HDR histograms of latency values.
+ *
+ * Values below 16 have their own bucket. Above that, each power of 2 is
+ * divided in 16 linear sub-buckets, so the width of a bucket is at most
+ * 1/16th of its lower bound. With 40 bits of range, microsecond values
+ * up to about 12 days are counted precisely, and larger values are counted
+ * in the last bucket.
+ */
+
+#include "picoquic_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HDR_HIST_SUB_BITS 4
+
+static int picoquic_hdr_hist_index(uint64_t value)
+{
+    int index;
+
+    if (value < PICOQUIC_HDR_HIST_SUB_BUCKETS) {
+        index = (int)value;
+    }
+    else {
+        int exponent = HDR_HIST_SUB_BITS;
+
+        while (exponent < PICOQUIC_HDR_HIST_MAX_EXPONENT - 1 && (value >> (exponent + 1)) != 0) {
+            exponent++;
+        }
+        if ((value >> (exponent + 1)) != 0) {
+            index = PICOQUIC_HDR_HIST_NB_BUCKETS - 1;
+        }
+        else {
+            index = PICOQUIC_HDR_HIST_SUB_BUCKETS * (exponent - HDR_HIST_SUB_BITS + 1) +
+                (int)((value >> (exponent - HDR_HIST_SUB_BITS)) & (PICOQUIC_HDR_HIST_SUB_BUCKETS - 1));
+        }
+    }
+
+    return index;
+}
+
+/* Highest value counted in the bucket */
+static uint64_t picoquic_hdr_hist_bucket_max(int index)
+{
+    uint64_t v;
+
+    if (index < PICOQUIC_HDR_HIST_SUB_BUCKETS) {
+        v = (uint64_t)index;
+    }
+    else {
+        int shift = index / PICOQUIC_HDR_HIST_SUB_BUCKETS - 1;
+        uint64_t sub = (uint64_t)(index % PICOQUIC_HDR_HIST_SUB_BUCKETS) + PICOQUIC_HDR_HIST_SUB_BUCKETS;
+
+        v = ((sub + 1) << shift) - 1;
+    }
+
+    return v;
+}
+
+void picoquic_hdr_hist_reset(picoquic_hdr_hist_t* hist)
+{
+    memset(hist, 0, sizeof(picoquic_hdr_hist_t));
+    hist->min = UINT64_MAX;
+}
+
+void picoquic_hdr_hist_record(picoquic_hdr_hist_t* hist, uint64_t value)
+{
+    hist->bucket[picoquic_hdr_hist_index(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void picoquic_hdr_hist_merge(picoquic_hdr_hist_t* hist, const picoquic_hdr_hist_t* other)
+{
+    for (int i = 0; i < PICOQUIC_HDR_HIST_NB_BUCKETS; i++) {
+        hist->bucket[i] += other->bucket[i];
+    }
+    hist->count += other->count;
+    hist->sum += other->sum;
+    if (other->min < hist->min) {
+        hist->min = other->min;
+    }
+    if (other->max > hist->max) {
+        hist->max = other->max;
+    }
+}
+
+uint64_t picoquic_hdr_hist_percentile(const picoquic_hdr_hist_t* hist, double percentile)
+{
+    uint64_t value = 0;
+
+    if (hist->count > 0) {
+        uint64_t rank = (uint64_t)((percentile * (double)hist->count) / 100.0 + 0.5);
+        uint64_t cumulated = 0;
+        int i = 0;
+
+        if (rank < 1) {
+            rank = 1;
+        }
+        else if (rank > hist->count) {
+            rank = hist->count;
+        }
+        while (i < PICOQUIC_HDR_HIST_NB_BUCKETS - 1) {
+            cumulated += hist->bucket[i];
+            if (cumulated >= rank) {
+                break;
+            }
+            i++;
+        }
+        /* The last bucket has no upper bound */
+        value = (i == PICOQUIC_HDR_HIST_NB_BUCKETS - 1) ? hist->max : picoquic_hdr_hist_bucket_max(i);
+        if (value > hist->max) {
+            value = hist->max;
+        }
+        if (value < hist->min) {
+            value = hist->min;
+        }
+    }
+
+    return value;
+}
+
+static picoquic_hdr_hist_t* picoquic_latency_hist_create(void)
+{
+    picoquic_hdr_hist_t* hist = (picoquic_hdr_hist_t*)malloc(picoquic_latency_max * sizeof(picoquic_hdr_hist_t));
+
+    if (hist != NULL) {
+        for (int i = 0; i < picoquic_latency_max; i++) {
+            picoquic_hdr_hist_reset(&hist[i]);
+        }
+    }
+
+    return hist;
+}
+
+int picoquic_set_latency_histograms(picoquic_quic_t* quic, int enable)
+{
+    int ret = 0;
+
+    if (enable) {
+        if (quic->latency_hist == NULL && (quic->latency_hist = picoquic_latency_hist_create()) == NULL) {
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+    }
+    else if (quic->latency_hist != NULL) {
+        /* Path histograms are kept until the paths are deleted, but will not be updated */
+        free(quic->latency_hist);
+        quic->latency_hist = NULL;
+    }
+
+    return ret;
+}
+
+/* Record a latency sample in the QUIC context and, if the path is
+ * specified, in the path context. The path histograms are only
+ * allocated when the first sample is recorded. */
+void picoquic_latency_record(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_latency_enum metric, uint64_t value)
+{
+    picoquic_hdr_hist_record(&cnx->quic->latency_hist[metric], value);
+    if (path_x != NULL) {
+        if (path_x->latency_hist == NULL) {
+            path_x->latency_hist = picoquic_latency_hist_create();
+        }
+        if (path_x->latency_hist != NULL) {
+            picoquic_hdr_hist_record(&path_x->latency_hist[metric], value);
+        }
+    }
+}
+
+const picoquic_hdr_hist_t* picoquic_get_latency_histogram(picoquic_quic_t* quic, picoquic_latency_enum metric)
+{
+    return (quic->latency_hist == NULL || metric >= picoquic_latency_max) ? NULL : &quic->latency_hist[metric];
+}
+
+const picoquic_hdr_hist_t* picoquic_get_path_latency_histogram(picoquic_cnx_t* cnx, uint64_t unique_path_id,
+    picoquic_latency_enum metric)
+{
+    const picoquic_hdr_hist_t* hist = NULL;
+    int path_id = picoquic_get_path_id_from_unique(cnx, unique_path_id);
+
+    if (path_id >= 0 && cnx->path[path_id]->latency_hist != NULL && metric < picoquic_latency_max) {
+        hist = &cnx->path[path_id]->latency_hist[metric];
+    }
+
+    return hist;
+}
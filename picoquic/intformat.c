@@ -137,7 +137,15 @@ size_t picoquic_varint_decode(const uint8_t* bytes, size_t max_bytes, uint64_t*
 {
     size_t length = 0;
     
-    if (max_bytes < 1) {
+    if (max_bytes >= 8) {
+        /* Single 64 bit load, see picoquic_frames_varint_decode */
+        uint64_t v = ((uint64_t)bytes[0] << 56) | ((uint64_t)bytes[1] << 48) | ((uint64_t)bytes[2] << 40) |
+            ((uint64_t)bytes[3] << 32) | ((uint64_t)bytes[4] << 24) | ((uint64_t)bytes[5] << 16) |
+            ((uint64_t)bytes[6] << 8) | (uint64_t)bytes[7];
+        length = ((size_t)1) << (bytes[0] >> 6);
+        *n64 = ((v << 2) >> 2) >> (64 - 8 * length);
+    }
+    else if (max_bytes < 1) {
         *n64 = 0;
     } else {
         length = ((size_t)1) << ((bytes[0] & 0xC0) >> 6);
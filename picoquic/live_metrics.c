@@ -0,0 +1,518 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Live metrics.
+ *
+ * The performance log only records connection data when the connection
+ * closes. The live metrics publish the state of running connections, so
+ * that it can be scraped while the connections are active.
+ *
+ * The network thread is the only writer. Each connection publishes its
+ * values in a slot of a fixed table, protected by a sequence number: the
+ * sequence is odd while the slot is being updated, and readers retry if
+ * the sequence changed while they were copying the values. When a
+ * connection is deleted, its values are added to the totals of closed
+ * connections and the slot is released, under a global sequence number,
+ * so that the aggregate counters never decrease. Histograms only have one
+ * writer, and each bucket is read independently.
+ *
+ * Connections that do not find a free slot are only counted when they
+ * close.
+ */
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "live_metrics.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#define PICOQUIC_METRICS_READ_TRIES 16
+
+typedef struct st_picoquic_metrics_slot_t {
+    uint64_t sequence;
+    uint64_t is_in_use;
+    uint64_t is_client;
+    uint64_t cnxid64;
+    uint64_t v[picoquic_metrics_cnx_max];
+} picoquic_metrics_slot_t;
+
+typedef struct st_picoquic_metrics_hist_t {
+    uint64_t base;
+    uint64_t bucket[PICOQUIC_METRICS_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+} picoquic_metrics_hist_t;
+
+struct st_picoquic_live_metrics_t {
+    uint64_t update_interval;
+    size_t nb_slots;
+    picoquic_metrics_slot_t* slots;
+    /* Totals of closed connections */
+    uint64_t sequence;
+    uint64_t nb_closed;
+    uint64_t closed_total[picoquic_metrics_cnx_max];
+    /* Histograms */
+    picoquic_metrics_hist_t rtt_hist;
+    picoquic_metrics_hist_t cwin_hist;
+    /* Export thread */
+    int is_export_started;
+    char* export_file_name;
+    uint64_t export_interval;
+    uint64_t is_export_shutdown;
+    picoquic_thread_t export_thread;
+    picoquic_event_t export_event;
+};
+
+static const struct {
+    const char* name;
+    int is_counter;
+} picoquic_metrics_cnx_desc[picoquic_metrics_cnx_max] = {
+    { "srtt_microseconds", 0 },
+    { "rtt_min_microseconds", 0 },
+    { "cwin_bytes", 0 },
+    { "pacing_rate_bytes_per_second", 0 },
+    { "bytes_in_transit", 0 },
+    { "packets_sent", 1 },
+    { "packets_received", 1 },
+    { "retransmissions", 1 },
+    { "spurious_retransmissions", 1 },
+    { "handover_suppressed_events", 1 },
+    { "data_sent_bytes", 1 },
+    { "data_received_bytes", 1 },
+    { "datagrams_expired", 1 },
+    { "datagrams_dropped", 1 },
+    { "datagrams_late", 1 }
+};
+
+static void picoquic_metrics_hist_add(picoquic_metrics_hist_t* hist, uint64_t value)
+{
+    int i = 0;
+    uint64_t bound = hist->base;
+
+    while (i < PICOQUIC_METRICS_HIST_BUCKETS - 1 && value > bound) {
+        bound <<= 1;
+        i++;
+    }
+    picoquic_atomic_store_64(&hist->bucket[i], hist->bucket[i] + 1);
+    picoquic_atomic_store_64(&hist->sum, hist->sum + value);
+    picoquic_atomic_store_64(&hist->count, hist->count + 1);
+}
+
+static void picoquic_metrics_collect(picoquic_cnx_t* cnx, uint64_t* v)
+{
+    picoquic_path_t* path_x = cnx->path[0];
+
+    v[picoquic_metrics_cnx_srtt] = path_x->smoothed_rtt;
+    v[picoquic_metrics_cnx_rtt_min] = path_x->rtt_min;
+    v[picoquic_metrics_cnx_cwin] = path_x->cwin;
+    v[picoquic_metrics_cnx_pacing_rate] = path_x->pacing.rate;
+    v[picoquic_metrics_cnx_bytes_in_transit] = path_x->bytes_in_transit;
+    v[picoquic_metrics_cnx_packets_sent] = cnx->nb_packets_sent;
+    v[picoquic_metrics_cnx_packets_received] = cnx->nb_packets_received;
+    v[picoquic_metrics_cnx_retransmissions] = cnx->nb_retransmission_total;
+    v[picoquic_metrics_cnx_spurious] = cnx->nb_spurious;
+    v[picoquic_metrics_cnx_handover_suppressed] = cnx->nb_handover_suppressed;
+    v[picoquic_metrics_cnx_data_sent] = cnx->data_sent;
+    v[picoquic_metrics_cnx_data_received] = cnx->data_received;
+    v[picoquic_metrics_cnx_datagrams_expired] = cnx->nb_datagrams_expired;
+    v[picoquic_metrics_cnx_datagrams_dropped] = cnx->nb_datagrams_dropped;
+    v[picoquic_metrics_cnx_datagrams_late] = cnx->nb_datagrams_late;
+}
+
+/* Called by the network thread after preparing packets for a connection */
+void picoquic_metrics_update(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    picoquic_live_metrics_t* metrics = cnx->quic->live_metrics;
+
+    if (current_time >= cnx->metrics_next_update && cnx->path != NULL && cnx->path[0] != NULL) {
+        uint64_t v[picoquic_metrics_cnx_max];
+
+        cnx->metrics_next_update = current_time + metrics->update_interval;
+        picoquic_metrics_collect(cnx, v);
+        picoquic_metrics_hist_add(&metrics->cwin_hist, v[picoquic_metrics_cnx_cwin]);
+
+        if (cnx->metrics_slot == 0) {
+            for (size_t i = 0; i < metrics->nb_slots; i++) {
+                if (!metrics->slots[i].is_in_use) {
+                    cnx->metrics_slot = i + 1;
+                    break;
+                }
+            }
+        }
+        if (cnx->metrics_slot != 0) {
+            picoquic_metrics_slot_t* slot = &metrics->slots[cnx->metrics_slot - 1];
+
+            picoquic_atomic_store_64(&slot->sequence, slot->sequence + 1);
+            picoquic_atomic_store_64(&slot->is_in_use, 1);
+            picoquic_atomic_store_64(&slot->is_client, cnx->client_mode);
+            picoquic_atomic_store_64(&slot->cnxid64, picoquic_val64_connection_id(picoquic_get_logging_cnxid(cnx)));
+            for (int i = 0; i < picoquic_metrics_cnx_max; i++) {
+                picoquic_atomic_store_64(&slot->v[i], v[i]);
+            }
+            picoquic_atomic_store_64(&slot->sequence, slot->sequence + 1);
+        }
+    }
+}
+
+/* Called by the network thread when a connection is deleted */
+void picoquic_metrics_release(picoquic_cnx_t* cnx)
+{
+    picoquic_live_metrics_t* metrics = cnx->quic->live_metrics;
+
+    if (cnx->path != NULL && cnx->path[0] != NULL) {
+        uint64_t v[picoquic_metrics_cnx_max];
+
+        picoquic_metrics_collect(cnx, v);
+        picoquic_atomic_store_64(&metrics->sequence, metrics->sequence + 1);
+        for (int i = 0; i < picoquic_metrics_cnx_max; i++) {
+            if (picoquic_metrics_cnx_desc[i].is_counter) {
+                picoquic_atomic_store_64(&metrics->closed_total[i], metrics->closed_total[i] + v[i]);
+            }
+        }
+        picoquic_atomic_store_64(&metrics->nb_closed, metrics->nb_closed + 1);
+        if (cnx->metrics_slot != 0) {
+            picoquic_metrics_slot_t* slot = &metrics->slots[cnx->metrics_slot - 1];
+            picoquic_atomic_store_64(&slot->sequence, slot->sequence + 1);
+            picoquic_atomic_store_64(&slot->is_in_use, 0);
+            picoquic_atomic_store_64(&slot->sequence, slot->sequence + 1);
+            cnx->metrics_slot = 0;
+        }
+        picoquic_atomic_store_64(&metrics->sequence, metrics->sequence + 1);
+    }
+}
+
+void picoquic_metrics_rtt_sample(picoquic_live_metrics_t* metrics, uint64_t rtt)
+{
+    picoquic_metrics_hist_add(&metrics->rtt_hist, rtt);
+}
+
+/* Copy a slot. Returns 0 if the copy is consistent and the slot in use. */
+static int picoquic_metrics_read_slot(picoquic_metrics_slot_t* slot, picoquic_metrics_slot_t* copy)
+{
+    int ret = -1;
+
+    for (int tries = 0; ret != 0 && tries < PICOQUIC_METRICS_READ_TRIES; tries++) {
+        uint64_t sequence = picoquic_atomic_load_64(&slot->sequence);
+        if ((sequence & 1) == 0) {
+            copy->is_in_use = picoquic_atomic_load_64(&slot->is_in_use);
+            copy->is_client = picoquic_atomic_load_64(&slot->is_client);
+            copy->cnxid64 = picoquic_atomic_load_64(&slot->cnxid64);
+            for (int i = 0; i < picoquic_metrics_cnx_max; i++) {
+                copy->v[i] = picoquic_atomic_load_64(&slot->v[i]);
+            }
+            if (picoquic_atomic_load_64(&slot->sequence) == sequence) {
+                ret = copy->is_in_use ? 0 : 1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Compute the aggregate counters, consistent with the closing of connections */
+static uint64_t picoquic_metrics_read_totals(picoquic_live_metrics_t* metrics, uint64_t* total)
+{
+    uint64_t nb_live = 0;
+
+    for (int tries = 0; tries < PICOQUIC_METRICS_READ_TRIES; tries++) {
+        uint64_t sequence = picoquic_atomic_load_64(&metrics->sequence);
+        if ((sequence & 1) == 0) {
+            nb_live = 0;
+            for (int i = 0; i < picoquic_metrics_cnx_max; i++) {
+                total[i] = picoquic_atomic_load_64(&metrics->closed_total[i]);
+            }
+            for (size_t s = 0; s < metrics->nb_slots; s++) {
+                picoquic_metrics_slot_t copy;
+                if (picoquic_metrics_read_slot(&metrics->slots[s], &copy) == 0) {
+                    nb_live++;
+                    for (int i = 0; i < picoquic_metrics_cnx_max; i++) {
+                        total[i] += copy.v[i];
+                    }
+                }
+            }
+            if (picoquic_atomic_load_64(&metrics->sequence) == sequence) {
+                break;
+            }
+        }
+    }
+
+    return nb_live;
+}
+
+static int picoquic_metrics_print(char* text, size_t text_max, size_t* text_length, const char* fmt, ...)
+{
+    int ret = 0;
+    va_list args;
+    int written;
+
+    va_start(args, fmt);
+#ifdef _WINDOWS
+    written = vsnprintf_s(text + *text_length, text_max - *text_length, _TRUNCATE, fmt, args);
+#else
+    written = vsnprintf(text + *text_length, text_max - *text_length, fmt, args);
+#endif
+    va_end(args);
+
+    if (written < 0 || (size_t)written >= text_max - *text_length) {
+        ret = -1;
+    }
+    else {
+        *text_length += written;
+    }
+
+    return ret;
+}
+
+static int picoquic_metrics_print_hist(char* text, size_t text_max, size_t* text_length,
+    const char* name, picoquic_metrics_hist_t* hist)
+{
+    int ret = picoquic_metrics_print(text, text_max, text_length, "# TYPE picoquic_%s histogram\n", name);
+    uint64_t cumulated = 0;
+    uint64_t bound = hist->base;
+
+    for (int i = 0; ret == 0 && i < PICOQUIC_METRICS_HIST_BUCKETS - 1; i++) {
+        cumulated += picoquic_atomic_load_64(&hist->bucket[i]);
+        ret = picoquic_metrics_print(text, text_max, text_length, "picoquic_%s_bucket{le=\"%" PRIu64 "\"} %" PRIu64 "\n",
+            name, bound, cumulated);
+        bound <<= 1;
+    }
+    if (ret == 0) {
+        cumulated += picoquic_atomic_load_64(&hist->bucket[PICOQUIC_METRICS_HIST_BUCKETS - 1]);
+        ret = picoquic_metrics_print(text, text_max, text_length,
+            "picoquic_%s_bucket{le=\"+Inf\"} %" PRIu64 "\npicoquic_%s_count %" PRIu64 "\npicoquic_%s_sum %" PRIu64 "\n",
+            name, cumulated, name, cumulated, name, picoquic_atomic_load_64(&hist->sum));
+    }
+
+    return ret;
+}
+
+int picoquic_metrics_format(picoquic_quic_t* quic, char* text, size_t text_max, size_t* text_length)
+{
+    int ret = 0;
+    picoquic_live_metrics_t* metrics = quic->live_metrics;
+    uint64_t total[picoquic_metrics_cnx_max];
+    uint64_t nb_live;
+
+    *text_length = 0;
+    if (metrics == NULL) {
+        return -1;
+    }
+
+    nb_live = picoquic_metrics_read_totals(metrics, total);
+    ret = picoquic_metrics_print(text, text_max, text_length,
+        "# TYPE picoquic_connections gauge\npicoquic_connections %" PRIu64 "\n"
+        "# TYPE picoquic_connections_closed counter\npicoquic_connections_closed_total %" PRIu64 "\n",
+        nb_live, picoquic_atomic_load_64(&metrics->nb_closed));
+
+    for (int i = 0; ret == 0 && i < picoquic_metrics_cnx_max; i++) {
+        if (picoquic_metrics_cnx_desc[i].is_counter) {
+            ret = picoquic_metrics_print(text, text_max, text_length,
+                "# TYPE picoquic_%s counter\npicoquic_%s_total %" PRIu64 "\n",
+                picoquic_metrics_cnx_desc[i].name, picoquic_metrics_cnx_desc[i].name, total[i]);
+        }
+    }
+
+    if (ret == 0) {
+        ret = picoquic_metrics_print_hist(text, text_max, text_length, "rtt_microseconds", &metrics->rtt_hist);
+    }
+    if (ret == 0) {
+        ret = picoquic_metrics_print_hist(text, text_max, text_length, "cwin_bytes", &metrics->cwin_hist);
+    }
+
+    /* Per connection values, one metric family at a time */
+    for (int i = 0; ret == 0 && i < picoquic_metrics_cnx_max; i++) {
+        ret = picoquic_metrics_print(text, text_max, text_length, "# TYPE picoquic_cnx_%s %s\n",
+            picoquic_metrics_cnx_desc[i].name, (picoquic_metrics_cnx_desc[i].is_counter) ? "counter" : "gauge");
+        for (size_t s = 0; ret == 0 && s < metrics->nb_slots; s++) {
+            picoquic_metrics_slot_t copy;
+            if (picoquic_metrics_read_slot(&metrics->slots[s], &copy) == 0) {
+                ret = picoquic_metrics_print(text, text_max, text_length,
+                    "picoquic_cnx_%s%s{cid=\"%016" PRIx64 "\",role=\"%s\"} %" PRIu64 "\n",
+                    picoquic_metrics_cnx_desc[i].name, (picoquic_metrics_cnx_desc[i].is_counter) ? "_total" : "",
+                    copy.cnxid64, (copy.is_client) ? "client" : "server", copy.v[i]);
+            }
+        }
+    }
+
+    if (ret == 0) {
+        ret = picoquic_metrics_print(text, text_max, text_length, "# EOF\n");
+    }
+
+    return ret;
+}
+
+static size_t picoquic_metrics_text_size(picoquic_live_metrics_t* metrics)
+{
+    return 8192 + metrics->nb_slots * picoquic_metrics_cnx_max * 128;
+}
+
+static int picoquic_metrics_export_file(picoquic_quic_t* quic, char* text, size_t text_max)
+{
+    int ret;
+    size_t text_length = 0;
+    picoquic_live_metrics_t* metrics = quic->live_metrics;
+    char tmp_name[512];
+
+    ret = picoquic_sprintf(tmp_name, sizeof(tmp_name), NULL, "%s.tmp", metrics->export_file_name);
+    if (ret == 0) {
+        ret = picoquic_metrics_format(quic, text, text_max, &text_length);
+    }
+    if (ret == 0) {
+        FILE* F = picoquic_file_open(tmp_name, "w");
+        if (F == NULL) {
+            ret = -1;
+        }
+        else {
+            if (fwrite(text, 1, text_length, F) != text_length) {
+                ret = -1;
+            }
+            (void)picoquic_file_close(F);
+        }
+    }
+    if (ret == 0) {
+#ifdef _WINDOWS
+        (void)remove(metrics->export_file_name);
+#endif
+        ret = rename(tmp_name, metrics->export_file_name);
+    }
+
+    return ret;
+}
+
+static picoquic_thread_return_t picoquic_metrics_exporter(void* arg)
+{
+    picoquic_quic_t* quic = (picoquic_quic_t*)arg;
+    picoquic_live_metrics_t* metrics = quic->live_metrics;
+    size_t text_max = picoquic_metrics_text_size(metrics);
+    char* text = (char*)malloc(text_max);
+
+    if (text == NULL) {
+        DBG_PRINTF("%s", "Cannot allocate the metrics export buffer");
+    }
+    else {
+        /* The file is written one last time after the shutdown is requested,
+         * so that it reflects the totals of all the closed connections. */
+        while (1) {
+            int is_shutdown = picoquic_atomic_load_64(&metrics->is_export_shutdown) != 0;
+            if (picoquic_metrics_export_file(quic, text, text_max) != 0) {
+                DBG_PRINTF("Cannot export metrics to %s", metrics->export_file_name);
+            }
+            if (is_shutdown) {
+                break;
+            }
+            (void)picoquic_wait_for_event(&metrics->export_event, metrics->export_interval);
+        }
+        free(text);
+    }
+
+    picoquic_thread_do_return;
+}
+
+int picoquic_metrics_export_start(picoquic_quic_t* quic, char const* file_name, uint64_t export_interval)
+{
+    int ret = 0;
+    picoquic_live_metrics_t* metrics = quic->live_metrics;
+
+    if (metrics == NULL || metrics->is_export_started || file_name == NULL) {
+        ret = -1;
+    }
+    else if ((metrics->export_file_name = picoquic_string_duplicate(file_name)) == NULL) {
+        ret = PICOQUIC_ERROR_MEMORY;
+    }
+    else if (picoquic_create_event(&metrics->export_event) != 0) {
+        metrics->export_file_name = picoquic_string_free(metrics->export_file_name);
+        ret = PICOQUIC_ERROR_MEMORY;
+    }
+    else {
+        metrics->export_interval = export_interval;
+        if (picoquic_create_thread(&metrics->export_thread, picoquic_metrics_exporter, quic) != 0) {
+            picoquic_delete_event(&metrics->export_event);
+            metrics->export_file_name = picoquic_string_free(metrics->export_file_name);
+            ret = PICOQUIC_ERROR_MEMORY;
+        }
+        else {
+            metrics->is_export_started = 1;
+        }
+    }
+
+    return ret;
+}
+
+void picoquic_metrics_delete(picoquic_live_metrics_t* metrics)
+{
+    if (metrics != NULL) {
+        if (metrics->is_export_started) {
+            picoquic_atomic_store_64(&metrics->is_export_shutdown, 1);
+            (void)picoquic_signal_event(&metrics->export_event);
+            (void)picoquic_wait_thread(metrics->export_thread);
+#ifdef _WINDOWS
+            CloseHandle(metrics->export_thread);
+#endif
+            picoquic_delete_event(&metrics->export_event);
+        }
+        metrics->export_file_name = picoquic_string_free(metrics->export_file_name);
+        if (metrics->slots != NULL) {
+            free(metrics->slots);
+        }
+        free(metrics);
+    }
+}
+
+int picoquic_metrics_setup(picoquic_quic_t* quic, size_t max_connections, uint64_t update_interval)
+{
+    int ret = 0;
+    picoquic_live_metrics_t* metrics;
+
+    if (quic->live_metrics != NULL) {
+        return -1;
+    }
+
+    metrics = (picoquic_live_metrics_t*)malloc(sizeof(picoquic_live_metrics_t));
+    if (metrics == NULL) {
+        ret = PICOQUIC_ERROR_MEMORY;
+    }
+    else {
+        memset(metrics, 0, sizeof(picoquic_live_metrics_t));
+        metrics->update_interval = update_interval;
+        metrics->rtt_hist.base = 1000;
+        metrics->cwin_hist.base = PICOQUIC_MAX_PACKET_SIZE;
+        if (max_connections > 0) {
+            metrics->slots = (picoquic_metrics_slot_t*)malloc(max_connections * sizeof(picoquic_metrics_slot_t));
+            if (metrics->slots == NULL) {
+                ret = PICOQUIC_ERROR_MEMORY;
+            }
+            else {
+                memset(metrics->slots, 0, max_connections * sizeof(picoquic_metrics_slot_t));
+                metrics->nb_slots = max_connections;
+            }
+        }
+        if (ret == 0) {
+            quic->live_metrics = metrics;
+        }
+        else {
+            picoquic_metrics_delete(metrics);
+        }
+    }
+
+    return ret;
+}
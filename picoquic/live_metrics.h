@@ -0,0 +1,74 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef PICOQUIC_LIVE_METRICS_H
+#define PICOQUIC_LIVE_METRICS_H
+
+#include "picoquic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_METRICS_UPDATE_INTERVAL_DEFAULT 100000 /* microseconds */
+#define PICOQUIC_METRICS_HIST_BUCKETS 20
+
+/* Per connection values published in the live metrics */
+typedef enum {
+    picoquic_metrics_cnx_srtt = 0,
+    picoquic_metrics_cnx_rtt_min,
+    picoquic_metrics_cnx_cwin,
+    picoquic_metrics_cnx_pacing_rate,
+    picoquic_metrics_cnx_bytes_in_transit,
+    picoquic_metrics_cnx_packets_sent,
+    picoquic_metrics_cnx_packets_received,
+    picoquic_metrics_cnx_retransmissions,
+    picoquic_metrics_cnx_spurious,
+    picoquic_metrics_cnx_handover_suppressed,
+    picoquic_metrics_cnx_data_sent,
+    picoquic_metrics_cnx_data_received,
+    picoquic_metrics_cnx_datagrams_expired,
+    picoquic_metrics_cnx_datagrams_dropped,
+    picoquic_metrics_cnx_datagrams_late,
+    picoquic_metrics_cnx_max
+} picoquic_metrics_cnx_enum;
+
+/* Start collecting live metrics for the QUIC context. The network thread
+ * publishes the values of up to max_connections connections, at most once
+ * per update_interval for each connection, plus aggregate counters and
+ * histograms of RTT samples and congestion windows. The metrics can be read
+ * from any thread without locking the network thread.
+ */
+int picoquic_metrics_setup(picoquic_quic_t* quic, size_t max_connections, uint64_t update_interval);
+
+/* Format the current metrics in OpenMetrics text format. Returns -1 if the
+ * buffer is too small. Can be called from any thread. */
+int picoquic_metrics_format(picoquic_quic_t* quic, char* text, size_t text_max, size_t* text_length);
+
+/* Start a thread that rewrites the metrics file every export_interval
+ * microseconds, e.g., for the node exporter textfile collector. The file
+ * is written under a temporary name and then renamed, so readers never
+ * see a partial file. */
+int picoquic_metrics_export_start(picoquic_quic_t* quic, char const* file_name, uint64_t export_interval);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PICOQUIC_LIVE_METRICS_H */
@@ -325,6 +325,9 @@ char const* textlog_frame_names(uint64_t frame_type)
     case picoquic_frame_type_bdp:
         frame_name = "bdp_frame";
         break;
+    case picoquic_frame_type_fec_repair:
+        frame_name = "fec_repair";
+        break;
     default:
         if (PICOQUIC_IN_RANGE(frame_type, picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
             frame_name = "stream";
@@ -421,6 +424,9 @@ char const* textlog_tp_name(picoquic_tp_enum tp_number)
     case picoquic_tp_enable_bdp_frame:
         tp_name = "enable_bdp_frame";
         break;
+    case picoquic_tp_enable_fec:
+        tp_name = "enable_fec";
+        break;
     case picoquic_tp_initial_max_paths:
         tp_name = "initial_max_paths";
         break;
@@ -1471,6 +1477,45 @@ size_t textlog_bdp_frame(FILE* F, const uint8_t* bytes, size_t bytes_max)
     return byte_index;
 }
 
+size_t textlog_fec_repair_frame(FILE* F, const uint8_t* bytes, size_t bytes_max)
+{
+    const uint8_t* bytes_end = bytes + bytes_max;
+    const uint8_t* bytes0 = bytes;
+    uint64_t key = 0;
+    uint64_t first_pn = 0;
+    uint64_t nb_pn = 0;
+    uint64_t repair_length = 0;
+    size_t byte_index = 0;
+
+    if ((bytes = picoquic_frames_varint_skip(bytes, bytes_end)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_end, &key)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_end, &first_pn)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_end, &nb_pn)) == NULL ||
+        (bytes = picoquic_frames_fixed_skip(bytes, bytes_end, (nb_pn + 7) / 8)) == NULL ||
+        (bytes = picoquic_frames_varint_decode(bytes, bytes_end, &repair_length)) == NULL ||
+        (bytes = picoquic_frames_fixed_skip(bytes, bytes_end, repair_length)) == NULL) {
+        fprintf(F, "    Malformed %s frame: ",
+            textlog_frame_names(picoquic_frame_type_fec_repair));
+        /* log format error */
+        for (size_t i = 0; i < bytes_max && i < 8; i++) {
+            fprintf(F, "%02x", bytes0[i]);
+        }
+        if (bytes_max > 8) {
+            fprintf(F, "...");
+        }
+        fprintf(F, "\n");
+        byte_index = bytes_max;
+    }
+    else {
+        fprintf(F, "    %s, key: %" PRIu64 ", first_pn: %" PRIu64 ", nb_pn: %" PRIu64 ", length: %" PRIu64 "\n",
+            textlog_frame_names(picoquic_frame_type_fec_repair),
+            key, first_pn, nb_pn, repair_length);
+        byte_index = (bytes - bytes0);
+    }
+
+    return byte_index;
+}
+
 void picoquic_textlog_frames(FILE* F, uint64_t cnx_id64, const uint8_t* bytes, size_t length)
 {
     size_t byte_index = 0;
@@ -1621,6 +1666,9 @@ void picoquic_textlog_frames(FILE* F, uint64_t cnx_id64, const uint8_t* bytes, s
         case picoquic_frame_type_bdp:
             byte_index += textlog_bdp_frame(F, bytes + byte_index, length - byte_index);
             break;
+        case picoquic_frame_type_fec_repair:
+            byte_index += textlog_fec_repair_frame(F, bytes + byte_index, length - byte_index);
+            break;
         default: {
             /* Not implemented yet! */
             fprintf(F, "    Unknown frame, type: %" PRIu64 " (0x", frame_id);
@@ -476,6 +476,7 @@ static size_t picoquic_retransmit_needed_packet(picoquic_cnx_t* cnx, picoquic_pa
             }
             else {
                 /* we did perform a repetition */
+                picoquic_log_trigger_event(cnx, PICOQUIC_LOG_TRIGGER_PTO, current_time);
                 /* First, keep track of retransmissions per path, in order to
                 * manage scheduling in multipath setup */
 
@@ -957,7 +958,7 @@ static void picoquic_count_and_notify_loss(
             picoquic_per_ack_state_t ack_state = { 0 };
             ack_state.lost_packet_number = old_p->path_packet_number;
             ack_state.nb_bytes_newly_lost = old_p->length;
-            cnx->congestion_alg->alg_notify(cnx, old_p->send_path,
+            picoquic_congestion_notify(cnx, old_p->send_path,
                 (timer_based_retransmit == 0) ? picoquic_congestion_notification_repeat : picoquic_congestion_notification_timeout,
                 &ack_state, current_time);
         }
@@ -38,8 +38,12 @@ void picoquic_pacing_init(picoquic_pacing_t* pacing, uint64_t current_time)
 */
 static void picoquic_update_pacing_bucket(picoquic_pacing_t* pacing, uint64_t current_time)
 {
-    if (pacing->bucket_nanosec < -pacing->packet_time_nanosec) {
-        pacing->bucket_nanosec = -pacing->packet_time_nanosec;
+    /* In txtime mode, the bucket may be borrowed up to the horizon. The
+     * debt is the schedule of packets already handed to the kernel. */
+    int64_t bucket_min = -pacing->packet_time_nanosec - pacing->txtime_horizon_nanosec;
+
+    if (pacing->bucket_nanosec < bucket_min) {
+        pacing->bucket_nanosec = bucket_min;
     }
 
     if (current_time > pacing->evaluation_time) {
@@ -65,6 +69,9 @@ int picoquic_is_pacing_blocked(picoquic_pacing_t* pacing)
 * 
 * In packet train mode, the wait will last until the bucket is completely full, or
 * if at least N packets are received.
+*
+* In txtime mode, packets are authorized if they can depart before the
+* end of the horizon. The kernel holds them until their departure time.
 */
 int picoquic_is_authorized_by_pacing(picoquic_pacing_t * pacing, uint64_t current_time, uint64_t * next_time,
     unsigned int packet_train_mode, picoquic_quic_t * quic)
@@ -73,11 +80,14 @@ int picoquic_is_authorized_by_pacing(picoquic_pacing_t * pacing, uint64_t curren
 
     picoquic_update_pacing_bucket(pacing, current_time);
 
-    if (pacing->bucket_nanosec < pacing->packet_time_nanosec) {
+    if (pacing->bucket_nanosec + pacing->txtime_horizon_nanosec < pacing->packet_time_nanosec) {
         uint64_t next_pacing_time;
         int64_t bucket_required;
 
-        if (packet_train_mode || pacing->bandwidth_pause) {
+        if (pacing->txtime_horizon_nanosec > 0) {
+            bucket_required = pacing->packet_time_nanosec - pacing->txtime_horizon_nanosec - pacing->bucket_nanosec;
+        }
+        else if (packet_train_mode || pacing->bandwidth_pause) {
             bucket_required = pacing->bucket_max;
 
             if (bucket_required > 10 * pacing->packet_time_nanosec) {
@@ -240,6 +250,13 @@ void picoquic_update_pacing_data_after_send(picoquic_pacing_t * pacing, size_t l
     uint64_t packet_time_nanosec;
 
     picoquic_update_pacing_bucket(pacing, current_time);
+    /* The packet departs when the bucket would have been refilled */
+    if (pacing->bucket_nanosec >= pacing->packet_time_nanosec) {
+        pacing->departure_time = current_time;
+    }
+    else {
+        pacing->departure_time = current_time + (pacing->packet_time_nanosec - pacing->bucket_nanosec + 999) / 1000;
+    }
     packet_time_nanosec = ((pacing->packet_time_nanosec * (uint64_t)length) + (send_mtu - 1)) / send_mtu;
     pacing->bucket_nanosec -= packet_time_nanosec;
 }
@@ -252,6 +269,7 @@ void picoquic_update_pacing_after_send(picoquic_path_t* path_x, size_t length, u
 
 int picoquic_is_sending_authorized_by_pacing(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint64_t current_time, uint64_t* next_time)
 {
+    path_x->pacing.txtime_horizon_nanosec = (int64_t)(cnx->quic->txtime_horizon * 1000);
     return picoquic_is_authorized_by_pacing(&path_x->pacing, current_time, next_time, cnx->quic->packet_train_mode,
         cnx->quic);
 }
@@ -259,12 +277,18 @@ int picoquic_is_sending_authorized_by_pacing(picoquic_cnx_t* cnx, picoquic_path_
 /* Reset pacing data if congestion algorithm computes it directly */
 void picoquic_update_pacing_rate(picoquic_cnx_t* cnx, picoquic_path_t* path_x, double pacing_rate, uint64_t quantum)
 {
+    if (cnx->pacing_gain > 0) {
+        pacing_rate *= cnx->pacing_gain;
+    }
     picoquic_update_pacing_parameters(&path_x->pacing, pacing_rate,
         quantum, path_x->send_mtu, path_x->smoothed_rtt, path_x);
 }
 /* Reset pacing if expressed as CWIN and RTT */
 void picoquic_update_pacing_data(picoquic_cnx_t* cnx, picoquic_path_t* path_x, int slow_start)
 {
-    picoquic_update_pacing_window(&path_x->pacing, slow_start, path_x->cwin, path_x->send_mtu, path_x->smoothed_rtt,
+    /* A pacing gain is applied by scaling the window, which also scales the quantum */
+    uint64_t cwin = (cnx->pacing_gain > 0) ? (uint64_t)((double)path_x->cwin * cnx->pacing_gain) : path_x->cwin;
+
+    picoquic_update_pacing_window(&path_x->pacing, slow_start, cwin, path_x->send_mtu, path_x->smoothed_rtt,
         path_x);
 }
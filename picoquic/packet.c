@@ -2348,15 +2348,31 @@ int picoquic_incoming_1rtt(
         }
         else if (ret == 0) {
             picoquic_path_t* path_x = cnx->path[path_id];
+            int is_fec_recovered = 0;
 
             path_x->if_index_dest = if_index_to;
             cnx->is_1rtt_received = 1;
             picoquic_spin_function_table[cnx->spin_policy].spinbit_incoming(cnx, path_x, ph);
+            if (cnx->is_fec_enabled && !path_is_not_allocated) {
+                if (picoquic_fec_is_recovered(cnx, ph->l_cid, ph->pn64)) {
+                    /* Late copy of a packet rebuilt from repair symbols. The frames
+                     * were already processed, the packet only needs to be acked. */
+                    is_fec_recovered = 1;
+                    picoquic_set_ack_needed(cnx, current_time, picoquic_packet_context_application, path_x, 0);
+                }
+                else {
+                    /* Keep a copy of the packet, in case it is needed to rebuild a lost one */
+                    ret = picoquic_fec_record_received(cnx, path_x, ph->l_cid, ph->pn64,
+                        bytes + ph->offset, ph->payload_length, addr_from, addr_to, current_time);
+                }
+            }
             /* Accept the incoming frames */
-            ret = picoquic_decode_frames(cnx, cnx->path[path_id],
-                bytes + ph->offset, ph->payload_length, received_data,
-                ph->epoch, addr_from, addr_to, ph->pn64,
-                path_is_not_allocated, current_time);
+            if (ret == 0 && !is_fec_recovered) {
+                ret = picoquic_decode_frames(cnx, cnx->path[path_id],
+                    bytes + ph->offset, ph->payload_length, received_data,
+                    ph->epoch, addr_from, addr_to, ph->pn64,
+                    path_is_not_allocated, current_time);
+            }
 
             if (ret == 0) {
                 /* Compute receive bandwidth */
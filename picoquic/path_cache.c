@@ -0,0 +1,348 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* Cross connection cache of path state.
+ *
+ * The cache is a fixed size, open addressed hash table keyed by the
+ * prefix of the peer address. An entry is searched in a window of
+ * PATH_CACHE_PROBE_MAX slots starting at the hash of the key. If the key
+ * is not found when updating, the entry is created in the first empty
+ * slot of the window, or else replaces the least recently updated entry,
+ * so the memory used by the cache never grows.
+ *
+ * Updates are serialized by a mutex. Each slot carries a sequence number
+ * that is odd while the slot is being written, and readers copy the slot
+ * and retry if the sequence changed during the copy. Lookups thus never
+ * block, and never see a partially updated entry.
+ *
+ * New observations are blended with the cached values, with a weight
+ * that depends on the age of the entry: the cached values weigh 1/2 after
+ * one half life, and at most 7/8 if the entry was just updated.
+ */
+
+#include "picoquic_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_CACHE_PROBE_MAX 8
+#define PATH_CACHE_READ_TRIES 16
+#define PATH_CACHE_WEIGHT_ONE 1024
+#define PATH_CACHE_WEIGHT_MAX 896
+#define PATH_CACHE_MIN_PACKETS 16
+
+typedef struct st_path_cache_slot_t {
+    uint64_t sequence;
+    uint64_t key[3];
+    uint64_t rtt_min;
+    uint64_t bandwidth;
+    uint64_t loss_ppm;
+    uint64_t nb_updates;
+    uint64_t last_update;
+} path_cache_slot_t;
+
+struct st_picoquic_path_cache_t {
+    path_cache_slot_t* slots;
+    size_t nb_slots;
+    int prefix_bits_v4;
+    int prefix_bits_v6;
+    uint64_t half_life;
+    uint64_t max_age;
+    picoquic_mutex_t update_lock;
+};
+
+/* The key is made of the address family followed by the masked prefix.
+ * The first word is never zero, which marks empty slots. */
+static int path_cache_get_key(picoquic_path_cache_t* cache, const struct sockaddr* addr, uint64_t key[3])
+{
+    uint8_t prefix[16];
+    const uint8_t* ip_addr = NULL;
+    int prefix_bits = 0;
+    int ret = 0;
+
+    if (addr->sa_family == AF_INET) {
+        ip_addr = (const uint8_t*)&((const struct sockaddr_in*)addr)->sin_addr;
+        prefix_bits = cache->prefix_bits_v4;
+    }
+    else if (addr->sa_family == AF_INET6) {
+        ip_addr = (const uint8_t*)&((const struct sockaddr_in6*)addr)->sin6_addr;
+        prefix_bits = cache->prefix_bits_v6;
+    }
+    else {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        memset(prefix, 0, sizeof(prefix));
+        memcpy(prefix, ip_addr, prefix_bits / 8);
+        if ((prefix_bits & 7) != 0) {
+            prefix[prefix_bits / 8] = ip_addr[prefix_bits / 8] & (uint8_t)(0xFF << (8 - (prefix_bits & 7)));
+        }
+        key[0] = (((uint64_t)prefix_bits) << 32) | (uint64_t)addr->sa_family;
+        key[1] = PICOPARSE_64(prefix);
+        key[2] = PICOPARSE_64(prefix + 8);
+    }
+
+    return ret;
+}
+
+static size_t path_cache_hash(picoquic_path_cache_t* cache, const uint64_t key[3])
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for (int i = 0; i < 3; i++) {
+        h ^= key[i];
+        h *= 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+
+    return (size_t)(h & (cache->nb_slots - 1));
+}
+
+/* Copy a slot without locking. Returns -1 if the slot kept changing. */
+static int path_cache_read_slot(path_cache_slot_t* slot, path_cache_slot_t* copy)
+{
+    for (int tries = 0; tries < PATH_CACHE_READ_TRIES; tries++) {
+        uint64_t sequence = picoquic_atomic_load_64(&slot->sequence);
+
+        if ((sequence & 1) == 0) {
+            for (int i = 0; i < 3; i++) {
+                copy->key[i] = picoquic_atomic_load_64(&slot->key[i]);
+            }
+            copy->rtt_min = picoquic_atomic_load_64(&slot->rtt_min);
+            copy->bandwidth = picoquic_atomic_load_64(&slot->bandwidth);
+            copy->loss_ppm = picoquic_atomic_load_64(&slot->loss_ppm);
+            copy->nb_updates = picoquic_atomic_load_64(&slot->nb_updates);
+            copy->last_update = picoquic_atomic_load_64(&slot->last_update);
+            if (picoquic_atomic_load_64(&slot->sequence) == sequence) {
+                copy->sequence = sequence;
+                return 0;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void path_cache_write_slot(path_cache_slot_t* slot, const path_cache_slot_t* value)
+{
+    uint64_t sequence = slot->sequence;
+
+    picoquic_atomic_store_64(&slot->sequence, sequence + 1);
+    for (int i = 0; i < 3; i++) {
+        picoquic_atomic_store_64(&slot->key[i], value->key[i]);
+    }
+    picoquic_atomic_store_64(&slot->rtt_min, value->rtt_min);
+    picoquic_atomic_store_64(&slot->bandwidth, value->bandwidth);
+    picoquic_atomic_store_64(&slot->loss_ppm, value->loss_ppm);
+    picoquic_atomic_store_64(&slot->nb_updates, value->nb_updates);
+    picoquic_atomic_store_64(&slot->last_update, value->last_update);
+    picoquic_atomic_store_64(&slot->sequence, sequence + 2);
+}
+
+static uint64_t path_cache_blend(uint64_t old_value, uint64_t new_value, uint64_t weight)
+{
+    return (old_value * weight + new_value * (PATH_CACHE_WEIGHT_ONE - weight)) / PATH_CACHE_WEIGHT_ONE;
+}
+
+picoquic_path_cache_t* picoquic_path_cache_create(size_t nb_entries, int prefix_bits_v4, int prefix_bits_v6,
+    uint64_t half_life, uint64_t max_age)
+{
+    picoquic_path_cache_t* cache = NULL;
+    size_t nb_slots = PATH_CACHE_PROBE_MAX;
+
+    if (prefix_bits_v4 < 0 || prefix_bits_v4 > 32 || prefix_bits_v6 < 0 || prefix_bits_v6 > 128) {
+        return NULL;
+    }
+    while (nb_slots < nb_entries) {
+        nb_slots <<= 1;
+    }
+
+    cache = (picoquic_path_cache_t*)malloc(sizeof(picoquic_path_cache_t));
+    if (cache != NULL) {
+        memset(cache, 0, sizeof(picoquic_path_cache_t));
+        cache->nb_slots = nb_slots;
+        cache->prefix_bits_v4 = prefix_bits_v4;
+        cache->prefix_bits_v6 = prefix_bits_v6;
+        cache->half_life = half_life;
+        cache->max_age = max_age;
+        cache->slots = (path_cache_slot_t*)calloc(nb_slots, sizeof(path_cache_slot_t));
+        if (cache->slots == NULL) {
+            free(cache);
+            cache = NULL;
+        }
+        else if (picoquic_create_mutex(&cache->update_lock) != 0) {
+            free(cache->slots);
+            free(cache);
+            cache = NULL;
+        }
+    }
+
+    return cache;
+}
+
+void picoquic_path_cache_delete(picoquic_path_cache_t* cache)
+{
+    if (cache != NULL) {
+        (void)picoquic_delete_mutex(&cache->update_lock);
+        free(cache->slots);
+        free(cache);
+    }
+}
+
+void picoquic_set_path_cache(picoquic_quic_t* quic, picoquic_path_cache_t* cache)
+{
+    quic->path_cache = cache;
+}
+
+int picoquic_path_cache_lookup(picoquic_path_cache_t* cache, const struct sockaddr* addr, uint64_t current_time,
+    picoquic_path_cache_entry_t* entry)
+{
+    uint64_t key[3];
+    int ret = -1;
+
+    if (path_cache_get_key(cache, addr, key) == 0) {
+        size_t index = path_cache_hash(cache, key);
+
+        for (int i = 0; i < PATH_CACHE_PROBE_MAX; i++) {
+            path_cache_slot_t copy;
+
+            if (path_cache_read_slot(&cache->slots[(index + i) & (cache->nb_slots - 1)], &copy) != 0) {
+                continue;
+            }
+            if (copy.key[0] == 0) {
+                break;
+            }
+            if (copy.key[0] == key[0] && copy.key[1] == key[1] && copy.key[2] == key[2]) {
+                if (copy.last_update + cache->max_age >= current_time) {
+                    entry->rtt_min = copy.rtt_min;
+                    entry->bandwidth = copy.bandwidth;
+                    entry->loss_ppm = copy.loss_ppm;
+                    entry->nb_updates = copy.nb_updates;
+                    entry->last_update = copy.last_update;
+                    ret = 0;
+                }
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int picoquic_path_cache_update(picoquic_path_cache_t* cache, const struct sockaddr* addr,
+    uint64_t rtt_min, uint64_t bandwidth, uint64_t loss_ppm, uint64_t current_time)
+{
+    uint64_t key[3];
+    int ret = path_cache_get_key(cache, addr, key);
+
+    if (ret == 0) {
+        size_t index = path_cache_hash(cache, key);
+        path_cache_slot_t* target = NULL;
+        path_cache_slot_t value;
+
+        if (loss_ppm > 1000000) {
+            loss_ppm = 1000000;
+        }
+
+        (void)picoquic_lock_mutex(&cache->update_lock);
+        /* Only the writer modifies the slots, so they can be read directly */
+        for (int i = 0; i < PATH_CACHE_PROBE_MAX; i++) {
+            path_cache_slot_t* slot = &cache->slots[(index + i) & (cache->nb_slots - 1)];
+
+            if (slot->key[0] == 0 || (slot->key[0] == key[0] && slot->key[1] == key[1] && slot->key[2] == key[2])) {
+                target = slot;
+                break;
+            }
+            if (target == NULL || slot->last_update < target->last_update) {
+                target = slot;
+            }
+        }
+
+        value.key[0] = key[0];
+        value.key[1] = key[1];
+        value.key[2] = key[2];
+        if (target->key[0] == key[0] && target->key[1] == key[1] && target->key[2] == key[2] &&
+            target->last_update + cache->max_age >= current_time) {
+            uint64_t age = (current_time > target->last_update) ? current_time - target->last_update : 0;
+            uint64_t weight = (cache->half_life == 0) ? 0 :
+                (PATH_CACHE_WEIGHT_ONE * cache->half_life) / (cache->half_life + age);
+
+            if (weight > PATH_CACHE_WEIGHT_MAX) {
+                weight = PATH_CACHE_WEIGHT_MAX;
+            }
+            value.rtt_min = path_cache_blend(target->rtt_min, rtt_min, weight);
+            value.bandwidth = path_cache_blend(target->bandwidth, bandwidth, weight);
+            value.loss_ppm = path_cache_blend(target->loss_ppm, loss_ppm, weight);
+            value.nb_updates = target->nb_updates + 1;
+        }
+        else {
+            value.rtt_min = rtt_min;
+            value.bandwidth = bandwidth;
+            value.loss_ppm = loss_ppm;
+            value.nb_updates = 1;
+        }
+        value.last_update = current_time;
+        path_cache_write_slot(target, &value);
+        (void)picoquic_unlock_mutex(&cache->update_lock);
+    }
+
+    return ret;
+}
+
+/* Seed a new connection with the cached values for the peer prefix,
+ * unless the connection was already seeded, e.g., from a ticket. The
+ * seeded window is the cached BDP, reduced by the loss rate. */
+void picoquic_path_cache_seed_cnx(picoquic_cnx_t* cnx, const struct sockaddr* addr, uint64_t current_time)
+{
+    picoquic_path_cache_entry_t entry;
+
+    if (cnx->seed_cwin == 0 &&
+        picoquic_path_cache_lookup(cnx->quic->path_cache, addr, current_time, &entry) == 0 &&
+        entry.rtt_min > 0) {
+        uint64_t cwin = (entry.bandwidth * entry.rtt_min) / 1000000;
+
+        cwin -= (cwin * entry.loss_ppm) / 1000000;
+        if (cwin > PICOQUIC_CWIN_INITIAL) {
+            uint8_t* ip_addr;
+            uint8_t ip_addr_length;
+
+            picoquic_get_ip_addr((struct sockaddr*)addr, &ip_addr, &ip_addr_length);
+            picoquic_seed_bandwidth(cnx, entry.rtt_min, cwin, ip_addr, ip_addr_length);
+        }
+    }
+}
+
+/* Record the state of the default path when a connection is deleted, if
+ * the connection carried enough traffic for the values to be meaningful. */
+void picoquic_path_cache_record_cnx(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    if (cnx->nb_paths > 0 && cnx->nb_packets_sent >= PATH_CACHE_MIN_PACKETS) {
+        picoquic_path_t* path_x = cnx->path[0];
+
+        if (path_x->rtt_min > 0 && path_x->bandwidth_estimate_max > 0 && path_x->peer_addr.ss_family != 0) {
+            uint64_t loss_ppm = (cnx->nb_retransmission_total * 1000000) / cnx->nb_packets_sent;
+
+            (void)picoquic_path_cache_update(cnx->quic->path_cache, (struct sockaddr*)&path_x->peer_addr,
+                path_x->rtt_min, path_x->bandwidth_estimate_max, loss_ppm, current_time);
+        }
+    }
+}
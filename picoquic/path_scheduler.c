@@ -0,0 +1,323 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Multipath schedulers.
+ *
+ * The path selection in sender.c handles path challenges, priorities,
+ * acknowledgements and path affinity, and builds the list of the paths
+ * that are ready to send at the highest priority level. When the
+ * connection has a path scheduler, the scheduler picks one of these
+ * candidates:
+ *
+ * - "minrtt" sends on the path with the lowest smoothed RTT.
+ * - "weighted" runs a smooth weighted round robin, in which the weight of
+ *   each path is its estimated bandwidth.
+ * - "redundant" sends new data on the least recently used path, and lets
+ *   the other paths repeat the packets not yet acknowledged, which is
+ *   useful during handovers.
+ * - "handover" avoids the paths marked as subject to satellite handovers
+ *   from one RTT before the predicted handover time until the end of the
+ *   handover, and otherwise uses the lowest RTT path.
+ * - "arrival" sends on the path where the data is expected to arrive
+ *   first, i.e., the lowest sum of the one way delay and of the time needed
+ *   to serialize a packet at the path's rate. If a faster path is only
+ *   blocked for a short time, waiting for it would deliver the data earlier
+ *   than sending it on a slower path: in that case the scheduler holds the
+ *   new data on the candidates until the faster path is expected to be
+ *   ready. This equalizes the delivery times, and reduces the amount of
+ *   data that the receiver holds in its reordering buffers.
+ */
+
+#include "picoquic_internal.h"
+#include "sat_utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int picoquic_min_rtt_select(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time)
+{
+    int selected = -1;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+    UNREFERENCED_PARAMETER(current_time);
+#endif
+
+    for (int i = 0; i < nb_candidates; i++) {
+        if (selected < 0 || candidates[i]->smoothed_rtt < candidates[selected]->smoothed_rtt) {
+            selected = i;
+        }
+    }
+    return selected;
+}
+
+/* Weight of a path in kB/s. Before a bandwidth estimate is available,
+ * the path weight is derived from the congestion window and the RTT. */
+static int64_t picoquic_path_scheduler_weight(picoquic_path_t* path_x)
+{
+    uint64_t bw = path_x->bandwidth_estimate;
+
+    if (bw == 0 && path_x->smoothed_rtt > 0) {
+        bw = (path_x->cwin * 1000000) / path_x->smoothed_rtt;
+    }
+    bw /= 1000;
+
+    return (bw == 0) ? 1 : (int64_t)bw;
+}
+
+static int picoquic_weighted_select(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time)
+{
+    int selected = -1;
+    int64_t total = 0;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+    UNREFERENCED_PARAMETER(current_time);
+#endif
+
+    for (int i = 0; i < nb_candidates; i++) {
+        int64_t weight = picoquic_path_scheduler_weight(candidates[i]);
+
+        total += weight;
+        candidates[i]->scheduler_credit += weight;
+        if (selected < 0 || candidates[i]->scheduler_credit > candidates[selected]->scheduler_credit) {
+            selected = i;
+        }
+    }
+    if (selected >= 0) {
+        candidates[selected]->scheduler_credit -= total;
+        /* Paths are not candidates at every round, so keep the credits bounded */
+        for (int i = 0; i < nb_candidates; i++) {
+            if (candidates[i]->scheduler_credit > total) {
+                candidates[i]->scheduler_credit = total;
+            }
+            else if (candidates[i]->scheduler_credit < -total) {
+                candidates[i]->scheduler_credit = -total;
+            }
+        }
+    }
+    return selected;
+}
+
+static int picoquic_redundant_select(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time)
+{
+    int selected = -1;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+    UNREFERENCED_PARAMETER(current_time);
+#endif
+
+    for (int i = 0; i < nb_candidates; i++) {
+        if (selected < 0 || candidates[i]->last_sent_time < candidates[selected]->last_sent_time) {
+            selected = i;
+        }
+    }
+    return selected;
+}
+
+static int picoquic_is_path_close_to_handover(picoquic_path_t* path_x, uint64_t current_time)
+{
+    return path_x->is_handover_prone &&
+        picoquic_handover_distance(current_time) <= path_x->smoothed_rtt + MARGIN * 1000ull;
+}
+
+static int picoquic_handover_select(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time)
+{
+    int selected = -1;
+    int is_selected_avoided = 0;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+#endif
+
+    for (int i = 0; i < nb_candidates; i++) {
+        int is_avoided = picoquic_is_path_close_to_handover(candidates[i], current_time);
+
+        if (selected < 0 || (is_selected_avoided && !is_avoided) ||
+            (is_avoided == is_selected_avoided && candidates[i]->smoothed_rtt < candidates[selected]->smoothed_rtt)) {
+            selected = i;
+            is_selected_avoided = is_avoided;
+        }
+    }
+    return selected;
+}
+
+/* Expected one way delay of a path. The smoothed one way delay is only
+ * available if the peer sends time stamps, otherwise use half the RTT. */
+static uint64_t picoquic_path_one_way_delay(picoquic_path_t* path_x)
+{
+    return (path_x->one_way_delay_avg > 0) ? path_x->one_way_delay_avg : path_x->smoothed_rtt / 2;
+}
+
+/* Sending rate of a path, in bytes per second */
+static uint64_t picoquic_path_scheduler_rate(picoquic_path_t* path_x)
+{
+    uint64_t rate = path_x->bandwidth_estimate;
+
+    if (rate == 0) {
+        rate = (uint64_t)path_x->pacing.rate;
+    }
+    if (rate == 0 && path_x->smoothed_rtt > 0) {
+        rate = (path_x->cwin * 1000000) / path_x->smoothed_rtt;
+    }
+    return (rate == 0) ? 1 : rate;
+}
+
+/* Time needed for a full size packet sent now to reach the peer */
+static uint64_t picoquic_path_arrival_delay(picoquic_path_t* path_x)
+{
+    return picoquic_path_one_way_delay(path_x) + (path_x->send_mtu * 1000000) / picoquic_path_scheduler_rate(path_x);
+}
+
+/* Time before a path that is not ready can send again. If the path is
+ * blocked by congestion control, it has to wait for the acknowledgement
+ * of enough bytes, otherwise it is blocked by pacing for about one packet
+ * time. */
+static uint64_t picoquic_path_wait_delay(picoquic_path_t* path_x)
+{
+    uint64_t rate = picoquic_path_scheduler_rate(path_x);
+    uint64_t wait = (path_x->send_mtu * 1000000) / rate;
+
+    if (path_x->bytes_in_transit + path_x->send_mtu > path_x->cwin) {
+        wait = ((path_x->bytes_in_transit + path_x->send_mtu - path_x->cwin) * 1000000) / rate;
+    }
+    return wait;
+}
+
+static int picoquic_arrival_select(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time)
+{
+    int selected = -1;
+    uint64_t selected_arrival = UINT64_MAX;
+    uint64_t hold_delay = UINT64_MAX;
+
+    for (int i = 0; i < nb_candidates; i++) {
+        uint64_t arrival = picoquic_path_arrival_delay(candidates[i]);
+
+        if (selected < 0 || arrival < selected_arrival) {
+            selected = i;
+            selected_arrival = arrival;
+        }
+    }
+
+    if (selected >= 0 && candidates[selected]->scheduler_hold_time <= current_time) {
+        /* A hold that just expired is not renewed, so that the candidates
+         * keep sending even if the estimates of the faster path are wrong. */
+        if (candidates[selected]->scheduler_hold_time == 0) {
+            for (int i = 0; i < cnx->nb_paths; i++) {
+                picoquic_path_t* path_x = cnx->path[i];
+                int is_candidate = 0;
+
+                for (int j = 0; j < nb_candidates; j++) {
+                    if (candidates[j] == path_x) {
+                        is_candidate = 1;
+                        break;
+                    }
+                }
+                if (!is_candidate && path_x->challenge_verified && !path_x->path_is_demoted &&
+                    !path_x->path_is_standby && path_x->smoothed_rtt > 0) {
+                    uint64_t arrival = picoquic_path_arrival_delay(path_x);
+
+                    if (arrival < selected_arrival) {
+                        uint64_t wait = picoquic_path_wait_delay(path_x);
+
+                        if (wait < selected_arrival - arrival && wait < hold_delay) {
+                            hold_delay = wait;
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < nb_candidates; i++) {
+            candidates[i]->scheduler_hold_time = (hold_delay == UINT64_MAX) ? 0 : current_time + hold_delay;
+        }
+    }
+
+    return selected;
+}
+
+picoquic_path_scheduler_t picoquic_min_rtt_path_scheduler_struct = { "minrtt", picoquic_min_rtt_select, 0 };
+picoquic_path_scheduler_t picoquic_weighted_path_scheduler_struct = { "weighted", picoquic_weighted_select, 0 };
+picoquic_path_scheduler_t picoquic_redundant_path_scheduler_struct = { "redundant", picoquic_redundant_select, 1 };
+picoquic_path_scheduler_t picoquic_handover_path_scheduler_struct = { "handover", picoquic_handover_select, 0 };
+picoquic_path_scheduler_t picoquic_arrival_path_scheduler_struct = { "arrival", picoquic_arrival_select, 0 };
+
+picoquic_path_scheduler_t* picoquic_min_rtt_path_scheduler = &picoquic_min_rtt_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_weighted_path_scheduler = &picoquic_weighted_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_redundant_path_scheduler = &picoquic_redundant_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_handover_path_scheduler = &picoquic_handover_path_scheduler_struct;
+picoquic_path_scheduler_t* picoquic_arrival_path_scheduler = &picoquic_arrival_path_scheduler_struct;
+
+picoquic_path_scheduler_t const* picoquic_get_path_scheduler(char const* scheduler_name)
+{
+    picoquic_path_scheduler_t const* scheduler = NULL;
+    picoquic_path_scheduler_t const* schedulers[] = {
+        picoquic_min_rtt_path_scheduler, picoquic_weighted_path_scheduler,
+        picoquic_redundant_path_scheduler, picoquic_handover_path_scheduler,
+        picoquic_arrival_path_scheduler };
+
+    if (scheduler_name != NULL) {
+        for (size_t i = 0; i < sizeof(schedulers) / sizeof(schedulers[0]); i++) {
+            if (strcmp(scheduler_name, schedulers[i]->path_scheduler_id) == 0) {
+                scheduler = schedulers[i];
+                break;
+            }
+        }
+    }
+    return scheduler;
+}
+
+void picoquic_set_default_path_scheduler(picoquic_quic_t* quic, picoquic_path_scheduler_t const* scheduler)
+{
+    quic->default_path_scheduler = scheduler;
+}
+
+void picoquic_set_path_scheduler(picoquic_cnx_t* cnx, picoquic_path_scheduler_t const* scheduler)
+{
+    cnx->path_scheduler = scheduler;
+    for (int i = 0; i < cnx->nb_paths; i++) {
+        cnx->path[i]->scheduler_credit = 0;
+        cnx->path[i]->scheduler_hold_time = 0;
+    }
+}
+
+int picoquic_set_path_handover_prone(picoquic_cnx_t* cnx, uint64_t unique_path_id, int is_handover_prone)
+{
+    int ret = -1;
+    int path_id = picoquic_get_path_id_from_unique(cnx, unique_path_id);
+
+    if (path_id >= 0) {
+        cnx->path[path_id]->is_handover_prone = (is_handover_prone) ? 1 : 0;
+        ret = 0;
+    }
+    return ret;
+}
+
+/* Select a path among the ready candidates. Returns the index of the
+ * selected candidate, or -1 if the default policy applies. */
+int picoquic_path_scheduler_select_path(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time)
+{
+    int selected = -1;
+
+    if (cnx->path_scheduler != NULL && nb_candidates > 0) {
+        selected = cnx->path_scheduler->select_path(cnx, candidates, nb_candidates, current_time);
+        if (selected >= nb_candidates) {
+            selected = -1;
+        }
+    }
+    return selected;
+}
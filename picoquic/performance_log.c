@@ -189,6 +189,8 @@ int picoquic_perflog_record(picoquic_cnx_t* cnx, picoquic_performance_log_ctx_t*
         if (cnx->congestion_alg != NULL) {
             perflog_item->v[picoquic_perflog_ccalgo] = cnx->congestion_alg->congestion_algorithm_number;
         }
+        /* 1 + index of the experiment arm, 0 if none */
+        perflog_item->v[picoquic_perflog_experiment_arm] = cnx->experiment_arm;
         
         if (perflog_ctx->first == NULL) {
             perflog_ctx->first = perflog_item;
@@ -270,6 +272,7 @@ const char* picoquic_perflog_param_name(picoquic_perflog_column_enum rank)
     case picoquic_perflog_bwe_max: return("bwe_max");
     case picoquic_perflog_pacing_quantum_max: return("p_quantum");
     case picoquic_perflog_pacing_rate: return("p_rate");
+    case picoquic_perflog_experiment_arm: return("exp_arm");
     default:
         break;
     }
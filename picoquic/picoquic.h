@@ -24,6 +24,7 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stdio.h>
 #ifdef _WINDOWS
 #include <WS2tcpip.h>
 #include <Ws2def.h>
@@ -104,6 +105,9 @@ extern "C" {
 #define PICOQUIC_ERROR_PATH_ID_INVALID (PICOQUIC_ERROR_CLASS + 60)
 #define PICOQUIC_ERROR_RETRY_NEEDED (PICOQUIC_ERROR_CLASS + 61)
 #define PICOQUIC_ERROR_SERVER_BUSY (PICOQUIC_ERROR_CLASS + 62)
+#define PICOQUIC_ERROR_CC_PLUGIN_LOAD (PICOQUIC_ERROR_CLASS + 63)
+#define PICOQUIC_ERROR_CC_PLUGIN_INVALID (PICOQUIC_ERROR_CLASS + 64)
+#define PICOQUIC_ERROR_DATAGRAM_QUEUE_FULL (PICOQUIC_ERROR_CLASS + 65)
 
 /*
  * Protocol errors defined in the QUIC spec
@@ -305,6 +309,7 @@ typedef struct st_picoquic_tp_t {
     int enable_multipath;
     picoquic_tp_version_negotiation_t version_negotiation;
     int enable_bdp_frame;
+    int enable_fec;
     int enable_simple_multipath;
     int is_multipath_enabled;
     uint64_t initial_max_paths;
@@ -446,6 +451,17 @@ void picoquic_set_random_initial(picoquic_quic_t* quic, int random_initial);
 /* Set the "packet train" mode for pacing */
 void picoquic_set_packet_train_mode(picoquic_quic_t* quic, int train_mode);
 
+/* Set the "txtime" mode for pacing. Instead of waking up for each packet,
+ * the sender may schedule packets up to "horizon_usec" in the future. The
+ * departure time of the packets returned by picoquic_prepare_packet_ex is
+ * obtained with picoquic_get_txtime, and passed to the kernel with SO_TXTIME
+ * (see picoquic_sendmsg_ex). Only use this mode if the socket supports it:
+ * otherwise, scheduled packets would be sent immediately, in bursts.
+ * Setting the horizon to 0 disables the mode (default).
+ */
+void picoquic_set_txtime_pacing(picoquic_quic_t* quic, uint64_t horizon_usec);
+uint64_t picoquic_get_txtime(picoquic_cnx_t* cnx);
+
 /* set the padding policy.
  * The padding policy is parameterized by two variables:
  * - packets shorter than padding_min_size will be padded to that size.
@@ -632,6 +648,19 @@ void picoquic_set_default_multipath_option(picoquic_quic_t* quic, int multipath_
  */
 void picoquic_set_cwin_max(picoquic_quic_t* quic, uint64_t cwin_max);
 
+/** picoquic_set_crypto_offload:
+ * Enable or disable the crypto offload thread for the context.
+ * When enabled, the AEAD encryption and header protection of 1-RTT
+ * packets are performed by a background thread, in parallel with the
+ * formatting of the next packets in the same call to
+ * picoquic_prepare_packet_ex. All packets are fully protected when
+ * that function returns. There is a single worker per QUIC context,
+ * because the crypto contexts of a connection cannot be shared between
+ * threads. Returns PICOQUIC_ERROR_MEMORY if the thread cannot be
+ * created, in which case packets keep being protected synchronously.
+ */
+int picoquic_set_crypto_offload(picoquic_quic_t* quic, int enable);
+
 /* picoquic_set_max_data_limit: 
 * set a maximum value for the "max data" option, thus limiting the
 * amount of data that the peer will be able to send before data is
@@ -646,6 +675,20 @@ void picoquic_set_cwin_max(picoquic_quic_t* quic, uint64_t cwin_max);
 */
 void picoquic_set_max_data_control(picoquic_quic_t* quic, uint64_t max_data);
 
+/* picoquic_set_memory_limits:
+* set a memory budget per connection and for the whole context.
+* The budget accounts for the packets waiting for acknowledgement,
+* the data queued for sending by the application, and the out of
+* order data waiting for reassembly. When a limit is reached, the
+* connection stops granting new flow control credit (MAX_DATA,
+* MAX_STREAM_DATA and MAX_STREAMS) until memory is released,
+* so the peer's windows shrink instead of allocations failing.
+* Setting a limit to 0 (default) means no limit.
+*/
+void picoquic_set_memory_limits(picoquic_quic_t* quic, uint64_t cnx_memory_max, uint64_t quic_memory_max);
+uint64_t picoquic_get_cnx_memory_used(picoquic_cnx_t* cnx);
+uint64_t picoquic_get_quic_memory_used(picoquic_quic_t* quic);
+
 /*
 * Idle timeout and handshake timeout
 * 
@@ -696,6 +739,13 @@ int picoquic_save_retry_tokens(picoquic_quic_t* quic, char const* token_store_fi
 /* Manage bdps */
 void picoquic_set_default_bdp_frame_option(picoquic_quic_t* quic, int enable_bdp_frame);
 
+/* Propose forward error correction on new connections. If the peer
+ * accepts, 1-RTT packets are protected by repair frames, sent after a
+ * number of packets that decreases when losses increase, or before
+ * satellite handovers. Lost packets are rebuilt by the receiver without
+ * waiting for a retransmission. */
+void picoquic_set_default_fec_option(picoquic_quic_t* quic, int enable_fec);
+
 /* Set default connection ID length for the context.
  * All valid values are supported on the client.
  * Using a null value on the server is not tested, may not work.
@@ -743,6 +793,24 @@ void picoquic_set_default_stateless_reset_min_interval(picoquic_quic_t* quic, ui
 void picoquic_set_max_simultaneous_logs(picoquic_quic_t* quic, uint32_t max_simultaneous_logs);
 uint32_t picoquic_get_max_simultaneous_logs(picoquic_quic_t* quic);
 
+/* Sampled logging.
+ * Connections are selected for logging by a hash of their initial connection ID,
+ * so that client and server make the same choice: with a rate of N, about 1
+ * connection in N is logged. Within logged connections, packet events are
+ * logged for 1 packet number in N. Sampling rates of 0 or 1 log everything.
+ * Setting a very large packet rate, e.g. UINT32_MAX, only logs the trigger windows.
+ *
+ * Trigger windows log all packets of a logged connection for the specified
+ * duration. A window starts when a selected event occurs (PTO), when the
+ * application calls picoquic_open_log_window, or is centered on the predicted
+ * satellite handover times if PICOQUIC_LOG_TRIGGER_HANDOVER is selected.
+ */
+#define PICOQUIC_LOG_TRIGGER_PTO 1
+#define PICOQUIC_LOG_TRIGGER_HANDOVER 2
+void picoquic_set_log_sampling(picoquic_quic_t* quic, uint32_t cnx_sample_rate, uint32_t packet_sample_rate);
+void picoquic_set_log_trigger_window(picoquic_quic_t* quic, uint32_t trigger_events, uint64_t window_usec);
+void picoquic_open_log_window(picoquic_cnx_t* cnx, uint64_t current_time);
+
 /* Connection context creation and registration */
 picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
     picoquic_connection_id_t initial_cnx_id, picoquic_connection_id_t remote_cnx_id,
@@ -906,7 +974,11 @@ typedef struct st_picoquic_path_quality_t {
     uint64_t max_reorder_delay; /* maximum time gap for out of order packets */
     uint64_t max_reorder_gap; /* maximum number gap for out of order packets */
     uint64_t bytes_in_transit; /* number of bytes currently in transit */
-
+    /* Receive side reordering, for the whole connection */
+    uint64_t reorder_buffer_bytes; /* stream bytes received but waiting for missing data */
+    uint64_t reorder_buffer_max; /* maximum value of reorder_buffer_bytes */
+    uint64_t hol_stalls; /* number of head of line stalls on receive streams */
+    uint64_t hol_stall_time; /* total duration of the completed head of line stalls, in microseconds */
 } picoquic_path_quality_t;
 
 int picoquic_get_path_quality(picoquic_cnx_t* cnx, uint64_t unique_path_id, picoquic_path_quality_t * quality);
@@ -916,6 +988,50 @@ int picoquic_subscribe_to_quality_update_per_path(picoquic_cnx_t* cnx, uint64_t
 void picoquic_subscribe_to_quality_update(picoquic_cnx_t* cnx, uint64_t pacing_rate_delta, uint64_t rtt_delta);
 void picoquic_default_quality_update(picoquic_quic_t* quic, uint64_t pacing_rate_delta, uint64_t rtt_delta);
 
+/* Latency histograms.
+ * The path quality only reports smoothed values. When latency histograms
+ * are enabled, the stack also records the distribution of RTT samples,
+ * of ACK delays reported by the peer, and of the stream delivery latency,
+ * i.e., the time between queuing data with picoquic_add_to_stream and
+ * the acknowledgement of the last byte. Stream delivery is sampled: each
+ * stream tracks one queued segment at a time.
+ *
+ * The histograms use fixed memory. Values are in microseconds, counted in
+ * buckets whose width is at most 1/16th of the value, so that percentiles
+ * are reported with a precision of about 6%.
+ * Histograms are kept per path and for the whole QUIC context. They are
+ * updated by the network thread and should be read from that thread.
+ */
+#define PICOQUIC_HDR_HIST_SUB_BUCKETS 16
+#define PICOQUIC_HDR_HIST_MAX_EXPONENT 40
+#define PICOQUIC_HDR_HIST_NB_BUCKETS (PICOQUIC_HDR_HIST_SUB_BUCKETS * (PICOQUIC_HDR_HIST_MAX_EXPONENT - 3))
+
+typedef struct st_picoquic_hdr_hist_t {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint32_t bucket[PICOQUIC_HDR_HIST_NB_BUCKETS];
+} picoquic_hdr_hist_t;
+
+typedef enum {
+    picoquic_latency_rtt = 0,
+    picoquic_latency_ack_delay,
+    picoquic_latency_stream_delivery,
+    picoquic_latency_max
+} picoquic_latency_enum;
+
+void picoquic_hdr_hist_reset(picoquic_hdr_hist_t* hist);
+void picoquic_hdr_hist_record(picoquic_hdr_hist_t* hist, uint64_t value);
+void picoquic_hdr_hist_merge(picoquic_hdr_hist_t* hist, const picoquic_hdr_hist_t* other);
+/* Return the highest value equivalent to the requested percentile, e.g., 99.9 */
+uint64_t picoquic_hdr_hist_percentile(const picoquic_hdr_hist_t* hist, double percentile);
+
+int picoquic_set_latency_histograms(picoquic_quic_t* quic, int enable);
+const picoquic_hdr_hist_t* picoquic_get_latency_histogram(picoquic_quic_t* quic, picoquic_latency_enum metric);
+const picoquic_hdr_hist_t* picoquic_get_path_latency_histogram(picoquic_cnx_t* cnx, uint64_t unique_path_id,
+    picoquic_latency_enum metric);
+
 /* Connection management API.
  * TODO: many of these API should be deprecated. They were created when we
  * envisaged that applications would directly manipulate which connection
@@ -1003,6 +1119,42 @@ int picoquic_queue_misc_frame(picoquic_cnx_t* cnx, const uint8_t* bytes, size_t
 #define PICOQUIC_DATAGRAM_QUEUE_MAX_LENGTH 1200
 int picoquic_queue_datagram_frame(picoquic_cnx_t* cnx, size_t length, const uint8_t* bytes);
 
+/* Queue a datagram frame with a priority class and a deadline.
+ * Queued datagrams are sent by priority class, lowest value first, and in
+ * FIFO order within a class. Datagrams queued with picoquic_queue_datagram_frame
+ * use the connection's datagram priority as class.
+ * If expiry_time is not zero, the datagram is dropped if it has not been sent
+ * before that time, per the QUIC context clock. A datagram sent less than half
+ * an RTT before its expiry time is counted as late.
+ * If the queue already holds the maximum number of datagrams set with
+ * picoquic_set_datagram_queue_max, the least urgent queued datagram is dropped
+ * to make room for a more urgent one. Otherwise, the new datagram is dropped and
+ * the call returns PICOQUIC_ERROR_DATAGRAM_QUEUE_FULL.
+ */
+int picoquic_queue_datagram_frame_ex(picoquic_cnx_t* cnx, size_t length, const uint8_t* bytes,
+    uint8_t priority, uint64_t expiry_time);
+/* Set the maximum number of queued datagrams, 0 for no limit (default) */
+void picoquic_set_datagram_queue_max(picoquic_cnx_t* cnx, size_t max_datagrams);
+
+typedef struct st_picoquic_datagram_queue_stats_t {
+    size_t nb_queued; /* datagrams currently in the queue */
+    uint64_t nb_sent; /* datagrams sent from the queue */
+    uint64_t nb_expired; /* datagrams dropped because their expiry time passed */
+    uint64_t nb_dropped; /* datagrams dropped because the queue was full */
+    uint64_t nb_late; /* datagrams sent less than half an RTT before their expiry time */
+} picoquic_datagram_queue_stats_t;
+
+void picoquic_get_datagram_queue_stats(picoquic_cnx_t* cnx, picoquic_datagram_queue_stats_t* stats);
+
+typedef struct st_picoquic_fec_stats_t {
+    int is_enabled; /* FEC was negotiated by both peers */
+    uint64_t nb_repair_sent; /* repair frames sent */
+    uint64_t nb_repair_received; /* repair frames received */
+    uint64_t nb_recovered; /* lost packets rebuilt from repair frames */
+} picoquic_fec_stats_t;
+
+void picoquic_get_fec_stats(picoquic_cnx_t* cnx, picoquic_fec_stats_t* stats);
+
 /* The incoming packet API is used to pass incoming packets to a 
  * Quic context. The API handles the decryption of the packets
  * and their processing in the context of connections.
@@ -1046,6 +1198,45 @@ int picoquic_prepare_next_packet(picoquic_quic_t* quic,
     struct sockaddr_storage* p_addr_to, struct sockaddr_storage* p_addr_from, int* if_index,
     picoquic_connection_id_t* p_logcid, picoquic_cnx_t** p_last_cnx);
 
+/* Batched version of picoquic_prepare_next_packet_ex. The send buffer is
+ * filled with the packets of as many connections as are ready to send,
+ * calling picoquic_prepare_next_packet_ex repeatedly with at most
+ * "packet_max" bytes each time, until the buffer is full, "batch_max"
+ * messages are ready, or no connection has anything to send.
+ *
+ * Each message in the batch describes a contiguous part of the send
+ * buffer, to be sent with one call to sendmsg, or one element of sendmmsg.
+ * If "send_msg_size" is not zero, the message is a train of packets of
+ * that size, except maybe the last one, to be sent using UDP GSO. If
+ * "use_gso" is set, consecutive packets sent to the same destination
+ * from the same source are grouped in a single message when their sizes
+ * are compatible with GSO, up to PICOQUIC_SEND_BATCH_GSO_MAX segments.
+ * In txtime pacing mode, "departure_time" is the departure time of the
+ * message, as returned by picoquic_get_txtime when it was prepared, and
+ * only packets with the same departure time are grouped. It is zero for
+ * stateless packets.
+ *
+ * Connections that are closed during the call are deleted, as with
+ * picoquic_prepare_next_packet_ex, and are never referenced in the batch.
+ */
+#define PICOQUIC_SEND_BATCH_GSO_MAX 64
+
+typedef struct st_picoquic_send_batch_t {
+    uint8_t* bytes;
+    size_t length;
+    size_t send_msg_size;
+    struct sockaddr_storage addr_to;
+    struct sockaddr_storage addr_from;
+    int if_index;
+    picoquic_connection_id_t log_cid;
+    picoquic_cnx_t* cnx;
+    uint64_t departure_time;
+} picoquic_send_batch_t;
+
+int picoquic_prepare_next_packets(picoquic_quic_t* quic, uint64_t current_time,
+    uint8_t* send_buffer, size_t send_buffer_max, size_t packet_max, int use_gso,
+    picoquic_send_batch_t* batch, size_t batch_max, size_t* nb_batch);
+
 int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
     uint64_t current_time, uint8_t* send_buffer, size_t send_buffer_max, size_t* send_length,
     struct sockaddr_storage* p_addr_to, struct sockaddr_storage* p_addr_from, int* if_index,
@@ -1243,6 +1434,36 @@ void picoquic_reset_stream_ctx(picoquic_cnx_t* cnx, uint64_t stream_id);
  */
 int picoquic_add_to_stream_with_ctx(picoquic_cnx_t * cnx, uint64_t stream_id, const uint8_t * data, size_t length, int set_fin, void * app_stream_ctx);
 
+/* Queue data on a stream without copying it in an intermediate buffer.
+ * The application keeps ownership of the "length" bytes at "data", and
+ * must not modify or free them until the transport calls "release_fn".
+ * The bytes are copied directly from the application buffer into the
+ * packets, and the release function is called once all of them have
+ * been acknowledged by the peer, or when the stream is reset or deleted.
+ * The buffer can be any memory the application manages, such as a
+ * region of a memory mapped file. If the call fails, or if "length" is
+ * zero, the release function is not called. Apart from that, the behavior
+ * is the same as "picoquic_add_to_stream_with_ctx".
+ */
+typedef void (*picoquic_stream_data_release_fn)(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, void* release_ctx);
+
+int picoquic_add_to_stream_by_reference(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin, void* app_stream_ctx,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx);
+
+/* Queue "length" bytes of a file, starting at "file_offset", on a stream.
+ * The data is read from the file directly into the packets when stream
+ * frames are formatted, so large files are sent without an application
+ * callback per frame and without holding the content in memory. The
+ * file must be opened for binary reading, e.g., with picoquic_file_open().
+ * If the call succeeds, the transport takes ownership of the file and
+ * closes it after all the bytes have been sent, or when the stream is
+ * reset or deleted. If the call fails, the application keeps ownership.
+ */
+int picoquic_add_file_to_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
+    FILE* F, uint64_t file_offset, uint64_t length, int set_fin, void* app_stream_ctx);
+
 /* Reset a stream, indicating that no more data will be sent on 
  * that stream and that any data currently queued can be abandoned. */
 int picoquic_reset_stream(picoquic_cnx_t* cnx,
@@ -1365,6 +1586,17 @@ void picoquic_set_optimistic_ack_policy(picoquic_quic_t* quic, uint32_t sequence
 void picoquic_set_preemptive_repeat_policy(picoquic_quic_t* quic, int do_repeat);
 void picoquic_set_preemptive_repeat_per_cnx(picoquic_cnx_t* cnx, int do_repeat);
 
+/* Selective preemptive repeat. Instead of repeating the tail of every
+ * finished stream, the packets are only repeated if the estimated loss
+ * rate of the path exceeds a threshold, or if they were sent close to
+ * a scheduled satellite handover. The bytes repeated are capped to
+ * budget_permille of the bytes sent, plus a small allowance so that
+ * short transfers can be protected; 0 selects the default budget.
+ * Enabling the selective mode also enables preemptive repeat.
+ */
+void picoquic_set_selective_repeat_policy(picoquic_quic_t* quic, int is_selective, uint32_t budget_permille);
+void picoquic_set_selective_repeat_per_cnx(picoquic_cnx_t* cnx, int is_selective, uint32_t budget_permille);
+
 /* Enables keep alive for a connection.
  * Keep alive interval is expressed in microseconds.
  * If `interval` is `0`, it is set to `idle_timeout / 2`.
@@ -1456,12 +1688,178 @@ extern picoquic_congestion_algorithm_t* picoquic_bbr1_algorithm;
 
 picoquic_congestion_algorithm_t const* picoquic_get_congestion_algorithm(char const* alg_name);
 
+/* Load a congestion control algorithm from a shared object implementing
+ * the plugin ABI defined in picoquic_cc_plugin.h. Once loaded, the
+ * algorithm can also be found by name with picoquic_get_congestion_algorithm.
+ * Plugins should be loaded before starting the network threads. They stay
+ * loaded until picoquic_cc_plugin_unload_all is called, which must only be
+ * done after all the QUIC contexts using them are freed.
+ */
+int picoquic_cc_plugin_load(char const* file_name, picoquic_congestion_algorithm_t const** alg);
+void picoquic_cc_plugin_unload_all(void);
+
 void picoquic_set_default_congestion_algorithm(picoquic_quic_t* quic, picoquic_congestion_algorithm_t const* algo);
 
 void picoquic_set_default_congestion_algorithm_by_name(picoquic_quic_t* quic, char const* alg_name);
 
 void picoquic_set_congestion_algorithm(picoquic_cnx_t* cnx, picoquic_congestion_algorithm_t const* algo);
 
+/* Multipath schedulers.
+ * When multipath is enabled, several paths may be available at the same
+ * priority level and ready to send, i.e., not blocked by pacing or by
+ * congestion control. The scheduler selects one of these candidates and
+ * returns its index in the candidate list, or -1 to keep the default
+ * choice. Challenges, acknowledgements and streams or datagrams with path
+ * affinity are served before the scheduler is called. If `is_redundant`
+ * is set, a path that has no new data to send repeats the packets sent
+ * on other paths that are not yet acknowledged.
+ *
+ * The default scheduler (NULL) sends on the ready path that was least
+ * recently used. The handover aware scheduler avoids the paths marked
+ * with `picoquic_set_path_handover_prone` shortly before and during the
+ * satellite handovers, and otherwise uses the lowest RTT path. The
+ * arrival time scheduler sends on the path with the earliest expected
+ * delivery, and may hold new data for a short time if a faster path is
+ * about to become ready, which limits reordering at the receiver.
+ */
+typedef int (*picoquic_path_scheduler_select)(picoquic_cnx_t* cnx,
+    picoquic_path_t** candidates, int nb_candidates, uint64_t current_time);
+
+typedef struct st_picoquic_path_scheduler_t {
+    char const* path_scheduler_id;
+    picoquic_path_scheduler_select select_path;
+    int is_redundant;
+} picoquic_path_scheduler_t;
+
+extern picoquic_path_scheduler_t* picoquic_min_rtt_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_weighted_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_redundant_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_handover_path_scheduler;
+extern picoquic_path_scheduler_t* picoquic_arrival_path_scheduler;
+
+picoquic_path_scheduler_t const* picoquic_get_path_scheduler(char const* scheduler_name);
+void picoquic_set_default_path_scheduler(picoquic_quic_t* quic, picoquic_path_scheduler_t const* scheduler);
+void picoquic_set_path_scheduler(picoquic_cnx_t* cnx, picoquic_path_scheduler_t const* scheduler);
+int picoquic_set_path_handover_prone(picoquic_cnx_t* cnx, uint64_t unique_path_id, int is_handover_prone);
+
+/* Congestion control telemetry.
+ * When enabled, each path keeps a ring of the last nb_events congestion
+ * control events: changes of the state reported by the `alg_observe`
+ * function of the algorithm, changes of the congestion window or of the
+ * pacing rate by more than 1/8th since the last recorded value, and losses
+ * ignored because of a satellite handover. Each event carries the
+ * algorithm number, the notification that caused it and a snapshot of the
+ * path state, so it can be interpreted without other logs.
+ *
+ * The ring is written by the network thread without locks, and the oldest
+ * events are overwritten when it is full. Events can be read by
+ * picoquic_get_cc_events from any thread, as long as the path is not
+ * deleted. The caller keeps the index of the next event to read; if
+ * events were overwritten before being read, the index of the first
+ * returned event is larger than the requested index.
+ *
+ * This should be set before the connections are created. Setting
+ * nb_events to 0 disables the telemetry for new paths.
+ */
+typedef enum {
+    picoquic_cc_event_state = 0, /* cc_state changed */
+    picoquic_cc_event_cwin, /* cwin changed by more than 1/8th */
+    picoquic_cc_event_pacing, /* pacing rate changed by more than 1/8th */
+    picoquic_cc_event_handover_suppressed /* loss ignored because of a handover */
+} picoquic_cc_event_type_t;
+
+typedef struct st_picoquic_cc_event_t {
+    uint64_t event_index;
+    uint64_t event_time;
+    picoquic_cc_event_type_t event_type;
+    uint8_t congestion_algorithm_number;
+    picoquic_congestion_notification_t notification;
+    uint64_t cc_state;
+    uint64_t cc_param;
+    uint64_t cwin;
+    uint64_t pacing_rate;
+    uint64_t bytes_in_transit;
+    uint64_t smoothed_rtt;
+} picoquic_cc_event_t;
+
+void picoquic_set_cc_telemetry(picoquic_quic_t* quic, size_t nb_events);
+size_t picoquic_get_cc_events(picoquic_cnx_t* cnx, uint64_t unique_path_id, uint64_t* next_event_index,
+    picoquic_cc_event_t* events, size_t max_events);
+
+/* Path state cache.
+ * Servers see many short connections from the same client networks. The
+ * path state cache remembers the minimum RTT, the maximum bandwidth and the
+ * loss rate observed on connections from each client prefix, by default
+ * /24 for IPv4 and /48 for IPv6. When a cache is attached to a QUIC
+ * context, new connections are seeded with the cached values through
+ * the same mechanism as `picoquic_seed_bandwidth`, and the values are
+ * updated when connections are deleted. Old observations decay with the
+ * specified half life, and entries older than max_age are ignored.
+ *
+ * The cache has a fixed number of entries, rounded up to a power of 2.
+ * Lookups do not take locks, updates are serialized by a mutex, so the
+ * same cache can be shared by QUIC contexts running in different threads.
+ * The cache is not deleted by `picoquic_free`: the application deletes
+ * it after freeing all the contexts that use it.
+ */
+#define PICOQUIC_PATH_CACHE_PREFIX_V4_DEFAULT 24
+#define PICOQUIC_PATH_CACHE_PREFIX_V6_DEFAULT 48
+#define PICOQUIC_PATH_CACHE_HALF_LIFE_DEFAULT 600000000ull /* 10 minutes */
+#define PICOQUIC_PATH_CACHE_MAX_AGE_DEFAULT 3600000000ull /* 1 hour */
+
+typedef struct st_picoquic_path_cache_t picoquic_path_cache_t;
+
+typedef struct st_picoquic_path_cache_entry_t {
+    uint64_t rtt_min; /* microseconds */
+    uint64_t bandwidth; /* bytes per second */
+    uint64_t loss_ppm; /* lost packets per million */
+    uint64_t nb_updates;
+    uint64_t last_update;
+} picoquic_path_cache_entry_t;
+
+picoquic_path_cache_t* picoquic_path_cache_create(size_t nb_entries, int prefix_bits_v4, int prefix_bits_v6,
+    uint64_t half_life, uint64_t max_age);
+void picoquic_path_cache_delete(picoquic_path_cache_t* cache);
+void picoquic_set_path_cache(picoquic_quic_t* quic, picoquic_path_cache_t* cache);
+int picoquic_path_cache_lookup(picoquic_path_cache_t* cache, const struct sockaddr* addr, uint64_t current_time,
+    picoquic_path_cache_entry_t* entry);
+int picoquic_path_cache_update(picoquic_path_cache_t* cache, const struct sockaddr* addr,
+    uint64_t rtt_min, uint64_t bandwidth, uint64_t loss_ppm, uint64_t current_time);
+
+/* Experiment arms.
+ * Connections can be assigned to experiment arms, so that variants of
+ * the congestion control and transport settings can be compared on the
+ * same traffic. Each new connection is assigned to an arm by hashing its
+ * initial connection ID with the salt, so the assignment is deterministic,
+ * with a probability proportional to the weight of the arm. The settings
+ * of the arm override the defaults of the QUIC context; zero or NULL
+ * values keep the defaults. The arms are copied, and the arm of each
+ * connection is recorded in the performance log.
+ * Setting nb_arms to 0 stops the experiment.
+ */
+#define PICOQUIC_EXPERIMENT_ARMS_MAX 16
+
+typedef enum {
+    picoquic_handover_policy_default = 0, /* Ignore congestion events close to satellite handovers */
+    picoquic_handover_policy_none /* Handle congestion events close to handovers as any other */
+} picoquic_handover_policy_enum;
+
+typedef struct st_picoquic_experiment_arm_t {
+    char const* name;
+    uint32_t weight;
+    picoquic_congestion_algorithm_t const* congestion_alg;
+    uint64_t initial_cwin; /* bytes */
+    double pacing_gain; /* Multiplies the pacing rate set by the congestion algorithm */
+    uint64_t ack_gap_max; /* Largest ACK gap requested from the peer */
+    uint64_t ack_delay_max; /* Largest ACK delay requested from the peer, microseconds */
+    picoquic_handover_policy_enum handover_policy;
+} picoquic_experiment_arm_t;
+
+int picoquic_set_experiment_arms(picoquic_quic_t* quic, const picoquic_experiment_arm_t* arms, size_t nb_arms, uint64_t salt);
+/* Returns the index of the arm of the connection, or -1 if there is none */
+int picoquic_get_experiment_arm(picoquic_cnx_t* cnx);
+char const* picoquic_get_experiment_arm_name(picoquic_quic_t* quic, int arm_index);
+
 /* Special code for Wi-Fi network. These networks are subject to occasional
  * "suspension", for power saving reasons. If the suspension is too long,
  * it causes transmission to stop after cngestion control credits are
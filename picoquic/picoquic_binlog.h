@@ -112,6 +112,17 @@ int picoquic_set_binlog(picoquic_quic_t* quic, char const* binlog_dir);
 /* Enable binary logs, e.g. if autoqlog is requests */
 void picoquic_enable_binlog(picoquic_quic_t* quic);
 
+/* Write the binary logs from a background thread. The network thread
+ * copies the log events in a ring of the specified size, and the events
+ * are dropped if the ring is full. Set the size to 0 to revert to
+ * synchronous writes. Returns PICOQUIC_ERROR_MEMORY if the ring or the
+ * thread cannot be created.
+ */
+int picoquic_set_binlog_async(picoquic_quic_t* quic, size_t ring_size);
+
+/* Number of binlog events dropped because the ring was full */
+uint64_t picoquic_get_binlog_async_dropped(picoquic_quic_t* quic);
+
 #ifdef __cplusplus
 }
 #endif
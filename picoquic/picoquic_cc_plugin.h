@@ -0,0 +1,141 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef PICOQUIC_CC_PLUGIN_H
+#define PICOQUIC_CC_PLUGIN_H
+
+/* Congestion control plugin ABI.
+ *
+ * Congestion control algorithms can be loaded at runtime from shared
+ * objects. A plugin only includes this header, and exports a function
+ * named PICOQUIC_CC_PLUGIN_ENTRY of type picoquic_cc_plugin_entry_fn.
+ * The function receives the table of host functions, and returns the
+ * description of the algorithm, or NULL if the host is not compatible.
+ *
+ * The host and plugin structures start with the ABI version and their
+ * size. The major version changes when the semantics of existing members
+ * change; new members are only ever added at the end of the structures,
+ * with a new minor version. The host rejects plugins with a different
+ * major version, or with a size smaller than that of the first minor
+ * version. Plugins must check that host_size covers the members they use.
+ *
+ * Plugins do not see the picoquic structures. Paths are passed as opaque
+ * handles, and the per ACK state is copied in a fixed layout structure.
+ * Notifications use the PICOQUIC_CC_PLUGIN_NOTIFICATION_* values defined
+ * here, which do not follow changes of the internal notification list;
+ * values unknown to the plugin must be ignored.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PICOQUIC_CC_PLUGIN_ABI_MAJOR 1
+#define PICOQUIC_CC_PLUGIN_ABI_MINOR 0
+#define PICOQUIC_CC_PLUGIN_ABI_VERSION ((PICOQUIC_CC_PLUGIN_ABI_MAJOR << 16) | PICOQUIC_CC_PLUGIN_ABI_MINOR)
+#define PICOQUIC_CC_PLUGIN_ENTRY "picoquic_cc_plugin_entry"
+/* Algorithm numbers below this value are reserved for built in algorithms */
+#define PICOQUIC_CC_PLUGIN_ALGO_NUMBER_MIN 128
+
+/* Notifications passed to the "notify" function of the plugin */
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_ACKNOWLEDGEMENT 0
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_REPEAT 1
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_TIMEOUT 2
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_SPURIOUS_REPEAT 3
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_RTT_MEASUREMENT 4
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_ECN_EC 5
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_CWIN_BLOCKED 6
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_SEED_CWIN 7
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_RESET 8
+#define PICOQUIC_CC_PLUGIN_NOTIFICATION_LOST_FEEDBACK 9
+
+typedef struct st_picoquic_cc_plugin_path_t picoquic_cc_plugin_path_t;
+
+typedef struct st_picoquic_cc_plugin_ack_t {
+    uint64_t rtt_measurement;
+    uint64_t one_way_delay;
+    uint64_t nb_bytes_acknowledged;
+    uint64_t nb_bytes_newly_lost;
+    uint64_t nb_bytes_lost_since_packet_sent;
+    uint64_t nb_bytes_delivered_since_packet_sent;
+    uint64_t inflight_prior;
+    uint64_t lost_packet_number;
+    uint64_t lost_packet_sent_time;
+    uint32_t is_app_limited;
+    uint32_t is_cwnd_limited;
+} picoquic_cc_plugin_ack_t;
+
+/* Functions provided by picoquic */
+typedef struct st_picoquic_cc_plugin_host_t {
+    uint32_t abi_version;
+    uint32_t host_size;
+    /* Path state */
+    uint64_t (*get_rtt_min)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_smoothed_rtt)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_rtt_variant)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_bandwidth_estimate)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_peak_bandwidth_estimate)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_bytes_in_transit)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_send_mtu)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_cwin)(picoquic_cc_plugin_path_t* path);
+    /* Packet numbers and times, as in cc_common.c */
+    uint64_t (*get_sequence_number)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_ack_number)(picoquic_cc_plugin_path_t* path);
+    uint64_t (*get_ack_sent_time)(picoquic_cc_plugin_path_t* path);
+    /* Congestion window and pacing */
+    void (*set_cwin)(picoquic_cc_plugin_path_t* path, uint64_t cwin);
+    void (*set_pacing_rate)(picoquic_cc_plugin_path_t* path, double pacing_rate, uint64_t quantum);
+    void (*set_pacing_from_cwin)(picoquic_cc_plugin_path_t* path, int slow_start);
+} picoquic_cc_plugin_host_t;
+
+/* Functions provided by the plugin. The "create" function returns the
+ * per path state, which is passed to the other functions and freed by
+ * "release". The "observe" function is optional. */
+typedef struct st_picoquic_cc_plugin_t {
+    uint32_t abi_version;
+    uint32_t plugin_size;
+    char const* name;
+    uint32_t algorithm_number;
+    void* (*create)(const picoquic_cc_plugin_host_t* host, picoquic_cc_plugin_path_t* path, uint64_t current_time);
+    void (*notify)(void* state, picoquic_cc_plugin_path_t* path, int notification,
+        const picoquic_cc_plugin_ack_t* ack, uint64_t current_time);
+    void (*release)(void* state);
+    void (*observe)(void* state, uint64_t* cc_state, uint64_t* cc_param);
+} picoquic_cc_plugin_t;
+
+/* Size of the plugin structure in the first minor version of the ABI.
+ * This stays the same when members are added in later minor versions. */
+#define PICOQUIC_CC_PLUGIN_SIZE_MIN (offsetof(picoquic_cc_plugin_t, observe) + sizeof(((picoquic_cc_plugin_t*)0)->observe))
+
+typedef const picoquic_cc_plugin_t* (*picoquic_cc_plugin_entry_fn)(const picoquic_cc_plugin_host_t* host);
+
+/* Host side registration of a plugin that is linked in the application,
+ * or already loaded. Loading from a file is done with picoquic_cc_plugin_load,
+ * declared in picoquic.h. */
+struct st_picoquic_congestion_algorithm_t;
+int picoquic_cc_plugin_register(picoquic_cc_plugin_entry_fn entry_fn, struct st_picoquic_congestion_algorithm_t const** alg);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PICOQUIC_CC_PLUGIN_H */
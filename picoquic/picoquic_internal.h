@@ -49,6 +49,7 @@ extern "C" {
 #define PICOQUIC_NB_PATH_DEFAULT 2
 #define PICOQUIC_MAX_PACKETS_IN_POOL 0x2000
 #define PICOQUIC_STORED_IP_MAX 16
+#define PICOQUIC_FILE_READAHEAD_SIZE 0x100000 /* read ahead 1MB when sending files */
 
 #define PICOQUIC_INITIAL_RTT 250000ull /* 250 ms */
 #define PICOQUIC_TARGET_RENO_RTT 100000ull /* 100 ms */
@@ -76,6 +77,11 @@ extern "C" {
 
 #define PICOQUIC_SPURIOUS_RETRANSMIT_DELAY_MAX 1000000ull /* one second */
 
+#define PICOQUIC_LOSS_ESTIMATE_INTERVAL 0x8000 /* bytes sent between updates of the path loss estimate */
+#define PICOQUIC_SELECTIVE_REPEAT_LOSS_MIN 20 /* per mille, path loss rate above which stream tails are repeated */
+#define PICOQUIC_SELECTIVE_REPEAT_BUDGET_DEFAULT 100 /* per mille of bytes sent */
+#define PICOQUIC_SELECTIVE_REPEAT_ALLOWANCE (4 * PICOQUIC_MAX_PACKET_SIZE) /* so short transfers can be protected */
+
 #define PICOQUIC_MICROSEC_SILENCE_MAX 120000000ull /* 120 seconds for now */
 #define PICOQUIC_MICROSEC_HANDSHAKE_MAX 30000000ull /* 30 seconds for now */
 #define PICOQUIC_MICROSEC_WAIT_MAX 10000000ull /* 10 seconds for now */
@@ -157,6 +163,7 @@ typedef enum {
     picoquic_frame_type_path_standby =  0x15228c07,
     picoquic_frame_type_path_available =  0x15228c08,
     picoquic_frame_type_bdp = 0xebd9,
+    picoquic_frame_type_fec_repair = 0xfec5,
     picoquic_frame_type_max_paths = 0x15228c0b
 } picoquic_frame_type_enum_t;
 
@@ -373,6 +380,13 @@ typedef struct st_picoquic_stream_queue_node_t {
     uint64_t offset;  /* Stream offset of the first octet in "bytes" */
     size_t length;    /* Number of octets in "bytes" */
     uint8_t* bytes;
+    picoquic_stream_data_release_fn release_fn; /* If not NULL, "bytes" is owned by the application */
+    void* release_ctx;
+    uint64_t stream_offset_end; /* Stream offset after the last octet, set when all octets are sent */
+    FILE* F; /* If not NULL, the octets are read from that file instead of "bytes" */
+    uint64_t file_offset; /* Offset in the file of the first octet */
+    uint64_t readahead_offset; /* Offset in the file up to which readahead was requested */
+    size_t memory_accounted; /* Bytes counted in the connection memory budget */
 } picoquic_stream_queue_node_t;
 
 /*
@@ -421,6 +435,7 @@ typedef struct st_picoquic_packet_t {
     unsigned int delivered_app_limited : 1;
     unsigned int sent_cwin_limited : 1;
     unsigned int is_preemptive_repeat : 1;
+    unsigned int is_fec_repair : 1;
     unsigned int was_preemptively_repeated : 1;
     unsigned int is_queued_to_path : 1;
     unsigned int is_queued_for_retransmit : 1;
@@ -593,6 +608,7 @@ typedef uint64_t picoquic_tp_enum;
 #define picoquic_tp_enable_simple_multipath  0x29e3d19e
 #define picoquic_tp_version_negotiation 0x11
 #define picoquic_tp_enable_bdp_frame 0xebd9 /* per draft-kuhn-quic-0rtt-bdp-09 */
+#define picoquic_tp_enable_fec 0xfec5 /* experimental, FEC repair frames */
 #define picoquic_tp_initial_max_paths  0x0f739bbc1b666d07ull /* per PR 292 draft quic multipath 06 */
 
 /* Callback for converting binary log to quic log at the end of a connection. 
@@ -605,6 +621,76 @@ typedef int (*picoquic_autoqlog_fn)(picoquic_cnx_t * cnx);
  */
 typedef int (*picoquic_performance_log_fn)(picoquic_quic_t* quic, picoquic_cnx_t* cnx, int should_delete);
 
+/* Packet protection job, used when AEAD and header protection are
+ * performed by the crypto offload thread. The clear text payload is
+ * copied after the header in the send buffer and encrypted in place.
+ */
+typedef struct st_picoquic_protect_job_t {
+    uint8_t* send_buffer;
+    size_t h_length;
+    size_t payload_length;
+    size_t pn_offset;
+    uint64_t sequence_number;
+    uint64_t unique_path_id;
+    void* aead_context;
+    void* pn_enc;
+    uint8_t first_mask;
+    unsigned int is_multipath : 1;
+} picoquic_protect_job_t;
+
+typedef struct st_picoquic_crypto_offload_t picoquic_crypto_offload_t;
+
+picoquic_crypto_offload_t* picoquic_crypto_offload_create(void);
+void picoquic_crypto_offload_delete(picoquic_crypto_offload_t* offload);
+void picoquic_crypto_offload_submit(picoquic_crypto_offload_t* offload, const picoquic_protect_job_t* job);
+void picoquic_crypto_offload_drain(picoquic_crypto_offload_t* offload);
+void picoquic_protect_job_execute(picoquic_protect_job_t* job);
+
+/* Asynchronous binary log writer, see binlog_async.c */
+typedef struct st_picoquic_binlog_async_t picoquic_binlog_async_t;
+
+picoquic_binlog_async_t* picoquic_binlog_async_create(size_t ring_size);
+void picoquic_binlog_async_delete(picoquic_binlog_async_t* async);
+void picoquic_binlog_async_write(picoquic_binlog_async_t* async, FILE* f,
+    const uint8_t* head, size_t head_length, const uint8_t* msg, size_t msg_length);
+void picoquic_binlog_async_close(picoquic_binlog_async_t* async, FILE* f);
+void picoquic_binlog_async_flush(picoquic_binlog_async_t* async);
+
+/* Live metrics, see live_metrics.c */
+typedef struct st_picoquic_live_metrics_t picoquic_live_metrics_t;
+
+void picoquic_metrics_update(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_metrics_release(picoquic_cnx_t* cnx);
+void picoquic_metrics_rtt_sample(picoquic_live_metrics_t* metrics, uint64_t rtt);
+void picoquic_metrics_delete(picoquic_live_metrics_t* metrics);
+
+/* Congestion control plugins, see cc_plugin.c */
+picoquic_congestion_algorithm_t const* picoquic_cc_plugin_find(char const* alg_name);
+
+/* Experiment arms, see experiment.c */
+const picoquic_experiment_arm_t* picoquic_experiment_assign(picoquic_cnx_t* cnx);
+
+/* Multipath schedulers, see path_scheduler.c */
+int picoquic_path_scheduler_select_path(picoquic_cnx_t* cnx, picoquic_path_t** candidates, int nb_candidates, uint64_t current_time);
+
+/* Path state cache, see path_cache.c */
+void picoquic_path_cache_seed_cnx(picoquic_cnx_t* cnx, const struct sockaddr* addr, uint64_t current_time);
+void picoquic_path_cache_record_cnx(picoquic_cnx_t* cnx, uint64_t current_time);
+
+/* Latency histograms, see hdr_histogram.c */
+void picoquic_latency_record(picoquic_cnx_t* cnx, struct st_picoquic_path_t* path_x, picoquic_latency_enum metric, uint64_t value);
+
+/* Congestion control notification and telemetry, see cc_telemetry.c */
+typedef struct st_picoquic_cc_telemetry_t picoquic_cc_telemetry_t;
+
+/* Forward error correction, see fec.c */
+#define PICOQUIC_FEC_WINDOW 32 /* source packets that a repair symbol can combine */
+#define PICOQUIC_FEC_REPAIR_OVERHEAD 32 /* room left in source packets for the repair frame fields */
+typedef struct st_picoquic_fec_ctx_t picoquic_fec_ctx_t;
+
+void picoquic_congestion_notify(picoquic_cnx_t* cnx, struct st_picoquic_path_t* path_x,
+    picoquic_congestion_notification_t notification, picoquic_per_ack_state_t* ack_state, uint64_t current_time);
+
 /* QUIC context, defining the tables of connections,
  * open sockets, etc.
  */
@@ -630,6 +716,7 @@ typedef struct st_picoquic_quic_t {
     uint32_t padding_multiple_default;
     uint32_t padding_minsize_default;
     uint32_t sequence_hole_pseudo_period; /* Optimistic ack defense */
+    uint32_t selective_repeat_budget; /* per mille of bytes sent, for new connections */
     picoquic_pmtud_policy_enum default_pmtud_policy;
     picoquic_spinbit_version_enum default_spin_policy;
     picoquic_lossbit_version_enum default_lossbit_policy;
@@ -638,6 +725,10 @@ typedef struct st_picoquic_quic_t {
     uint64_t crypto_epoch_length_max; /* Default packet interval between key rotations */
     uint32_t max_simultaneous_logs;
     uint32_t current_number_of_open_logs;
+    uint32_t log_cnx_sample_rate; /* Log 1 connection in N, all if 0 or 1 */
+    uint32_t log_packet_sample_rate; /* Log 1 packet in N, all if 0 or 1 */
+    uint32_t log_trigger_events; /* Events that open a full logging window, see PICOQUIC_LOG_TRIGGER_* */
+    uint64_t log_trigger_window; /* Duration of the full logging windows, microseconds */
     uint32_t max_half_open_before_retry;
     uint32_t current_number_half_open;
     uint32_t current_number_connections;
@@ -666,15 +757,19 @@ typedef struct st_picoquic_quic_t {
     unsigned int use_constant_challenges : 1; /* Use predictable challenges when producing constant logs. */
     unsigned int use_low_memory : 1; /* if possible, use low memory alternatives, e.g. for AES */
     unsigned int is_preemptive_repeat_enabled : 1; /* enable premptive repeat on new connections */
+    unsigned int is_selective_repeat_enabled : 1; /* limit preemptive repeat to lossy paths and handovers */
     unsigned int default_send_receive_bdp_frame : 1; /* enable sending and receiving BDP frame */
+    unsigned int default_fec_option : 1; /* propose FEC on new connections */
     unsigned int enforce_client_only : 1; /* Do not authorize incoming connections */
     unsigned int test_large_server_flight : 1; /* Use TP to ensure server flight is at least 8K */
     unsigned int is_port_blocking_disabled : 1; /* Do not check client port on incoming connections */
     unsigned int are_path_callbacks_enabled : 1; /* Enable path specific callbacks by default */
     unsigned int use_predictable_random : 1; /* For logging tests */
+    unsigned int use_float_cc_gains : 1; /* test option, BBR applies gains in floating point as reference */
     picoquic_stateless_packet_t* pending_stateless_packet;
 
     picoquic_congestion_algorithm_t const* default_congestion_alg;
+    picoquic_path_scheduler_t const* default_path_scheduler;
     uint64_t wifi_shadow_rtt;
     double bbr_quantum_ratio;
 
@@ -719,11 +814,26 @@ typedef struct st_picoquic_quic_t {
 
     picoquic_fuzz_fn fuzz_fn;
     void* fuzz_ctx;
+    picoquic_crypto_offload_t* crypto_offload;
+    picoquic_binlog_async_t* binlog_async;
+    picoquic_live_metrics_t* live_metrics;
+    picoquic_hdr_hist_t* latency_hist; /* Array of picoquic_latency_max histograms, NULL if not enabled */
+    size_t cc_telemetry_size; /* Number of events in the CC telemetry rings, 0 if not enabled */
+    picoquic_path_cache_t* path_cache; /* Shared with other contexts, not owned */
+    picoquic_experiment_arm_t* experiment_arms; /* Copies of the arms, see experiment.c */
+    size_t nb_experiment_arms;
+    uint64_t experiment_weight_total;
+    uint64_t experiment_salt;
+    uint64_t txtime_horizon; /* Pacing horizon in microseconds if SO_TXTIME is used, 0 otherwise */
     int wake_file;
     int wake_line;
 
     /* Global flow control enforcement */
     uint64_t max_data_limit;
+    /* Memory budget. Limits set to 0 mean no limit */
+    uint64_t memory_used;
+    uint64_t memory_max;
+    uint64_t cnx_memory_max;
 
     /* Path quality callback. These variables store the default values
     * of the min deltas required to perform path quality signaling.
@@ -773,6 +883,7 @@ typedef struct st_picoquic_sack_list_t {
     uint64_t ack_horizon;
     int64_t horizon_delay;
     picoquic_sack_range_count_t rc[2];
+    uint64_t change_count; /* incremented when ranges below the last one change */
 } picoquic_sack_list_t;
 
 /*
@@ -818,10 +929,18 @@ typedef struct st_picoquic_stream_head_t {
     picosplay_tree_t stream_data_tree; /* splay of received stream segments */
     uint64_t sent_offset; /* Amount of data sent in the stream */
     picoquic_stream_queue_node_t* send_queue; /* if the stream is not "active", list of data segments ready to send */
+    picoquic_stream_queue_node_t* release_queue; /* application owned segments, sent but not yet acknowledged */
+    picoquic_stream_queue_node_t* release_queue_last;
     void * app_stream_ctx;
     picoquic_stream_direct_receive_fn direct_receive_fn; /* direct receive function, if not NULL */
     void* direct_receive_ctx; /* direct receive context */
     picoquic_sack_list_t sack_list; /* Track which parts of the stream were acknowledged by the peer */
+    int nb_data_nodes_accounted; /* Number of received data nodes counted in the connection memory budget */
+    uint64_t reorder_bytes; /* Out of order bytes received above the consumed offset, waiting in the data tree */
+    uint64_t reorder_bytes_accounted; /* Out of order bytes counted in the connection reordering statistics */
+    uint64_t hol_stall_start; /* Start of the current head of line stall, if is_hol_stalled */
+    uint64_t delivery_probe_offset; /* Last stream offset of the queued segment tracked for delivery latency */
+    uint64_t delivery_probe_time; /* Time at which that segment was queued */
     /* Stream priority -- lowest is most urgent */
     uint8_t stream_priority;
     /* Flags describing the state of the stream */
@@ -844,6 +963,8 @@ typedef struct st_picoquic_stream_head_t {
     unsigned int is_output_stream : 1; /* If stream is listed in the output list */
     unsigned int is_closed : 1; /* Stream is closed, closure is accouted for */
     unsigned int is_discarded : 1; /* There should be no more callback for that stream, the application has discarded it */
+    unsigned int is_delivery_probe_set : 1; /* A queued segment is tracked for delivery latency */
+    unsigned int is_hol_stalled : 1; /* Received data is waiting for missing bytes */
 } picoquic_stream_head_t;
 
 #define IS_CLIENT_STREAM_ID(id) (unsigned int)(((id) & 1) == 0)
@@ -871,6 +992,9 @@ typedef struct st_picoquic_misc_frame_header_t {
     struct st_picoquic_misc_frame_header_t* previous_misc_frame;
     size_t length;
     int is_pure_ack;
+    uint64_t expiry_time; /* Datagrams only, 0 if no deadline */
+    uint8_t priority; /* Datagrams only, priority class in the queue */
+    uint8_t is_datagram; /* Not set for other frames in the datagram queue, e.g., HANDSHAKE_DONE */
 } picoquic_misc_frame_header_t;
 
 /* Per epoch sequence/packet context.
@@ -894,6 +1018,7 @@ typedef struct st_picoquic_packet_context_t {
     picoquic_packet_t* retransmitted_newest;
     picoquic_packet_t* retransmitted_oldest;
     picoquic_packet_t* preemptive_repeat_ptr;
+    picoquic_fec_ctx_t* fec_ctx; /* FEC source packets, allocated when FEC is negotiated */
     /* monitor size of queues */
     uint64_t retransmitted_queue_size;
     /* ECN Counters */
@@ -922,8 +1047,28 @@ typedef struct st_picoquic_ack_context_track_t {
     unsigned int is_immediate_ack_required : 1;
 } picoquic_ack_context_track_t;
 
+/* Cache of the ACK blocks encoded after the first range, used by
+ * picoquic_format_ack_frame_in_context to avoid re-encoding ranges
+ * that did not change since the previous ACK.
+ */
+#define PICOQUIC_MAX_ACK_BLOCKS 32
+
+typedef struct st_picoquic_ack_cache_t {
+    uint64_t sack_change_count;
+    picoquic_sack_item_t* top_sack;
+    picoquic_sack_item_t* blocks[PICOQUIC_MAX_ACK_BLOCKS];
+    int nb_blocks;
+    int is_opportunistic;
+    int is_valid;
+    size_t tail_length;
+    uint8_t tail[PICOQUIC_MAX_ACK_BLOCKS * 16];
+    uint64_t nb_reused;
+} picoquic_ack_cache_t;
+
 typedef struct st_picoquic_ack_context_t {
     picoquic_sack_list_t sack_list; /* picoquic_format_ack_frame */
+    picoquic_ack_cache_t* ack_cache; /* picoquic_format_ack_frame */
+    picoquic_fec_ctx_t* fec_ctx; /* FEC received packets and repair symbols */
     uint64_t time_stamp_largest_received; /* picoquic_format_ack_frame */
     picoquic_ack_context_track_t act[2];
     uint64_t crypto_rotation_sequence; /* Lowest sequence seen with current key */
@@ -999,6 +1144,8 @@ typedef struct st_picoquic_remote_cnxid_stash_t {
 * Internal variables:
 * - bucket_nanosec: number of nanoseconds of transmission time that are allowed.
 * - packet_time_nanosec: number of nanoseconds required to send a full size packet.
+* - txtime_horizon_nanosec: how far in the future packets may be scheduled (txtime mode).
+* - departure_time: scheduled departure of the last packet sent.
 */
 typedef struct st_picoquic_pacing_t {
     uint64_t rate;
@@ -1008,9 +1155,11 @@ typedef struct st_picoquic_pacing_t {
     uint64_t quantum_max;
     uint64_t rate_max;
     int bandwidth_pause;
+    uint64_t departure_time;
     /* High precision variables should only be used inside pacing.c */
     int64_t bucket_nanosec;
     int64_t packet_time_nanosec;
+    int64_t txtime_horizon_nanosec;
 } picoquic_pacing_t;
 
 /*
@@ -1042,6 +1191,8 @@ typedef struct st_picoquic_path_t {
     uint64_t unique_path_id;
 
     void* app_path_ctx;
+    picoquic_hdr_hist_t* latency_hist; /* Array of picoquic_latency_max histograms, allocated on first sample */
+    picoquic_cc_telemetry_t* cc_telemetry; /* Ring of CC events, allocated on first notification */
     /* If using unique path id multipath */
     picoquic_ack_context_t ack_ctx;
     picoquic_packet_context_t pkt_ctx;
@@ -1106,6 +1257,9 @@ typedef struct st_picoquic_path_t {
     unsigned int is_pto_required : 1; /* Should send PTO probe */
     unsigned int is_probing_nat : 1; /* When path transmission is scheduled only for NAT probing */
     unsigned int is_lost_feedback_notified : 1; /* Lost feedback has been notified */
+    unsigned int is_handover_prone : 1; /* Path subject to satellite handovers, for path schedulers */
+    int64_t scheduler_credit; /* Used by the weighted round robin path scheduler */
+    uint64_t scheduler_hold_time; /* No new data sent on the path before that time, set by the path scheduler */
     
     /* Management of retransmissions in a path.
      * The "path_packet" variables are used for the RACK algorithm, per path, to avoid
@@ -1120,6 +1274,9 @@ typedef struct st_picoquic_path_t {
     uint64_t nb_losses_found;
     uint64_t nb_timer_losses;
     uint64_t nb_spurious; /* Number of spurious retransmissions for the path */
+    uint64_t loss_permille; /* Smoothed ratio of bytes lost to bytes sent, for selective repeat */
+    uint64_t loss_estimate_sent_prior; /* Value of bytes_sent at the last update of the estimate */
+    uint64_t loss_estimate_lost_prior; /* Value of total_bytes_lost at the last update of the estimate */
     uint64_t path_packet_acked_number; /* path packet number of highest ack */
     uint64_t path_packet_acked_time_sent; /* path packet number of highest ack */
     uint64_t path_packet_acked_received; /* time at which the highest ack was received */
@@ -1131,6 +1288,7 @@ typedef struct st_picoquic_path_t {
     uint64_t max_ack_delay;
     uint64_t rtt_sample;
     uint64_t one_way_delay_sample;
+    uint64_t one_way_delay_avg; /* Smoothed one way delay, if time stamps are enabled */
     uint64_t smoothed_rtt;
     uint64_t rtt_variant;
     uint64_t retransmit_timer;
@@ -1293,14 +1451,19 @@ typedef struct st_picoquic_cnx_t {
     unsigned int is_simple_multipath_enabled : 1; /* Usage of simple multipath was negotiated */
     unsigned int are_path_callbacks_enabled : 1; /* Enable path specific callbacks */
     unsigned int is_sending_large_buffer : 1; /* Buffer provided by application is sufficient for PMTUD */
+    unsigned int is_crypto_offload_active : 1; /* 1-RTT packets are protected by the crypto offload thread */
+    unsigned int is_log_sampled_out : 1; /* Connection not selected by the log sampling policy */
     unsigned int is_preemptive_repeat_enabled : 1; /* Preemptive repat of packets to reduce transaction latency */
+    unsigned int is_selective_repeat_enabled : 1; /* Preemptive repeat driven by path loss and handovers */
     unsigned int do_version_negotiation : 1; /* Whether compatible version negotiation is activated */
     unsigned int send_receive_bdp_frame : 1; /* enable sending and receiving BDP frame */
+    unsigned int is_fec_enabled : 1; /* FEC repair frames negotiated by both parties */
     unsigned int cwin_notified_from_seed : 1; /* cwin was reset from a seeded value */
     unsigned int is_datagram_ready : 1; /* Active polling for datagrams */
     unsigned int is_immediate_ack_required : 1; /* Should send an ACK asap */
     unsigned int is_multipath_enabled : 1; /* Unique path ID extension has been negotiated */
     unsigned int is_lost_feedback_notification_required : 1; /* CC algorithm requests lost feedback notification */
+    unsigned int skip_handover_suppression : 1; /* Treat congestion events close to satellite handovers as usual */
     
     /* PMTUD policy */
     picoquic_pmtud_policy_enum pmtud_policy;
@@ -1398,11 +1561,27 @@ typedef struct st_picoquic_cnx_t {
     uint64_t nb_trains_blocked_cwin;
     uint64_t nb_trains_blocked_pacing;
     uint64_t nb_trains_blocked_others;
+    uint64_t txtime_departure; /* Departure time of the packets prepared in the last call */
     uint64_t nb_packets_sent;
     uint64_t nb_packets_logged;
+    uint64_t nb_log_sample_events; /* Events without sequence number considered for packet sampling */
+    uint64_t log_window_end; /* All packets are logged until that time */
     uint64_t nb_retransmission_total;
     uint64_t nb_preemptive_repeat;
+    uint64_t nb_preemptive_repeat_bytes; /* Bytes repeated preemptively, checked against the selective repeat budget */
+    uint32_t selective_repeat_budget; /* per mille of bytes sent */
     uint64_t nb_spurious;
+    uint64_t nb_handover_suppressed; /* Congestion events ignored because of a satellite handover */
+    uint64_t reorder_buffer_bytes; /* Received stream bytes waiting for missing data */
+    uint64_t reorder_buffer_max; /* Highest value of reorder_buffer_bytes */
+    uint64_t nb_hol_stalls; /* Number of head of line stalls on receive streams */
+    uint64_t hol_stall_time; /* Total duration of the completed head of line stalls */
+    size_t experiment_arm; /* 1 + index of the experiment arm, 0 if none */
+    double pacing_gain; /* Set by the experiment arm, 0 if not used */
+    uint64_t ack_gap_limit; /* Set by the experiment arm, 0 if not used */
+    uint64_t ack_delay_limit; /* Set by the experiment arm, 0 if not used */
+    size_t metrics_slot; /* 1 + index of the live metrics slot, 0 if none */
+    uint64_t metrics_next_update;
     uint64_t nb_crypto_key_rotations;
     uint64_t nb_packet_holes_inserted;
     uint64_t max_ack_delay_remote;
@@ -1416,6 +1595,8 @@ typedef struct st_picoquic_cnx_t {
     unsigned int stream_blocked : 1;
     /* Congestion algorithm */
     picoquic_congestion_algorithm_t const* congestion_alg;
+    /* Multipath scheduler, NULL for the default policy */
+    picoquic_path_scheduler_t const* path_scheduler;
     /* Management of quality signalling updates */
     uint64_t rtt_update_delta;
     uint64_t pacing_rate_update_delta;
@@ -1436,6 +1617,7 @@ typedef struct st_picoquic_cnx_t {
     uint64_t maxdata_remote; /* Highest value received from the peer */
     uint64_t max_stream_data_local;
     uint64_t max_stream_data_remote;
+    uint64_t memory_used; /* Memory held for the connection, see picoquic_set_memory_limits */
     uint64_t max_stream_id_bidir_local; /* Highest value sent to the peer */
     uint64_t max_stream_id_bidir_rank_acked; /* Highest rank value acked by the peer */
     uint64_t max_stream_id_bidir_local_computed; /* Value computed from stream FIN but not yet sent */
@@ -1472,6 +1654,18 @@ typedef struct st_picoquic_cnx_t {
     picoquic_misc_frame_header_t* first_datagram;
     picoquic_misc_frame_header_t* last_datagram;
     uint64_t datagram_priority;
+    /* Management of the datagram queue, see picoquic_queue_datagram_frame_ex */
+    size_t datagram_queue_max;
+    size_t nb_datagrams_queued;
+    uint64_t datagram_expiry_next; /* No datagram expires before that time */
+    uint64_t nb_datagrams_queue_sent;
+    uint64_t nb_datagrams_expired;
+    uint64_t nb_datagrams_dropped;
+    uint64_t nb_datagrams_late;
+    /* Forward error correction statistics */
+    uint64_t nb_fec_repair_sent;
+    uint64_t nb_fec_repair_received;
+    uint64_t nb_fec_recovered;
     int datagram_conflicts_count;
     int datagram_conflicts_max;
 
@@ -1898,6 +2092,11 @@ int picoquic_copy_before_retransmit(picoquic_packet_t * old_p,
 
 int picoquic_retransmit_needed(picoquic_cnx_t* cnx, picoquic_packet_context_enum pc, picoquic_path_t* path_x, uint64_t current_time, uint64_t* next_wake_time, picoquic_packet_t* packet, size_t send_buffer_max, size_t* header_length);
 
+int picoquic_preemptive_retransmit_as_needed(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_packet_context_enum pc, uint64_t current_time, uint64_t* next_wake_time,
+    uint8_t* new_bytes, size_t send_buffer_max_minus_checksum, size_t* length,
+    int* more_data, int* is_pure_ack);
+
 void picoquic_set_ack_needed(picoquic_cnx_t* cnx, uint64_t current_time, picoquic_packet_context_enum pc,
     picoquic_path_t * path_x, int is_immediate_ack_required);
 
@@ -1927,6 +2126,8 @@ int picoquic_parse_stream_header(
     const uint8_t* bytes, size_t bytes_max,
     uint64_t* stream_id, uint64_t* offset, size_t* data_length, int* fin,
     size_t* consumed);
+int picoquic_process_ack_of_stream_frame(picoquic_cnx_t* cnx, uint8_t* bytes,
+    size_t bytes_max, size_t* consumed);
 
 int picoquic_parse_ack_header(
     uint8_t const* bytes, size_t bytes_max,
@@ -1947,6 +2148,18 @@ uint8_t* picoquic_format_max_streams_frame_if_needed(picoquic_cnx_t* cnx, uint8_
 void picoquic_stream_data_node_recycle(picoquic_stream_data_node_t* stream_data);
 picoquic_stream_data_node_t* picoquic_stream_data_node_alloc(picoquic_quic_t* quic);
 void picoquic_clear_stream(picoquic_stream_head_t* stream);
+void picoquic_stream_queue_node_free(picoquic_stream_head_t* stream, picoquic_stream_queue_node_t* stream_data);
+void picoquic_stream_queue_node_sent(picoquic_stream_head_t* stream, picoquic_stream_queue_node_t* stream_data);
+void picoquic_stream_release_acked_data(picoquic_stream_head_t* stream);
+void picoquic_memory_allocated(picoquic_cnx_t* cnx, size_t size);
+void picoquic_memory_released(picoquic_cnx_t* cnx, size_t size);
+int picoquic_is_memory_constrained(picoquic_cnx_t* cnx);
+
+/* Log sampling */
+int picoquic_is_cnx_selected_for_log(picoquic_quic_t* quic, const picoquic_connection_id_t* initial_cnxid);
+int picoquic_is_packet_selected_for_log(picoquic_cnx_t* cnx, uint64_t sequence_number, uint64_t current_time);
+void picoquic_log_trigger_event(picoquic_cnx_t* cnx, uint32_t trigger_event, uint64_t current_time);
+void picoquic_stream_data_nodes_account(picoquic_stream_head_t* stream, uint64_t current_time);
 void picoquic_delete_stream(picoquic_cnx_t * cnx, picoquic_stream_head_t * stream);
 picoquic_local_cnxid_list_t* picoquic_find_or_create_local_cnxid_list(picoquic_cnx_t* cnx, uint64_t unique_path_id, int do_create);
 picoquic_local_cnxid_t* picoquic_create_local_cnxid(picoquic_cnx_t* cnx,
@@ -1974,7 +2187,22 @@ void picoquic_delete_misc_or_dg(picoquic_misc_frame_header_t** first, picoquic_m
 void picoquic_clear_ack_ctx(picoquic_ack_context_t* ack_ctx);
 void picoquic_reset_ack_context(picoquic_ack_context_t* ack_ctx);
 int picoquic_queue_handshake_done_frame(picoquic_cnx_t* cnx);
-uint8_t* picoquic_format_first_datagram_frame(picoquic_cnx_t* cnx, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack);
+uint8_t* picoquic_format_first_datagram_frame(picoquic_cnx_t* cnx, picoquic_path_t* path_x, uint8_t* bytes, uint8_t* bytes_max,
+    int* more_data, int* is_pure_ack, uint64_t current_time);
+void picoquic_purge_expired_datagrams(picoquic_cnx_t* cnx, uint64_t current_time);
+void picoquic_fec_ctx_delete(picoquic_fec_ctx_t** p_fec_ctx);
+void picoquic_fec_record_sent(picoquic_packet_context_t* pkt_ctx, uint64_t pn, const uint8_t* bytes, size_t length);
+int picoquic_fec_is_repair_needed(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_packet_context_t* pkt_ctx,
+    int is_tail, uint64_t current_time);
+uint8_t* picoquic_format_fec_repair_frame(picoquic_cnx_t* cnx, picoquic_packet_context_t* pkt_ctx,
+    uint8_t* bytes, uint8_t* bytes_max, int* is_pure_ack);
+int picoquic_fec_record_received(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_local_cnxid_t* l_cid,
+    uint64_t pn, const uint8_t* bytes, size_t length,
+    struct sockaddr* addr_from, struct sockaddr* addr_to, uint64_t current_time);
+int picoquic_fec_is_recovered(picoquic_cnx_t* cnx, picoquic_local_cnxid_t* l_cid, uint64_t pn);
+const uint8_t* picoquic_decode_fec_repair_frame(picoquic_cnx_t* cnx, const uint8_t* bytes, const uint8_t* bytes_max,
+    picoquic_path_t* path_x, struct sockaddr* addr_from, struct sockaddr* addr_to, uint64_t current_time);
+const uint8_t* picoquic_skip_fec_repair_frame(const uint8_t* bytes, const uint8_t* bytes_max);
 uint8_t* picoquic_format_ready_datagram_frame(picoquic_cnx_t* cnx, picoquic_path_t * path_x, uint8_t* bytes, uint8_t* bytes_max, int* more_data, int* is_pure_ack, int* ret);
 uint8_t* picoquic_decode_datagram_frame_header(uint8_t* bytes, const uint8_t* bytes_max,
     uint8_t* frame_id, uint64_t* length);
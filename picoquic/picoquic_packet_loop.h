@@ -113,6 +113,9 @@ typedef struct st_picoquic_packet_loop_param_t {
     int extra_socket_required;
     int simulate_eio;
     size_t send_length_max;
+    /* If not zero, packets are prepared by picoquic_prepare_next_packets
+     * in batches of up to send_batch_max messages, and sent with sendmmsg. */
+    size_t send_batch_max;
 } picoquic_packet_loop_param_t;
 
 int picoquic_packet_loop_v2(picoquic_quic_t* quic,
@@ -149,12 +149,17 @@ FILE * picoquic_file_open_ex(char const * file_name, char const * flags, int * l
 FILE * picoquic_file_open(char const * file_name, char const * flags);
 FILE * picoquic_file_close(FILE * F);
 
+/* Read file content at a given offset, and advise the system of upcoming reads */
+int picoquic_file_read_at(FILE* F, uint64_t offset, uint8_t* buffer, size_t length);
+void picoquic_file_readahead(FILE* F, uint64_t offset, uint64_t length);
+
 int picoquic_file_delete(char const* file_name, int* last_err);
 
 /* Skip and decoding functions */
 const uint8_t* picoquic_frames_fixed_skip(const uint8_t * bytes, const uint8_t * bytes_max, uint64_t size);
 const uint8_t* picoquic_frames_varint_skip(const uint8_t * bytes, const uint8_t * bytes_max);
 const uint8_t* picoquic_frames_varint_decode(const uint8_t * bytes, const uint8_t * bytes_max, uint64_t * n64);
+const uint8_t* picoquic_frames_varint_decode_n(const uint8_t * bytes, const uint8_t * bytes_max, uint64_t * values, size_t nb_values);
 const uint8_t* picoquic_frames_varlen_decode(const uint8_t * bytes, const uint8_t * bytes_max, size_t * n);
 const uint8_t* picoquic_frames_uint8_decode(const uint8_t * bytes, const uint8_t * bytes_max, uint8_t * n);
 const uint8_t* picoquic_frames_uint16_decode(const uint8_t * bytes, const uint8_t * bytes_max, uint16_t * n);
@@ -223,6 +228,16 @@ void picoquic_delete_event(picoquic_event_t* event);
 int picoquic_signal_event(picoquic_event_t* event);
 int picoquic_wait_for_event(picoquic_event_t* event, uint64_t microsec_wait);
 
+/* 64 bit variables shared between threads without locks, loaded with
+ * acquire and stored with release semantics */
+#ifdef _WINDOWS
+#define picoquic_atomic_load_64(p) ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)(p), 0, 0))
+#define picoquic_atomic_store_64(p, v) (void)InterlockedExchange64((volatile LONG64*)(p), (LONG64)(v))
+#else
+#define picoquic_atomic_load_64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define picoquic_atomic_store_64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
 /* Simple portable random number generation
  */
 uint64_t picoquic_uniform_random(uint64_t rnd_max);
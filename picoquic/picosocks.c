@@ -19,8 +19,15 @@
 * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* for sendmmsg */
+#endif
 #include "picosocks.h"
 #include "picoquic_utils.h"
+#if defined(__linux__)
+#include <time.h>
+#include <linux/net_tstamp.h>
+#endif
 
 int picoquic_bind_to_port(SOCKET_TYPE fd, int af, int port)
 {
@@ -241,6 +248,27 @@ int picoquic_socket_set_pmtud_options(SOCKET_TYPE sd, int af)
     return ret;
 }
 
+/* Enable scheduling of departure times with SO_TXTIME. The queue
+ * discipline (fq or etf) holds each packet until the time set in
+ * the SCM_TXTIME control message, using the monotonic clock.
+ */
+int picoquic_socket_set_txtime(SOCKET_TYPE sd)
+{
+    int ret = -1;
+#if defined(__linux__) && defined(SO_TXTIME)
+    struct sock_txtime txtime_option;
+
+    memset(&txtime_option, 0, sizeof(txtime_option));
+    txtime_option.clockid = CLOCK_MONOTONIC;
+    ret = setsockopt(sd, SOL_SOCKET, SO_TXTIME, &txtime_option, sizeof(txtime_option));
+#else
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(sd);
+#endif
+#endif
+    return ret;
+}
+
 SOCKET_TYPE picoquic_open_client_socket(int af)
 {
 #ifdef _WINDOWS
@@ -530,12 +558,25 @@ void picoquic_socks_cmsg_format(
     size_t send_msg_size,
     struct sockaddr* addr_from,
     int dest_if)
+{
+    picoquic_socks_cmsg_format_ex(vmsg, message_length, send_msg_size, addr_from, dest_if, 0);
+}
+
+void picoquic_socks_cmsg_format_ex(
+    void* vmsg,
+    size_t message_length,
+    size_t send_msg_size,
+    struct sockaddr* addr_from,
+    int dest_if,
+    uint64_t txtime_delay)
 {
 #ifdef _WINDOWS
     WSAMSG* msg = (WSAMSG*)vmsg;
     int control_length = 0;
     struct cmsghdr* last_cmsg = NULL;
     int is_null = 0;
+    /* Departure time scheduling is not supported on Windows */
+    UNREFERENCED_PARAMETER(txtime_delay);
     /* Format the control message */
     if (addr_from != NULL && addr_from->sa_family != 0) {
         if (addr_from->sa_family == AF_INET) {
@@ -699,6 +740,24 @@ void picoquic_socks_cmsg_format(
             is_null = 1;
         }
     }
+#endif
+#if defined(__linux__) && defined(SCM_TXTIME)
+    if (!is_null && txtime_delay > 0) {
+        uint64_t* pval = (uint64_t*)cmsg_format_header_return_data_ptr(msg, &last_cmsg,
+            &control_length, SOL_SOCKET, SCM_TXTIME, sizeof(uint64_t));
+        if (pval != NULL) {
+            struct timespec ts;
+            (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+            *pval = ((uint64_t)ts.tv_sec) * 1000000000ull + (uint64_t)ts.tv_nsec + txtime_delay * 1000ull;
+        }
+        else {
+            is_null = 1;
+        }
+    }
+#else
+#ifdef UNREFERENCED_PARAMETER
+    UNREFERENCED_PARAMETER(txtime_delay);
+#endif
 #endif
 
     msg->msg_controllen = control_length;
@@ -1031,6 +1090,18 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
     const char* bytes, int length,
     int send_msg_size,
     int * sock_err)
+{
+    return picoquic_sendmsg_ex(fd, addr_dest, addr_from, dest_if, bytes, length, send_msg_size, 0, sock_err);
+}
+
+int picoquic_sendmsg_ex(SOCKET_TYPE fd,
+    struct sockaddr* addr_dest,
+    struct sockaddr* addr_from,
+    int dest_if,
+    const char* bytes, int length,
+    int send_msg_size,
+    uint64_t txtime_delay,
+    int * sock_err)
 #ifdef _WINDOWS
 {
     GUID WSASendMsg_GUID = WSAID_WSASENDMSG;
@@ -1068,7 +1139,7 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
         msg.Control.len = sizeof(cmsg_buffer);
 
         /* Format the control message */
-        picoquic_socks_cmsg_format(&msg, length, send_msg_size, addr_from, dest_if);
+        picoquic_socks_cmsg_format_ex(&msg, length, send_msg_size, addr_from, dest_if, txtime_delay);
 
         /* Send the message */
         ret = WSASendMsg(fd, &msg, 0, &dwBytesSent, NULL, NULL);
@@ -1117,7 +1188,7 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
     msg.msg_controllen = sizeof(cmsg_buffer);
 
     /* Format the control message */
-    picoquic_socks_cmsg_format(&msg, length, send_msg_size, addr_from, dest_if);
+    picoquic_socks_cmsg_format_ex(&msg, length, send_msg_size, addr_from, dest_if, txtime_delay);
 
     bytes_sent = sendmsg(fd, &msg, 0);
 
@@ -1136,6 +1207,77 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
 }
 #endif
 
+size_t picoquic_sendmmsg(SOCKET_TYPE fd, picoquic_send_batch_t* batch, size_t nb_msg,
+    const uint64_t* txtime_delay, int* sock_err)
+#if defined(__linux__)
+{
+    struct mmsghdr msgs[PICOQUIC_SENDMMSG_MAX];
+    struct iovec data_bufs[PICOQUIC_SENDMMSG_MAX];
+    union {
+        struct cmsghdr align;
+        char buf[128];
+    } cmsg_buffers[PICOQUIC_SENDMMSG_MAX];
+    size_t nb_sent = 0;
+
+    while (nb_sent < nb_msg) {
+        unsigned int nb_group = 0;
+        int ret;
+
+        memset(msgs, 0, sizeof(msgs));
+        while (nb_group < PICOQUIC_SENDMMSG_MAX && nb_sent + nb_group < nb_msg) {
+            picoquic_send_batch_t* msg = &batch[nb_sent + nb_group];
+            struct msghdr* hdr = &msgs[nb_group].msg_hdr;
+
+            data_bufs[nb_group].iov_base = msg->bytes;
+            data_bufs[nb_group].iov_len = msg->length;
+            hdr->msg_name = &msg->addr_to;
+            hdr->msg_namelen = picoquic_addr_length((struct sockaddr*)&msg->addr_to);
+            hdr->msg_iov = &data_bufs[nb_group];
+            hdr->msg_iovlen = 1;
+            hdr->msg_control = (void*)cmsg_buffers[nb_group].buf;
+            hdr->msg_controllen = sizeof(cmsg_buffers[nb_group].buf);
+            picoquic_socks_cmsg_format_ex(hdr, msg->length, msg->send_msg_size, (struct sockaddr*)&msg->addr_from,
+                msg->if_index, (txtime_delay == NULL) ? 0 : txtime_delay[nb_sent + nb_group]);
+            nb_group++;
+        }
+
+        ret = sendmmsg(fd, msgs, nb_group, 0);
+        if (ret <= 0) {
+            int last_error = errno;
+#ifndef DISABLE_DEBUG_PRINTF
+            DBG_PRINTF("Could not send packets on UDP socket[AF=%d]= %d!\n",
+                batch[nb_sent].addr_to.ss_family, last_error);
+#endif
+            if (sock_err != NULL) {
+                *sock_err = last_error;
+            }
+            break;
+        }
+        /* If only part of the group was sent, the next call reports the error */
+        nb_sent += (size_t)ret;
+    }
+
+    return nb_sent;
+}
+#else
+{
+    size_t nb_sent = 0;
+
+    while (nb_sent < nb_msg) {
+        picoquic_send_batch_t* msg = &batch[nb_sent];
+
+        if (picoquic_sendmsg_ex(fd, (struct sockaddr*)&msg->addr_to, (struct sockaddr*)&msg->addr_from,
+            msg->if_index, (const char*)msg->bytes, (int)msg->length, (int)msg->send_msg_size,
+            (txtime_delay == NULL) ? 0 : txtime_delay[nb_sent], sock_err) <= 0) {
+            break;
+        }
+        nb_sent++;
+    }
+
+    return nb_sent;
+}
+#endif
+
 int picoquic_select_ex(SOCKET_TYPE* sockets,
     int nb_sockets,
     struct sockaddr_storage* addr_from,
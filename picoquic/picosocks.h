@@ -185,6 +185,7 @@ void picoquic_close_server_sockets(picoquic_server_sockets_t* sockets);
 int picoquic_socket_set_pkt_info(SOCKET_TYPE sd, int af);
 int picoquic_socket_set_ecn_options(SOCKET_TYPE sd, int af, int * recv_set, int * send_set);
 int picoquic_socket_set_pmtud_options(SOCKET_TYPE sd, int af);
+int picoquic_socket_set_txtime(SOCKET_TYPE sd);
 
 int picoquic_select(SOCKET_TYPE* sockets, int nb_sockets,
     struct sockaddr_storage* addr_from,
@@ -220,6 +221,29 @@ int picoquic_sendmsg(SOCKET_TYPE fd,
     const char* bytes, int length,
     int send_msg_size, int * sock_err);
 
+/* Same as picoquic_sendmsg, but if "txtime_delay" is not zero the
+ * packets are held by the kernel until "txtime_delay" microseconds
+ * from now. Requires SO_TXTIME, see picoquic_socket_set_txtime. */
+int picoquic_sendmsg_ex(SOCKET_TYPE fd,
+    struct sockaddr* addr_dest,
+    struct sockaddr* addr_from,
+    int dest_if,
+    const char* bytes, int length,
+    int send_msg_size, uint64_t txtime_delay,
+    int * sock_err);
+
+/* Send messages prepared by picoquic_prepare_next_packets through the
+ * same socket, using a single sendmmsg call per group of up to
+ * PICOQUIC_SENDMMSG_MAX messages when the system supports it. The
+ * "txtime_delay" array may be NULL. Returns the number of messages sent.
+ * If that number is lower than nb_msg, the next message could not be sent
+ * and the error is returned in sock_err.
+ */
+#define PICOQUIC_SENDMMSG_MAX 16
+
+size_t picoquic_sendmmsg(SOCKET_TYPE fd, picoquic_send_batch_t* batch, size_t nb_msg,
+    const uint64_t* txtime_delay, int* sock_err);
+
 int picoquic_send_through_socket(
     SOCKET_TYPE fd,
     struct sockaddr* addr_dest,
@@ -265,6 +289,14 @@ void picoquic_socks_cmsg_format(
     struct sockaddr* addr_from,
     int dest_if);
 
+void picoquic_socks_cmsg_format_ex(
+    void* vmsg,
+    size_t message_length,
+    size_t send_msg_size,
+    struct sockaddr* addr_from,
+    int dest_if,
+    uint64_t txtime_delay);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,7 @@
 #include "picoquic_internal.h"
 #include "picoquic_utils.h"
 #include "picoquic_unified_log.h"
+#include "sat_utils.h"
 #include "tls_api.h"
 #include <stdlib.h>
 #include <string.h>
@@ -839,6 +840,41 @@ void picoquic_set_max_data_control(picoquic_quic_t* quic, uint64_t max_data)
     }
 }
 
+void picoquic_set_memory_limits(picoquic_quic_t* quic, uint64_t cnx_memory_max, uint64_t quic_memory_max)
+{
+    quic->cnx_memory_max = cnx_memory_max;
+    quic->memory_max = quic_memory_max;
+}
+
+uint64_t picoquic_get_cnx_memory_used(picoquic_cnx_t* cnx)
+{
+    return cnx->memory_used;
+}
+
+uint64_t picoquic_get_quic_memory_used(picoquic_quic_t* quic)
+{
+    return quic->memory_used;
+}
+
+void picoquic_memory_allocated(picoquic_cnx_t* cnx, size_t size)
+{
+    cnx->memory_used += size;
+    cnx->quic->memory_used += size;
+}
+
+void picoquic_memory_released(picoquic_cnx_t* cnx, size_t size)
+{
+    cnx->memory_used = (cnx->memory_used > size) ? cnx->memory_used - size : 0;
+    cnx->quic->memory_used = (cnx->quic->memory_used > size) ? cnx->quic->memory_used - size : 0;
+}
+
+/* When the budget is exceeded, flow control credit is withheld until memory is released */
+int picoquic_is_memory_constrained(picoquic_cnx_t* cnx)
+{
+    return ((cnx->quic->cnx_memory_max != 0 && cnx->memory_used >= cnx->quic->cnx_memory_max) ||
+        (cnx->quic->memory_max != 0 && cnx->quic->memory_used >= cnx->quic->memory_max));
+}
+
 void picoquic_set_default_idle_timeout(picoquic_quic_t* quic, uint64_t idle_timeout_ms)
 {
     quic->default_tp.max_idle_timeout = idle_timeout_ms;
@@ -893,11 +929,82 @@ uint32_t picoquic_get_max_simultaneous_logs(picoquic_quic_t* quic)
     return quic->max_simultaneous_logs;
 }
 
+void picoquic_set_log_sampling(picoquic_quic_t* quic, uint32_t cnx_sample_rate, uint32_t packet_sample_rate)
+{
+    quic->log_cnx_sample_rate = cnx_sample_rate;
+    quic->log_packet_sample_rate = packet_sample_rate;
+}
+
+void picoquic_set_log_trigger_window(picoquic_quic_t* quic, uint32_t trigger_events, uint64_t window_usec)
+{
+    quic->log_trigger_events = trigger_events;
+    quic->log_trigger_window = window_usec;
+}
+
+void picoquic_open_log_window(picoquic_cnx_t* cnx, uint64_t current_time)
+{
+    if (current_time + cnx->quic->log_trigger_window > cnx->log_window_end) {
+        cnx->log_window_end = current_time + cnx->quic->log_trigger_window;
+    }
+}
+
+void picoquic_log_trigger_event(picoquic_cnx_t* cnx, uint32_t trigger_event, uint64_t current_time)
+{
+    if ((cnx->quic->log_trigger_events & trigger_event) != 0) {
+        picoquic_open_log_window(cnx, current_time);
+    }
+}
+
+/* The connection hash used for the hash tables is not well mixed, so we
+ * apply the 64 bit finalizer of MurmurHash3 before sampling. */
+int picoquic_is_cnx_selected_for_log(picoquic_quic_t* quic, const picoquic_connection_id_t* initial_cnxid)
+{
+    int is_selected = 1;
+
+    if (quic->log_cnx_sample_rate > 1) {
+        uint64_t h = picoquic_connection_id_hash(initial_cnxid);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        is_selected = (h % quic->log_cnx_sample_rate) == 0;
+    }
+
+    return is_selected;
+}
+
+/* Packet events are selected by packet number if there is one, so that
+ * all the events relative to a packet are kept together, or by counting
+ * the events otherwise. */
+int picoquic_is_packet_selected_for_log(picoquic_cnx_t* cnx, uint64_t sequence_number, uint64_t current_time)
+{
+    int is_selected = 1;
+    uint32_t rate = cnx->quic->log_packet_sample_rate;
+
+    if (rate > 1 && current_time >= cnx->log_window_end) {
+        if (sequence_number == UINT64_MAX) {
+            sequence_number = cnx->nb_log_sample_events++;
+        }
+        is_selected = (sequence_number % rate) == 0;
+        if (!is_selected && (cnx->quic->log_trigger_events & PICOQUIC_LOG_TRIGGER_HANDOVER) != 0) {
+            is_selected = picoquic_handover_distance(current_time) <= cnx->quic->log_trigger_window / 2;
+        }
+    }
+
+    return is_selected;
+}
+
 void picoquic_set_default_bdp_frame_option(picoquic_quic_t* quic, int bdp_option)
 {
     quic->default_send_receive_bdp_frame = bdp_option;
 }
 
+void picoquic_set_default_fec_option(picoquic_quic_t* quic, int enable_fec)
+{
+    quic->default_fec_option = (enable_fec) ? 1 : 0;
+}
+
 void picoquic_free(picoquic_quic_t* quic)
 {
     if (quic != NULL) {
@@ -909,6 +1016,31 @@ void picoquic_free(picoquic_quic_t* quic)
             picoquic_delete_cnx(quic->cnx_list);
         }
 
+        /* Stop the crypto offload thread, if any */
+        if (quic->crypto_offload != NULL) {
+            picoquic_crypto_offload_delete(quic->crypto_offload);
+            quic->crypto_offload = NULL;
+        }
+
+        /* Stop the binary log writer thread, after all logs are closed */
+        if (quic->binlog_async != NULL) {
+            picoquic_binlog_async_delete(quic->binlog_async);
+            quic->binlog_async = NULL;
+        }
+
+        /* Stop the metrics export thread, if any */
+        if (quic->live_metrics != NULL) {
+            picoquic_metrics_delete(quic->live_metrics);
+            quic->live_metrics = NULL;
+        }
+
+        if (quic->latency_hist != NULL) {
+            free(quic->latency_hist);
+            quic->latency_hist = NULL;
+        }
+
+        (void)picoquic_set_experiment_arms(quic, NULL, 0, 0);
+
         /* Delete TLS and AEAD cntexts */
         picoquic_delete_retry_protection_contexts(quic);
 
@@ -1086,7 +1218,7 @@ picoquic_stateless_packet_t* picoquic_dequeue_stateless_packet(picoquic_quic_t*
 
 int picoquic_cnx_is_still_logging(picoquic_cnx_t* cnx)
 {
-    int ret =
+    int ret = !cnx->is_log_sampled_out &&
         (cnx->nb_packets_logged < PICOQUIC_LOG_PACKET_MAX_SEQUENCE || cnx->quic->use_long_log);
 
     return ret;
@@ -1242,6 +1374,7 @@ void picoquic_init_transport_parameters(picoquic_tp_t* tp, int client_mode)
     tp->min_ack_delay = PICOQUIC_ACK_DELAY_MIN;
     tp->enable_time_stamp = 0;
     tp->enable_bdp_frame = 0;
+    tp->enable_fec = 0;
 }
 
 
@@ -1584,6 +1717,14 @@ static void picoquic_clear_path_data(picoquic_cnx_t* cnx, picoquic_path_t * path
         cnx->congestion_alg->alg_delete(path_x);
     }
 
+    if (path_x->latency_hist != NULL) {
+        free(path_x->latency_hist);
+    }
+
+    if (path_x->cc_telemetry != NULL) {
+        free(path_x->cc_telemetry);
+    }
+
     /* Free the record */
     free(path_x);
 }
@@ -2259,6 +2400,10 @@ static void picoquic_get_path_quality_from_context(picoquic_path_t* path_x, pico
     quality->max_reorder_delay = path_x->max_reorder_delay;
     quality->max_reorder_gap = path_x->max_reorder_gap;
     quality->bytes_in_transit = path_x->bytes_in_transit;
+    quality->reorder_buffer_bytes = path_x->cnx->reorder_buffer_bytes;
+    quality->reorder_buffer_max = path_x->cnx->reorder_buffer_max;
+    quality->hol_stalls = path_x->cnx->nb_hol_stalls;
+    quality->hol_stall_time = path_x->cnx->hol_stall_time;
 }
 
 int picoquic_get_path_quality(picoquic_cnx_t* cnx, uint64_t unique_path_id, picoquic_path_quality_t* quality)
@@ -2938,6 +3083,107 @@ static void * picoquic_stream_node_value(picosplay_node_t * node)
     return (void*)((char*)node - offsetof(struct st_picoquic_stream_head_t, stream_node));
 }
 
+/* Update the memory accounted for the out of order data nodes of a stream,
+ * and the reordering statistics of the connection. The bytes waiting in the
+ * reassembly buffer are the bytes of the chunks received above the consumed
+ * offset; the gaps between chunks are not counted. That count is kept up to
+ * date in stream->reorder_bytes as chunks are queued, delivered or dropped,
+ * so this function only applies the difference since the last call. The
+ * stream is stalled as long as that buffer is not empty, i.e., data was
+ * received but cannot be delivered to the application.
+ */
+void picoquic_stream_data_nodes_account(picoquic_stream_head_t* stream, uint64_t current_time)
+{
+    picoquic_cnx_t* cnx = stream->cnx;
+    int nb_nodes = stream->stream_data_tree.size;
+    uint64_t reorder_bytes = stream->reorder_bytes;
+
+    if (nb_nodes > stream->nb_data_nodes_accounted) {
+        picoquic_memory_allocated(stream->cnx,
+            (size_t)(nb_nodes - stream->nb_data_nodes_accounted) * sizeof(picoquic_stream_data_node_t));
+    }
+    else if (nb_nodes < stream->nb_data_nodes_accounted) {
+        picoquic_memory_released(stream->cnx,
+            (size_t)(stream->nb_data_nodes_accounted - nb_nodes) * sizeof(picoquic_stream_data_node_t));
+    }
+    stream->nb_data_nodes_accounted = nb_nodes;
+
+    /* Streams that are not attached to a connection are not accounted */
+    if (cnx != NULL) {
+        cnx->reorder_buffer_bytes = cnx->reorder_buffer_bytes + reorder_bytes - stream->reorder_bytes_accounted;
+        stream->reorder_bytes_accounted = reorder_bytes;
+        if (cnx->reorder_buffer_bytes > cnx->reorder_buffer_max) {
+            cnx->reorder_buffer_max = cnx->reorder_buffer_bytes;
+        }
+        if (reorder_bytes > 0 && !stream->is_hol_stalled) {
+            stream->is_hol_stalled = 1;
+            stream->hol_stall_start = current_time;
+            cnx->nb_hol_stalls++;
+        }
+        else if (reorder_bytes == 0 && stream->is_hol_stalled) {
+            stream->is_hol_stalled = 0;
+            if (current_time > stream->hol_stall_start) {
+                cnx->hol_stall_time += current_time - stream->hol_stall_start;
+            }
+        }
+    }
+}
+
+/* Free a queued data segment. If the bytes are owned by the application,
+ * call the release function instead of freeing them.
+ */
+void picoquic_stream_queue_node_free(picoquic_stream_head_t* stream, picoquic_stream_queue_node_t* stream_data)
+{
+    if (stream_data->memory_accounted > 0) {
+        picoquic_memory_released(stream->cnx, stream_data->memory_accounted);
+    }
+    if (stream_data->release_fn != NULL) {
+        stream_data->release_fn(stream->cnx, stream->stream_id, stream_data->bytes, stream_data->length, stream_data->release_ctx);
+    }
+    else if (stream_data->F != NULL) {
+        stream_data->F = picoquic_file_close(stream_data->F);
+    }
+    else if (stream_data->bytes != NULL) {
+        free(stream_data->bytes);
+    }
+    free(stream_data);
+}
+
+/* Called when all the bytes in a queued segment have been copied into
+ * packets. Segments owned by the application are kept in the release queue
+ * until the peer has acknowledged them, other segments are freed.
+ */
+void picoquic_stream_queue_node_sent(picoquic_stream_head_t* stream, picoquic_stream_queue_node_t* stream_data)
+{
+    if (stream_data->release_fn == NULL) {
+        picoquic_stream_queue_node_free(stream, stream_data);
+    }
+    else {
+        stream_data->next_stream_data = NULL;
+        if (stream->release_queue_last == NULL) {
+            stream->release_queue = stream_data;
+        }
+        else {
+            stream->release_queue_last->next_stream_data = stream_data;
+        }
+        stream->release_queue_last = stream_data;
+    }
+}
+
+/* Release the application owned segments once all their bytes are acknowledged */
+void picoquic_stream_release_acked_data(picoquic_stream_head_t* stream)
+{
+    while (stream->release_queue != NULL &&
+        picoquic_check_sack_list(&stream->sack_list, 0, stream->release_queue->stream_offset_end - 1) != 0) {
+        picoquic_stream_queue_node_t* next = stream->release_queue->next_stream_data;
+        picoquic_stream_queue_node_free(stream, stream->release_queue);
+        stream->release_queue = next;
+    }
+    if (stream->release_queue == NULL) {
+        stream->release_queue_last = NULL;
+    }
+}
+
 void picoquic_clear_stream(picoquic_stream_head_t* stream)
 {
     picoquic_stream_queue_node_t* ready = stream->send_queue;
@@ -2945,16 +3191,22 @@ void picoquic_clear_stream(picoquic_stream_head_t* stream)
 
     while ((next = ready) != NULL) {
         ready = next->next_stream_data;
-        if (next->bytes != NULL) {
-            free(next->bytes);
-        }
-        free(next);
+        picoquic_stream_queue_node_free(stream, next);
     }
     stream->send_queue = NULL;
+    ready = stream->release_queue;
+    while ((next = ready) != NULL) {
+        ready = next->next_stream_data;
+        picoquic_stream_queue_node_free(stream, next);
+    }
+    stream->release_queue = NULL;
+    stream->release_queue_last = NULL;
     if (stream->is_output_stream) {
         picoquic_remove_output_stream(stream->cnx, stream);
     }
     picosplay_empty_tree(&stream->stream_data_tree);
+    stream->reorder_bytes = 0;
+    picoquic_stream_data_nodes_account(stream, (stream->cnx == NULL) ? 0 : picoquic_get_quic_time(stream->cnx->quic));
     picoquic_sack_list_free(&stream->sack_list);
 }
 
@@ -3254,12 +3506,14 @@ int picoquic_mark_direct_receive_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
             }
 
             if (ret == 0) {
+                stream->reorder_bytes -= length;
                 picosplay_delete_hint(&stream->stream_data_tree, &data->stream_data_node);
             }
             else {
                 break;
             }
         }
+        picoquic_stream_data_nodes_account(stream, picoquic_get_quic_time(cnx->quic));
 
         /* If there is a fin offset, pass it. */
         if (ret == 0 && stream->fin_received && !stream->fin_signalled) {
@@ -3602,6 +3856,7 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
         }
         cnx->initial_cnxid = initial_cnx_id;
         cnx->quic = quic;
+        cnx->is_log_sampled_out = !picoquic_is_cnx_selected_for_log(quic, &initial_cnx_id);
         cnx->pmtud_policy = quic->default_pmtud_policy;
         /* Create the connection ID number 0 */
         cnxid0 = picoquic_create_local_cnxid(cnx, 0, NULL, start_time);
@@ -3645,6 +3900,8 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
     }
 
     if (cnx != NULL) {
+        const picoquic_experiment_arm_t* arm;
+
         memcpy(&cnx->local_parameters, &quic->default_tp, sizeof(picoquic_tp_t));
         /* If the default parameters include preferred address, document it */
         if (cnx->local_parameters.prefered_address.is_defined) {
@@ -3677,6 +3934,11 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
            /* Accept and send BDP extension frame */
             cnx->local_parameters.enable_bdp_frame = 1;
         }
+
+        /* Propose FEC if enabled in the context */
+        if (quic->default_fec_option) {
+            cnx->local_parameters.enable_fec = 1;
+        }
  
         /* Initialize local flow control variables to advertised values */
         cnx->maxdata_local = ((uint64_t)cnx->local_parameters.initial_max_data);
@@ -3715,7 +3977,10 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
         cnx->callback_fn = quic->default_callback_fn;
         cnx->callback_ctx = quic->default_callback_ctx;
         cnx->congestion_alg = quic->default_congestion_alg;
+        cnx->path_scheduler = quic->default_path_scheduler;
         cnx->is_preemptive_repeat_enabled = quic->is_preemptive_repeat_enabled;
+        cnx->is_selective_repeat_enabled = quic->is_selective_repeat_enabled;
+        cnx->selective_repeat_budget = quic->selective_repeat_budget;
 
         /* Initialize key rotation interval to default value */
         cnx->crypto_epoch_length_max = quic->crypto_epoch_length_max;
@@ -3824,9 +4089,13 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
         picosplay_init_tree(&cnx->stream_tree, picoquic_stream_node_compare, picoquic_stream_node_create, picoquic_stream_node_delete, picoquic_stream_node_value);
 
         cnx->congestion_alg = cnx->quic->default_congestion_alg;
+        arm = picoquic_experiment_assign(cnx);
         if (cnx->congestion_alg != NULL) {
             cnx->congestion_alg->alg_init(cnx, cnx->path[0], start_time);
         }
+        if (arm != NULL && arm->initial_cwin > 0) {
+            cnx->path[0]->cwin = arm->initial_cwin;
+        }
     }
 
     /* Only initialize TLS after all parameters have been set */
@@ -3856,6 +4125,10 @@ picoquic_cnx_t* picoquic_create_cnx(picoquic_quic_t* quic,
         picoquic_crypto_random(quic, &cnx->log_unique, sizeof(cnx->log_unique));
     }
 
+    if (cnx != NULL && quic->path_cache != NULL && addr_to != NULL) {
+        picoquic_path_cache_seed_cnx(cnx, addr_to, start_time);
+    }
+
     if (cnx != NULL && !cnx->client_mode) {
         picoquic_log_new_connection(cnx);
     }
@@ -4137,6 +4410,16 @@ void picoquic_set_packet_train_mode(picoquic_quic_t* quic, int train_mode)
     quic->packet_train_mode = (train_mode > 0) ? 1 : 0;
 }
 
+void picoquic_set_txtime_pacing(picoquic_quic_t* quic, uint64_t horizon_usec)
+{
+    quic->txtime_horizon = horizon_usec;
+}
+
+uint64_t picoquic_get_txtime(picoquic_cnx_t* cnx)
+{
+    return cnx->txtime_departure;
+}
+
 void picoquic_set_padding_policy(picoquic_quic_t* quic, uint32_t padding_min_size, uint32_t padding_multiple)
 {
     quic->padding_minsize_default = padding_min_size;
@@ -4298,7 +4581,11 @@ void picoquic_delete_misc_or_dg(picoquic_misc_frame_header_t** first, picoquic_m
 void picoquic_clear_ack_ctx(picoquic_ack_context_t* ack_ctx)
 {
     picoquic_sack_list_free(&ack_ctx->sack_list);
-
+    if (ack_ctx->ack_cache != NULL) {
+        free(ack_ctx->ack_cache);
+        ack_ctx->ack_cache = NULL;
+    }
+    picoquic_fec_ctx_delete(&ack_ctx->fec_ctx);
 }
 
 
@@ -4326,6 +4613,7 @@ void picoquic_reset_packet_context(picoquic_cnx_t* cnx,
     }
 
     pkt_ctx->retransmitted_oldest = NULL;
+    picoquic_fec_ctx_delete(&pkt_ctx->fec_ctx);
 
     /* Reset the ECN data */
     pkt_ctx->ecn_ect0_total_remote = 0;
@@ -4490,6 +4778,14 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
 
         picoquic_log_close_connection(cnx);
 
+        if (cnx->quic->live_metrics != NULL) {
+            picoquic_metrics_release(cnx);
+        }
+
+        if (cnx->quic->path_cache != NULL) {
+            picoquic_path_cache_record_cnx(cnx, picoquic_get_quic_time(cnx->quic));
+        }
+
         if (cnx->is_half_open && cnx->quic->current_number_half_open > 0) {
             cnx->quic->current_number_half_open--;
             cnx->is_half_open = 0;
@@ -4570,6 +4866,9 @@ void picoquic_delete_cnx(picoquic_cnx_t* cnx)
 
         picoquic_unregister_net_icid(cnx);
 
+        /* Whatever was not released with the queues is no longer used */
+        picoquic_memory_released(cnx, (size_t)cnx->memory_used);
+
         free(cnx);
     }
 }
@@ -4710,7 +5009,7 @@ picoquic_congestion_algorithm_t const* picoquic_get_congestion_algorithm(char co
             alg = picoquic_bbr1_algorithm;
         }
         else {
-            alg = NULL;
+            alg = picoquic_cc_plugin_find(alg_name);
         }
     }
     return alg;
@@ -4748,6 +5047,24 @@ void picoquic_set_preemptive_repeat_per_cnx(picoquic_cnx_t* cnx, int do_repeat)
     cnx->is_preemptive_repeat_enabled = (do_repeat) ? 1 : 0;
 }
 
+void picoquic_set_selective_repeat_policy(picoquic_quic_t* quic, int is_selective, uint32_t budget_permille)
+{
+    quic->is_selective_repeat_enabled = (is_selective) ? 1 : 0;
+    quic->selective_repeat_budget = (budget_permille == 0) ? PICOQUIC_SELECTIVE_REPEAT_BUDGET_DEFAULT : budget_permille;
+    if (is_selective) {
+        quic->is_preemptive_repeat_enabled = 1;
+    }
+}
+
+void picoquic_set_selective_repeat_per_cnx(picoquic_cnx_t* cnx, int is_selective, uint32_t budget_permille)
+{
+    cnx->is_selective_repeat_enabled = (is_selective) ? 1 : 0;
+    cnx->selective_repeat_budget = (budget_permille == 0) ? PICOQUIC_SELECTIVE_REPEAT_BUDGET_DEFAULT : budget_permille;
+    if (is_selective) {
+        cnx->is_preemptive_repeat_enabled = 1;
+    }
+}
+
 void picoquic_set_congestion_algorithm(picoquic_cnx_t* cnx, picoquic_congestion_algorithm_t const* alg)
 {
     if (cnx->congestion_alg != NULL) {
@@ -101,6 +101,7 @@ int picoquic_sack_insert_item(picoquic_sack_list_t* sack_list, uint64_t range_mi
         sack_new->time_created = current_time;
         sack_list->rc[0].range_counts[0] += 1;
         sack_list->rc[1].range_counts[0] += 1;
+        sack_list->change_count++;
         (void)picosplay_insert(&sack_list->ack_tree, sack_new);
     }
 
@@ -114,6 +115,7 @@ void picoquic_sack_delete_item(picoquic_sack_list_t* sack_list, picoquic_sack_it
             sack_list->rc[r].range_counts[sack->nb_times_sent[r]] -= 1;
         }
     }
+    sack_list->change_count++;
     /* Delete the item in the splay */
     picosplay_delete_hint(&sack_list->ack_tree, &sack->node);
 }
@@ -377,6 +379,7 @@ picoquic_sack_item_t* picoquic_process_ack_of_ack_range(picoquic_sack_list_t* sa
                         previous->nb_times_sent[r] = PICOQUIC_MAX_ACK_RANGE_REPEAT;
                     }
                 }
+                sack_list->change_count++;
             } else {
                 picoquic_sack_delete_item(sack_list, previous);
             }
@@ -458,6 +461,7 @@ int picoquic_sack_list_reset(picoquic_sack_list_t* sack_list, uint64_t range_min
 void picoquic_sack_list_free(picoquic_sack_list_t* sack_list)
 {
     picosplay_empty_tree(&sack_list->ack_tree);
+    sack_list->change_count++;
     for (int r = 0; r < 2; r++) {
         memset(sack_list->rc[r].range_counts, 0, sizeof(sack_list->rc[r].range_counts));
     }
@@ -493,6 +497,10 @@ void picoquic_sack_item_record_sent(picoquic_sack_list_t* sack_list, picoquic_sa
 
 void picoquic_sack_item_record_reset(picoquic_sack_list_t* sack_list, picoquic_sack_item_t* sack_item)
 {
+    /* Extending the last range does not change the ranges encoded after it in ACK frames */
+    if (picoquic_sack_next_item(sack_item) != NULL) {
+        sack_list->change_count++;
+    }
     for (int r = 0; r < 2; r++) {
         if (sack_item->nb_times_sent[r] < PICOQUIC_MAX_ACK_RANGE_REPEAT) {
             sack_list->rc[r].range_counts[sack_item->nb_times_sent[r]] -= 1;
@@ -20,6 +20,22 @@ bool picoquic_check_handover(uint64_t ts)
     return false;
 }
 
+// Distance in microseconds between ts and the closest scheduled handover
+uint64_t picoquic_handover_distance(uint64_t ts)
+{
+    const int64_t usecond = ts % s_to_us(60);
+    uint64_t distance = UINT64_MAX;
+
+    for (size_t i = 0; i < SL_HANDOVER_COUNT; ++i) {
+        for (int64_t minute = -1; minute <= 1; ++minute) {
+            int64_t delta = s_to_us(SL_HANDOVER_INTERVALS[i]) + minute * s_to_us(60) - usecond;
+            uint64_t d = (delta < 0) ? (uint64_t)(-delta) : (uint64_t)delta;
+            if (d < distance) distance = d;
+        }
+    }
+
+    return distance;
+}
 
 // TODO: Reconfigure to use a reference time and current_time
 bool picoquic_check_handover_now()
@@ -13,5 +13,6 @@
 
 bool picoquic_check_handover(uint64_t);
 bool picoquic_check_handover_now();
+uint64_t picoquic_handover_distance(uint64_t);
 
 #endif //SAT_UTILS_H
\ No newline at end of file
@@ -22,6 +22,7 @@
 #include "picoquic_internal.h"
 #include "picoquic_unified_log.h"
 #include "tls_api.h"
+#include "sat_utils.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -208,8 +209,12 @@ int picoquic_mark_high_priority_stream(picoquic_cnx_t * cnx, uint64_t stream_id,
     return ret;
 }
 
-int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
-    const uint8_t* data, size_t length, int set_fin, void * app_stream_ctx)
+/* Queue data on a stream. The data is either copied, passed by reference
+ * if release_fn is set, or read from the file F when the stream frames are
+ * formatted. Copying bytes from a NULL pointer is rejected as an error. */
+static int picoquic_add_to_stream_ex(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin, void* app_stream_ctx,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx, FILE* F, uint64_t file_offset)
 {
     int ret = 0;
     picoquic_stream_head_t* stream = picoquic_find_stream_for_writing(cnx, stream_id, &ret);
@@ -236,27 +241,58 @@ int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
         if (stream_data == 0) {
             ret = -1;
         } else {
-            stream_data->bytes = (uint8_t*)malloc(length);
+            memset(stream_data, 0, sizeof(picoquic_stream_queue_node_t));
+            if (F != NULL) {
+                /* The bytes are read from the file when the stream frames are formatted */
+                stream_data->F = F;
+                stream_data->file_offset = file_offset;
+                stream_data->readahead_offset = file_offset;
+                stream_data->memory_accounted = sizeof(picoquic_stream_queue_node_t);
+            }
+            else if (release_fn != NULL) {
+                /* The application keeps ownership of the bytes until they are acknowledged */
+                stream_data->bytes = (uint8_t*)data;
+                stream_data->release_fn = release_fn;
+                stream_data->release_ctx = release_ctx;
+                stream_data->memory_accounted = sizeof(picoquic_stream_queue_node_t);
+            }
+            else if (data != NULL) {
+                /* The bytes are copied, the application can reuse its buffer */
+                stream_data->bytes = (uint8_t*)malloc(length);
+                if (stream_data->bytes != NULL) {
+                    memcpy(stream_data->bytes, data, length);
+                }
+                stream_data->memory_accounted = sizeof(picoquic_stream_queue_node_t) + length;
+            }
 
-            if (stream_data->bytes == NULL) {
+            if (stream_data->bytes == NULL && F == NULL) {
                 free(stream_data);
                 stream_data = NULL;
                 ret = -1;
             } else {
                 picoquic_stream_queue_node_t** pprevious = &stream->send_queue;
                 picoquic_stream_queue_node_t* next = stream->send_queue;
+                uint64_t end_offset = stream->sent_offset + length;
 
-                memcpy(stream_data->bytes, data, length);
                 stream_data->length = length;
                 stream_data->offset = 0;
                 stream_data->next_stream_data = NULL;
 
                 while (next != NULL) {
+                    end_offset += next->length - next->offset;
                     pprevious = &next->next_stream_data;
                     next = next->next_stream_data;
                 }
 
+                if (cnx->quic->latency_hist != NULL && !stream->is_delivery_probe_set) {
+                    /* Track the last byte of the segment, or the FIN mark if set */
+                    stream->is_delivery_probe_set = 1;
+                    stream->delivery_probe_offset = (set_fin) ? end_offset : end_offset - 1;
+                    stream->delivery_probe_time = picoquic_get_quic_time(cnx->quic);
+                }
+
                 *pprevious = stream_data;
+                picoquic_memory_allocated(cnx, stream_data->memory_accounted);
             }
         }
 
@@ -272,6 +308,46 @@ int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
     return ret;
 }
 
+int picoquic_add_to_stream_with_ctx(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin, void * app_stream_ctx)
+{
+    return picoquic_add_to_stream_ex(cnx, stream_id, data, length, set_fin, app_stream_ctx, NULL, NULL, NULL, 0);
+}
+
+int picoquic_add_to_stream_by_reference(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, int set_fin, void* app_stream_ctx,
+    picoquic_stream_data_release_fn release_fn, void* release_ctx)
+{
+    int ret = 0;
+
+    if (release_fn == NULL || (length > 0 && data == NULL)) {
+        ret = PICOQUIC_ERROR_UNEXPECTED_ERROR;
+    }
+    else {
+        ret = picoquic_add_to_stream_ex(cnx, stream_id, data, length, set_fin, app_stream_ctx, release_fn, release_ctx, NULL, 0);
+    }
+
+    return ret;
+}
+
+int picoquic_add_file_to_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
+    FILE* F, uint64_t file_offset, uint64_t length, int set_fin, void* app_stream_ctx)
+{
+    int ret = 0;
+
+    if (F == NULL || length > (uint64_t)SIZE_MAX) {
+        ret = PICOQUIC_ERROR_UNEXPECTED_ERROR;
+    }
+    else {
+        ret = picoquic_add_to_stream_ex(cnx, stream_id, NULL, (size_t)length, set_fin, app_stream_ctx, NULL, NULL, F, file_offset);
+        if (ret == 0 && length == 0) {
+            (void)picoquic_file_close(F);
+        }
+    }
+
+    return ret;
+}
+
 int picoquic_add_to_stream(picoquic_cnx_t* cnx, uint64_t stream_id,
     const uint8_t* data, size_t length, int set_fin)
 {
@@ -827,6 +903,25 @@ void picoquic_protect_packet_header(uint8_t * send_buffer, size_t pn_offset, uin
     }
 }
 
+/* Encrypt in place the payload of a packet prepared for the crypto
+ * offload thread, then apply header protection.
+ */
+void picoquic_protect_job_execute(picoquic_protect_job_t* job)
+{
+    uint8_t* payload = job->send_buffer + job->h_length;
+
+    if (job->is_multipath) {
+        (void)picoquic_aead_encrypt_mp(payload, payload, job->payload_length, job->unique_path_id,
+            job->sequence_number, job->send_buffer, job->h_length, job->aead_context);
+    }
+    else {
+        (void)picoquic_aead_encrypt_generic(payload, payload, job->payload_length,
+            job->sequence_number, job->send_buffer, job->h_length, job->aead_context);
+    }
+
+    picoquic_protect_packet_header(job->send_buffer, job->pn_offset, job->first_mask, job->pn_enc);
+}
+
 static size_t picoquic_protect_packet(picoquic_cnx_t* cnx, 
     picoquic_packet_type_enum ptype,
     uint8_t * bytes, 
@@ -888,6 +983,34 @@ static size_t picoquic_protect_packet(picoquic_cnx_t* cnx,
         }
     }
 
+    if (ptype == picoquic_packet_1rtt_protected && cnx->is_crypto_offload_active) {
+        /* Copy the clear text after the header, log the packet, and let the
+         * offload thread encrypt it in place and protect the header. */
+        picoquic_protect_job_t job;
+
+        job.send_buffer = send_buffer;
+        job.h_length = h_length;
+        job.payload_length = length - header_length;
+        job.pn_offset = pn_offset;
+        job.sequence_number = sequence_number;
+        job.unique_path_id = path_x->unique_path_id;
+        job.aead_context = aead_context;
+        job.pn_enc = pn_enc;
+        job.first_mask = first_mask;
+        job.is_multipath = cnx->is_multipath_enabled;
+
+        memmove(send_buffer + h_length, bytes + header_length, job.payload_length);
+        send_length = h_length + job.payload_length + aead_checksum_length;
+
+        picoquic_log_outgoing_packet(cnx, path_x,
+            bytes, sequence_number, pn_length, length,
+            send_buffer, send_length, current_time);
+
+        picoquic_crypto_offload_submit(cnx->quic->crypto_offload, &job);
+
+        return send_length;
+    }
+
     /* Encrypt the packet */
     if (cnx->is_multipath_enabled && ptype == picoquic_packet_1rtt_protected) {
         send_length = picoquic_aead_encrypt_mp(send_buffer + /* header_length */ h_length,
@@ -940,6 +1063,7 @@ void picoquic_queue_for_retransmit(picoquic_cnx_t* cnx, picoquic_path_t * path_x
     }
     pkt_ctx->pending_last = packet;
     packet->is_queued_for_retransmit = 1;
+    picoquic_memory_allocated(cnx, sizeof(picoquic_packet_t));
 
     /* Add at last position of packet per path list
      */
@@ -976,6 +1100,7 @@ picoquic_packet_t* picoquic_dequeue_retransmit_packet(picoquic_cnx_t* cnx,
             p->packet_previous->packet_next = p->packet_next;
         }
         p->is_queued_for_retransmit = 0;
+        picoquic_memory_released(cnx, sizeof(picoquic_packet_t));
     }
 
     /* Account for bytes in transit, for congestion control */
@@ -1256,13 +1381,18 @@ int picoquic_is_cnx_backlog_empty(picoquic_cnx_t* cnx)
  * could be repeated, e.g., because of packet size, then the old packet
  * must not be marked as preemptively repeated, because otherwise these
  * non-repeated frames would be lost forever.
+ *
+ * If is_forced is set, e.g., for redundant path scheduling or before a
+ * handover, the packet is repeated even if it does not contain a frame
+ * triggering preemptive repeat.
  */
 static int picoquic_preemptive_retransmit_packet(picoquic_packet_t* old_p,
     picoquic_cnx_t* cnx,
     uint8_t* new_bytes,
     size_t send_buffer_max_minus_checksum,
     size_t* length,
-    int * has_data)
+    int * has_data,
+    int is_forced)
 {
     /* check if this is an ACK only packet */
     int ret = 0;
@@ -1321,7 +1451,7 @@ static int picoquic_preemptive_retransmit_packet(picoquic_packet_t* old_p,
     }
 
     if (*has_data) {
-        if (!is_preemptive_needed) {
+        if (!is_preemptive_needed && !is_forced) {
             /* If the packet does not contain any frame requiring preemptive repeat, do not repeat it. */
             *length = initial_length;
             *has_data = 0;
@@ -1334,8 +1464,74 @@ static int picoquic_preemptive_retransmit_packet(picoquic_packet_t* old_p,
     return ret;
 }
 
+/* Loss rate of the path, in per mille of the bytes sent. The estimate is
+ * smoothed over intervals of PICOQUIC_LOSS_ESTIMATE_INTERVAL bytes. Before
+ * the end of the first interval, the loss rate since the beginning of the
+ * path is used, so that short connections get an estimate as well. */
+static uint64_t picoquic_path_loss_estimate(picoquic_path_t* path_x)
+{
+    uint64_t nb_sent = path_x->bytes_sent - path_x->loss_estimate_sent_prior;
+    uint64_t nb_lost = (path_x->total_bytes_lost > path_x->loss_estimate_lost_prior) ?
+        path_x->total_bytes_lost - path_x->loss_estimate_lost_prior : 0;
+    uint64_t loss = 0;
+
+    if (nb_sent > 0) {
+        loss = (nb_lost >= nb_sent) ? 1000 : (nb_lost * 1000) / nb_sent;
+    }
+    if (nb_sent >= PICOQUIC_LOSS_ESTIMATE_INTERVAL) {
+        path_x->loss_permille = (path_x->loss_estimate_sent_prior == 0) ? loss :
+            (7 * path_x->loss_permille + loss) / 8;
+        path_x->loss_estimate_sent_prior = path_x->bytes_sent;
+        path_x->loss_estimate_lost_prior = path_x->total_bytes_lost;
+    }
+    else if (path_x->loss_estimate_sent_prior == 0) {
+        path_x->loss_permille = loss;
+    }
+
+    return path_x->loss_permille;
+}
+
+/* Check whether the selective repeat budget allows repeating length more bytes */
+static int picoquic_selective_repeat_budget_ok(picoquic_cnx_t* cnx, size_t length)
+{
+    uint64_t bytes_sent = 0;
+
+    for (int i = 0; i < cnx->nb_paths; i++) {
+        bytes_sent += cnx->path[i]->bytes_sent;
+    }
+
+    return cnx->nb_preemptive_repeat_bytes + length <=
+        PICOQUIC_SELECTIVE_REPEAT_ALLOWANCE + (bytes_sent * cnx->selective_repeat_budget) / 1000;
+}
+
+/* In selective mode, packets sent close to a handover are repeated whatever
+ * their content, because the reconfiguration is likely to lose them. Other
+ * packets are only considered if the loss rate of their path is high enough,
+ * and then only if they carry the tail of a finished stream. */
+static int picoquic_selective_repeat_check(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
+    picoquic_packet_t* old_p, uint64_t rtt, int* is_forced)
+{
+    picoquic_path_t* send_path = (old_p->send_path == NULL) ? path_x : old_p->send_path;
+    int is_candidate = 0;
+
+    *is_forced = 0;
+    if (picoquic_selective_repeat_budget_ok(cnx, old_p->length)) {
+        if (!cnx->skip_handover_suppression &&
+            picoquic_handover_distance(old_p->send_time) <= rtt + MARGIN * 1000ull) {
+            *is_forced = 1;
+            is_candidate = 1;
+        }
+        else {
+            is_candidate = picoquic_path_loss_estimate(send_path) >= PICOQUIC_SELECTIVE_REPEAT_LOSS_MIN;
+        }
+    }
+
+    return is_candidate;
+}
+
 int picoquic_preemptive_retransmit_in_context(
     picoquic_cnx_t* cnx,
+    picoquic_path_t* path_x,
     picoquic_packet_context_t* pkt_ctx,
     uint64_t rtt,
     uint64_t current_time,
@@ -1351,8 +1547,16 @@ int picoquic_preemptive_retransmit_in_context(
      * the code just has to track the preemptive_repeat_ptr for
      * that context. If there are multiple paths, we need to consider
      * packets from every plausible path.
+     * With a redundant path scheduler, all packets sent on other paths
+     * are repeated as soon as possible, without waiting for a fraction
+     * of the RTT.
+     * In selective mode, the packets are checked once their repeat
+     * time has come, and skipped if they do not pass the check.
      */
     int ret = 0;
+    int is_redundant = cnx->path_scheduler != NULL && cnx->path_scheduler->is_redundant;
+    int is_head = 1;
+    picoquic_packet_t* old_p;
 
     /* Check that the connection is still active before adding more preemptive repeats */
     if (cnx->latest_progress_time + rtt < current_time ||
@@ -1366,18 +1570,31 @@ int picoquic_preemptive_retransmit_in_context(
     }
     /* Skip all packets that are too old to be repeated */
     while (pkt_ctx->preemptive_repeat_ptr != NULL) {
-        if (pkt_ctx->preemptive_repeat_ptr->send_time + rtt / 2 >= current_time) {
+        uint64_t max_age = rtt / 2;
+        if (is_redundant && pkt_ctx->preemptive_repeat_ptr->send_path != NULL) {
+            /* Repeat the packets until they are acknowledged on their own path */
+            max_age = pkt_ctx->preemptive_repeat_ptr->send_path->smoothed_rtt;
+        }
+        if (pkt_ctx->preemptive_repeat_ptr->send_time + max_age >= current_time) {
             break;
         }
         pkt_ctx->preemptive_repeat_ptr = pkt_ctx->preemptive_repeat_ptr->packet_next;
     }
-    /* Try to format the repeated packet */
-    while (pkt_ctx->preemptive_repeat_ptr != NULL) {
+    /* Try to format the repeated packet. In redundant mode, the packets sent
+     * on this path are left to the other paths: the head of the repeat list
+     * stays on the first of them. */
+    old_p = pkt_ctx->preemptive_repeat_ptr;
+    while (old_p != NULL) {
         uint64_t early_delay = (rtt > 8 * PICOQUIC_ACK_DELAY_MAX) ? rtt / 8 : PICOQUIC_ACK_DELAY_MAX;
-        uint64_t early_time = pkt_ctx->preemptive_repeat_ptr->send_time + early_delay;
+        uint64_t early_time = (is_redundant) ? old_p->send_time : old_p->send_time + early_delay;
+
+        if (!old_p->was_preemptively_repeated) {
+            int is_forced = is_redundant;
 
-        if (!pkt_ctx->preemptive_repeat_ptr->was_preemptively_repeated) {
-            if (early_time > current_time) {
+            if (is_redundant && old_p->send_path == path_x) {
+                is_head = 0;
+            }
+            else if (early_time > current_time) {
                 /* Wait until the next repeat */
                 if (*next_wake_time > early_time) {
                     *next_wake_time = early_time;
@@ -1385,20 +1602,29 @@ int picoquic_preemptive_retransmit_in_context(
                 }
                 break;
             }
-            if (test_only) {
-                *more_data = 1;
-                break;
-            }
-            ret = picoquic_preemptive_retransmit_packet(pkt_ctx->preemptive_repeat_ptr, cnx,
-                new_bytes, send_buffer_max_minus_checksum, length, has_data);
-            if (ret != 0) {
-                break;
+            else if (!cnx->is_selective_repeat_enabled || is_redundant ||
+                picoquic_selective_repeat_check(cnx, path_x, old_p, rtt, &is_forced)) {
+                size_t length_before = *length;
+
+                if (test_only) {
+                    *more_data = 1;
+                    break;
+                }
+                ret = picoquic_preemptive_retransmit_packet(old_p, cnx,
+                    new_bytes, send_buffer_max_minus_checksum, length, has_data, is_forced);
+                if (ret != 0) {
+                    break;
+                }
+                cnx->nb_preemptive_repeat_bytes += *length - length_before;
             }
         }
-        pkt_ctx->preemptive_repeat_ptr = pkt_ctx->preemptive_repeat_ptr->packet_next;
+        old_p = old_p->packet_next;
+        if (is_head) {
+            pkt_ctx->preemptive_repeat_ptr = old_p;
+        }
         if (*has_data) {
             cnx->nb_preemptive_repeat++;
-            if (pkt_ctx->preemptive_repeat_ptr != NULL) {
+            if (old_p != NULL) {
                 *more_data = 1;
             }
             break;
@@ -1435,9 +1661,13 @@ int picoquic_preemptive_retransmit_as_needed(
     if (pc == picoquic_packet_context_application &&
         cnx->is_multipath_enabled) {
         for (int i = 0; i < cnx->nb_paths; i++) {
+            if (cnx->path[i] == path_x && cnx->path_scheduler != NULL && cnx->path_scheduler->is_redundant) {
+                /* Redundant copies are sent on other paths */
+                continue;
+            }
             pkt_ctx = &cnx->path[i]->pkt_ctx;
             ret = picoquic_preemptive_retransmit_in_context(
-                cnx, pkt_ctx, rtt, current_time, next_wake_time,
+                cnx, path_x, pkt_ctx, rtt, current_time, next_wake_time,
                 new_bytes, send_buffer_max_minus_checksum, length, &has_data, more_data, is_pure_ack == NULL);
             if (ret != 0 || has_data != 0) {
                 break;
@@ -1447,7 +1677,7 @@ int picoquic_preemptive_retransmit_as_needed(
     else {
         pkt_ctx = &cnx->pkt_ctx[pc];
         ret = picoquic_preemptive_retransmit_in_context(
-            cnx, pkt_ctx, rtt, current_time, next_wake_time,
+            cnx, path_x, pkt_ctx, rtt, current_time, next_wake_time,
             new_bytes, send_buffer_max_minus_checksum, length, &has_data, more_data, is_pure_ack == NULL);
     }
     
@@ -1768,7 +1998,7 @@ void picoquic_implicit_handshake_ack(picoquic_cnx_t* cnx, picoquic_packet_contex
             ack_state.nb_bytes_delivered_since_packet_sent = old_path->delivered - p->delivered_prior;
             ack_state.is_app_limited = 1;
 
-            cnx->congestion_alg->alg_notify(cnx, old_path,
+            picoquic_congestion_notify(cnx, old_path,
                 picoquic_congestion_notification_acknowledgement,
                 &ack_state, current_time);
         }
@@ -2861,12 +3091,12 @@ uint8_t * picoquic_prepare_path_challenge_frames(picoquic_cnx_t* cnx, picoquic_p
 
 /* sending of datagrams */
 static uint8_t* picoquic_prepare_datagram_ready(picoquic_cnx_t* cnx, picoquic_path_t * path_x, uint8_t* bytes_next, uint8_t* bytes_max,
-    int* more_data, int* is_pure_ack, int* datagram_tried_and_failed, int* datagram_sent, int * ret)
+    int* more_data, int* is_pure_ack, int* datagram_tried_and_failed, int* datagram_sent, uint64_t current_time, int * ret)
 {
     uint8_t* bytes0 = bytes_next;
 
     if (cnx->first_datagram != NULL) {
-        bytes_next = picoquic_format_first_datagram_frame(cnx, bytes_next, bytes_max, more_data, is_pure_ack);
+        bytes_next = picoquic_format_first_datagram_frame(cnx, path_x, bytes_next, bytes_max, more_data, is_pure_ack, current_time);
         *more_data |= (cnx->first_datagram != NULL);
     }
     else {
@@ -2940,6 +3170,9 @@ static uint8_t* picoquic_prepare_stream_and_datagrams(picoquic_cnx_t* cnx, picoq
     int more_data_this_round = 0;
     int is_first_round = 1;
 
+    /* Stale datagrams would only waste capacity */
+    picoquic_purge_expired_datagrams(cnx, current_time);
+
     while (bytes_next + 8 < bytes_max && *ret == 0) {
         /* Find the highest priority level for which there is something to send, then
         * format the frames to send at that level. Repeat in a loop until the
@@ -2982,7 +3215,7 @@ static uint8_t* picoquic_prepare_stream_and_datagrams(picoquic_cnx_t* cnx, picoq
             cnx->datagram_priority == current_priority &&
             (cnx->datagram_priority < stream_priority || datagram_first)) {
             bytes_next = picoquic_prepare_datagram_ready(cnx, path_x, bytes_next, bytes_max,
-                &more_data_this_round, is_pure_ack, &datagram_tried_and_failed, &datagram_sent, ret);
+                &more_data_this_round, is_pure_ack, &datagram_tried_and_failed, &datagram_sent, current_time, ret);
             something_sent = datagram_sent;
         }
 
@@ -3028,7 +3261,7 @@ static uint8_t* picoquic_prepare_stream_and_datagrams(picoquic_cnx_t* cnx, picoq
             cnx->datagram_priority <= stream_priority &&
             !datagram_first) {
             bytes_next = picoquic_prepare_datagram_ready(cnx, path_x, bytes_next, bytes_max,
-                more_data, is_pure_ack, &datagram_tried_and_failed, &datagram_sent, ret);
+                more_data, is_pure_ack, &datagram_tried_and_failed, &datagram_sent, current_time, ret);
             something_sent = datagram_sent;
         }
 
@@ -3185,7 +3418,7 @@ int picoquic_prepare_packet_almost_ready(picoquic_cnx_t* cnx, picoquic_path_t* p
                     cnx->cwin_blocked = 1;
                     path_x->last_cwin_blocked_time = current_time;
                     if (cnx->congestion_alg != NULL) {
-                        cnx->congestion_alg->alg_notify(cnx, path_x,
+                        picoquic_congestion_notify(cnx, path_x,
                             picoquic_congestion_notification_cwin_blocked,
                             &ack_state, current_time);
                     }
@@ -3374,6 +3607,11 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
         &path_x->pkt_ctx :
         &cnx->pkt_ctx[picoquic_packet_context_application];
 
+    if (cnx->is_fec_enabled) {
+        /* Leave room for the fields of the repair frame, so the packet can be protected */
+        bytes_max -= PICOQUIC_FEC_REPAIR_OVERHEAD;
+    }
+
     /* Check whether to insert a hole in the sequence of packets */
     if (pkt_ctx->send_sequence >= pkt_ctx->next_sequence_hole) {
         picoquic_insert_hole_in_send_sequence_if_needed(cnx, path_x, pkt_ctx, current_time, next_wake_time);
@@ -3404,6 +3642,10 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
     if ((cnx->nb_packets_sent - cnx->crypto_epoch_sequence >
         cnx->crypto_epoch_length_max) &&
         current_time > cnx->crypto_rotation_time_guard) {
+        if (cnx->is_crypto_offload_active) {
+            /* The rotation frees the current encryption context */
+            picoquic_crypto_offload_drain(cnx->quic->crypto_offload);
+        }
         if (picoquic_start_key_rotation(cnx) != 0) {
             picoquic_log_app_message(cnx, "Cannot start key rotation after %"PRIu64" packets",
                 cnx->pkt_ctx[picoquic_packet_context_application].send_sequence);
@@ -3479,13 +3721,13 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                     ack_sent = (bytes_next > bytes_ack);
                 }
 
-                /* if necessary, prepare the MAX STREAM frames */
-                if (ret == 0) {
+                /* if necessary, prepare the MAX STREAM frames, unless the memory budget is exhausted */
+                if (ret == 0 && !picoquic_is_memory_constrained(cnx)) {
                     bytes_next = picoquic_format_max_streams_frame_if_needed(cnx, bytes_next, bytes_max, &more_data, &is_pure_ack);
                 }
 
                 /* If necessary, encode the max data frame */
-                if (ret == 0){
+                if (ret == 0 && !picoquic_is_memory_constrained(cnx)) {
                     if (cnx->quic->max_data_limit != 0) {
                         if (cnx->data_received + ((3 * cnx->quic->max_data_limit) / 4) > cnx->maxdata_local) {
                             uint64_t max_data_increase = cnx->data_received + cnx->quic->max_data_limit - cnx->maxdata_local;
@@ -3500,7 +3742,7 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                 }
 
                 /* If necessary, encode the max stream data frames */
-                if (ret == 0 && cnx->max_stream_data_needed) {
+                if (ret == 0 && cnx->max_stream_data_needed && !picoquic_is_memory_constrained(cnx)) {
                     bytes_next = picoquic_format_required_max_stream_data_frames(cnx, bytes_next, bytes_max, &more_data, &is_pure_ack);
                 }
 
@@ -3523,7 +3765,15 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                 /* Compute the length before entering the CC block */
                 length = bytes_next - bytes;
 
-                if ((path_x->cwin < path_x->bytes_in_transit || cnx->quic->cwin_max < path_x->bytes_in_transit)
+                if (path_x->scheduler_hold_time > current_time && !path_x->is_pto_required) {
+                    /* The path scheduler expects data sent on a faster path to arrive first,
+                     * only send acknowledgements and control frames until the hold expires. */
+                    if (*next_wake_time > path_x->scheduler_hold_time) {
+                        *next_wake_time = path_x->scheduler_hold_time;
+                        SET_LAST_WAKE(cnx->quic, PICOQUIC_SENDER);
+                    }
+                }
+                else if ((path_x->cwin < path_x->bytes_in_transit || cnx->quic->cwin_max < path_x->bytes_in_transit)
                     &&!path_x->is_pto_required) {
                         /* Implementation of experimental API, picoquic_set_priority_limit_for_bypass */
                         uint8_t* bytes_next_before_bypass = bytes_next;
@@ -3544,7 +3794,7 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                             if (cnx->congestion_alg != NULL) {
                                 picoquic_per_ack_state_t ack_state = { 0 };
 
-                                cnx->congestion_alg->alg_notify(cnx, path_x,
+                                picoquic_congestion_notify(cnx, path_x,
                                     picoquic_congestion_notification_cwin_blocked,
                                     &ack_state, current_time);
                             }
@@ -3578,6 +3828,13 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                         if (ret == 0 && cnx->is_ack_frequency_updated && cnx->is_ack_frequency_negotiated) {
                             bytes_next = picoquic_format_ack_frequency_frame(cnx, bytes_next, bytes_max, &more_data);
                         }
+                        if (ret == 0 && cnx->is_fec_enabled &&
+                            picoquic_fec_is_repair_needed(cnx, path_x, pkt_ctx, 0, current_time)) {
+                            uint8_t* bytes_repair = bytes_next;
+                            bytes_next = picoquic_format_fec_repair_frame(cnx, pkt_ctx, bytes_next,
+                                bytes_max + PICOQUIC_FEC_REPAIR_OVERHEAD, &is_pure_ack);
+                            packet->is_fec_repair = (bytes_next > bytes_repair);
+                        }
                         if (ret == 0) {
                             bytes_next = picoquic_prepare_stream_and_datagrams(cnx, path_x, bytes_next, bytes_max,
                                 UINT64_MAX, current_time, &more_data, &is_pure_ack, &no_data_to_send, &ret);
@@ -3600,7 +3857,17 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
                             length = bytes_next - bytes;
                         }
 
-                        if (cnx->is_preemptive_repeat_enabled) {
+                        if (ret == 0 && cnx->is_fec_enabled && (length <= header_length || is_pure_ack) &&
+                            picoquic_fec_is_repair_needed(cnx, path_x, pkt_ctx, 1, current_time)) {
+                            /* No more data to send, protect the last packets now */
+                            bytes_next = picoquic_format_fec_repair_frame(cnx, pkt_ctx, bytes_next,
+                                bytes_max + PICOQUIC_FEC_REPAIR_OVERHEAD, &is_pure_ack);
+                            packet->is_fec_repair = (bytes_next > bytes + length);
+                            length = bytes_next - bytes;
+                        }
+
+                        if (cnx->is_preemptive_repeat_enabled ||
+                            (cnx->path_scheduler != NULL && cnx->path_scheduler->is_redundant)) {
                             if (length <= header_length) {
                                 /* Consider redundant retransmission:
                                  * if the redundant retransmission index is null:
@@ -3770,6 +4037,13 @@ int picoquic_prepare_packet_ready(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
         *next_wake_time = current_time;
         SET_LAST_WAKE(cnx->quic, PICOQUIC_SENDER);
 
+        if (cnx->is_fec_enabled && !is_pure_ack && !packet->is_fec_repair && !packet->is_mtu_probe &&
+            !packet->is_multipath_probe && !packet->is_ack_trap) {
+            /* Keep a copy of the packet, to compute the next repair symbols */
+            picoquic_fec_record_sent(pkt_ctx, packet->sequence_number, packet->bytes + header_length,
+                packet->length - header_length);
+        }
+
         if (ret == 0 && picoquic_cnx_is_still_logging(cnx)) {
             picoquic_log_cc_dump(cnx, current_time);
         }
@@ -4008,6 +4282,9 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
     picoquic_stream_head_t* next_stream = picoquic_find_ready_stream(cnx);
     int affinity_path_id = -1;
     unsigned int is_nat = 0;
+    picoquic_path_t* candidates[PICOQUIC_NB_PATH_TARGET];
+    int candidate_ids[PICOQUIC_NB_PATH_TARGET];
+    int nb_candidates = 0;
 
     cnx->last_path_polled++;
     if (cnx->last_path_polled > cnx->nb_paths) {
@@ -4085,6 +4362,7 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
                     last_sent_cwin = UINT64_MAX;
                     i_min_rtt = -1;
                     is_min_rtt_pacing_ok = 0;
+                    nb_candidates = 0;
                 }
                 if (is_polled) {
                     /* This path is a candidate for min rtt */
@@ -4110,14 +4388,21 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
                                 last_sent_cwin = cnx->path[i]->last_sent_time;
                                 data_path_cwin = i;
                             }
+                            if (nb_candidates < PICOQUIC_NB_PATH_TARGET) {
+                                candidates[nb_candidates] = cnx->path[i];
+                                candidate_ids[nb_candidates] = i;
+                                nb_candidates++;
+                            }
                             if (affinity_path_id < 0) {
                                 /* we select here the first path that is either ready to send on
                                  * the highest priority stream with affinity on this path, or
-                                 * ready to send datagrams on this path. */
+                                 * ready to send datagrams on this path. Datagrams that are
+                                 * not bound to a path are left to the path scheduler, if any. */
                                 if (next_stream != NULL && cnx->path[i] == next_stream->affinity_path) {
                                     affinity_path_id = i;
                                 }
-                                else if (cnx->path[i]->is_datagram_ready || cnx->is_datagram_ready) {
+                                else if (cnx->path[i]->is_datagram_ready ||
+                                    (cnx->is_datagram_ready && cnx->path_scheduler == NULL)) {
                                     affinity_path_id = i;
                                 }
                             }
@@ -4151,9 +4436,13 @@ static int picoquic_select_next_path_mp(picoquic_cnx_t* cnx, uint64_t current_ti
     }
     else if (data_path_cwin >= 0) {
         /* if there is a path ready to send the most urgent data, select it */
+        int selected = -1;
         if (affinity_path_id >= 0) {
             path_id = affinity_path_id;
         }
+        else if ((selected = picoquic_path_scheduler_select_path(cnx, candidates, nb_candidates, current_time)) >= 0) {
+            path_id = candidate_ids[selected];
+        }
         else {
             path_id = data_path_cwin;
         }
@@ -4268,7 +4557,7 @@ static int picoquic_check_cc_feedback_timer(picoquic_cnx_t* cnx, uint64_t* next_
                             
                     if (lost_feedback_time <= current_time) {
                         path_x->is_lost_feedback_notified = 1;
-                        cnx->congestion_alg->alg_notify(cnx, path_x,
+                        picoquic_congestion_notify(cnx, path_x,
                             picoquic_congestion_notification_lost_feedback,
                             NULL, current_time);
                     }
@@ -4338,6 +4627,13 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
             cnx->is_sending_large_buffer = 1;
         }
 
+        /* In txtime mode, the train departs at the time scheduled for its first packet */
+        cnx->txtime_departure = current_time;
+        cnx->path[path_id]->pacing.departure_time = current_time;
+
+        /* Protection of 1-RTT packets can be offloaded until the end of this call */
+        cnx->is_crypto_offload_active = (cnx->quic->crypto_offload != NULL);
+
         while (ret == 0)
         {
             /* Create a new packet, which may include several segments */
@@ -4438,6 +4734,10 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
                 SET_LAST_WAKE(cnx->quic, PICOQUIC_SENDER);
             }
 
+            if (packet_size > 0 && *send_length == 0) {
+                cnx->txtime_departure = cnx->path[path_id]->pacing.departure_time;
+            }
+
             /* Account for the bytes in the packet. */
             *send_length += packet_size;
 
@@ -4471,10 +4771,27 @@ int picoquic_prepare_packet_ex(picoquic_cnx_t* cnx,
             else if (*send_length + *send_msg_size > send_buffer_max) {
                 break;
             }
+            else if (cnx->quic->txtime_horizon > 0 &&
+                cnx->path[path_id]->pacing.departure_time > cnx->txtime_departure +
+                (uint64_t)cnx->path[path_id]->pacing.bucket_max / 1000) {
+                /* All packets in the train share the same departure time. Stop before
+                 * the train becomes a larger burst than the pacing quantum. */
+                break;
+            }
         }
         if (*send_length > 0) {
             cnx->nb_trains_sent++;
         }
+
+        if (cnx->is_crypto_offload_active) {
+            /* All packets must be protected before they are handed to the caller */
+            picoquic_crypto_offload_drain(cnx->quic->crypto_offload);
+            cnx->is_crypto_offload_active = 0;
+        }
+    }
+
+    if (cnx->quic->live_metrics != NULL) {
+        picoquic_metrics_update(cnx, current_time);
     }
 
     picoquic_reinsert_by_wake_time(cnx->quic, cnx, next_wake_time);
@@ -4529,12 +4846,14 @@ void picoquic_close_immediate(picoquic_cnx_t* cnx)
 
 /* Quic context level call.
  * will send a stateless packet if one is queued, or ask the first connection in
- * the wake list to prepare a packet */
+ * the wake list to prepare a packet. If the connection is closed and deleted,
+ * its former address is returned in p_deleted_cnx. */
 
-int picoquic_prepare_next_packet_ex(picoquic_quic_t* quic,
+static int picoquic_prepare_next_packet_or_delete(picoquic_quic_t* quic,
     uint64_t current_time, uint8_t* send_buffer, size_t send_buffer_max, size_t* send_length,
     struct sockaddr_storage* p_addr_to, struct sockaddr_storage* p_addr_from, int * if_index,
-    picoquic_connection_id_t * log_cid, picoquic_cnx_t** p_last_cnx, size_t * send_msg_size)
+    picoquic_connection_id_t * log_cid, picoquic_cnx_t** p_last_cnx, size_t * send_msg_size,
+    picoquic_cnx_t** p_deleted_cnx)
 {
     int ret = 0;
     picoquic_stateless_packet_t* sp = picoquic_dequeue_stateless_packet(quic);
@@ -4584,7 +4903,7 @@ int picoquic_prepare_next_packet_ex(picoquic_quic_t* quic,
                     fflush(quic->F_log);
                 }
 
-                if (cnx->f_binlog != NULL) {
+                if (cnx->f_binlog != NULL && quic->binlog_async == NULL) {
                     fflush(cnx->f_binlog);
                 }
 
@@ -4595,6 +4914,9 @@ int picoquic_prepare_next_packet_ex(picoquic_quic_t* quic,
                 }
                 else {
                     picoquic_delete_cnx(cnx);
+                    if (p_deleted_cnx != NULL) {
+                        *p_deleted_cnx = cnx;
+                    }
                 }
             }
             else {
@@ -4611,6 +4933,15 @@ int picoquic_prepare_next_packet_ex(picoquic_quic_t* quic,
     return ret;
 }
 
+int picoquic_prepare_next_packet_ex(picoquic_quic_t* quic,
+    uint64_t current_time, uint8_t* send_buffer, size_t send_buffer_max, size_t* send_length,
+    struct sockaddr_storage* p_addr_to, struct sockaddr_storage* p_addr_from, int* if_index,
+    picoquic_connection_id_t* log_cid, picoquic_cnx_t** p_last_cnx, size_t* send_msg_size)
+{
+    return picoquic_prepare_next_packet_or_delete(quic, current_time, send_buffer, send_buffer_max, send_length,
+        p_addr_to, p_addr_from, if_index, log_cid, p_last_cnx, send_msg_size, NULL);
+}
+
 int picoquic_prepare_next_packet(picoquic_quic_t* quic,
     uint64_t current_time, uint8_t* send_buffer, size_t send_buffer_max, size_t* send_length,
     struct sockaddr_storage* p_addr_to, struct sockaddr_storage* p_addr_from, int* if_index,
@@ -4619,3 +4950,81 @@ int picoquic_prepare_next_packet(picoquic_quic_t* quic,
     return picoquic_prepare_next_packet_ex(quic, current_time, send_buffer, send_buffer_max, send_length,
         p_addr_to, p_addr_from, if_index, log_cid, p_last_cnx, NULL);
 }
+
+/* Check whether a train of packets can be appended to the previous message
+ * of a batch and sent with a single GSO call. The packets must be sent by
+ * the same connection between the same addresses, at the same departure
+ * time, follow the previous message in the send buffer, and all packets
+ * except the last one must have the same size.
+ */
+static int picoquic_send_batch_can_append(picoquic_send_batch_t* msg, picoquic_send_batch_t* next)
+{
+    size_t segment_size = (msg->send_msg_size == 0) ? msg->length : msg->send_msg_size;
+    size_t next_segment_size = (next->send_msg_size == 0) ? next->length : next->send_msg_size;
+    size_t nb_segments = (msg->length + next->length + segment_size - 1) / segment_size;
+
+    return (msg->cnx == next->cnx &&
+        msg->departure_time == next->departure_time &&
+        msg->bytes + msg->length == next->bytes &&
+        msg->length % segment_size == 0 &&
+        (next_segment_size == segment_size || (next->send_msg_size == 0 && next->length < segment_size)) &&
+        nb_segments <= PICOQUIC_SEND_BATCH_GSO_MAX &&
+        msg->length + next->length <= 0xFFFF &&
+        msg->if_index == next->if_index &&
+        picoquic_compare_addr((struct sockaddr*)&msg->addr_to, (struct sockaddr*)&next->addr_to) == 0 &&
+        picoquic_compare_addr((struct sockaddr*)&msg->addr_from, (struct sockaddr*)&next->addr_from) == 0);
+}
+
+int picoquic_prepare_next_packets(picoquic_quic_t* quic, uint64_t current_time,
+    uint8_t* send_buffer, size_t send_buffer_max, size_t packet_max, int use_gso,
+    picoquic_send_batch_t* batch, size_t batch_max, size_t* nb_batch)
+{
+    int ret = 0;
+    size_t offset = 0;
+
+    *nb_batch = 0;
+
+    while (ret == 0 && *nb_batch < batch_max && offset + packet_max <= send_buffer_max) {
+        picoquic_send_batch_t* msg = &batch[*nb_batch];
+        picoquic_cnx_t* deleted_cnx = NULL;
+
+        memset(msg, 0, sizeof(picoquic_send_batch_t));
+        msg->bytes = send_buffer + offset;
+        ret = picoquic_prepare_next_packet_or_delete(quic, current_time, msg->bytes, packet_max, &msg->length,
+            &msg->addr_to, &msg->addr_from, &msg->if_index, &msg->log_cid, &msg->cnx,
+            (use_gso) ? &msg->send_msg_size : NULL, &deleted_cnx);
+
+        if (deleted_cnx != NULL) {
+            /* Do not keep references to a deleted connection */
+            for (size_t i = 0; i < *nb_batch; i++) {
+                if (batch[i].cnx == deleted_cnx) {
+                    batch[i].cnx = NULL;
+                }
+            }
+        }
+        if (ret != 0 || msg->length == 0) {
+            break;
+        }
+        if (msg->cnx != NULL) {
+            /* Read now, the next packets of the connection may leave later */
+            msg->departure_time = picoquic_get_txtime(msg->cnx);
+        }
+        if (msg->send_msg_size >= msg->length) {
+            msg->send_msg_size = 0;
+        }
+        offset += msg->length;
+        if (use_gso && *nb_batch > 0 && picoquic_send_batch_can_append(&batch[*nb_batch - 1], msg)) {
+            picoquic_send_batch_t* previous = &batch[*nb_batch - 1];
+
+            if (previous->send_msg_size == 0) {
+                previous->send_msg_size = previous->length;
+            }
+            previous->length += msg->length;
+        }
+        else {
+            *nb_batch += 1;
+        }
+    }
+
+    return ret;
+}
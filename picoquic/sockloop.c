@@ -658,6 +658,125 @@ int picoquic_packet_loop_select(picoquic_socket_ctx_t* s_ctx,
     return bytes_recv;
 }
 #endif
+
+/* We have multiple sockets, with support for
+ * either IPv6, or IPv4, or both, and binding to a port number.
+ * Find the first socket where:
+ * - the destination AF is supported.
+ * - either the source port is not specified, or it matches the local port.
+ */
+static SOCKET_TYPE picoquic_packet_loop_send_socket(picoquic_socket_ctx_t* s_ctx, int nb_sockets_available,
+    struct sockaddr_storage* peer_addr, struct sockaddr_storage* local_addr)
+{
+    SOCKET_TYPE send_socket = INVALID_SOCKET;
+    uint16_t send_port = (peer_addr->ss_family == AF_INET) ?
+        ((struct sockaddr_in*)local_addr)->sin_port :
+        ((struct sockaddr_in6*)local_addr)->sin6_port;
+
+    /* TODO: verify htons/ntohs */
+    for (int i = 0; i < nb_sockets_available; i++) {
+        if (s_ctx[i].af == peer_addr->ss_family) {
+            send_socket = s_ctx[i].fd;
+            if (send_port != 0 && htons(s_ctx[i].port) == send_port)
+                break;
+        }
+    }
+
+    return send_socket;
+}
+
+/* Handle the failure to send one message of a batch. */
+static void picoquic_packet_loop_batch_error(picoquic_quic_t* quic, SOCKET_TYPE send_socket,
+    picoquic_send_batch_t* msg, int sock_err, uint64_t current_time, size_t** send_msg_ptr)
+{
+    if (msg->cnx == NULL) {
+        picoquic_log_context_free_app_message(quic, &msg->log_cid, "Could not send message to AF_to=%d, AF_from=%d, if=%d, err=%d",
+            msg->addr_to.ss_family, msg->addr_from.ss_family, msg->if_index, sock_err);
+    }
+    else {
+        picoquic_log_app_message(msg->cnx, "Could not send message to AF_to=%d, AF_from=%d, if=%d, err=%d",
+            msg->addr_to.ss_family, msg->addr_from.ss_family, msg->if_index, sock_err);
+
+        if (picoquic_socket_error_implies_unreachable(sock_err)) {
+            picoquic_notify_destination_unreachable(msg->cnx, current_time,
+                (struct sockaddr*)&msg->addr_to, (struct sockaddr*)&msg->addr_from, msg->if_index,
+                sock_err);
+        }
+        else if (sock_err == EIO && send_socket != INVALID_SOCKET && msg->send_msg_size > 0) {
+            /* The system supports GSO, but the interface driver does not.
+             * Send the packets one by one, and stop using GSO. */
+            size_t packet_index = 0;
+            size_t packet_size = msg->send_msg_size;
+            int sock_ret = 0;
+
+            while (packet_index < msg->length) {
+                if (packet_index + packet_size > msg->length) {
+                    packet_size = msg->length - packet_index;
+                }
+                sock_ret = picoquic_sendmsg(send_socket,
+                    (struct sockaddr*)&msg->addr_to, (struct sockaddr*)&msg->addr_from, msg->if_index,
+                    (const char*)(msg->bytes + packet_index), (int)packet_size, 0, &sock_err);
+                if (sock_ret > 0) {
+                    packet_index += packet_size;
+                }
+                else {
+                    picoquic_log_app_message(msg->cnx, "Retry with packet size=%zu fails at index %zu, ret=%d, err=%d.",
+                        packet_size, packet_index, sock_ret, sock_err);
+                    break;
+                }
+            }
+            if (*send_msg_ptr != NULL) {
+                *send_msg_ptr = NULL;
+                picoquic_log_app_message(msg->cnx, "%s", "UDP GSO was disabled");
+            }
+        }
+    }
+}
+
+/* Send the messages prepared by picoquic_prepare_next_packets. Consecutive
+ * messages that go through the same socket are sent with one call to
+ * picoquic_sendmmsg. */
+static void picoquic_packet_loop_send_batch(picoquic_quic_t* quic, picoquic_packet_loop_param_t* param,
+    picoquic_socket_ctx_t* s_ctx, int nb_sockets_available, picoquic_send_batch_t* batch, size_t nb_batch,
+    uint64_t* txtime_delay, uint64_t loop_time, uint64_t current_time, size_t** send_msg_ptr)
+{
+    size_t i = 0;
+
+    while (i < nb_batch) {
+        SOCKET_TYPE send_socket = picoquic_packet_loop_send_socket(s_ctx, nb_sockets_available,
+            &batch[i].addr_to, &batch[i].addr_from);
+        size_t nb_group = 0;
+        size_t nb_sent = 0;
+        int sock_err = -1;
+
+        if (send_socket != INVALID_SOCKET) {
+            while (i + nb_group < nb_batch &&
+                !(param->simulate_eio && batch[i + nb_group].length > PICOQUIC_MAX_PACKET_SIZE) &&
+                picoquic_packet_loop_send_socket(s_ctx, nb_sockets_available,
+                    &batch[i + nb_group].addr_to, &batch[i + nb_group].addr_from) == send_socket) {
+                txtime_delay[i + nb_group] = 0;
+                if (quic->txtime_horizon > 0 && batch[i + nb_group].departure_time > loop_time) {
+                    txtime_delay[i + nb_group] = batch[i + nb_group].departure_time - loop_time;
+                }
+                nb_group++;
+            }
+            if (nb_group == 0) {
+                /* Test hook, simulating a driver that does not support GSO */
+                sock_err = EIO;
+                param->simulate_eio = 0;
+            }
+            else {
+                nb_sent = picoquic_sendmmsg(send_socket, batch + i, nb_group, txtime_delay + i, &sock_err);
+            }
+        }
+        i += nb_sent;
+        if (nb_sent < nb_group || nb_group == 0) {
+            picoquic_packet_loop_batch_error(quic, send_socket, &batch[i], sock_err, current_time, send_msg_ptr);
+            i++;
+        }
+    }
+}
+
 #ifdef _WINDOWS
     DWORD WINAPI picoquic_packet_loop_v3(LPVOID v_ctx)
 #else
@@ -683,6 +802,8 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     size_t send_msg_size = 0;
     size_t send_buffer_size = param->socket_buffer_size;
     size_t* send_msg_ptr = NULL;
+    picoquic_send_batch_t* send_batch = NULL;
+    uint64_t* send_batch_txtime = NULL;
     int bytes_recv;
     picoquic_connection_id_t log_cid;
     picoquic_socket_ctx_t s_ctx[4];
@@ -724,12 +845,31 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     if (ret == 0) {
         nb_sockets_available = nb_sockets;
 
+        if (quic->txtime_horizon > 0) {
+            /* Departure time scheduling requires SO_TXTIME on all sockets. If it
+             * is not available, fall back to waking up at each pacing time. */
+            for (int i = 0; i < nb_sockets; i++) {
+                if (picoquic_socket_set_txtime(s_ctx[i].fd) != 0) {
+                    DBG_PRINTF("Cannot set SO_TXTIME (af=%d), txtime pacing disabled\n", s_ctx[i].af);
+                    picoquic_set_txtime_pacing(quic, 0);
+                    break;
+                }
+            }
+        }
+
         if (udp_gso_available && !param->do_not_use_gso) {
             send_buffer_size = 0xFFFF;
             send_msg_ptr = &send_msg_size;
         }
-        send_buffer = malloc(send_buffer_size);
-        if (send_buffer == NULL) {
+        if (param->send_batch_max > 0) {
+            send_batch = (picoquic_send_batch_t*)malloc(param->send_batch_max * sizeof(picoquic_send_batch_t));
+            send_batch_txtime = (uint64_t*)malloc(param->send_batch_max * sizeof(uint64_t));
+            send_buffer = malloc(param->send_batch_max * send_buffer_size);
+        }
+        else {
+            send_buffer = malloc(send_buffer_size);
+        }
+        if (send_buffer == NULL || (param->send_batch_max > 0 && (send_batch == NULL || send_batch_txtime == NULL))) {
             ret = -1;
         }
     }
@@ -872,7 +1012,25 @@ void* picoquic_packet_loop_v3(void* v_ctx)
             * packets may be adding in the receive queue.
              */
 
-            while (ret == 0 && nb_packets_sent < PICOQUIC_PACKET_LOOP_SEND_MAX) {
+            if (ret == 0 && send_batch != NULL) {
+                size_t nb_batch = 0;
+
+                ret = picoquic_prepare_next_packets(quic, loop_time, send_buffer, param->send_batch_max * send_buffer_size,
+                    (send_msg_ptr == NULL) ? PICOQUIC_MAX_PACKET_SIZE : send_buffer_size, send_msg_ptr != NULL,
+                    send_batch, param->send_batch_max, &nb_batch);
+                if (ret == 0 && nb_batch > 0) {
+                    for (size_t i = 0; i < nb_batch; i++) {
+                        bytes_sent += send_batch[i].length;
+                        if (send_batch[i].length > param->send_length_max) {
+                            param->send_length_max = send_batch[i].length;
+                        }
+                    }
+                    picoquic_packet_loop_send_batch(quic, param, s_ctx, nb_sockets_available, send_batch, nb_batch,
+                        send_batch_txtime, loop_time, current_time, &send_msg_ptr);
+                }
+            }
+
+            while (ret == 0 && send_batch == NULL && nb_packets_sent < PICOQUIC_PACKET_LOOP_SEND_MAX) {
                 struct sockaddr_storage peer_addr;
                 struct sockaddr_storage local_addr = { 0 };
                 int if_index = param->dest_if;
@@ -893,28 +1051,11 @@ void* picoquic_packet_loop_v3(void* v_ctx)
                     if (send_length > param->send_length_max) {
                         param->send_length_max = send_length;
                     }
-                    /* We have multiple sockets, with support for
-                    * either IPv6, or IPv4, or both, and binding to a port number.
-                    * Find the first socket where:
-                    * - the destination AF is supported.
-                    * - either the source port is not specified, or it matches the local port.
-                    */
-                    SOCKET_TYPE send_socket = INVALID_SOCKET;
-                    uint16_t send_port = (peer_addr.ss_family == AF_INET) ?
-                        ((struct sockaddr_in*)&local_addr)->sin_port :
-                        ((struct sockaddr_in6*)&local_addr)->sin6_port;
+                    SOCKET_TYPE send_socket = picoquic_packet_loop_send_socket(s_ctx, nb_sockets_available,
+                        &peer_addr, &local_addr);
 
                     bytes_sent += send_length;
 
-                    /* TODO: verify htons/ntohs */
-                    for (int i = 0; i < nb_sockets_available; i++) {
-                        if (s_ctx[i].af == peer_addr.ss_family) {
-                            send_socket = s_ctx[i].fd;
-                            if (send_port != 0 && htons(s_ctx[i].port) == send_port)
-                                break;
-                        }
-                    }
-
                     if (send_socket == INVALID_SOCKET) {
                         sock_ret = -1;
                         sock_err = -1;
@@ -926,9 +1067,17 @@ void* picoquic_packet_loop_v3(void* v_ctx)
                         param->simulate_eio = 0;
                     }
                     else {
-                        sock_ret = picoquic_sendmsg(send_socket,
+                        uint64_t txtime_delay = 0;
+
+                        if (quic->txtime_horizon > 0 && last_cnx != NULL) {
+                            uint64_t departure_time = picoquic_get_txtime(last_cnx);
+                            if (departure_time > loop_time) {
+                                txtime_delay = departure_time - loop_time;
+                            }
+                        }
+                        sock_ret = picoquic_sendmsg_ex(send_socket,
                             (struct sockaddr*)&peer_addr, (struct sockaddr*)&local_addr, if_index,
-                            (const char*)send_buffer, (int)send_length, (int)send_msg_size, &sock_err);
+                            (const char*)send_buffer, (int)send_length, (int)send_msg_size, txtime_delay, &sock_err);
                     }
 
                     if (sock_ret <= 0) {
@@ -1010,6 +1159,12 @@ void* picoquic_packet_loop_v3(void* v_ctx)
     if (send_buffer != NULL) {
         free(send_buffer);
     }
+    if (send_batch != NULL) {
+        free(send_batch);
+    }
+    if (send_batch_txtime != NULL) {
+        free(send_batch_txtime);
+    }
     thread_ctx->return_code = ret;
 #ifdef _WINDOWS
     return (DWORD)ret;
@@ -103,7 +103,7 @@ static void picoquic_validate_bdp_seed(picoquic_cnx_t* cnx, picoquic_path_t* pat
             picoquic_per_ack_state_t ack_state = { 0 };
             ack_state.nb_bytes_acknowledged = (uint64_t)cnx->seed_cwin;
             cnx->cwin_notified_from_seed = 1;
-            cnx->congestion_alg->alg_notify(cnx, path_x,
+            picoquic_congestion_notify(cnx, path_x,
                 picoquic_congestion_notification_seed_cwin,
                 &ack_state, current_time);
         }
@@ -161,6 +161,12 @@ void picoquic_update_path_rtt_one_way(picoquic_cnx_t* cnx, picoquic_path_t* old_
         }
         if (is_time_stamp_valid) {
             old_path->one_way_delay_sample = time_stamp_local - send_time;
+            if (old_path->one_way_delay_avg == 0) {
+                old_path->one_way_delay_avg = old_path->one_way_delay_sample;
+            }
+            else {
+                old_path->one_way_delay_avg = (7 * old_path->one_way_delay_avg + old_path->one_way_delay_sample) / 8;
+            }
         }
         else {
             old_path->nb_delay_outliers++;
@@ -195,6 +201,12 @@ void picoquic_update_path_rtt(picoquic_cnx_t* cnx, picoquic_path_t* old_path, pi
             }
         }
         old_path->rtt_sample = rtt_estimate;
+        if (cnx->quic->live_metrics != NULL) {
+            picoquic_metrics_rtt_sample(cnx->quic->live_metrics, rtt_estimate);
+        }
+        if (cnx->quic->latency_hist != NULL) {
+            picoquic_latency_record(cnx, old_path, picoquic_latency_rtt, rtt_estimate);
+        }
 #ifdef PICOQUIC_TESTING_CLASSIC_RTT_COMPUTATION
         if (is_first) {
             old_path->smoothed_rtt = rtt_estimate;
@@ -228,7 +240,7 @@ void picoquic_update_path_rtt(picoquic_cnx_t* cnx, picoquic_path_t* old_path, pi
 
         /* Pass the new values to the congestion algorithm */
         if (cnx->congestion_alg != NULL) {
-            cnx->congestion_alg->alg_notify(cnx, old_path,
+            picoquic_congestion_notify(cnx, old_path,
                 picoquic_congestion_notification_rtt_measurement,
                 rtt_estimate, (cnx->is_time_stamp_enabled)?old_path->one_way_delay_sample:0,
                 0, 0, current_time);
@@ -340,7 +352,7 @@ void picoquic_update_path_rtt(picoquic_cnx_t* cnx, picoquic_path_t* old_path, pi
             picoquic_per_ack_state_t ack_state = { 0 };
             ack_state.rtt_measurement = rtt_estimate;
             ack_state.one_way_delay = (cnx->is_time_stamp_enabled) ? old_path->one_way_delay_sample : 0;
-            cnx->congestion_alg->alg_notify(cnx, old_path,
+            picoquic_congestion_notify(cnx, old_path,
                 picoquic_congestion_notification_rtt_measurement,
                 &ack_state, current_time);
         }
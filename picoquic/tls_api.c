@@ -747,46 +747,80 @@ uint64_t picoquic_crypto_uniform_random(picoquic_quic_t* quic, uint64_t rnd_max)
  * that it cannot be broken.
  */
 
-static uint64_t public_random_seed[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
-static int public_random_index = 0;
+typedef struct st_picoquic_public_random_state_t {
+    uint64_t seed[16];
+    int index;
+    uint64_t obfuscator;
+} picoquic_public_random_state_t;
+
+#ifdef _WINDOWS
+#define PICOQUIC_THREAD_LOCAL __declspec(thread)
+#else
+#define PICOQUIC_THREAD_LOCAL __thread
+#endif
+
+static const picoquic_public_random_state_t public_random_initial_state = {
+    { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 }, 0, 0x5555555555555555ull };
+static picoquic_public_random_state_t public_random_state = {
+    { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 }, 0, 0x5555555555555555ull };
+static PICOQUIC_THREAD_LOCAL picoquic_public_random_state_t public_random_thread_state;
+static PICOQUIC_THREAD_LOCAL picoquic_public_random_state_t* public_random_thread_ctx = NULL;
 static const uint64_t public_random_multiplier = 1181783497276652981ull;
-static uint64_t public_random_obfuscator = 0x5555555555555555ull;
 
-static uint64_t picoquic_public_random_step(void)
+/* The generator state is shared by all threads, unless the calling thread
+ * asked for its own state with picoquic_public_random_set_thread_local.
+ * This is used by simulations running in parallel threads, so that their
+ * random sequences do not depend on each other. */
+void picoquic_public_random_set_thread_local(int is_thread_local)
+{
+    if (is_thread_local) {
+        public_random_thread_state = public_random_initial_state;
+        public_random_thread_ctx = &public_random_thread_state;
+    }
+    else {
+        public_random_thread_ctx = NULL;
+    }
+}
+
+static picoquic_public_random_state_t* picoquic_public_random_state(void)
+{
+    return (public_random_thread_ctx != NULL) ? public_random_thread_ctx : &public_random_state;
+}
+
+static uint64_t picoquic_public_random_step(picoquic_public_random_state_t* state)
 {
     uint64_t s1;
-    const uint64_t s0 = public_random_seed[public_random_index++];
-    public_random_index &= 15;
-    s1 = public_random_seed[public_random_index];
+    const uint64_t s0 = state->seed[state->index++];
+    state->index &= 15;
+    s1 = state->seed[state->index];
     s1 ^= (s1 << 31); // a
     s1 ^= (s1 >> 11); // b
     s1 ^= (s0 ^ (s0 >> 30)); // c
-    public_random_seed[public_random_index] = s1;
+    state->seed[state->index] = s1;
     return s1;
 }
 
 uint64_t picoquic_public_random_64(void)
 {
-    uint64_t s1 = picoquic_public_random_step();
+    picoquic_public_random_state_t* state = picoquic_public_random_state();
+    uint64_t s1 = picoquic_public_random_step(state);
     s1 *= public_random_multiplier;
-    s1 ^= public_random_obfuscator;
+    s1 ^= state->obfuscator;
     return s1;
 }
 
 void picoquic_public_random_seed_64(uint64_t seed, int reset)
 {
+    picoquic_public_random_state_t* state = picoquic_public_random_state();
+
     if (reset) {
-        public_random_index = 0;
-        for (uint64_t i = 0; i < 16; i++) {
-            public_random_seed[i] = i + 1u;
-        }
-        public_random_obfuscator = 0x5555555555555555ull;
+        *state = public_random_initial_state;
     }
 
-    public_random_seed[public_random_index] ^= seed;
+    state->seed[state->index] ^= seed;
 
     for (int i = 0; i < 16; i++) {
-        (void)picoquic_public_random_step();
+        (void)picoquic_public_random_step(state);
     }
 }
 
@@ -797,7 +831,7 @@ void picoquic_public_random_seed(picoquic_quic_t* quic)
     picoquic_crypto_random(quic, &seed, sizeof(seed));
 
     picoquic_public_random_seed_64(seed[0], 0);
-    public_random_obfuscator = seed[1];
+    picoquic_public_random_state()->obfuscator = seed[1];
 }
 
 void picoquic_public_random(void* buf, size_t len)
@@ -2121,6 +2155,7 @@ static int picoquic_add_to_tls_stream(picoquic_cnx_t* cnx, const uint8_t* data,
             ret = -1;
         }
         else {
+            memset(stream_data, 0, sizeof(picoquic_stream_queue_node_t));
             stream_data->bytes = (uint8_t*)malloc(length);
 
             if (stream_data->bytes == NULL) {
@@ -553,6 +553,11 @@ int picoquic_prepare_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
             (uint64_t)cnx->local_parameters.enable_bdp_frame);
     }
 
+    if (cnx->local_parameters.enable_fec > 0 && bytes != NULL) {
+        bytes = picoquic_transport_param_type_varint_encode(bytes, bytes_max, picoquic_tp_enable_fec,
+            (uint64_t)cnx->local_parameters.enable_fec);
+    }
+
     if (cnx->local_parameters.is_multipath_enabled > 0 && bytes != NULL){
         bytes = picoquic_transport_param_type_varint_encode(bytes, bytes_max, picoquic_tp_initial_max_paths,
             (uint64_t)cnx->local_parameters.initial_max_paths);
@@ -614,6 +619,7 @@ void picoquic_clear_transport_extensions(picoquic_cnx_t* cnx)
     cnx->remote_parameters.min_ack_delay = 0;
     cnx->remote_parameters.do_grease_quic_bit = 0;
     cnx->remote_parameters.enable_bdp_frame = 0;
+    cnx->remote_parameters.enable_fec = 0;
     cnx->remote_parameters.initial_max_paths = 0;
 }
 
@@ -920,6 +926,19 @@ int picoquic_receive_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
                     }
                     break;
                 }
+                case picoquic_tp_enable_fec: {
+                    uint64_t enable_fec =
+                        picoquic_transport_param_varint_decode(cnx, bytes + byte_index, extension_length, &ret);
+                    if (ret == 0) {
+                        if (enable_fec > 1) {
+                            ret = picoquic_connection_error_ex(cnx, PICOQUIC_TRANSPORT_PARAMETER_ERROR, 0, "FEC parameter");
+                        }
+                        else {
+                            cnx->remote_parameters.enable_fec = (int)enable_fec;
+                        }
+                    }
+                    break;
+                }
                 default:
                     /* ignore unknown extensions */
                     break;
@@ -1036,6 +1055,9 @@ int picoquic_receive_transport_extensions(picoquic_cnx_t* cnx, int extension_mod
     /* Send-receive BDP frame is only enabled if negotiated by both parties */
     cnx->send_receive_bdp_frame = (cnx->local_parameters.enable_bdp_frame > 0) && (cnx->remote_parameters.enable_bdp_frame > 0);
 
+    /* FEC repair frames are only sent if negotiated by both parties */
+    cnx->is_fec_enabled = (cnx->local_parameters.enable_fec > 0) && (cnx->remote_parameters.enable_fec > 0);
+
     /* One way delay, Quic_bit_grease and Multipath only enabled if asked by client and accepted by server */
     if (cnx->client_mode) {
         cnx->is_time_stamp_enabled = 
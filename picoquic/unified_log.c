@@ -54,7 +54,7 @@ void picoquic_log_quic_pdu(picoquic_quic_t* quic, int receiving, uint64_t curren
 
 void picoquic_log_app_message_v(picoquic_cnx_t* cnx, const char* fmt, va_list vargs)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->text_log_fns->log_app_message(cnx, fmt, vargs);
     }
 
@@ -65,7 +65,7 @@ void picoquic_log_app_message_v(picoquic_cnx_t* cnx, const char* fmt, va_list va
 
 void picoquic_log_app_message(picoquic_cnx_t* cnx, const char* fmt, ...)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         va_list args;
         va_start(args, fmt);
         cnx->quic->text_log_fns->log_app_message(cnx, fmt, args);
@@ -94,7 +94,7 @@ void picoquic_log_context_free_app_message(picoquic_quic_t* quic, const picoquic
 void picoquic_log_pdu(picoquic_cnx_t* cnx, int receiving, uint64_t current_time,
     const struct sockaddr* addr_peer, const struct sockaddr* addr_local, size_t packet_length)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, UINT64_MAX, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_pdu(cnx, receiving, current_time, addr_peer, addr_local, packet_length);
         }
@@ -109,7 +109,7 @@ void picoquic_log_pdu(picoquic_cnx_t* cnx, int receiving, uint64_t current_time,
 void picoquic_log_packet(picoquic_cnx_t* cnx, picoquic_path_t* path_x, int receiving, uint64_t current_time,
     struct st_picoquic_packet_header_t* ph, const uint8_t* bytes, size_t bytes_max)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, ph->pn64, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_packet(cnx, path_x, receiving, current_time, ph, bytes, bytes_max);
         }
@@ -124,7 +124,7 @@ void picoquic_log_packet(picoquic_cnx_t* cnx, picoquic_path_t* path_x, int recei
 void picoquic_log_dropped_packet(picoquic_cnx_t* cnx, picoquic_path_t* path_x, struct st_picoquic_packet_header_t* ph, size_t packet_size,
     int err, uint8_t* raw_data, uint64_t current_time)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, UINT64_MAX, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_dropped_packet(cnx, path_x, ph, packet_size, err, raw_data, current_time);
         }
@@ -138,7 +138,7 @@ void picoquic_log_dropped_packet(picoquic_cnx_t* cnx, picoquic_path_t* path_x, s
 /* Report that packet was buffered waiting for decryption */
 void picoquic_log_buffered_packet(picoquic_cnx_t* cnx, picoquic_path_t* path_x, picoquic_packet_type_enum ptype, uint64_t current_time)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, UINT64_MAX, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_buffered_packet(cnx, path_x, ptype, current_time);
         }
@@ -154,7 +154,7 @@ void picoquic_log_outgoing_packet(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
     uint8_t* bytes, uint64_t sequence_number, size_t pn_length, size_t length,
     uint8_t* send_buffer, size_t send_length, uint64_t current_time)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, sequence_number, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_outgoing_packet(cnx, path_x, bytes, sequence_number, pn_length, length,
                 send_buffer, send_length, current_time);
@@ -173,7 +173,7 @@ void picoquic_log_packet_lost(picoquic_cnx_t* cnx, picoquic_path_t* path_x,
     picoquic_connection_id_t* dcid, size_t packet_size,
     uint64_t current_time)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, sequence_number, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_packet_lost(cnx, path_x, ptype, sequence_number, trigger, dcid, packet_size, current_time);
         }
@@ -189,7 +189,7 @@ void picoquic_log_negotiated_alpn(picoquic_cnx_t* cnx, int is_local,
     uint8_t const* sni, size_t sni_len, uint8_t const* alpn, size_t alpn_len,
     const ptls_iovec_t* alpn_list, size_t alpn_count)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->text_log_fns->log_negotiated_alpn(cnx, is_local, sni, sni_len, alpn, alpn_len, alpn_list, alpn_count);
     }
 
@@ -202,7 +202,7 @@ void picoquic_log_negotiated_alpn(picoquic_cnx_t* cnx, int is_local,
 void picoquic_log_transport_extension(picoquic_cnx_t* cnx, int is_local,
     size_t param_length, uint8_t* params)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->text_log_fns->log_transport_extension(cnx, is_local, param_length, params);
     }
 
@@ -214,7 +214,7 @@ void picoquic_log_transport_extension(picoquic_cnx_t* cnx, int is_local,
 /* log TLS ticket */
 void picoquic_log_tls_ticket(picoquic_cnx_t* cnx, uint8_t* ticket, uint16_t ticket_length)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->text_log_fns->log_picotls_ticket(cnx, ticket, ticket_length);
     }
 
@@ -226,18 +226,18 @@ void picoquic_log_tls_ticket(picoquic_cnx_t* cnx, uint8_t* ticket, uint16_t tick
 /* log the start of a connection */
 void picoquic_log_new_connection(picoquic_cnx_t* cnx)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->text_log_fns->log_new_connection(cnx);
     }
 
-    if (cnx->quic->bin_log_fns != NULL) {
+    if (cnx->quic->bin_log_fns != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->bin_log_fns->log_new_connection(cnx);
     }
 }
 /* log the end of a connection */
 void picoquic_log_close_connection(picoquic_cnx_t* cnx)
 {
-    if (cnx->quic->F_log != NULL) {
+    if (cnx->quic->F_log != NULL && !cnx->is_log_sampled_out) {
         cnx->quic->text_log_fns->log_close_connection(cnx);
     }
 
@@ -249,7 +249,7 @@ void picoquic_log_close_connection(picoquic_cnx_t* cnx)
 /* log congestion control parameters */
 void picoquic_log_cc_dump(picoquic_cnx_t* cnx, uint64_t current_time)
 {
-    if (picoquic_cnx_is_still_logging(cnx)) {
+    if (picoquic_cnx_is_still_logging(cnx) && picoquic_is_packet_selected_for_log(cnx, UINT64_MAX, current_time)) {
         if (cnx->quic->F_log != NULL) {
             cnx->quic->text_log_fns->log_cc_dump(cnx, current_time);
         }
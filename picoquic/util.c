@@ -31,6 +31,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <unistd.h>
 #endif
@@ -642,6 +643,52 @@ FILE * picoquic_file_close(FILE * F)
     return NULL;
 }
 
+/* Read file content at a given offset. On POSIX systems, use "pread" on
+ * the underlying descriptor, bypassing the stdio buffer and leaving the file
+ * position unchanged. Returns 0 if all requested bytes were read.
+ */
+int picoquic_file_read_at(FILE* F, uint64_t offset, uint8_t* buffer, size_t length)
+{
+    int ret = 0;
+
+#ifdef _WINDOWS
+    if (_fseeki64(F, (__int64)offset, SEEK_SET) != 0 ||
+        fread(buffer, 1, length, F) != length) {
+        ret = -1;
+    }
+#else
+    int fd = fileno(F);
+    size_t nb_read = 0;
+
+    while (ret == 0 && nb_read < length) {
+        ssize_t r = pread(fd, buffer + nb_read, length - nb_read, (off_t)(offset + nb_read));
+        if (r > 0) {
+            nb_read += (size_t)r;
+        }
+        else if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        else {
+            ret = -1;
+        }
+    }
+#endif
+
+    return ret;
+}
+
+/* Advise the system that a range of the file will be read soon */
+void picoquic_file_readahead(FILE* F, uint64_t offset, uint64_t length)
+{
+#if defined(__linux__) && defined(POSIX_FADV_WILLNEED)
+    (void)posix_fadvise(fileno(F), (off_t)offset, (off_t)length, POSIX_FADV_WILLNEED);
+#else
+    (void)F;
+    (void)offset;
+    (void)length;
+#endif
+}
+
 /* Safely delete file in a portable way */
 int picoquic_file_delete(char const * file_name, int * last_err)
 {
@@ -684,12 +731,21 @@ const uint8_t* picoquic_frames_varint_skip(const uint8_t* bytes, const uint8_t*
 }
 
 
-/* Parse a varint. In case of an error, *n64 is unchanged, and NULL is returned */
+/* Parse a varint. In case of an error, *n64 is unchanged, and NULL is returned.
+ * If at least 8 bytes are available, the varint is read with a single 64 bit
+ * load: the length bits are cleared and the bytes that follow the varint are
+ * shifted out, without a loop or a branch on the length.
+ */
 const uint8_t* picoquic_frames_varint_decode(const uint8_t* bytes, const uint8_t* bytes_max, uint64_t* n64)
 {
     uint8_t length;
 
-    if (bytes < bytes_max && bytes + (length = VARINT_LEN_T(bytes, uint8_t)) <= bytes_max) {
+    if (bytes_max - bytes >= 8) {
+        length = VARINT_LEN_T(bytes, uint8_t);
+        *n64 = ((PICOPARSE_64(bytes) << 2) >> 2) >> (64 - 8 * length);
+        bytes += length;
+    }
+    else if (bytes < bytes_max && bytes + (length = VARINT_LEN_T(bytes, uint8_t)) <= bytes_max) {
         uint64_t v = *bytes++ & 0x3F;
 
         while (--length > 0) {
@@ -706,6 +762,24 @@ const uint8_t* picoquic_frames_varint_decode(const uint8_t* bytes, const uint8_t
     return bytes;
 }
 
+/* Parse a sequence of varints, e.g., the ranges of an ACK frame. Returns NULL
+ * if the buffer does not contain nb_values varints. */
+const uint8_t* picoquic_frames_varint_decode_n(const uint8_t* bytes, const uint8_t* bytes_max, uint64_t* values, size_t nb_values)
+{
+    size_t i = 0;
+
+    while (i < nb_values && bytes_max - bytes >= 8) {
+        uint8_t length = VARINT_LEN_T(bytes, uint8_t);
+        values[i++] = ((PICOPARSE_64(bytes) << 2) >> 2) >> (64 - 8 * length);
+        bytes += length;
+    }
+    while (i < nb_values && bytes != NULL) {
+        bytes = picoquic_frames_varint_decode(bytes, bytes_max, &values[i++]);
+    }
+
+    return bytes;
+}
+
 const uint8_t* picoquic_frames_varlen_decode(const uint8_t* bytes, const uint8_t* bytes_max, size_t* n)
 {
     uint64_t len = 0;
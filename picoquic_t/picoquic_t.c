@@ -48,6 +48,7 @@ static const picoquic_test_def_t test_table[] = {
     { "sprintf", util_sprintf_test },
     { "memcmp", util_memcmp_test },
     { "threading", util_threading_test },
+    { "hdr_histogram", util_hdr_histogram_test },
     { "picohash", picohash_test },
     { "picohash_embedded", picohash_embedded_test },
     { "bytestream", bytestream_test },
@@ -59,6 +60,8 @@ static const picoquic_test_def_t test_table[] = {
     { "sockloop_nat", sockloop_nat_test },
     { "sockloop_thread", sockloop_thread_test },
     { "sockloop_thread_name", sockloop_thread_name_test },
+    { "sockloop_batch", sockloop_batch_test },
+    { "send_batch", send_batch_test },
     { "splay", splay_test },
     { "cnxcreation", cnxcreation_test },
     { "parseheader", parseheadertest },
@@ -67,17 +70,33 @@ static const picoquic_test_def_t test_table[] = {
     { "pn2pn64", pn2pn64test },
     { "intformat", intformattest },
     { "varint", varint_test },
+    { "varint_bulk", varint_bulk_test },
     { "sqrt_for_test", sqrt_for_test_test },
     { "ack_sack", sacktest },
     { "skip_frames", skip_frame_test },
     { "parse_frames", parse_frame_test },
     { "logger", logger_test },
     { "binlog", binlog_test },
+    { "binlog_async", binlog_async_test },
+    { "binlog_index", binlog_index_test },
+    { "columnar", columnar_test },
+    { "log_sampling", log_sampling_test },
+    { "live_metrics", live_metrics_test },
+    { "cc_telemetry", cc_telemetry_test },
+    { "path_cache", path_cache_test },
+    { "cc_plugin", cc_plugin_test },
+    { "experiment_arm", experiment_arm_test },
+    { "cc_fixed_point", cc_fixed_point_test },
     { "app_message_overflow", app_message_overflow_test },
     { "TlsStreamFrame", TlsStreamFrameTest },
     { "StreamZeroFrame", StreamZeroFrameTest },
     { "stream_splay", stream_splay_test },
     { "stream_output", stream_output_test },
+    { "stream_by_reference", stream_by_reference_test },
+    { "stream_file", stream_file_test },
+    { "stream_delivery_latency", stream_delivery_latency_test },
+    { "memory_budget", memory_budget_test },
+    { "stream_reorder_stats", stream_reorder_stats_test },
     { "stream_retransmit_copy", test_copy_for_retransmit },
     { "dataqueue_copy", dataqueue_copy_test },
     { "dataqueue_packet", dataqueue_packet_test },
@@ -87,6 +106,7 @@ static const picoquic_test_def_t test_table[] = {
     { "ack_range", ackrange_test },
     { "ack_disorder", ack_disorder_test },
     { "ack_horizon", ack_horizon_test },
+    { "ack_cache", ack_cache_test },
     { "ack_of_ack", ack_of_ack_test },
     { "sim_link", sim_link_test },
     { "clear_text_aead", cleartext_aead_test },
@@ -106,6 +126,7 @@ static const picoquic_test_def_t test_table[] = {
     { "new_cnxid", new_cnxid_test },
     { "pacing", pacing_test },
     { "pacing_repeat", pacing_repeat_test },
+    { "pacing_txtime", pacing_txtime_test },
 #if 0
     /* The TLS API connect test is only useful when debugging issues step by step */
     { "tls_api_connect", tls_api_connect_test },
@@ -135,6 +156,9 @@ static const picoquic_test_def_t test_table[] = {
     { "datagram_small", datagram_small_test },
     { "datagram_small_new", datagram_small_new_test },
     { "datagram_small_packet", datagram_small_packet_test },
+    { "datagram_queue", datagram_queue_test },
+    { "fec_repair", fec_repair_test },
+    { "fec_loss", fec_loss_test },
     { "datagram_wifi", datagram_wifi_test },
     { "ddos_amplification", ddos_amplification_test },
     { "ddos_amplification_0rtt", ddos_amplification_0rtt_test },
@@ -208,6 +232,7 @@ static const picoquic_test_def_t test_table[] = {
     { "red_newreno", red_newreno_test },
     { "multi_segment", multi_segment_test },
     { "pacing_bbr", pacing_bbr_test },
+    { "cc_fixed_point_sim", cc_fixed_point_sim_test },
     { "pacing_cubic", pacing_cubic_test },
     { "pacing_dcubic", pacing_dcubic_test },
     { "pacing_fast", pacing_fast_test },
@@ -270,6 +295,7 @@ static const picoquic_test_def_t test_table[] = {
     { "key_rotation", key_rotation_test },
     { "key_rotation_server", key_rotation_auto_server },
     { "key_rotation_client", key_rotation_auto_client },
+    { "crypto_offload", crypto_offload_test },
     { "false_migration", false_migration_test },
     { "nat_handshake", nat_handshake_test },
     { "key_rotation_vector", key_rotation_vector_test },
@@ -304,6 +330,7 @@ static const picoquic_test_def_t test_table[] = {
     { "reset_need_max", reset_need_max_test },
     { "reset_need_reset", reset_need_reset_test },
     { "reset_need_stop", reset_need_stop_test },
+    { "selective_repeat", selective_repeat_test },
     { "ready_to_send", ready_to_send_test },
     { "ready_to_skip", ready_to_skip_test },
     { "ready_to_zfin", ready_to_zfin_test },
@@ -328,6 +355,7 @@ static const picoquic_test_def_t test_table[] = {
     { "l4s_prague_updown", l4s_prague_updown_test },
     { "l4s_bbr", l4s_bbr_test },
     { "l4s_bbr_updown", l4s_bbr_updown_test },
+    { "cc_bench", cc_bench_test },
     { "long_rtt", long_rtt_test },
     { "high_latency_basic", high_latency_basic_test },
     { "high_latency_bbr", high_latency_bbr_test },
@@ -451,6 +479,8 @@ static const picoquic_test_def_t test_table[] = {
     { "multipath_standup", multipath_standup_test },
     { "multipath_qlog", multipath_qlog_test },
     { "multipath_tunnel", multipath_tunnel_test },
+    { "multipath_redundant", multipath_redundant_test },
+    { "path_scheduler", path_scheduler_test },
     { "monopath_0rtt", monopath_0rtt_test },
     { "monopath_0rtt_loss", monopath_0rtt_loss_test },
     { "simple_multipath_basic", simple_multipath_basic_test },
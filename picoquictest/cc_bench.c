@@ -0,0 +1,617 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "picoquic.h"
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "tls_api.h"
+#include "picoquictest_internal.h"
+
+/* Congestion control evaluation harness.
+ *
+ * Each scenario runs a number of competing flows over a simulated link.
+ * All flows are carried by connections from the same client to the same
+ * server, sharing the two links of the simulation. Each client connection
+ * uploads flow_size bytes on a single stream, so the congestion control
+ * algorithm under test runs at the client. The simulation stops when all
+ * flows are complete, or after the specified duration.
+ *
+ * Random losses are applied on arrival, in both directions, using the
+ * scenario seed. If the link profile specifies handovers, both links are
+ * suspended for the handover duration at each scheduled handover; by
+ * default, the schedule matches the one in sat_utils.h, so satellite
+ * aware algorithms can be evaluated.
+ *
+ * Scenarios are independent, and a matrix of scenarios can be executed
+ * by a pool of threads. Each worker thread uses its own "public random"
+ * generator, reset to the scenario seed after the contexts are created, so
+ * the results do not depend on the number of threads.
+ */
+
+#define CC_BENCH_ALPN "picoquic_ccbench"
+#define CC_BENCH_MAX_INACTIVE 512
+
+typedef struct st_cc_bench_flow_t {
+    picoquic_cnx_t* cnx;
+    uint64_t stream_id;
+    size_t bytes_sent;
+    size_t bytes_received;
+    uint64_t completion_time;
+    int is_complete;
+} cc_bench_flow_t;
+
+typedef struct st_cc_bench_ctx_t {
+    uint64_t simulated_time;
+    uint64_t start_time;
+    uint64_t random_context;
+    uint64_t next_handover;
+    const cc_bench_scenario_t* scenario;
+    picoquic_quic_t* quic[2]; /* QUIC Context for client[0] or server[1] */
+    picoquictest_sim_link_t* link[2]; /* Link to client [0] and to server [1] */
+    struct sockaddr_storage addr[2]; /* addresses of client [0] and server [1]*/
+    int nb_completed;
+    cc_bench_flow_t flows[CC_BENCH_MAX_FLOWS];
+} cc_bench_ctx_t;
+
+static const uint8_t cc_bench_ticket_encrypt_key[32] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31
+};
+
+const cc_bench_link_t cc_bench_default_links[] = {
+    { "dsl", 10.0, 40000, 0, 100000, 0, 0, 0, 0 },
+    { "fiber", 100.0, 10000, 0, 20000, 0, 0, 0, 0 },
+    { "lossy", 20.0, 60000, 10000, 60000, 0, 0, 0, 0 },
+    { "leo", 100.0, 40000, 1000, 50000, 12000000, 15000000, 50000, 11000000 }
+};
+
+const size_t cc_bench_nb_default_links = sizeof(cc_bench_default_links) / sizeof(cc_bench_link_t);
+
+/* Flows are identified by the last byte of the initial connection ID,
+ * which is visible to both client and server. */
+static cc_bench_flow_t* cc_bench_find_flow(cc_bench_ctx_t* ctx, picoquic_cnx_t* cnx)
+{
+    picoquic_connection_id_t icid = picoquic_get_initial_cnxid(cnx);
+    int flow_id = icid.id[7];
+
+    return (flow_id < ctx->scenario->nb_flows) ? &ctx->flows[flow_id] : NULL;
+}
+
+static int cc_bench_callback(picoquic_cnx_t* cnx,
+    uint64_t stream_id, uint8_t* bytes, size_t length,
+    picoquic_call_back_event_t fin_or_event, void* callback_ctx, void* v_stream_ctx)
+{
+    int ret = 0;
+    cc_bench_ctx_t* ctx = (cc_bench_ctx_t*)callback_ctx;
+    cc_bench_flow_t* flow = cc_bench_find_flow(ctx, cnx);
+
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(stream_id);
+    UNREFERENCED_PARAMETER(v_stream_ctx);
+#endif
+
+    if (flow == NULL) {
+        return (fin_or_event == picoquic_callback_prepare_to_send) ? -1 : 0;
+    }
+
+    switch (fin_or_event) {
+    case picoquic_callback_stream_data:
+    case picoquic_callback_stream_fin:
+        /* Only the server receives data */
+        flow->bytes_received += length;
+        if (fin_or_event == picoquic_callback_stream_fin && !flow->is_complete) {
+            flow->is_complete = 1;
+            flow->completion_time = ctx->simulated_time;
+            ctx->nb_completed++;
+        }
+        break;
+    case picoquic_callback_prepare_to_send:
+        if (flow->bytes_sent < ctx->scenario->flow_size) {
+            size_t available = ctx->scenario->flow_size - flow->bytes_sent;
+            int is_fin = 1;
+            uint8_t* buffer;
+
+            if (available > length) {
+                available = length;
+                is_fin = 0;
+            }
+            buffer = picoquic_provide_stream_data_buffer(bytes, available, is_fin, !is_fin);
+            if (buffer == NULL) {
+                ret = -1;
+            }
+            else {
+                memset(buffer, 0x5a, available);
+                flow->bytes_sent += available;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static void cc_bench_delete_ctx(cc_bench_ctx_t* ctx)
+{
+    for (int i = 0; i < 2; i++) {
+        if (ctx->link[i] != NULL) {
+            picoquictest_sim_link_delete(ctx->link[i]);
+        }
+        if (ctx->quic[i] != NULL) {
+            picoquic_free(ctx->quic[i]);
+        }
+    }
+    free(ctx);
+}
+
+static cc_bench_ctx_t* cc_bench_configure(const cc_bench_scenario_t* scenario)
+{
+    int ret = 0;
+    cc_bench_ctx_t* ctx = NULL;
+    char test_server_cert_file[512];
+    char test_server_key_file[512];
+    char test_server_cert_store_file[512];
+
+    if (scenario->nb_flows <= 0 || scenario->nb_flows > CC_BENCH_MAX_FLOWS || scenario->link == NULL ||
+        scenario->ccalgo == NULL) {
+        DBG_PRINTF("%s", "Invalid cc bench scenario.\n");
+        ret = -1;
+    }
+    if (ret == 0) {
+        ret = picoquic_get_input_path(test_server_cert_file, sizeof(test_server_cert_file), picoquic_solution_dir, PICOQUIC_TEST_FILE_SERVER_CERT);
+    }
+    if (ret == 0) {
+        ret = picoquic_get_input_path(test_server_key_file, sizeof(test_server_key_file), picoquic_solution_dir, PICOQUIC_TEST_FILE_SERVER_KEY);
+    }
+    if (ret == 0) {
+        ret = picoquic_get_input_path(test_server_cert_store_file, sizeof(test_server_cert_store_file), picoquic_solution_dir, PICOQUIC_TEST_FILE_CERT_STORE);
+    }
+    if (ret == 0 && (ctx = (cc_bench_ctx_t*)malloc(sizeof(cc_bench_ctx_t))) == NULL) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        const cc_bench_link_t* link = scenario->link;
+
+        memset(ctx, 0, sizeof(cc_bench_ctx_t));
+        ctx->scenario = scenario;
+        ctx->random_context = scenario->seed;
+        ctx->start_time = link->start_time;
+        ctx->simulated_time = link->start_time;
+        ctx->next_handover = UINT64_MAX;
+        if (link->handover_period > 0) {
+            ctx->next_handover = link->handover_offset;
+            while (ctx->next_handover < ctx->start_time) {
+                ctx->next_handover += link->handover_period;
+            }
+        }
+
+        ctx->quic[0] = picoquic_create(CC_BENCH_MAX_FLOWS, NULL, NULL, test_server_cert_store_file, NULL, cc_bench_callback,
+            (void*)ctx, NULL, NULL, NULL, ctx->simulated_time, &ctx->simulated_time, NULL, NULL, 0);
+        ctx->quic[1] = picoquic_create(CC_BENCH_MAX_FLOWS,
+            test_server_cert_file, test_server_key_file, test_server_cert_store_file,
+            CC_BENCH_ALPN, cc_bench_callback, (void*)ctx, NULL, NULL, NULL,
+            ctx->simulated_time, &ctx->simulated_time, NULL, cc_bench_ticket_encrypt_key, sizeof(cc_bench_ticket_encrypt_key));
+
+        if (ctx->quic[0] == NULL || ctx->quic[1] == NULL) {
+            ret = -1;
+        }
+        for (int i = 0; i < 2 && ret == 0; i++) {
+            picoquic_set_default_congestion_algorithm(ctx->quic[i], scenario->ccalgo);
+            picoquic_set_random_initial(ctx->quic[i], 0);
+            /* Do not reseed the public random generator when connections complete */
+            ctx->quic[i]->use_predictable_random = 1;
+            picoquic_set_test_address((struct sockaddr_in*)&ctx->addr[i], 0x0A000001 + i, 1234 + i);
+            ctx->link[i] = picoquictest_sim_link_create(link->mbps / 1000.0, link->rtt / 2, NULL,
+                link->buffer_delay, ctx->simulated_time);
+            if (ctx->link[i] == NULL) {
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            /* Creating the contexts seeded the public random generator from the crypto
+             * random generator. Reset it, so the results only depend on the scenario seed. */
+            picoquic_public_random_seed_64(scenario->seed, 1);
+            /* RTT samples are measured at the sender */
+            ret = picoquic_set_latency_histograms(ctx->quic[0], 1);
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < scenario->nb_flows; i++) {
+        picoquic_connection_id_t icid = { { 0xcc, 0xbe, 0x9c, 0, 0, 0, 0, 0 }, 8 };
+        picoquic_cnx_t* cnx;
+
+        icid.id[3] = (uint8_t)scenario->ccalgo->congestion_algorithm_number;
+        icid.id[7] = (uint8_t)i;
+        cnx = picoquic_create_cnx(ctx->quic[0], icid, picoquic_null_connection_id,
+            (struct sockaddr*)&ctx->addr[1], ctx->simulated_time, 0, PICOQUIC_TEST_SNI, CC_BENCH_ALPN, 1);
+        if (cnx == NULL) {
+            ret = -1;
+        }
+        else if (picoquic_start_client_cnx(cnx) != 0) {
+            picoquic_delete_cnx(cnx);
+            ret = -1;
+        }
+        else {
+            ctx->flows[i].cnx = cnx;
+            ctx->flows[i].stream_id = picoquic_get_next_local_stream_id(cnx, 0);
+            ret = picoquic_mark_active_stream(cnx, ctx->flows[i].stream_id, 1, &ctx->flows[i]);
+        }
+    }
+
+    if (ret != 0 && ctx != NULL) {
+        cc_bench_delete_ctx(ctx);
+        ctx = NULL;
+    }
+
+    return ctx;
+}
+
+static int cc_bench_packet_arrival(cc_bench_ctx_t* ctx, int link_id, int* is_active)
+{
+    int ret = 0;
+    picoquictest_sim_packet_t* packet = picoquictest_sim_link_dequeue(ctx->link[link_id], ctx->simulated_time);
+
+    if (packet == NULL) {
+        ret = -1;
+    }
+    else {
+        *is_active = 1;
+        if (ctx->scenario->link->loss_ppm == 0 ||
+            picoquic_test_uniform_random(&ctx->random_context, 1000000) >= ctx->scenario->link->loss_ppm) {
+            ret = picoquic_incoming_packet(ctx->quic[link_id],
+                packet->bytes, (uint32_t)packet->length,
+                (struct sockaddr*)&packet->addr_from,
+                (struct sockaddr*)&packet->addr_to, 0, 0,
+                ctx->simulated_time);
+        }
+        free(packet);
+    }
+
+    return ret;
+}
+
+static int cc_bench_packet_departure(cc_bench_ctx_t* ctx, int node_id, int* is_active)
+{
+    int ret = 0;
+    picoquictest_sim_packet_t* packet = picoquictest_sim_link_create_packet();
+
+    if (packet == NULL) {
+        ret = -1;
+    }
+    else {
+        int if_index = 0;
+
+        ret = picoquic_prepare_next_packet(ctx->quic[node_id], ctx->simulated_time,
+            packet->bytes, PICOQUIC_MAX_PACKET_SIZE, &packet->length,
+            &packet->addr_to, &packet->addr_from, &if_index, NULL, NULL);
+
+        if (ret != 0) {
+            free(packet);
+        }
+        else if (packet->length > 0) {
+            int link_id = 1 - node_id;
+
+            if (packet->addr_from.ss_family == 0) {
+                picoquic_store_addr(&packet->addr_from, (struct sockaddr*)&ctx->addr[node_id]);
+            }
+            *is_active = 1;
+            picoquictest_sim_link_submit(ctx->link[link_id], packet, ctx->simulated_time);
+        }
+        else {
+            free(packet);
+        }
+    }
+
+    return ret;
+}
+
+/* Execute the next event: handover, packet arrival or packet departure */
+static int cc_bench_step(cc_bench_ctx_t* ctx, int* is_active)
+{
+    int ret = 0;
+    uint64_t next_arrival_time = UINT64_MAX;
+    int arrival_index = -1;
+    uint64_t next_departure_time = UINT64_MAX;
+    int departure_index = -1;
+
+    for (int i = 0; i < 2; i++) {
+        uint64_t arrival = picoquictest_sim_link_next_arrival(ctx->link[i], next_arrival_time);
+        if (arrival < next_arrival_time) {
+            next_arrival_time = arrival;
+            arrival_index = i;
+        }
+        uint64_t departure = picoquic_get_next_wake_time(ctx->quic[i], ctx->simulated_time);
+        if (departure < next_departure_time) {
+            next_departure_time = departure;
+            departure_index = i;
+        }
+    }
+
+    if (ctx->next_handover != UINT64_MAX &&
+        ctx->next_handover <= next_arrival_time && ctx->next_handover <= next_departure_time) {
+        const cc_bench_link_t* link = ctx->scenario->link;
+
+        if (ctx->next_handover > ctx->simulated_time) {
+            ctx->simulated_time = ctx->next_handover;
+        }
+        picoquic_test_simlink_suspend(ctx->link[0], ctx->simulated_time + link->handover_duration, 0);
+        picoquic_test_simlink_suspend(ctx->link[1], ctx->simulated_time + link->handover_duration, 1);
+        ctx->next_handover += link->handover_period;
+        *is_active = 1;
+    }
+    else if (next_arrival_time <= next_departure_time) {
+        if (next_arrival_time > ctx->simulated_time) {
+            ctx->simulated_time = next_arrival_time;
+        }
+        ret = cc_bench_packet_arrival(ctx, arrival_index, is_active);
+    }
+    else if (departure_index >= 0) {
+        if (next_departure_time > ctx->simulated_time) {
+            ctx->simulated_time = next_departure_time;
+        }
+        ret = cc_bench_packet_departure(ctx, departure_index, is_active);
+    }
+
+    return ret;
+}
+
+static void cc_bench_compute_results(cc_bench_ctx_t* ctx, cc_bench_result_t* result)
+{
+    const cc_bench_scenario_t* scenario = ctx->scenario;
+    const picoquic_hdr_hist_t* rtt_hist = picoquic_get_latency_histogram(ctx->quic[0], picoquic_latency_rtt);
+    uint64_t end_time = ctx->simulated_time;
+    uint64_t total_bytes = 0;
+    uint64_t packets_sent = 0;
+    uint64_t retransmissions = 0;
+    double sum_rate = 0;
+    double sum_rate_squares = 0;
+
+    if (end_time > ctx->start_time + scenario->max_duration) {
+        /* The last event may be an idle timer far in the future */
+        end_time = ctx->start_time + scenario->max_duration;
+    }
+    if (ctx->nb_completed == scenario->nb_flows) {
+        end_time = ctx->start_time;
+        for (int i = 0; i < scenario->nb_flows; i++) {
+            if (ctx->flows[i].completion_time > end_time) {
+                end_time = ctx->flows[i].completion_time;
+            }
+        }
+    }
+
+    for (int i = 0; i < scenario->nb_flows; i++) {
+        cc_bench_flow_t* flow = &ctx->flows[i];
+        uint64_t flow_end = (flow->is_complete) ? flow->completion_time : end_time;
+        double rate = (flow_end > ctx->start_time) ?
+            ((double)flow->bytes_received * 8.0) / (double)(flow_end - ctx->start_time) : 0;
+
+        total_bytes += flow->bytes_received;
+        sum_rate += rate;
+        sum_rate_squares += rate * rate;
+        if (flow->cnx != NULL) {
+            packets_sent += flow->cnx->nb_packets_sent;
+            retransmissions += flow->cnx->nb_retransmission_total;
+        }
+    }
+
+    memset(result, 0, sizeof(cc_bench_result_t));
+    result->nb_completed = ctx->nb_completed;
+    result->duration = end_time - ctx->start_time;
+    if (result->duration > 0) {
+        result->goodput_mbps = ((double)total_bytes * 8.0) / (double)result->duration;
+    }
+    if (rtt_hist != NULL) {
+        result->rtt_p50 = picoquic_hdr_hist_percentile(rtt_hist, 50.0);
+        result->rtt_p99 = picoquic_hdr_hist_percentile(rtt_hist, 99.0);
+    }
+    if (packets_sent > 0) {
+        result->retransmit_ratio = (double)retransmissions / (double)packets_sent;
+    }
+    /* Jain's fairness index of the per flow throughputs */
+    if (sum_rate_squares > 0) {
+        result->fairness = (sum_rate * sum_rate) / ((double)scenario->nb_flows * sum_rate_squares);
+    }
+}
+
+int cc_bench_run_one(const cc_bench_scenario_t* scenario, cc_bench_result_t* result)
+{
+    int ret = 0;
+    cc_bench_ctx_t* ctx;
+
+    memset(result, 0, sizeof(cc_bench_result_t));
+    ctx = cc_bench_configure(scenario);
+    if (ctx == NULL) {
+        ret = -1;
+    }
+    else {
+        uint64_t time_max = ctx->start_time + scenario->max_duration;
+        int nb_inactive = 0;
+
+        while (ret == 0 && ctx->nb_completed < scenario->nb_flows && ctx->simulated_time < time_max &&
+            nb_inactive < CC_BENCH_MAX_INACTIVE) {
+            int is_active = 0;
+
+            ret = cc_bench_step(ctx, &is_active);
+            nb_inactive = (is_active) ? 0 : nb_inactive + 1;
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Simulation of %s on %s fails at T=%" PRIu64 "\n",
+                scenario->ccalgo->congestion_algorithm_id, scenario->link->name, ctx->simulated_time);
+        }
+        cc_bench_compute_results(ctx, result);
+        cc_bench_delete_ctx(ctx);
+    }
+    result->ret = ret;
+
+    return ret;
+}
+
+/* Run a matrix of scenarios on a pool of threads.
+ * The public random generator of the library is a process wide state by
+ * default. Each worker switches to a thread local generator, so that
+ * concurrent simulations do not race on it and each run only depends on
+ * its own seed.
+ */
+typedef struct st_cc_bench_pool_t {
+    const cc_bench_scenario_t* scenarios;
+    cc_bench_result_t* results;
+    size_t nb_scenarios;
+    size_t next_scenario;
+    picoquic_mutex_t lock;
+} cc_bench_pool_t;
+
+static picoquic_thread_return_t cc_bench_worker(void* arg)
+{
+    cc_bench_pool_t* pool = (cc_bench_pool_t*)arg;
+
+    picoquic_public_random_set_thread_local(1);
+    while (1) {
+        size_t i;
+
+        (void)picoquic_lock_mutex(&pool->lock);
+        i = pool->next_scenario++;
+        (void)picoquic_unlock_mutex(&pool->lock);
+        if (i >= pool->nb_scenarios) {
+            break;
+        }
+        (void)cc_bench_run_one(&pool->scenarios[i], &pool->results[i]);
+    }
+    picoquic_public_random_set_thread_local(0);
+
+    picoquic_thread_do_return;
+}
+
+int cc_bench_run_matrix(const cc_bench_scenario_t* scenarios, size_t nb_scenarios, cc_bench_result_t* results, int nb_threads)
+{
+    int ret = 0;
+
+    if (nb_threads <= 1) {
+        for (size_t i = 0; i < nb_scenarios; i++) {
+            (void)cc_bench_run_one(&scenarios[i], &results[i]);
+        }
+    }
+    else {
+        cc_bench_pool_t pool;
+        picoquic_thread_t threads[CC_BENCH_MAX_THREADS];
+        int nb_started = 0;
+
+        memset(&pool, 0, sizeof(pool));
+        pool.scenarios = scenarios;
+        pool.results = results;
+        pool.nb_scenarios = nb_scenarios;
+        if (nb_threads > CC_BENCH_MAX_THREADS) {
+            nb_threads = CC_BENCH_MAX_THREADS;
+        }
+        /* Initialize the TLS providers before the workers create their contexts */
+        picoquic_tls_api_init();
+        if (picoquic_create_mutex(&pool.lock) != 0) {
+            ret = -1;
+        }
+        else {
+            for (int i = 0; i < nb_threads; i++) {
+                if (picoquic_create_thread(&threads[nb_started], cc_bench_worker, &pool) == 0) {
+                    nb_started++;
+                }
+            }
+            if (nb_started == 0) {
+                /* Not fatal, run the scenarios in this thread */
+                (void)cc_bench_worker(&pool);
+            }
+            for (int i = 0; i < nb_started; i++) {
+                (void)picoquic_wait_thread(threads[i]);
+#ifdef _WINDOWS
+                CloseHandle(threads[i]);
+#endif
+            }
+            (void)picoquic_delete_mutex(&pool.lock);
+        }
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_scenarios; i++) {
+        if (results[i].ret != 0) {
+            ret = results[i].ret;
+        }
+    }
+
+    return ret;
+}
+
+void cc_bench_print_header(FILE* F)
+{
+    fprintf(F, "cc,link,flows,flow_bytes,completed,duration_us,goodput_mbps,rtt_p50_us,rtt_p99_us,retransmit_ratio,fairness\n");
+}
+
+void cc_bench_print_result(FILE* F, const cc_bench_scenario_t* scenario, const cc_bench_result_t* result)
+{
+    fprintf(F, "%s,%s,%d,%zu,%d,%" PRIu64 ",%.3f,%" PRIu64 ",%" PRIu64 ",%.5f,%.4f\n",
+        scenario->ccalgo->congestion_algorithm_id, scenario->link->name, scenario->nb_flows, scenario->flow_size,
+        result->nb_completed, result->duration, result->goodput_mbps, result->rtt_p50, result->rtt_p99,
+        result->retransmit_ratio, result->fairness);
+}
+
+/* Short matrix, checking that the harness runs and produces sensible values */
+int cc_bench_test()
+{
+    int ret = 0;
+    const cc_bench_link_t test_link = { "test", 10.0, 20000, 1000, 40000, 0, 0, 0, 0 };
+    cc_bench_scenario_t scenarios[4];
+    cc_bench_result_t results[4];
+    cc_bench_result_t replay;
+
+    memset(scenarios, 0, sizeof(scenarios));
+    for (int i = 0; i < 4; i++) {
+        scenarios[i].ccalgo = (i < 2) ? picoquic_newreno_algorithm : picoquic_bbr_algorithm;
+        scenarios[i].link = &test_link;
+        scenarios[i].nb_flows = 1 + (i & 1);
+        scenarios[i].flow_size = 1000000;
+        scenarios[i].max_duration = 10000000;
+        scenarios[i].seed = 0xcc0be9c + i;
+    }
+
+    if (cc_bench_run_matrix(scenarios, 4, results, 2) != 0) {
+        DBG_PRINTF("%s", "Cannot run the scenarios\n");
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < 4; i++) {
+        if (results[i].nb_completed != scenarios[i].nb_flows || results[i].goodput_mbps < 2.0 ||
+            results[i].goodput_mbps > 10.0 || results[i].rtt_p50 < test_link.rtt || results[i].rtt_p99 < results[i].rtt_p50 ||
+            results[i].fairness < 0.7 || results[i].fairness > 1.0) {
+            DBG_PRINTF("Unexpected results for scenario %d: ", i);
+            cc_bench_print_result(stderr, &scenarios[i], &results[i]);
+            ret = -1;
+        }
+    }
+    /* Runs are reproducible, whether the matrix uses one thread or several */
+    if (ret == 0 && (cc_bench_run_matrix(&scenarios[3], 1, &replay, 1) != 0 ||
+        memcmp(&replay, &results[3], sizeof(replay)) != 0)) {
+        DBG_PRINTF("%s", "Results are not reproducible\n");
+        ret = -1;
+    }
+
+    return ret;
+}
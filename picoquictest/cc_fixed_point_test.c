@@ -0,0 +1,357 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Tests of the fixed point gains used by congestion control algorithms.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "tls_api.h"
+#include "picoquictest_internal.h"
+#ifdef _WINDOWS
+#include "wincompat.h"
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cc_common.h"
+#include "picoquictest.h"
+
+/* Check the fixed point gains used in the per ACK path of BBR against the
+ * floating point computations that they replace. Values are log spaced with
+ * random jitter, from a few bytes to about 1TB, which covers the congestion
+ * windows, BDP and rates (bytes per second) seen in the simulations. The
+ * gained values and the threshold decisions shall be identical. Pacing
+ * gains are converted back to double, which shall give the same value as
+ * the decimal constant.
+ */
+static const double cc_fixed_point_gains[] = {
+    0.2, 0.5, 0.85, 1.0, 1.125, 1.25, 2.0, 2.25 };
+static const double cc_fixed_point_pacing_gains[] = {
+    0.5, 0.9, 1.0, 1.25, 2.77 };
+
+int cc_fixed_point_test()
+{
+    int ret = 0;
+    uint64_t random_ctx = 0xf1ed901d;
+
+    for (size_t i = 0; ret == 0 && i < sizeof(cc_fixed_point_pacing_gains) / sizeof(double); i++) {
+        double d_gain = cc_fixed_point_pacing_gains[i];
+        if (PICOQUIC_CC_GAIN_TO_DOUBLE(PICOQUIC_CC_GAIN(d_gain)) != d_gain) {
+            DBG_PRINTF("Pacing gain %f represented as %" PRIu64, d_gain, PICOQUIC_CC_GAIN(d_gain));
+            ret = -1;
+        }
+    }
+
+    for (size_t i = 0; ret == 0 && i < sizeof(cc_fixed_point_gains) / sizeof(double); i++) {
+        double d_gain = cc_fixed_point_gains[i];
+        uint64_t gain = PICOQUIC_CC_GAIN(d_gain);
+
+        if (PICOQUIC_CC_GAIN_TO_DOUBLE(gain) != d_gain) {
+            DBG_PRINTF("Gain %f represented as %" PRIu64, d_gain, gain);
+            ret = -1;
+        }
+
+        for (uint64_t base = 1; ret == 0 && base < (1ull << 40); base += (base / 4) + 1) {
+            uint64_t v = base + picoquic_test_uniform_random(&random_ctx, (base / 4) + 1);
+            uint64_t fixed = PICOQUIC_CC_APPLY_GAIN(v, gain);
+            uint64_t expected = (uint64_t)(d_gain * (double)v);
+
+            if (fixed != expected) {
+                DBG_PRINTF("Gain %f, value %" PRIu64 ", fixed %" PRIu64 " vs %" PRIu64, d_gain, v, fixed, expected);
+                ret = -1;
+            }
+            else {
+                /* Threshold tests, as in the full bandwidth check, just below, at and above the threshold */
+                for (uint64_t x = ((expected > 0) ? expected - 1 : 0); ret == 0 && x <= expected + 1; x++) {
+                    int fixed_above = (x * PICOQUIC_CC_GAIN_UNIT >= gain * v);
+                    int float_above = ((double)x >= d_gain * (double)v);
+
+                    if (fixed_above != float_above) {
+                        DBG_PRINTF("Gain %f, threshold mismatch for %" PRIu64 " vs %" PRIu64, d_gain, x, v);
+                        ret = -1;
+                    }
+                }
+            }
+        }
+        /* Very large values saturate instead of wrapping around */
+        if (ret == 0) {
+            uint64_t large = PICOQUIC_CC_APPLY_GAIN(UINT64_MAX, gain);
+
+            if ((gain > PICOQUIC_CC_GAIN_UNIT) ? (large != UINT64_MAX) :
+                ((double)large < 0.999 * d_gain * (double)UINT64_MAX)) {
+                DBG_PRINTF("Gain %f, overflow on large value", d_gain);
+                ret = -1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Differential simulation of BBR with fixed point gains and with the
+ * floating point reference, selected by the test option use_float_cc_gains.
+ * The links mirror the satellite, high latency, pacing and wifi tests, with
+ * a smaller transfer. The first run records the state of the sending path
+ * after each simulation round, the second run shall produce exactly the
+ * same sequence of congestion window, pacing rate, CC state and timing.
+ * The completion times are generous, the test is about identical behavior.
+ */
+typedef struct st_cc_fixed_point_sim_spec_t {
+    uint8_t test_id;
+    uint64_t latency;
+    uint64_t mbps_up;
+    uint64_t mbps_down;
+    uint64_t jitter;
+    uint64_t loss_mask;
+    uint64_t data_size;
+    uint64_t wifi_shadow_rtt;
+    int seed_bw;
+    int leaky_bucket;
+    uint64_t max_completion_time;
+} cc_fixed_point_sim_spec_t;
+
+typedef struct st_cc_fixed_point_sample_t {
+    uint64_t simulated_time;
+    uint64_t cwin;
+    uint64_t bytes_in_transit;
+    uint64_t pacing_rate;
+    int64_t packet_time_nanosec;
+    uint64_t quantum_max;
+    uint64_t cc_state;
+    uint64_t cc_param;
+} cc_fixed_point_sample_t;
+
+typedef struct st_cc_fixed_point_trace_t {
+    cc_fixed_point_sample_t* samples;
+    size_t nb_samples;
+    size_t nb_alloc;
+    int is_reference;
+    size_t nb_compared;
+} cc_fixed_point_trace_t;
+
+static int cc_fixed_point_sample(picoquic_cnx_t* cnx, uint64_t simulated_time, cc_fixed_point_trace_t* trace)
+{
+    int ret = 0;
+    picoquic_path_t* path_x = cnx->path[0];
+    cc_fixed_point_sample_t sample;
+
+    memset(&sample, 0, sizeof(sample));
+    sample.simulated_time = simulated_time;
+    sample.cwin = path_x->cwin;
+    sample.bytes_in_transit = path_x->bytes_in_transit;
+    sample.pacing_rate = path_x->pacing.rate;
+    sample.packet_time_nanosec = path_x->pacing.packet_time_nanosec;
+    sample.quantum_max = path_x->pacing.quantum_max;
+    if (cnx->congestion_alg != NULL && cnx->congestion_alg->alg_observe != NULL) {
+        cnx->congestion_alg->alg_observe(path_x, &sample.cc_state, &sample.cc_param);
+    }
+
+    if (trace->is_reference) {
+        if (trace->nb_samples >= trace->nb_alloc) {
+            size_t new_alloc = (trace->nb_alloc == 0) ? 4096 : 2 * trace->nb_alloc;
+            cc_fixed_point_sample_t* new_samples = (cc_fixed_point_sample_t*)realloc(trace->samples,
+                new_alloc * sizeof(cc_fixed_point_sample_t));
+            if (new_samples == NULL) {
+                ret = -1;
+            }
+            else {
+                trace->samples = new_samples;
+                trace->nb_alloc = new_alloc;
+            }
+        }
+        if (ret == 0) {
+            trace->samples[trace->nb_samples++] = sample;
+        }
+    }
+    else if (trace->nb_compared >= trace->nb_samples) {
+        DBG_PRINTF("Fixed point run longer than reference, %zu rounds", trace->nb_samples);
+        ret = -1;
+    }
+    else {
+        cc_fixed_point_sample_t* ref = &trace->samples[trace->nb_compared];
+        if (memcmp(ref, &sample, sizeof(sample)) != 0) {
+            DBG_PRINTF("Round %zu at t=%" PRIu64 ", cwin %" PRIu64 " vs %" PRIu64 ", rate %" PRIu64 " vs %" PRIu64
+                ", state %" PRIu64 " vs %" PRIu64,
+                trace->nb_compared, simulated_time, sample.cwin, ref->cwin, sample.pacing_rate, ref->pacing_rate,
+                sample.cc_state, ref->cc_state);
+            ret = -1;
+        }
+        trace->nb_compared++;
+    }
+
+    return ret;
+}
+
+static int cc_fixed_point_sim_one(picoquic_congestion_algorithm_t* ccalgo, const cc_fixed_point_sim_spec_t* spec,
+    cc_fixed_point_trace_t* trace)
+{
+    uint64_t simulated_time = 0;
+    uint64_t loss_mask = 0;
+    picoquic_connection_id_t initial_cid = { {0xcc, 0xf1, 0, 0, 0, 0, 0, 0}, 8 };
+    picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    test_api_stream_desc_t scenario[] = { { 4, 0, 0, 257 } };
+    int nb_trials = 0;
+    int nb_inactive = 0;
+    int ret;
+
+    scenario[0].q_len = (size_t)spec->data_size;
+    initial_cid.id[2] = ccalgo->congestion_algorithm_number;
+    initial_cid.id[3] = spec->test_id;
+
+    ret = tls_api_one_scenario_init_ex(&test_ctx, &simulated_time, PICOQUIC_INTERNAL_TEST_VERSION_1, NULL, NULL, &initial_cid, 0);
+
+    if (ret == 0 && test_ctx == NULL) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        /* Make the simulation reproducible: reset the public random generator
+         * after creating the contexts, and do not reseed it on connection */
+        test_ctx->qclient->use_predictable_random = 1;
+        test_ctx->qserver->use_predictable_random = 1;
+        picoquic_public_random_seed_64(RANDOM_PUBLIC_TEST_SEED, 1);
+        test_ctx->qclient->use_float_cc_gains = trace->is_reference;
+        test_ctx->qserver->use_float_cc_gains = trace->is_reference;
+        picoquic_set_default_wifi_shadow_rtt(test_ctx->qclient, spec->wifi_shadow_rtt);
+        picoquic_set_default_congestion_algorithm(test_ctx->qserver, ccalgo);
+        picoquic_set_congestion_algorithm(test_ctx->cnx_client, ccalgo);
+
+        test_ctx->c_to_s_link->jitter = spec->jitter;
+        test_ctx->c_to_s_link->microsec_latency = spec->latency;
+        test_ctx->c_to_s_link->picosec_per_byte = (1000000ull * 8) / spec->mbps_up;
+        test_ctx->s_to_c_link->microsec_latency = spec->latency;
+        test_ctx->s_to_c_link->picosec_per_byte = (1000000ull * 8) / spec->mbps_down;
+        test_ctx->s_to_c_link->jitter = spec->jitter;
+        test_ctx->stream0_flow_release = 1;
+        test_ctx->immediate_exit = 1;
+
+        if (spec->leaky_bucket) {
+            /* Leaky bucket at a quarter of the link rate, as in the pacing tests */
+            test_ctx->c_to_s_link->bucket_increase_per_microsec = ((double)spec->mbps_up) / 32.0;
+            test_ctx->c_to_s_link->bucket_max = 16 * PICOQUIC_MAX_PACKET_SIZE;
+            test_ctx->c_to_s_link->bucket_current = (double)test_ctx->c_to_s_link->bucket_max;
+            test_ctx->c_to_s_link->bucket_arrival_last = simulated_time;
+        }
+
+        if (spec->seed_bw) {
+            uint8_t* ip_addr;
+            uint8_t ip_addr_length;
+            uint64_t estimated_rtt = 2 * spec->latency;
+            uint64_t estimated_bdp = (125000ull * spec->mbps_up) * estimated_rtt / 1000000ull;
+            picoquic_get_ip_addr((struct sockaddr*)&test_ctx->server_addr, &ip_addr, &ip_addr_length);
+
+            picoquic_seed_bandwidth(test_ctx->cnx_client, estimated_rtt, estimated_bdp,
+                ip_addr, ip_addr_length);
+        }
+
+        ret = tls_api_one_scenario_body_connect(test_ctx, &simulated_time, 0, 0, 2 * spec->latency);
+    }
+
+    if (ret == 0) {
+        ret = test_api_init_send_recv_scenario(test_ctx, scenario, sizeof(scenario));
+    }
+
+    /* Data sending loop, sampling the client path after each round */
+    if (ret == 0) {
+        loss_mask = spec->loss_mask;
+        test_ctx->c_to_s_link->loss_mask = &loss_mask;
+        test_ctx->s_to_c_link->loss_mask = &loss_mask;
+
+        while (ret == 0 && nb_trials < 4000000 && nb_inactive < 256 && TEST_CLIENT_READY && TEST_SERVER_READY) {
+            int was_active = 0;
+
+            nb_trials++;
+            ret = tls_api_one_sim_round(test_ctx, &simulated_time, 0, &was_active);
+            if (ret == 0) {
+                ret = cc_fixed_point_sample(test_ctx->cnx_client, simulated_time, trace);
+            }
+            if (was_active) {
+                nb_inactive = 0;
+            }
+            else {
+                nb_inactive++;
+            }
+            if (test_ctx->test_finished) {
+                break;
+            }
+        }
+    }
+
+    if (ret == 0 && !trace->is_reference && trace->nb_compared != trace->nb_samples) {
+        DBG_PRINTF("Fixed point run shorter than reference, %zu vs %zu rounds", trace->nb_compared, trace->nb_samples);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        ret = tls_api_one_scenario_body_verify(test_ctx, &simulated_time, spec->max_completion_time);
+    }
+
+    if (test_ctx != NULL) {
+        tls_api_delete_ctx(test_ctx);
+        test_ctx = NULL;
+    }
+
+    return ret;
+}
+
+static const cc_fixed_point_sim_spec_t cc_fixed_point_sim_specs[] = {
+    /* Satellite, 250 Mbps up, 3 Mbps down, 300 ms each way */
+    { 1, 300000, 250, 3, 0, 0, 10000000, 0, 0, 0, 10000000 },
+    /* Satellite with losses */
+    { 2, 300000, 250, 3, 0, 0x10000000, 10000000, 0, 0, 0, 20000000 },
+    /* Satellite with bandwidth seeded from a previous connection */
+    { 3, 300000, 250, 3, 0, 0, 10000000, 0, 1, 0, 10000000 },
+    /* High latency, 10 Mbps, 5 seconds each way */
+    { 4, 5000000, 10, 10, 0, 0, 5000000, 0, 0, 0, 150000000 },
+    /* Leaky bucket pacing, 100 Mbps link policed at 25 Mbps */
+    { 5, 7500, 100, 100, 0, 0, 2000000, 0, 0, 1, 10000000 },
+    /* Wifi like, jitter and short latency with shadow RTT */
+    { 6, 2000, 50, 50, 5000, 0, 5000000, 50000, 0, 0, 10000000 }
+};
+
+int cc_fixed_point_sim_test()
+{
+    int ret = 0;
+    size_t nb_specs = sizeof(cc_fixed_point_sim_specs) / sizeof(cc_fixed_point_sim_spec_t);
+
+    for (size_t i = 0; ret == 0 && i < nb_specs; i++) {
+        cc_fixed_point_trace_t trace;
+
+        memset(&trace, 0, sizeof(trace));
+        trace.is_reference = 1;
+        ret = cc_fixed_point_sim_one(picoquic_bbr_algorithm, &cc_fixed_point_sim_specs[i], &trace);
+        if (ret == 0) {
+            trace.is_reference = 0;
+            ret = cc_fixed_point_sim_one(picoquic_bbr_algorithm, &cc_fixed_point_sim_specs[i], &trace);
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Fixed point simulation %zu fails, %zu rounds", i, trace.nb_samples);
+        }
+        if (trace.samples != NULL) {
+            free(trace.samples);
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,235 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Test of the congestion control plugin interface.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include "picoquic_cc_plugin.h"
+
+/* A minimal plugin, which doubles the window on each acknowledgement and
+ * halves it on losses, using only the host functions. */
+typedef struct st_cc_plugin_test_state_t {
+    const picoquic_cc_plugin_host_t* host;
+    uint64_t nb_notifications;
+} cc_plugin_test_state_t;
+
+static int cc_plugin_test_nb_states = 0;
+static uint32_t cc_plugin_test_abi_version = PICOQUIC_CC_PLUGIN_ABI_VERSION;
+static uint32_t cc_plugin_test_number = 200;
+static uint32_t cc_plugin_test_size = sizeof(picoquic_cc_plugin_t);
+static char const* cc_plugin_test_name = "test_plugin";
+
+static void* cc_plugin_test_create(const picoquic_cc_plugin_host_t* host, picoquic_cc_plugin_path_t* path, uint64_t current_time)
+{
+    cc_plugin_test_state_t* state = (cc_plugin_test_state_t*)malloc(sizeof(cc_plugin_test_state_t));
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(current_time);
+#endif
+
+    if (state != NULL) {
+        state->host = host;
+        state->nb_notifications = 0;
+        host->set_cwin(path, 4 * host->get_send_mtu(path));
+        cc_plugin_test_nb_states++;
+    }
+    return state;
+}
+
+static void cc_plugin_test_notify(void* state, picoquic_cc_plugin_path_t* path, int notification,
+    const picoquic_cc_plugin_ack_t* ack, uint64_t current_time)
+{
+    cc_plugin_test_state_t* test_state = (cc_plugin_test_state_t*)state;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(current_time);
+#endif
+
+    test_state->nb_notifications++;
+    if (notification == PICOQUIC_CC_PLUGIN_NOTIFICATION_ACKNOWLEDGEMENT && ack != NULL) {
+        test_state->host->set_cwin(path, test_state->host->get_cwin(path) + ack->nb_bytes_acknowledged);
+    }
+    else if (notification == PICOQUIC_CC_PLUGIN_NOTIFICATION_REPEAT) {
+        test_state->host->set_cwin(path, test_state->host->get_cwin(path) / 2);
+    }
+    test_state->host->set_pacing_from_cwin(path, 0);
+}
+
+static void cc_plugin_test_release(void* state)
+{
+    free(state);
+    cc_plugin_test_nb_states--;
+}
+
+static void cc_plugin_test_observe(void* state, uint64_t* cc_state, uint64_t* cc_param)
+{
+    *cc_state = 1;
+    *cc_param = ((cc_plugin_test_state_t*)state)->nb_notifications;
+}
+
+static const picoquic_cc_plugin_t* cc_plugin_test_entry(const picoquic_cc_plugin_host_t* host)
+{
+    static picoquic_cc_plugin_t plugin;
+
+    if ((host->abi_version >> 16) != PICOQUIC_CC_PLUGIN_ABI_MAJOR) {
+        return NULL;
+    }
+    plugin.abi_version = cc_plugin_test_abi_version;
+    plugin.plugin_size = cc_plugin_test_size;
+    plugin.name = cc_plugin_test_name;
+    plugin.algorithm_number = cc_plugin_test_number;
+    plugin.create = cc_plugin_test_create;
+    plugin.notify = cc_plugin_test_notify;
+    plugin.release = cc_plugin_test_release;
+    plugin.observe = cc_plugin_test_observe;
+
+    return &plugin;
+}
+
+int cc_plugin_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_congestion_algorithm_t const* alg = NULL;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    picoquic_cnx_t* cnx = NULL;
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if (picoquic_cc_plugin_register(cc_plugin_test_entry, &alg) != 0 || alg == NULL ||
+        picoquic_get_congestion_algorithm("test_plugin") != alg || alg->congestion_algorithm_number != 200) {
+        DBG_PRINTF("%s", "Cannot register the test plugin\n");
+        ret = -1;
+    }
+    else {
+        struct sockaddr_in saddr;
+        memset(&saddr, 0, sizeof(struct sockaddr_in));
+        saddr.sin_family = AF_INET;
+        cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            (struct sockaddr*)&saddr, simulated_time, 0, "test-sni", "test-alpn", 1);
+        if (cnx == NULL) {
+            DBG_PRINTF("%s", "Cannot create connection\n");
+            ret = -1;
+        }
+    }
+
+    /* The window and pacing are only set through the host functions */
+    if (ret == 0) {
+        picoquic_path_t* path_x;
+        picoquic_per_ack_state_t ack_state = { 0 };
+        uint64_t cc_state = 0;
+        uint64_t cc_param = 0;
+
+        picoquic_set_congestion_algorithm(cnx, alg);
+        path_x = cnx->path[0];
+        if (cc_plugin_test_nb_states != 1 || path_x->cwin != 4 * path_x->send_mtu) {
+            DBG_PRINTF("Unexpected state after init, cwin: %" PRIu64 "\n", path_x->cwin);
+            ret = -1;
+        }
+        else {
+            ack_state.nb_bytes_acknowledged = 1000;
+            cnx->congestion_alg->alg_notify(cnx, path_x, picoquic_congestion_notification_acknowledgement, &ack_state, simulated_time);
+            if (path_x->cwin != 4 * path_x->send_mtu + 1000) {
+                DBG_PRINTF("Unexpected cwin after ack: %" PRIu64 "\n", path_x->cwin);
+                ret = -1;
+            }
+            cnx->congestion_alg->alg_notify(cnx, path_x, picoquic_congestion_notification_repeat, NULL, simulated_time);
+            if (ret == 0 && path_x->cwin != (4 * path_x->send_mtu + 1000) / 2) {
+                DBG_PRINTF("Unexpected cwin after loss: %" PRIu64 "\n", path_x->cwin);
+                ret = -1;
+            }
+            cnx->congestion_alg->alg_observe(path_x, &cc_state, &cc_param);
+            if (ret == 0 && (cc_state != 1 || cc_param != 2)) {
+                DBG_PRINTF("Unexpected observation: %" PRIu64 ", %" PRIu64 "\n", cc_state, cc_param);
+                ret = -1;
+            }
+        }
+    }
+
+    /* The path states are released with the connection */
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+        if (ret == 0 && cc_plugin_test_nb_states != 0) {
+            DBG_PRINTF("%d plugin states not released\n", cc_plugin_test_nb_states);
+            ret = -1;
+        }
+    }
+
+    /* Incompatible or conflicting plugins are rejected */
+    if (ret == 0) {
+        cc_plugin_test_name = "test_plugin_2";
+        cc_plugin_test_abi_version = (PICOQUIC_CC_PLUGIN_ABI_MAJOR + 1) << 16;
+        if (picoquic_cc_plugin_register(cc_plugin_test_entry, NULL) != PICOQUIC_ERROR_CC_PLUGIN_INVALID) {
+            DBG_PRINTF("%s", "Plugin with wrong ABI version was accepted\n");
+            ret = -1;
+        }
+        cc_plugin_test_abi_version = PICOQUIC_CC_PLUGIN_ABI_VERSION;
+        cc_plugin_test_size = (uint32_t)PICOQUIC_CC_PLUGIN_SIZE_MIN - 1;
+        cc_plugin_test_number = 202;
+        if (ret == 0 && picoquic_cc_plugin_register(cc_plugin_test_entry, NULL) != PICOQUIC_ERROR_CC_PLUGIN_INVALID) {
+            DBG_PRINTF("%s", "Plugin smaller than the first ABI version was accepted\n");
+            ret = -1;
+        }
+        cc_plugin_test_size = (uint32_t)PICOQUIC_CC_PLUGIN_SIZE_MIN;
+        cc_plugin_test_number = 200;
+        if (ret == 0 && picoquic_cc_plugin_register(cc_plugin_test_entry, NULL) != PICOQUIC_ERROR_CC_PLUGIN_INVALID) {
+            DBG_PRINTF("%s", "Plugin with duplicate number was accepted\n");
+            ret = -1;
+        }
+        cc_plugin_test_number = 1;
+        if (ret == 0 && picoquic_cc_plugin_register(cc_plugin_test_entry, NULL) != PICOQUIC_ERROR_CC_PLUGIN_INVALID) {
+            DBG_PRINTF("%s", "Plugin with reserved number was accepted\n");
+            ret = -1;
+        }
+        cc_plugin_test_name = "cubic";
+        cc_plugin_test_number = 201;
+        if (ret == 0 && picoquic_cc_plugin_register(cc_plugin_test_entry, NULL) != PICOQUIC_ERROR_CC_PLUGIN_INVALID) {
+            DBG_PRINTF("%s", "Plugin with built in name was accepted\n");
+            ret = -1;
+        }
+        cc_plugin_test_name = "test_plugin";
+        cc_plugin_test_number = 200;
+        if (ret == 0 && picoquic_cc_plugin_load("no_such_cc_plugin.so", NULL) != PICOQUIC_ERROR_CC_PLUGIN_LOAD) {
+            DBG_PRINTF("%s", "Loading a missing plugin did not fail\n");
+            ret = -1;
+        }
+    }
+
+    picoquic_cc_plugin_unload_all();
+    if (ret == 0 && picoquic_get_congestion_algorithm("test_plugin") != NULL) {
+        DBG_PRINTF("%s", "Plugin still found after unloading\n");
+        ret = -1;
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
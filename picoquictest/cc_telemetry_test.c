@@ -0,0 +1,139 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Tests of the congestion control telemetry ring.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Test of the congestion control telemetry. Feed a Cubic path with
+ * acknowledgements, a loss during a satellite handover and an ECN
+ * congestion signal, and check the events recorded in the ring.
+ */
+int cc_telemetry_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_connection_id_t initial_cid = { { 1, 2, 3, 4, 5, 6, 7, 8 }, 8 };
+    picoquic_connection_id_t dest_cid = { { 5, 6, 7, 8 }, 4 };
+    picoquic_cnx_t* cnx = NULL;
+    struct sockaddr_in saddr;
+    picoquic_cc_event_t events[32];
+    uint64_t next_event = 0;
+    size_t nb_events = 0;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time, &simulated_time, NULL, NULL, 0);
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_cc_telemetry(quic, 16);
+        picoquic_set_default_congestion_algorithm(quic, picoquic_cubic_algorithm);
+        if ((cnx = picoquic_create_cnx(quic, initial_cid, dest_cid, (struct sockaddr*)&saddr,
+            simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+            DBG_PRINTF("%s", "Cannot create connection\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_path_t* path_x = cnx->path[0];
+        picoquic_per_ack_state_t ack_state = { 0 };
+        uint64_t cwin_before = 0;
+
+        /* Slow start increases the window and the pacing rate, with one event
+         * per increase of more than 1/8th */
+        simulated_time = 5000000;
+        path_x->last_time_acked_data_frame_sent = 1;
+        ack_state.nb_bytes_acknowledged = path_x->cwin / 4;
+        for (int i = 0; i < 4; i++) {
+            simulated_time += 1000;
+            picoquic_congestion_notify(cnx, path_x, picoquic_congestion_notification_acknowledgement, &ack_state, simulated_time);
+        }
+        nb_events = picoquic_get_cc_events(cnx, 0, &next_event, events, 32);
+        if (nb_events != 7 || next_event != 7 || events[0].event_type != picoquic_cc_event_state ||
+            events[0].congestion_algorithm_number != PICOQUIC_CC_ALGO_NUMBER_CUBIC ||
+            events[1].event_type != picoquic_cc_event_cwin || events[2].event_type != picoquic_cc_event_pacing ||
+            events[1].cwin <= events[0].cwin + events[0].cwin / 8 || events[6].event_index != 6 ||
+            events[6].cwin != path_x->cwin || events[6].event_time != simulated_time) {
+            DBG_PRINTF("Unexpected slow start events, nb = %zu\n", nb_events);
+            ret = -1;
+        }
+
+        /* A loss close to a handover is ignored */
+        if (ret == 0) {
+            cwin_before = path_x->cwin;
+            memset(&ack_state, 0, sizeof(ack_state));
+            ack_state.lost_packet_sent_time = 12000000;
+            simulated_time += 1000;
+            picoquic_congestion_notify(cnx, path_x, picoquic_congestion_notification_ecn_ec, &ack_state, simulated_time);
+            nb_events = picoquic_get_cc_events(cnx, 0, &next_event, events, 32);
+            if (nb_events != 1 || events[0].event_type != picoquic_cc_event_handover_suppressed ||
+                events[0].notification != picoquic_congestion_notification_ecn_ec || path_x->cwin != cwin_before) {
+                DBG_PRINTF("Unexpected handover events, nb = %zu\n", nb_events);
+                ret = -1;
+            }
+        }
+
+        /* Congestion causes a state change */
+        if (ret == 0) {
+            ack_state.lost_packet_sent_time = 5000000;
+            simulated_time += 1000000;
+            picoquic_congestion_notify(cnx, path_x, picoquic_congestion_notification_ecn_ec, &ack_state, simulated_time);
+            nb_events = picoquic_get_cc_events(cnx, 0, &next_event, events, 32);
+            if (nb_events != 1 || events[0].event_type != picoquic_cc_event_state || events[0].cwin >= cwin_before) {
+                DBG_PRINTF("Unexpected recovery events, nb = %zu\n", nb_events);
+                ret = -1;
+            }
+        }
+
+        /* When the ring wraps around, the oldest events are lost */
+        if (ret == 0) {
+            next_event = 0;
+            for (int i = 0; i < 20; i++) {
+                ack_state.lost_packet_sent_time = 12000000;
+                picoquic_congestion_notify(cnx, path_x, picoquic_congestion_notification_ecn_ec, &ack_state, simulated_time);
+            }
+            nb_events = picoquic_get_cc_events(cnx, 0, &next_event, events, 32);
+            if (nb_events != 16 || events[0].event_index != 29 - 16 || next_event != 29 ||
+                picoquic_get_cc_events(cnx, 0, &next_event, events, 32) != 0) {
+                DBG_PRINTF("Unexpected events after wrap around, nb = %zu\n", nb_events);
+                ret = -1;
+            }
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -0,0 +1,291 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Tests of the columnar export of binary logs.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include "bytestream.h"
+#include "logreader.h"
+#include "picoquic_binlog.h"
+#include "columnar.h"
+
+/* Test of the columnar export. The rows read back must match the
+ * packet and congestion control events of the binary log, in order.
+ */
+#define COLUMNAR_TEST_REF "picoquictest" PICOQUIC_FILE_SEPARATOR "binlog_ref.log"
+#define COLUMNAR_TEST_LOG "columnar_test.log"
+#define COLUMNAR_TEST_FILE "columnar_test.pqcl"
+#define COLUMNAR_TEST_MAX_ROWS 1024
+
+typedef struct st_columnar_test_ctx_t {
+    size_t nb_events;
+    size_t nb_rows;
+    uint64_t time[COLUMNAR_TEST_MAX_ROWS];
+    columnar_event_enum event_type[COLUMNAR_TEST_MAX_ROWS];
+    size_t nb_per_type[columnar_event_cc_update + 1];
+    uint64_t last_cwin;
+    int ret;
+} columnar_test_ctx_t;
+
+static int columnar_test_event_cb(bytestream* s, void* ptr)
+{
+    columnar_test_ctx_t* ctx = (columnar_test_ctx_t*)ptr;
+    picoquic_connection_id_t cid;
+    uint64_t time = 0;
+    uint64_t path_id = 0;
+    uint64_t id = 0;
+    int ret = byteread_cid(s, &cid);
+    int event_type = -1;
+
+    ret |= byteread_vint(s, &time);
+    ret |= byteread_vint(s, &path_id);
+    ret |= byteread_vint(s, &id);
+
+    switch (id) {
+    case picoquic_log_event_packet_sent:
+        event_type = columnar_event_packet_sent;
+        break;
+    case picoquic_log_event_packet_recv:
+        event_type = columnar_event_packet_received;
+        break;
+    case picoquic_log_event_packet_lost:
+        event_type = columnar_event_packet_lost;
+        break;
+    case picoquic_log_event_packet_dropped:
+        event_type = columnar_event_packet_dropped;
+        break;
+    case picoquic_log_event_cc_update:
+        event_type = columnar_event_cc_update;
+        break;
+    default:
+        break;
+    }
+    if (ret == 0 && event_type >= 0) {
+        if (ctx->nb_events >= COLUMNAR_TEST_MAX_ROWS) {
+            ret = -1;
+        }
+        else {
+            ctx->time[ctx->nb_events] = time;
+            ctx->event_type[ctx->nb_events] = (columnar_event_enum)event_type;
+            ctx->nb_per_type[event_type]++;
+            ctx->nb_events++;
+        }
+    }
+
+    return ret;
+}
+
+static int columnar_test_row_cb(const columnar_row_t* row, void* ptr)
+{
+    columnar_test_ctx_t* ctx = (columnar_test_ctx_t*)ptr;
+    int ret = 0;
+
+    if (ctx->nb_rows >= ctx->nb_events || row->time != ctx->time[ctx->nb_rows] ||
+        row->event_type != ctx->event_type[ctx->nb_rows] || row->cid_index != 0 || row->cid->id_len != 4) {
+        DBG_PRINTF("Unexpected columnar row %zu", ctx->nb_rows);
+        ret = -1;
+    }
+    else if ((row->event_type == columnar_event_packet_sent || row->event_type == columnar_event_packet_received) &&
+        row->size == 0) {
+        DBG_PRINTF("Missing packet size in row %zu", ctx->nb_rows);
+        ret = -1;
+    }
+    else if (row->event_type == columnar_event_cc_update && row->rtt != 20000 + row->pn) {
+        DBG_PRINTF("Unexpected RTT in row %zu", ctx->nb_rows);
+        ret = -1;
+    }
+    else if (row->event_type != columnar_event_cc_update && row->cwin != ctx->last_cwin) {
+        DBG_PRINTF("CWIN not carried forward in row %zu", ctx->nb_rows);
+        ret = -1;
+    }
+    ctx->last_cwin = row->cwin;
+    ctx->nb_rows++;
+
+    return ret;
+}
+
+/* The reference log only contains sent packets. Add congestion control
+ * updates and packet losses after some of the packets. */
+static int columnar_test_write_event(FILE* F, bytestream* s)
+{
+    uint8_t head[4];
+
+    picoformat_32(head, (uint32_t)bytestream_length(s));
+
+    return (fwrite(head, 4, 1, F) != 1 || fwrite(bytestream_data(s), bytestream_length(s), 1, F) != 1) ? -1 : 0;
+}
+
+static int columnar_test_write_log(char const* log_test_ref)
+{
+    int ret = 0;
+    FILE* F_ref = picoquic_file_open(log_test_ref, "rb");
+    FILE* F = picoquic_file_open(COLUMNAR_TEST_LOG, "wb");
+    uint8_t buffer[2048];
+    uint64_t nb_events = 0;
+
+    if (F_ref == NULL || F == NULL || fread(buffer, 16, 1, F_ref) != 1 || fwrite(buffer, 16, 1, F) != 1) {
+        ret = -1;
+    }
+    while (ret == 0 && fread(buffer, 4, 1, F_ref) == 1) {
+        uint32_t len = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+        if (len + 4 > sizeof(buffer) || fread(buffer + 4, len, 1, F_ref) != 1 ||
+            fwrite(buffer, len + 4, 1, F) != 1) {
+            ret = -1;
+        }
+        else if (++nb_events % 8 == 0) {
+            bytestream stream;
+            bytestream* s = bytestream_ref_init(&stream, buffer + 4, len);
+            bytestream_buf event;
+            bytestream* e = bytestream_buf_init(&event, BYTESTREAM_MAX_BUFFER_SIZE);
+            picoquic_connection_id_t cid;
+            uint64_t time = 0;
+            uint64_t path_id = 0;
+
+            ret |= byteread_cid(s, &cid);
+            ret |= byteread_vint(s, &time);
+            ret |= byteread_vint(s, &path_id);
+            if (ret == 0) {
+                bytestream_reset(e);
+                ret |= bytewrite_cid(e, &cid);
+                ret |= bytewrite_vint(e, time);
+                ret |= bytewrite_vint(e, path_id);
+                ret |= bytewrite_vint(e, picoquic_log_event_cc_update);
+                ret |= bytewrite_vint(e, nb_events); /* sequence */
+                ret |= bytewrite_vint(e, 0); /* no packet received */
+                ret |= bytewrite_vint(e, 10000 + 1000 * nb_events); /* cwin */
+                ret |= bytewrite_vint(e, 0); /* one way delay */
+                ret |= bytewrite_vint(e, 20000); /* rtt sample */
+                ret |= bytewrite_vint(e, 20000 + nb_events); /* SRTT */
+                for (int i = 0; i < 10; i++) {
+                    ret |= bytewrite_vint(e, 0);
+                }
+                ret |= columnar_test_write_event(F, e);
+            }
+            if (ret == 0 && nb_events % 16 == 0) {
+                bytestream_reset(e);
+                ret |= bytewrite_cid(e, &cid);
+                ret |= bytewrite_vint(e, time);
+                ret |= bytewrite_vint(e, path_id);
+                ret |= bytewrite_vint(e, picoquic_log_event_packet_lost);
+                ret |= bytewrite_vint(e, picoquic_packet_1rtt_protected);
+                ret |= bytewrite_vint(e, nb_events); /* sequence */
+                ret |= bytewrite_vint(e, 0); /* no trigger */
+                ret |= bytewrite_int8(e, 0); /* no cid */
+                ret |= bytewrite_vint(e, 1252); /* packet size */
+                ret |= columnar_test_write_event(F, e);
+            }
+        }
+    }
+    (void)picoquic_file_close(F_ref);
+    (void)picoquic_file_close(F);
+
+    return ret;
+}
+
+int columnar_test()
+{
+    int ret = 0;
+    char log_test_ref[512];
+    const picoquic_connection_id_t other_cid = { { 1, 2, 3, 5 }, 4 };
+    columnar_test_ctx_t* ctx = (columnar_test_ctx_t*)malloc(sizeof(columnar_test_ctx_t));
+    FILE* F_bin = NULL;
+    FILE* F_col = NULL;
+    uint64_t log_time = 0;
+    uint64_t read_time = 0;
+    uint16_t flags = 0;
+    long bin_size = 0;
+    long col_size = 0;
+
+    if (ctx == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(ctx, 0, sizeof(columnar_test_ctx_t));
+        if (picoquic_get_input_path(log_test_ref, sizeof(log_test_ref), picoquic_solution_dir, COLUMNAR_TEST_REF) != 0 ||
+            columnar_test_write_log(log_test_ref) != 0 ||
+            (F_bin = picoquic_open_cc_log_file_for_read(COLUMNAR_TEST_LOG, &flags, &log_time)) == NULL) {
+            DBG_PRINTF("%s", "Cannot write the test log.\n");
+            ret = -1;
+        }
+        else if (fileread_binlog(F_bin, columnar_test_event_cb, ctx) != 0 || ctx->nb_events == 0) {
+            DBG_PRINTF("%s", "Cannot read the test log.\n");
+            ret = -1;
+        }
+        else if ((F_col = picoquic_file_open(COLUMNAR_TEST_FILE, "wb")) == NULL ||
+            columnar_convert(F_bin, F_col, log_time, NULL) != 0) {
+            DBG_PRINTF("%s", "Cannot convert the log ref file.\n");
+            ret = -1;
+        }
+        else {
+            (void)fseek(F_bin, 0, SEEK_END);
+            bin_size = ftell(F_bin);
+            col_size = ftell(F_col);
+        }
+        F_col = picoquic_file_close(F_col);
+
+        if (ret == 0) {
+            if ((F_col = picoquic_file_open(COLUMNAR_TEST_FILE, "rb")) == NULL ||
+                columnar_read(F_col, &read_time, columnar_test_row_cb, ctx) != 0) {
+                DBG_PRINTF("%s", "Cannot read the columnar file.\n");
+                ret = -1;
+            }
+            else if (read_time != log_time || ctx->nb_rows != ctx->nb_events) {
+                DBG_PRINTF("Read %zu rows, expected %zu.\n", ctx->nb_rows, ctx->nb_events);
+                ret = -1;
+            }
+            else if (ctx->nb_per_type[columnar_event_packet_sent] == 0 || ctx->nb_per_type[columnar_event_cc_update] == 0 ||
+                ctx->nb_per_type[columnar_event_packet_lost] == 0 ||
+                col_size * 4 > bin_size) {
+                DBG_PRINTF("Columnar size %ld, binary log size %ld.\n", col_size, bin_size);
+                ret = -1;
+            }
+            F_col = picoquic_file_close(F_col);
+        }
+
+        /* Filtering on a connection that is not in the log produces no rows */
+        if (ret == 0) {
+            ctx->nb_rows = 0;
+            if ((F_col = picoquic_file_open(COLUMNAR_TEST_FILE, "wb")) == NULL ||
+                columnar_convert(F_bin, F_col, log_time, &other_cid) != 0) {
+                ret = -1;
+            }
+            F_col = picoquic_file_close(F_col);
+            if (ret == 0 && ((F_col = picoquic_file_open(COLUMNAR_TEST_FILE, "rb")) == NULL ||
+                columnar_read(F_col, NULL, columnar_test_row_cb, ctx) != 0 || ctx->nb_rows != 0)) {
+                DBG_PRINTF("%s", "Unexpected rows for a filtered connection.\n");
+                ret = -1;
+            }
+            F_col = picoquic_file_close(F_col);
+        }
+
+        (void)picoquic_file_close(F_bin);
+        free(ctx);
+    }
+
+    return ret;
+}
@@ -636,4 +636,201 @@ int datagram_small_packet_test()
     dg_ctx.duration_max = 2060000;
 
     return datagram_test_one(9, &dg_ctx, 0);
-}
\ No newline at end of file
+}
+
+/* Unit test of the datagram queue: datagrams are queued by priority class,
+ * the least urgent datagrams are dropped when the queue is full, and
+ * expired datagrams are dropped before being sent. The server also queues
+ * the HANDSHAKE_DONE frame with the datagrams; it is not counted as one.
+ * In the expected list, 0 stands for the HANDSHAKE_DONE frame.
+ */
+static int datagram_queue_check_order(picoquic_cnx_t* cnx, const uint8_t* expected, size_t nb_expected)
+{
+    int ret = 0;
+    size_t nb_found = 0;
+    size_t nb_datagrams = 0;
+    picoquic_misc_frame_header_t* datagram = cnx->first_datagram;
+
+    while (ret == 0 && datagram != NULL) {
+        uint8_t* frame = ((uint8_t*)datagram) + sizeof(picoquic_misc_frame_header_t);
+        if (nb_found >= nb_expected) {
+            ret = -1;
+        }
+        else if (expected[nb_found] == 0) {
+            if (datagram->is_datagram || frame[0] != picoquic_frame_type_handshake_done) {
+                ret = -1;
+            }
+        }
+        else if (!datagram->is_datagram || frame[2] != expected[nb_found]) {
+            /* The first byte of the datagram content follows the frame type and length */
+            ret = -1;
+        }
+        else {
+            nb_datagrams++;
+        }
+        nb_found++;
+        datagram = datagram->next_misc_frame;
+    }
+    if (ret == 0 && (nb_found != nb_expected || cnx->nb_datagrams_queued != nb_datagrams)) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        DBG_PRINTF("Unexpected datagram queue, %zu datagrams\n", nb_found);
+    }
+    return ret;
+}
+
+int datagram_queue_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_cnx_t* server_cnx = NULL;
+    struct sockaddr_in saddr;
+    uint8_t dg[8];
+    picoquic_datagram_queue_stats_t stats;
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&saddr, simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the connection\n");
+        ret = -1;
+    }
+    else {
+        /* Datagram 1 has no deadline, datagrams 2 and 3 expire at 20ms and 50ms */
+        const uint8_t expected[] = { 3, 1, 2, 4 };
+        const uint8_t priority[] = { 4, 8, 2, 8 };
+        const uint64_t expiry[] = { 0, 20000, 50000, 0 };
+
+        memset(dg, 0, sizeof(dg));
+        picoquic_set_datagram_queue_max(cnx, 4);
+        for (int i = 0; ret == 0 && i < 4; i++) {
+            dg[0] = (uint8_t)(i + 1);
+            ret = picoquic_queue_datagram_frame_ex(cnx, sizeof(dg), dg, priority[i], expiry[i]);
+        }
+        if (ret == 0) {
+            ret = datagram_queue_check_order(cnx, expected, 4);
+        }
+    }
+
+    if (ret == 0) {
+        /* The queue is full. A less urgent datagram is rejected, a more urgent one
+         * replaces the last datagram of the least urgent class. */
+        const uint8_t expected[] = { 3, 5, 1, 2 };
+
+        dg[0] = 6;
+        if (picoquic_queue_datagram_frame_ex(cnx, sizeof(dg), dg, 8, 0) != PICOQUIC_ERROR_DATAGRAM_QUEUE_FULL) {
+            DBG_PRINTF("%s", "Datagram queued in a full queue\n");
+            ret = -1;
+        }
+        else {
+            dg[0] = 5;
+            ret = picoquic_queue_datagram_frame_ex(cnx, sizeof(dg), dg, 3, 0);
+            if (ret == 0) {
+                ret = datagram_queue_check_order(cnx, expected, 4);
+            }
+        }
+    }
+
+    if (ret == 0) {
+        /* Datagram 2 expires, datagram 3 is sent late */
+        const uint8_t expected[] = { 5, 1 };
+        uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+        int more_data = 0;
+        int is_pure_ack = 1;
+
+        simulated_time = 30000;
+        cnx->path[0]->smoothed_rtt = 60000;
+        picoquic_purge_expired_datagrams(cnx, simulated_time);
+        if (picoquic_format_first_datagram_frame(cnx, cnx->path[0], bytes, bytes + sizeof(bytes),
+            &more_data, &is_pure_ack, simulated_time) == bytes) {
+            DBG_PRINTF("%s", "Cannot format the first datagram\n");
+            ret = -1;
+        }
+        else {
+            ret = datagram_queue_check_order(cnx, expected, 2);
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_get_datagram_queue_stats(cnx, &stats);
+        if (stats.nb_queued != 2 || stats.nb_sent != 1 || stats.nb_expired != 1 ||
+            stats.nb_dropped != 2 || stats.nb_late != 1) {
+            DBG_PRINTF("Unexpected stats, sent %" PRIu64 ", expired %" PRIu64 ", dropped %" PRIu64 ", late %" PRIu64 "\n",
+                stats.nb_sent, stats.nb_expired, stats.nb_dropped, stats.nb_late);
+            ret = -1;
+        }
+        else if (cnx->datagram_expiry_next != 50000) {
+            DBG_PRINTF("%s", "Next expiry time not updated\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* On the server, HANDSHAKE_DONE is queued behind datagram 1. It is not
+         * counted, dropped or passed by the datagrams queued after it. */
+        const uint8_t expected[] = { 1, 0, 2 };
+        const uint8_t expected_after_drop[] = { 1, 0, 3 };
+        picoquic_connection_id_t icid = { { 0xd9, 0xe0, 0, 0, 0, 0, 0, 0 }, 8 };
+
+        if ((server_cnx = picoquic_create_cnx(quic, icid, picoquic_null_connection_id,
+            (struct sockaddr*)&saddr, simulated_time, 0, NULL, NULL, 0)) == NULL) {
+            DBG_PRINTF("%s", "Cannot create the server connection\n");
+            ret = -1;
+        }
+        else {
+            picoquic_set_datagram_queue_max(server_cnx, 2);
+            dg[0] = 1;
+            if (picoquic_queue_datagram_frame_ex(server_cnx, sizeof(dg), dg, 4, 0) != 0 ||
+                picoquic_queue_handshake_done_frame(server_cnx) != 0) {
+                ret = -1;
+            }
+            else {
+                dg[0] = 2;
+                ret = picoquic_queue_datagram_frame_ex(server_cnx, sizeof(dg), dg, 8, 0);
+            }
+            if (ret == 0) {
+                ret = datagram_queue_check_order(server_cnx, expected, 3);
+            }
+        }
+        if (ret == 0) {
+            /* The queue is full, datagram 2 is dropped to make room for datagram 3 */
+            dg[0] = 3;
+            ret = picoquic_queue_datagram_frame_ex(server_cnx, sizeof(dg), dg, 2, 0);
+            if (ret == 0) {
+                ret = datagram_queue_check_order(server_cnx, expected_after_drop, 3);
+            }
+        }
+        if (ret == 0) {
+            uint8_t bytes[PICOQUIC_MAX_PACKET_SIZE];
+            int more_data = 0;
+            int is_pure_ack = 1;
+
+            while (ret == 0 && server_cnx->first_datagram != NULL) {
+                if (picoquic_format_first_datagram_frame(server_cnx, server_cnx->path[0], bytes, bytes + sizeof(bytes),
+                    &more_data, &is_pure_ack, simulated_time) == bytes) {
+                    DBG_PRINTF("%s", "Cannot format the first queued frame\n");
+                    ret = -1;
+                }
+            }
+            picoquic_get_datagram_queue_stats(server_cnx, &stats);
+            if (ret == 0 && (stats.nb_queued != 0 || stats.nb_sent != 2 || stats.nb_dropped != 1)) {
+                DBG_PRINTF("Unexpected server stats, queued %" PRIu64 ", sent %" PRIu64 ", dropped %" PRIu64 "\n",
+                    (uint64_t)stats.nb_queued, stats.nb_sent, stats.nb_dropped);
+                ret = -1;
+            }
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -1231,4 +1231,177 @@ int reset_need_reset_test()
 int reset_need_stop_test()
 {
     return reset_repeat_test_one(reset_need_stop_sending);
-}
\ No newline at end of file
+}
+
+/* Selective preemptive repeat.
+ * A single packet carrying stream data is queued in the application context,
+ * and the test checks whether it is repeated depending on the loss rate of
+ * the path, on the proximity of a satellite handover, and on the budget.
+ */
+static int selective_repeat_test_one(int test_id, picoquic_cnx_t* cnx, picoquic_packet_t* old_p,
+    uint64_t send_time, int is_fin, int expect_repeat)
+{
+    int ret = 0;
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    size_t length = 0;
+    int more_data = 0;
+    int is_pure_ack = 1;
+    uint64_t current_time = send_time + cnx->path[0]->smoothed_rtt / 4;
+    uint64_t next_wake_time = UINT64_MAX;
+    picoquic_stream_head_t* stream = picoquic_find_stream(cnx, 0);
+
+    stream->fin_sent = is_fin;
+    old_p->send_time = send_time;
+    old_p->was_preemptively_repeated = 0;
+    cnx->pkt_ctx[picoquic_packet_context_application].preemptive_repeat_ptr = NULL;
+    cnx->latest_progress_time = current_time;
+    cnx->latest_receive_time = current_time;
+
+    ret = picoquic_preemptive_retransmit_as_needed(cnx, cnx->path[0], picoquic_packet_context_application,
+        current_time, &next_wake_time, buffer, sizeof(buffer), &length, &more_data, &is_pure_ack);
+
+    if (ret != 0) {
+        DBG_PRINTF("Test %d, preemptive repeat returns 0x%x", test_id, ret);
+    }
+    else if ((length > 0) != (expect_repeat != 0) || old_p->was_preemptively_repeated != (expect_repeat != 0)) {
+        DBG_PRINTF("Test %d, repeated %zu bytes, expected %s", test_id, length, (expect_repeat) ? "repeat" : "none");
+        ret = -1;
+    }
+    return ret;
+}
+
+int selective_repeat_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_packet_t* old_p = NULL;
+    picoquic_path_t* path_x = NULL;
+    uint64_t handover_time = 12000000;
+    uint64_t quiet_time = 5000000;
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    if (quic == NULL || (cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&saddr, simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL ||
+        picoquic_create_stream(cnx, 0) == NULL || (old_p = picoquic_create_packet(quic)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the test context");
+        ret = -1;
+    }
+    else {
+        /* Queue a packet carrying 60 bytes of stream 0 */
+        uint8_t* bytes = old_p->bytes + 16;
+
+        *bytes++ = picoquic_frame_type_stream_range_min | 6; /* offset and length present */
+        *bytes++ = 0;
+        *bytes++ = 0;
+        *bytes++ = 60;
+        memset(bytes, 0x5a, 60);
+        old_p->offset = 16;
+        old_p->length = (bytes - old_p->bytes) + 60;
+        old_p->ptype = picoquic_packet_1rtt_protected;
+        old_p->pc = picoquic_packet_context_application;
+        old_p->send_path = cnx->path[0];
+        picoquic_queue_for_retransmit(cnx, cnx->path[0], old_p, old_p->length, simulated_time);
+
+        /* Less than a loss estimate interval, so the loss rate since the start is used */
+        path_x = cnx->path[0];
+        path_x->smoothed_rtt = 100000;
+        path_x->bytes_sent = 20000;
+        picoquic_set_selective_repeat_per_cnx(cnx, 1, 0);
+
+        /* No loss: even the tail of a finished stream is not repeated */
+        ret = selective_repeat_test_one(1, cnx, old_p, quiet_time, 1, 0);
+        /* Close to a handover, the packet is repeated even if the stream is not finished */
+        if (ret == 0) {
+            ret = selective_repeat_test_one(2, cnx, old_p, handover_time, 0, 1);
+        }
+        /* With 5% loss on the path, the tail of a finished stream is repeated */
+        if (ret == 0) {
+            path_x->total_bytes_lost = 1000;
+            ret = selective_repeat_test_one(3, cnx, old_p, quiet_time, 1, 1);
+        }
+        if (ret == 0 && path_x->loss_permille != 50) {
+            DBG_PRINTF("Loss estimate is %" PRIu64 " per mille instead of 50", path_x->loss_permille);
+            ret = -1;
+        }
+        /* But other packets are not */
+        if (ret == 0) {
+            ret = selective_repeat_test_one(4, cnx, old_p, quiet_time, 0, 0);
+        }
+        /* Once the budget is spent, nothing is repeated */
+        if (ret == 0) {
+            cnx->nb_preemptive_repeat_bytes = PICOQUIC_SELECTIVE_REPEAT_ALLOWANCE +
+                (path_x->bytes_sent * PICOQUIC_SELECTIVE_REPEAT_BUDGET_DEFAULT) / 1000;
+            ret = selective_repeat_test_one(5, cnx, old_p, handover_time, 1, 0);
+        }
+        /* A packet is only checked when its repeat time comes. Before that, it
+         * stays the next candidate, even if the budget is too short for it and
+         * a later packet would pass the check. */
+        if (ret == 0) {
+            picoquic_packet_t* later_p = picoquic_create_packet(quic);
+            uint64_t early_time = quiet_time + path_x->smoothed_rtt / 8;
+            uint64_t next_wake_time = UINT64_MAX;
+            uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+            size_t length = 0;
+            int more_data = 0;
+            int is_pure_ack = 1;
+
+            if (later_p == NULL) {
+                DBG_PRINTF("%s", "Cannot create the second packet");
+                ret = -1;
+            }
+            else {
+                later_p->bytes[16] = picoquic_frame_type_ping;
+                later_p->offset = 16;
+                later_p->length = 17;
+                later_p->ptype = picoquic_packet_1rtt_protected;
+                later_p->pc = picoquic_packet_context_application;
+                later_p->send_path = path_x;
+                picoquic_queue_for_retransmit(cnx, path_x, later_p, later_p->length, simulated_time);
+                later_p->send_time = handover_time;
+                old_p->send_time = quiet_time;
+                old_p->was_preemptively_repeated = 0;
+                cnx->pkt_ctx[picoquic_packet_context_application].preemptive_repeat_ptr = NULL;
+                cnx->latest_progress_time = quiet_time;
+                cnx->latest_receive_time = quiet_time;
+                cnx->nb_preemptive_repeat_bytes = PICOQUIC_SELECTIVE_REPEAT_ALLOWANCE +
+                    (path_x->bytes_sent * PICOQUIC_SELECTIVE_REPEAT_BUDGET_DEFAULT) / 1000 - later_p->length;
+
+                ret = picoquic_preemptive_retransmit_as_needed(cnx, path_x, picoquic_packet_context_application,
+                    quiet_time + 1000, &next_wake_time, buffer, sizeof(buffer), &length, &more_data, &is_pure_ack);
+                if (ret == 0 && (length > 0 || next_wake_time != early_time)) {
+                    DBG_PRINTF("Test 6, repeated %zu bytes, wake time %" PRIu64 " instead of %" PRIu64,
+                        length, next_wake_time, early_time);
+                    ret = -1;
+                }
+                else if (ret == 0) {
+                    /* More data was sent, the budget now allows the repeat */
+                    cnx->nb_preemptive_repeat_bytes = 0;
+                    next_wake_time = UINT64_MAX;
+                    ret = picoquic_preemptive_retransmit_as_needed(cnx, path_x, picoquic_packet_context_application,
+                        early_time, &next_wake_time, buffer, sizeof(buffer), &length, &more_data, &is_pure_ack);
+                    if (ret == 0 && (length == 0 || !old_p->was_preemptively_repeated)) {
+                        DBG_PRINTF("Test 7, repeated %zu bytes, expected repeat", length);
+                        ret = -1;
+                    }
+                }
+            }
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -0,0 +1,191 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Test of the assignment of connections to experiment arms.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include "performance_log.h"
+
+static picoquic_cnx_t* experiment_arm_test_cnx(picoquic_quic_t* quic, uint32_t i, uint64_t simulated_time)
+{
+    picoquic_connection_id_t icid = { { 0xea, 0, 0, 0, 0, 0, 0, 0 }, 8 };
+    struct sockaddr_in saddr;
+
+    icid.id[4] = (uint8_t)(i >> 8);
+    icid.id[5] = (uint8_t)i;
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+
+    return picoquic_create_cnx(quic, icid, picoquic_null_connection_id,
+        (struct sockaddr*)&saddr, simulated_time, 0, "test-sni", "test-alpn", 1);
+}
+
+int experiment_arm_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    int nb_per_arm[2] = { 0, 0 };
+    int nb_moved = 0;
+    picoquic_experiment_arm_t arms[2];
+    picoquic_quic_t* quic[2];
+
+    memset(arms, 0, sizeof(arms));
+    arms[0].name = "control";
+    arms[0].weight = 1;
+    arms[1].name = "bbr_fast_start";
+    arms[1].weight = 3;
+    arms[1].congestion_alg = picoquic_bbr_algorithm;
+    arms[1].initial_cwin = 100000;
+    arms[1].pacing_gain = 1.25;
+    arms[1].ack_gap_max = 4;
+    arms[1].ack_delay_max = 5000;
+    arms[1].handover_policy = picoquic_handover_policy_none;
+
+    for (int i = 0; i < 2; i++) {
+        quic[i] = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+            simulated_time, &simulated_time, NULL, NULL, 0);
+        if (quic[i] == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_set_default_congestion_algorithm(quic[0], picoquic_cubic_algorithm);
+        if (picoquic_set_experiment_arms(quic[0], arms, 2, 0x1234) != 0 ||
+            picoquic_set_experiment_arms(quic[1], arms, 2, 0x5678) != 0) {
+            DBG_PRINTF("%s", "Cannot set the experiment arms\n");
+            ret = -1;
+        }
+        else if (picoquic_get_experiment_arm_name(quic[0], 1) == NULL ||
+            strcmp(picoquic_get_experiment_arm_name(quic[0], 1), "bbr_fast_start") != 0 ||
+            picoquic_get_experiment_arm_name(quic[0], 2) != NULL) {
+            DBG_PRINTF("%s", "Unexpected arm names\n");
+            ret = -1;
+        }
+        else if (strcmp(picoquic_perflog_param_name(picoquic_perflog_experiment_arm), "exp_arm") != 0) {
+            DBG_PRINTF("%s", "Unexpected perflog column name\n");
+            ret = -1;
+        }
+    }
+
+    /* Connections are split by weight, and get the settings of their arm */
+    for (uint32_t i = 0; ret == 0 && i < 400; i++) {
+        picoquic_cnx_t* cnx = experiment_arm_test_cnx(quic[0], i, simulated_time);
+        picoquic_cnx_t* cnx_again = NULL;
+        picoquic_cnx_t* cnx_salted = NULL;
+        int arm;
+
+        if (cnx == NULL) {
+            ret = -1;
+            break;
+        }
+        arm = picoquic_get_experiment_arm(cnx);
+        if (arm < 0 || arm > 1) {
+            DBG_PRINTF("Unexpected arm %d\n", arm);
+            ret = -1;
+        }
+        else {
+            nb_per_arm[arm]++;
+            if (arm == 0 && (cnx->congestion_alg != picoquic_cubic_algorithm || cnx->pacing_gain != 0 ||
+                cnx->ack_gap_limit != 0 || cnx->skip_handover_suppression)) {
+                DBG_PRINTF("%s", "Control arm does not use the defaults\n");
+                ret = -1;
+            }
+            else if (arm == 1) {
+                uint64_t ack_gap = 0;
+                uint64_t ack_delay_max = 0;
+
+                picoquic_compute_ack_gap_and_delay(cnx, 1000000, 0, 100000000, &ack_gap, &ack_delay_max);
+                picoquic_update_pacing_rate(cnx, cnx->path[0], 1000000.0, 16000);
+                if (cnx->congestion_alg != picoquic_bbr_algorithm || cnx->path[0]->cwin != 100000 ||
+                    !cnx->skip_handover_suppression || ack_gap > 4 || ack_delay_max > 5000 ||
+                    cnx->path[0]->pacing.rate != 1250000) {
+                    DBG_PRINTF("Experiment arm not applied, gap %" PRIu64 ", delay %" PRIu64 ", rate %" PRIu64 "\n",
+                        ack_gap, ack_delay_max, cnx->path[0]->pacing.rate);
+                    ret = -1;
+                }
+            }
+        }
+        /* Same assignment for the same CID, even after restart, but not with another salt */
+        if (ret == 0) {
+            cnx_again = experiment_arm_test_cnx(quic[0], i, simulated_time);
+            cnx_salted = experiment_arm_test_cnx(quic[1], i, simulated_time);
+            if (cnx_again == NULL || cnx_salted == NULL || picoquic_get_experiment_arm(cnx_again) != arm) {
+                DBG_PRINTF("%s", "Assignment is not deterministic\n");
+                ret = -1;
+            }
+            else if (picoquic_get_experiment_arm(cnx_salted) != arm) {
+                nb_moved++;
+            }
+        }
+        picoquic_delete_cnx(cnx);
+        if (cnx_again != NULL) {
+            picoquic_delete_cnx(cnx_again);
+        }
+        if (cnx_salted != NULL) {
+            picoquic_delete_cnx(cnx_salted);
+        }
+    }
+
+    if (ret == 0 && (nb_per_arm[1] < 250 || nb_per_arm[1] > 350 || nb_moved < 100)) {
+        DBG_PRINTF("Unexpected split: %d, %d, moved %d\n", nb_per_arm[0], nb_per_arm[1], nb_moved);
+        ret = -1;
+    }
+
+    /* Invalid settings are rejected, and the experiment can be stopped */
+    if (ret == 0) {
+        arms[0].weight = 0;
+        arms[1].weight = 0;
+        if (picoquic_set_experiment_arms(quic[0], arms, 2, 0) == 0 ||
+            picoquic_set_experiment_arms(quic[0], arms, PICOQUIC_EXPERIMENT_ARMS_MAX + 1, 0) == 0) {
+            DBG_PRINTF("%s", "Invalid arms were accepted\n");
+            ret = -1;
+        }
+        else if (picoquic_set_experiment_arms(quic[0], NULL, 0, 0) != 0) {
+            ret = -1;
+        }
+        else {
+            picoquic_cnx_t* cnx = experiment_arm_test_cnx(quic[0], 0, simulated_time);
+            if (cnx == NULL || picoquic_get_experiment_arm(cnx) != -1) {
+                DBG_PRINTF("%s", "Arm assigned after the end of the experiment\n");
+                ret = -1;
+            }
+            if (cnx != NULL) {
+                picoquic_delete_cnx(cnx);
+            }
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (quic[i] != NULL) {
+            picoquic_free(quic[i]);
+        }
+    }
+
+    return ret;
+}
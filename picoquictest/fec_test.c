@@ -0,0 +1,311 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Forward error correction tests.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#ifdef _WINDOWS
+#include "wincompat.h"
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "picoquictest.h"
+
+#define FEC_TEST_NB_PACKETS 8
+#define FEC_TEST_MAX_DATA 100000
+
+/* Each source packet carries a MAX DATA frame, so the test can verify that
+ * the recovered packets are processed, followed by padding. */
+static size_t fec_test_payload(uint8_t* bytes, size_t bytes_max, uint64_t pn)
+{
+    size_t length = 100 + 37 * (size_t)pn;
+    uint8_t* bytes_next = bytes;
+
+    memset(bytes, 0, bytes_max);
+    *bytes_next++ = picoquic_frame_type_max_data;
+    bytes_next = picoquic_frames_varint_encode(bytes_next, bytes + bytes_max, FEC_TEST_MAX_DATA + 1000 * pn);
+
+    return (bytes_next == NULL) ? 0 : length;
+}
+
+static picoquic_cnx_t* fec_test_cnx(picoquic_quic_t* quic, uint64_t simulated_time)
+{
+    struct sockaddr_in saddr;
+    picoquic_cnx_t* cnx;
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    cnx = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&saddr, simulated_time, 0, "test-sni", "test-alpn", 1);
+    if (cnx != NULL) {
+        cnx->is_fec_enabled = 1;
+    }
+    return cnx;
+}
+
+/* Two packets are lost in a window of eight. The first repair frame
+ * combines both of them and cannot be used alone, the second one allows
+ * the receiver to rebuild both packets. */
+int fec_repair_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx_s = NULL;
+    picoquic_cnx_t* cnx_r = NULL;
+    picoquic_packet_context_t* pkt_ctx = NULL;
+    uint8_t payload[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t repair[2][PICOQUIC_MAX_PACKET_SIZE];
+    size_t repair_length[2] = { 0, 0 };
+    const uint64_t lost_pn[2] = { 2, 5 };
+    picoquic_fec_stats_t stats;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    if (quic == NULL || (cnx_s = fec_test_cnx(quic, simulated_time)) == NULL ||
+        (cnx_r = fec_test_cnx(quic, simulated_time)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create the connections\n");
+        ret = -1;
+    }
+    else {
+        pkt_ctx = &cnx_s->pkt_ctx[picoquic_packet_context_application];
+        for (uint64_t pn = 0; ret == 0 && pn < FEC_TEST_NB_PACKETS; pn++) {
+            size_t length = fec_test_payload(payload, sizeof(payload), pn);
+
+            if (length == 0) {
+                ret = -1;
+            }
+            else {
+                picoquic_fec_record_sent(pkt_ctx, pn, payload, length);
+                if (pn != lost_pn[0] && pn != lost_pn[1]) {
+                    ret = picoquic_fec_record_received(cnx_r, cnx_r->path[0], cnx_r->path[0]->p_local_cnxid,
+                        pn, payload, length, NULL, NULL, simulated_time);
+                    if (ret == 0) {
+                        ret = picoquic_record_pn_received(cnx_r, picoquic_packet_context_application,
+                            cnx_r->path[0]->p_local_cnxid, pn, simulated_time);
+                    }
+                }
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("%s", "Cannot record the source packets\n");
+        }
+    }
+
+    if (ret == 0) {
+        /* No handover is expected in the next seconds, so with no loss
+         * the repair is not needed before the tail of the transmission. */
+        if (picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 0, simulated_time) ||
+            !picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 1, simulated_time)) {
+            DBG_PRINTF("%s", "Unexpected repair schedule\n");
+            ret = -1;
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        int is_pure_ack = 1;
+        uint8_t* bytes_next = picoquic_format_fec_repair_frame(cnx_s, pkt_ctx, repair[i], repair[i] + sizeof(repair[i]), &is_pure_ack);
+        size_t consumed = 0;
+        int pure_ack = 1;
+
+        repair_length[i] = bytes_next - repair[i];
+        if (repair_length[i] == 0 || is_pure_ack) {
+            DBG_PRINTF("Cannot format repair frame %d\n", i);
+            ret = -1;
+        }
+        else if (picoquic_skip_frame(repair[i], repair_length[i], &consumed, &pure_ack) != 0 ||
+            consumed != repair_length[i] || pure_ack) {
+            DBG_PRINTF("Cannot skip repair frame %d\n", i);
+            ret = -1;
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        ret = picoquic_decode_frames(cnx_r, cnx_r->path[0], repair[i], repair_length[i], NULL, picoquic_epoch_1rtt,
+            NULL, NULL, FEC_TEST_NB_PACKETS + i, 0, simulated_time);
+        if (ret != 0) {
+            DBG_PRINTF("Cannot decode repair frame %d\n", i);
+        }
+        else if (cnx_r->nb_fec_recovered != ((i == 0) ? 0 : 2)) {
+            DBG_PRINTF("After repair %d, %" PRIu64 " packets recovered\n", i, cnx_r->nb_fec_recovered);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The recovered packets are not acknowledged, so the sender sees the losses */
+        for (int i = 0; ret == 0 && i < 2; i++) {
+            if (picoquic_is_pn_already_received(cnx_r, picoquic_packet_context_application,
+                cnx_r->path[0]->p_local_cnxid, lost_pn[i]) ||
+                !picoquic_fec_is_recovered(cnx_r, cnx_r->path[0]->p_local_cnxid, lost_pn[i])) {
+                DBG_PRINTF("Packet %" PRIu64 " not marked as recovered\n", lost_pn[i]);
+                ret = -1;
+            }
+        }
+        if (ret == 0 && cnx_r->maxdata_remote != FEC_TEST_MAX_DATA + 1000 * lost_pn[1]) {
+            DBG_PRINTF("Max data is %" PRIu64 " instead of %" PRIu64 "\n", cnx_r->maxdata_remote,
+                (uint64_t)(FEC_TEST_MAX_DATA + 1000 * lost_pn[1]));
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_get_fec_stats(cnx_s, &stats);
+        if (!stats.is_enabled || stats.nb_repair_sent != 2) {
+            DBG_PRINTF("Sender stats: enabled %d, %" PRIu64 " repairs\n", stats.is_enabled, stats.nb_repair_sent);
+            ret = -1;
+        }
+        picoquic_get_fec_stats(cnx_r, &stats);
+        if (stats.nb_repair_received != 2 || stats.nb_recovered != 2) {
+            DBG_PRINTF("Receiver stats: %" PRIu64 " repairs, %" PRIu64 " recovered\n", stats.nb_repair_received, stats.nb_recovered);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Close to a satellite handover, a repair is sent every other packet */
+        uint64_t handover_time = 12000000;
+        int is_pure_ack = 1;
+
+        for (uint64_t pn = FEC_TEST_NB_PACKETS; ret == 0 && pn < FEC_TEST_NB_PACKETS + 2; pn++) {
+            if (picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 0, handover_time)) {
+                DBG_PRINTF("Repair needed after packet %" PRIu64 "\n", pn);
+                ret = -1;
+            }
+            else {
+                picoquic_fec_record_sent(pkt_ctx, pn, payload, fec_test_payload(payload, sizeof(payload), pn));
+            }
+        }
+        if (ret == 0 && (!picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 0, handover_time) ||
+            picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 0, simulated_time))) {
+            DBG_PRINTF("%s", "Repair not scheduled before the handover\n");
+            ret = -1;
+        }
+        else if (ret == 0 && picoquic_format_fec_repair_frame(cnx_s, pkt_ctx, repair[0], repair[0] + sizeof(repair[0]), &is_pure_ack) == repair[0]) {
+            DBG_PRINTF("%s", "Cannot format repair frame before the handover\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The sender counts the recovered packets as lost. With 25% losses,
+         * a repair is sent every other packet. */
+        uint64_t pn = FEC_TEST_NB_PACKETS + 2;
+
+        picoquic_fec_record_sent(pkt_ctx, pn, payload, fec_test_payload(payload, sizeof(payload), pn));
+        for (int i = 0; i < 16; i++) {
+            cnx_s->nb_packets_sent += 64;
+            cnx_s->nb_retransmission_total += 16;
+            (void)picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 0, simulated_time);
+        }
+        pn++;
+        picoquic_fec_record_sent(pkt_ctx, pn, payload, fec_test_payload(payload, sizeof(payload), pn));
+        if (!picoquic_fec_is_repair_needed(cnx_s, cnx_s->path[0], pkt_ctx, 0, simulated_time)) {
+            DBG_PRINTF("%s", "Repair interval does not follow the loss rate\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx_s != NULL) {
+        picoquic_delete_cnx(cnx_s);
+    }
+    if (cnx_r != NULL) {
+        picoquic_delete_cnx(cnx_r);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/* Simulated connection with losses. FEC is negotiated through the transport
+ * parameters: the server proposes it by default, the client in its own
+ * parameters. The server sends repair frames between full size packets and
+ * at the end of each response. The client rebuilds some of the lost packets,
+ * but does not acknowledge them, so the server still repeats the data. */
+static test_api_stream_desc_t test_scenario_fec[] = {
+    { 4, 0, 257, 200000 },
+    { 8, 4, 257, 3000 },
+    { 12, 8, 257, 3000 },
+    { 16, 12, 257, 3000 }
+};
+
+int fec_loss_test()
+{
+    uint64_t simulated_time = 0;
+    uint64_t loss_mask = 0x0000100000200000ull;
+    picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    picoquic_tp_t client_parameters;
+    picoquic_fec_stats_t server_stats;
+    picoquic_fec_stats_t client_stats;
+    int ret;
+
+    memset(&client_parameters, 0, sizeof(picoquic_tp_t));
+    picoquic_init_transport_parameters(&client_parameters, 1);
+    client_parameters.enable_fec = 1;
+    ret = tls_api_one_scenario_init(&test_ctx, &simulated_time, 0, &client_parameters, NULL);
+
+    if (ret == 0) {
+        picoquic_set_default_fec_option(test_ctx->qserver, 1);
+        ret = tls_api_one_scenario_body(test_ctx, &simulated_time, test_scenario_fec, sizeof(test_scenario_fec), 0,
+            loss_mask, 0, 0, 0);
+    }
+
+    if (ret == 0) {
+        picoquic_get_fec_stats(test_ctx->cnx_server, &server_stats);
+        picoquic_get_fec_stats(test_ctx->cnx_client, &client_stats);
+        if (!server_stats.is_enabled || !client_stats.is_enabled) {
+            DBG_PRINTF("FEC not negotiated, server %d, client %d\n", server_stats.is_enabled, client_stats.is_enabled);
+            ret = -1;
+        }
+        else if (server_stats.nb_repair_sent < sizeof(test_scenario_fec) / sizeof(test_api_stream_desc_t) ||
+            client_stats.nb_repair_received == 0) {
+            /* Each response ends with a repair frame */
+            DBG_PRINTF("%" PRIu64 " repairs sent, %" PRIu64 " received\n",
+                server_stats.nb_repair_sent, client_stats.nb_repair_received);
+            ret = -1;
+        }
+        else if (client_stats.nb_recovered == 0) {
+            DBG_PRINTF("%s", "No packet recovered\n");
+            ret = -1;
+        }
+        else if (test_ctx->cnx_server->nb_retransmission_total == 0) {
+            DBG_PRINTF("%s", "The server did not see the losses\n");
+            ret = -1;
+        }
+    }
+
+    if (test_ctx != NULL) {
+        tls_api_delete_ctx(test_ctx);
+        test_ctx = NULL;
+    }
+
+    return ret;
+}
@@ -255,7 +255,8 @@ int varint_test()
 
     for (picoquic_varintformat_test_t* test = varint_test_cases; ret == 0 && test < max_test; test++) {
         for (int is_new_decode = 0; ret == 0 && is_new_decode <= 1; is_new_decode++) {
-            for (size_t buf_size = 0; ret == 0 && buf_size <= test->length + 2 && buf_size < 16; buf_size++) {
+            /* Buffers of 8 bytes or more use the single load code path */
+            for (size_t buf_size = 0; ret == 0 && buf_size <= test->length + 8 && buf_size < 16; buf_size++) {
                 int test_ret = 0;
                 uint64_t n64 = 0;
                 size_t length;
@@ -328,6 +329,60 @@ int varint_test()
     return ret;
 }
 
+/* Bulk decoding of varints, as used for ACK ranges. The values of mixed
+ * lengths must be decoded the same way close to the end of the buffer,
+ * where the single load is not possible, and elsewhere.
+ */
+#define VARINT_BULK_TEST_NB 64
+
+int varint_bulk_test()
+{
+    int ret = 0;
+    uint8_t buffer[VARINT_BULK_TEST_NB * 8];
+    uint8_t* bytes = buffer;
+    uint64_t values[VARINT_BULK_TEST_NB];
+    uint64_t decoded[VARINT_BULK_TEST_NB];
+    uint64_t random_ctx = 0xdeadbeefcafebabeull;
+
+    for (int i = 0; i < VARINT_BULK_TEST_NB && bytes != NULL; i++) {
+        int nb_bits = 6 + 8 * (i % 8);
+        values[i] = picoquic_test_random(&random_ctx) & ((nb_bits >= 62) ? 0x3FFFFFFFFFFFFFFFull : ((1ull << nb_bits) - 1));
+        bytes = picoquic_frames_varint_encode(bytes, buffer + sizeof(buffer), values[i]);
+    }
+
+    if (bytes == NULL) {
+        DBG_PRINTF("%s", "Cannot encode the test values\n");
+        ret = -1;
+    }
+    else {
+        const uint8_t* bytes_max = bytes;
+
+        memset(decoded, 0, sizeof(decoded));
+        if (picoquic_frames_varint_decode_n(buffer, bytes_max, decoded, VARINT_BULK_TEST_NB) != bytes_max ||
+            memcmp(values, decoded, sizeof(values)) != 0) {
+            DBG_PRINTF("%s", "Unexpected bulk decoding\n");
+            ret = -1;
+        }
+        else if (picoquic_frames_varint_decode_n(buffer, bytes_max - 1, decoded, VARINT_BULK_TEST_NB) != NULL) {
+            DBG_PRINTF("%s", "Truncated buffer not detected\n");
+            ret = -1;
+        }
+        else {
+            /* Decode one value at a time, check consistency with bulk decoding */
+            const uint8_t* x = buffer;
+            for (int i = 0; ret == 0 && i < VARINT_BULK_TEST_NB; i++) {
+                uint64_t n64 = 0;
+                if ((x = picoquic_frames_varint_decode(x, bytes_max, &n64)) == NULL || n64 != values[i]) {
+                    DBG_PRINTF("Unexpected decoding of value %d\n", i);
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
 /* Simple implementation of SQRT using UINT64, so we do not have to link 
  * the math library
  */
@@ -0,0 +1,173 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Tests of the live metrics export.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include "live_metrics.h"
+
+/* Check that the live metrics reflect the state of the connections,
+ * and that the counters of closed connections are preserved.
+ */
+static int live_metrics_check(picoquic_quic_t* quic, char const** expected, size_t nb_expected)
+{
+    int ret = 0;
+    size_t text_length = 0;
+    char text[16384];
+
+    if (picoquic_metrics_format(quic, text, sizeof(text) - 1, &text_length) != 0) {
+        DBG_PRINTF("%s", "Cannot format the metrics\n");
+        ret = -1;
+    }
+    else {
+        text[text_length] = 0;
+        for (size_t i = 0; ret == 0 && i < nb_expected; i++) {
+            if (strstr(text, expected[i]) == NULL) {
+                DBG_PRINTF("Cannot find <%s> in metrics\n", expected[i]);
+                ret = -1;
+            }
+        }
+        if (ret == 0 && (text_length < 6 || strcmp(text + text_length - 6, "# EOF\n") != 0)) {
+            DBG_PRINTF("%s", "Metrics do not end with EOF\n");
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+#define LIVE_METRICS_TEST_FILE "live_metrics_test.txt"
+
+int live_metrics_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_connection_id_t initial_cid = { { 1, 2, 3, 4, 5, 6, 7, 8 }, 8 };
+    picoquic_connection_id_t dest_cid = { { 5, 6, 7, 8 }, 4 };
+    picoquic_cnx_t* cnx = NULL;
+    struct sockaddr_in saddr;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time, &simulated_time, NULL, NULL, 0);
+    char const* expected_live[] = {
+        "picoquic_connections 1\n",
+        "picoquic_cnx_srtt_microseconds{cid=\"0102030405060708\",role=\"client\"} 250000\n",
+        "picoquic_cnx_packets_sent_total{cid=\"0102030405060708\",role=\"client\"} 17\n",
+        "picoquic_cnx_handover_suppressed_events_total{cid=\"0102030405060708\",role=\"client\"} 2\n",
+        "picoquic_packets_sent_total 17\n",
+        "picoquic_rtt_microseconds_bucket{le=\"4000\"} 0\n",
+        "picoquic_rtt_microseconds_bucket{le=\"8000\"} 1\n",
+        "picoquic_rtt_microseconds_bucket{le=\"+Inf\"} 2\n",
+        "picoquic_rtt_microseconds_sum 20000\n" };
+    char const* expected_closed[] = {
+        "picoquic_connections 0\n",
+        "picoquic_connections_closed_total 1\n",
+        "picoquic_packets_sent_total 17\n",
+        "picoquic_handover_suppressed_events_total 2\n" };
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if (picoquic_metrics_setup(quic, 4, PICOQUIC_METRICS_UPDATE_INTERVAL_DEFAULT) != 0) {
+        DBG_PRINTF("%s", "Cannot set up the metrics\n");
+        ret = -1;
+    }
+    else if ((cnx = picoquic_create_cnx(quic, initial_cid, dest_cid, (struct sockaddr*)&saddr,
+        simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        picoquic_metrics_rtt_sample(quic->live_metrics, 12000);
+        picoquic_metrics_rtt_sample(quic->live_metrics, 8000);
+        cnx->nb_packets_sent = 17;
+        cnx->nb_handover_suppressed = 2;
+        picoquic_metrics_update(cnx, simulated_time);
+        /* Updates are rate limited */
+        cnx->nb_packets_sent = 18;
+        picoquic_metrics_update(cnx, simulated_time + 1000);
+        ret = live_metrics_check(quic, expected_live, sizeof(expected_live) / sizeof(char const*));
+    }
+
+    if (ret == 0) {
+        size_t text_length = 0;
+        char small_text[256];
+        if (picoquic_metrics_format(quic, small_text, sizeof(small_text), &text_length) == 0) {
+            DBG_PRINTF("%s", "Metrics do not fit in 256 bytes\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        cnx->nb_packets_sent = 17;
+        picoquic_delete_cnx(cnx);
+        cnx = NULL;
+        ret = live_metrics_check(quic, expected_closed, sizeof(expected_closed) / sizeof(char const*));
+    }
+
+    if (ret == 0 && picoquic_metrics_export_start(quic, LIVE_METRICS_TEST_FILE, 1000000) != 0) {
+        DBG_PRINTF("%s", "Cannot start the metrics export\n");
+        ret = -1;
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    if (ret == 0) {
+        /* The file is written at least once before the export thread stops */
+        char line[256];
+        int is_found = 0;
+        FILE* F = picoquic_file_open(LIVE_METRICS_TEST_FILE, "r");
+
+        if (F == NULL) {
+            DBG_PRINTF("Cannot open %s\n", LIVE_METRICS_TEST_FILE);
+            ret = -1;
+        }
+        else {
+            while (fgets(line, sizeof(line), F) != NULL) {
+                if (strcmp(line, expected_closed[1]) == 0) {
+                    is_found = 1;
+                }
+            }
+            (void)picoquic_file_close(F);
+            if (!is_found || strcmp(line, "# EOF\n") != 0) {
+                DBG_PRINTF("%s", "Unexpected content of metrics file\n");
+                ret = -1;
+            }
+        }
+    }
+
+    return ret;
+}
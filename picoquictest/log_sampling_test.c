@@ -0,0 +1,148 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Tests of the selection of connections and packets for logging.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Count the packets selected for logging among the first nb_packets */
+static int log_sampling_count_packets(picoquic_cnx_t* cnx, uint64_t current_time, uint64_t nb_packets)
+{
+    int nb_selected = 0;
+
+    for (uint64_t pn = 0; pn < nb_packets; pn++) {
+        nb_selected += picoquic_is_packet_selected_for_log(cnx, pn, current_time);
+    }
+
+    return nb_selected;
+}
+
+int log_sampling_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 20000000;
+    picoquic_connection_id_t initial_cid = { { 1, 2, 3, 4, 5, 6, 7, 8 }, 8 };
+    picoquic_connection_id_t dest_cid = { { 5, 6, 7, 8 }, 4 };
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time, &simulated_time, NULL, NULL, 0);
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else {
+        /* About 1 connection in 4 is selected, and the choice is deterministic */
+        int nb_selected = 0;
+        picoquic_set_log_sampling(quic, 4, 8);
+        for (int i = 0; i < 1024; i++) {
+            picoquic_connection_id_t cid = initial_cid;
+            cid.id[6] = (uint8_t)(i >> 8);
+            cid.id[7] = (uint8_t)i;
+            if (picoquic_is_cnx_selected_for_log(quic, &cid)) {
+                nb_selected++;
+            }
+            if (picoquic_is_cnx_selected_for_log(quic, &cid) != picoquic_is_cnx_selected_for_log(quic, &cid)) {
+                ret = -1;
+            }
+        }
+        if (ret != 0 || nb_selected < 192 || nb_selected > 320) {
+            DBG_PRINTF("Selected %d connections out of 1024 for sample rate 4", nb_selected);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        struct sockaddr_in saddr;
+        memset(&saddr, 0, sizeof(struct sockaddr_in));
+        /* Sampled out connections are not logged */
+        picoquic_set_log_sampling(quic, UINT32_MAX, 8);
+        cnx = picoquic_create_cnx(quic, initial_cid, dest_cid, (struct sockaddr*)&saddr,
+            simulated_time, 0, "test-sni", "test-alpn", 1);
+        if (cnx == NULL || picoquic_cnx_is_still_logging(cnx)) {
+            DBG_PRINTF("%s", "Sampled out connection is still logging\n");
+            ret = -1;
+        }
+        if (cnx != NULL) {
+            picoquic_delete_cnx(cnx);
+        }
+        /* Log all connections, 1 packet in 8 */
+        picoquic_set_log_sampling(quic, 1, 8);
+        cnx = picoquic_create_cnx(quic, initial_cid, dest_cid, (struct sockaddr*)&saddr,
+            simulated_time, 0, "test-sni", "test-alpn", 1);
+        if (cnx == NULL || !picoquic_cnx_is_still_logging(cnx)) {
+            DBG_PRINTF("%s", "Sampled connection is not logging\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && log_sampling_count_packets(cnx, simulated_time, 800) != 100) {
+        DBG_PRINTF("%s", "Unexpected packet sampling\n");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        /* A PTO opens a one second window in which all packets are logged */
+        picoquic_set_log_trigger_window(quic, PICOQUIC_LOG_TRIGGER_PTO, 1000000);
+        picoquic_log_trigger_event(cnx, PICOQUIC_LOG_TRIGGER_HANDOVER, simulated_time);
+        if (log_sampling_count_packets(cnx, simulated_time + 500000, 800) != 100) {
+            DBG_PRINTF("%s", "Window opened by unselected trigger\n");
+            ret = -1;
+        }
+        picoquic_log_trigger_event(cnx, PICOQUIC_LOG_TRIGGER_PTO, simulated_time);
+        if (log_sampling_count_packets(cnx, simulated_time + 500000, 800) != 800) {
+            DBG_PRINTF("%s", "Packets not logged in trigger window\n");
+            ret = -1;
+        }
+        else if (log_sampling_count_packets(cnx, simulated_time + 1000001, 800) != 100) {
+            DBG_PRINTF("%s", "Packets logged after trigger window\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Handover windows are centered on the scheduled handovers, at 12, 27, 42 and 57 seconds */
+        picoquic_set_log_trigger_window(quic, PICOQUIC_LOG_TRIGGER_HANDOVER, 2000000);
+        if (log_sampling_count_packets(cnx, 26500000, 800) != 800 ||
+            log_sampling_count_packets(cnx, 60000000 + 57900000, 800) != 800 ||
+            log_sampling_count_packets(cnx, 35000000, 800) != 100) {
+            DBG_PRINTF("%s", "Unexpected handover window sampling\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -453,7 +453,8 @@ typedef enum {
     multipath_test_dg_af,
     multipath_test_standby,
     multipath_test_standup,
-    multipath_test_tunnel
+    multipath_test_tunnel,
+    multipath_test_redundant
 } multipath_test_enum_t;
 
 #ifdef _WINDOWS
@@ -710,6 +711,11 @@ int multipath_test_one(uint64_t max_completion_microsec, multipath_test_enum_t t
             multipath_init_datagram_ctx(test_ctx, &dg_ctx);
         }
 
+        if (test_id == multipath_test_redundant) {
+            picoquic_set_default_path_scheduler(test_ctx->qserver, picoquic_redundant_path_scheduler);
+            picoquic_set_path_scheduler(test_ctx->cnx_client, picoquic_redundant_path_scheduler);
+        }
+
         picoquic_set_binlog(test_ctx->qserver, ".");
         test_ctx->qserver->use_long_log = 1;
         /* set the binary log on the client side */
@@ -1020,6 +1026,18 @@ int multipath_test_one(uint64_t max_completion_microsec, multipath_test_enum_t t
         }
     }
 
+    /* With the redundant scheduler, verify that packets were repeated on the other path */
+    if (ret == 0 && test_id == multipath_test_redundant) {
+        if (test_ctx->cnx_server->path_scheduler != picoquic_redundant_path_scheduler) {
+            DBG_PRINTF("%s", "Redundant scheduler not set on server connection.\n");
+            ret = -1;
+        }
+        else if (test_ctx->cnx_server->nb_preemptive_repeat == 0) {
+            DBG_PRINTF("%s", "No redundant packet sent by the server.\n");
+            ret = -1;
+        }
+    }
+
     /* In the datagram scenarios, verify the datagram transmission */
     if (ret == 0 && (test_id == multipath_test_datagram || test_id == multipath_test_dg_af)) {
         ret = multipath_verify_datagram_sent(&dg_ctx, test_id);
@@ -1673,6 +1691,16 @@ int multipath_tunnel_test()
     return multipath_test_one(max_completion_microsec, multipath_test_tunnel, multipath_variant_unique);
 }
 
+/* Redundant scheduling: the packets sent on one path are repeated on the
+ * other path, so the transfer takes longer than in the basic test.
+ */
+int multipath_redundant_test()
+{
+    uint64_t max_completion_microsec = 2000000;
+
+    return multipath_test_one(max_completion_microsec, multipath_test_redundant, multipath_variant_unique);
+}
+
 
 /* Simple multipath tests.
  * These are the same as the multipath tests, but using the "simple" multipath option
@@ -1938,3 +1966,171 @@ int path_packet_queue_test()
  * 
  * TODO: break that into parts that can be verified!
  */
+
+/* Unit test of the path schedulers. Set up a connection with two paths,
+ * a low RTT satellite path and a higher RTT terrestrial path with a third
+ * of the bandwidth, and verify the choice of each scheduler.
+ */
+int path_scheduler_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_path_t* candidates[2];
+    picoquic_connection_id_t icid = { { 0x5c, 0xed, 0, 0, 0, 0, 0, 0 }, 8 };
+    struct sockaddr_in saddr;
+    struct sockaddr_in saddr2;
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = htons(4433);
+    memcpy(&saddr2, &saddr, sizeof(struct sockaddr_in));
+    saddr2.sin_port = htons(4434);
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+        simulated_time, &simulated_time, NULL, NULL, 0);
+    if (quic == NULL) {
+        ret = -1;
+    }
+    else {
+        cnx = picoquic_create_cnx(quic, icid, picoquic_null_connection_id,
+            (struct sockaddr*)&saddr, simulated_time, 0, "test-sni", "test-alpn", 1);
+        if (cnx == NULL || picoquic_create_path(cnx, simulated_time, NULL, (struct sockaddr*)&saddr2) < 0) {
+            DBG_PRINTF("%s", "Cannot create the connection paths\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        candidates[0] = cnx->path[0];
+        candidates[1] = cnx->path[1];
+        candidates[0]->smoothed_rtt = 30000;
+        candidates[0]->bandwidth_estimate = 3000000;
+        candidates[0]->last_sent_time = 2000;
+        candidates[1]->smoothed_rtt = 60000;
+        candidates[1]->bandwidth_estimate = 1000000;
+        candidates[1]->last_sent_time = 1000;
+
+        if (picoquic_get_path_scheduler("minrtt") != picoquic_min_rtt_path_scheduler ||
+            picoquic_get_path_scheduler("weighted") != picoquic_weighted_path_scheduler ||
+            picoquic_get_path_scheduler("redundant") != picoquic_redundant_path_scheduler ||
+            picoquic_get_path_scheduler("handover") != picoquic_handover_path_scheduler ||
+            picoquic_get_path_scheduler("arrival") != picoquic_arrival_path_scheduler ||
+            picoquic_get_path_scheduler("fastest") != NULL) {
+            DBG_PRINTF("%s", "Path schedulers not found by name\n");
+            ret = -1;
+        }
+        else if (picoquic_path_scheduler_select_path(cnx, candidates, 2, simulated_time) != -1) {
+            DBG_PRINTF("%s", "Default scheduler should not select a path\n");
+            ret = -1;
+        }
+        else if (picoquic_set_path_handover_prone(cnx, 0, 1) != 0 ||
+            picoquic_set_path_handover_prone(cnx, 123, 1) == 0) {
+            DBG_PRINTF("%s", "Cannot mark the satellite path\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_set_path_scheduler(cnx, picoquic_min_rtt_path_scheduler);
+        if (picoquic_path_scheduler_select_path(cnx, candidates, 2, simulated_time) != 0) {
+            DBG_PRINTF("%s", "Min RTT scheduler did not select path 0\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_set_path_scheduler(cnx, picoquic_redundant_path_scheduler);
+        if (picoquic_path_scheduler_select_path(cnx, candidates, 2, simulated_time) != 1) {
+            DBG_PRINTF("%s", "Redundant scheduler did not select the least recently used path\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        int nb_selected[2] = { 0, 0 };
+
+        picoquic_set_path_scheduler(cnx, picoquic_weighted_path_scheduler);
+        for (int i = 0; i < 400; i++) {
+            int selected = picoquic_path_scheduler_select_path(cnx, candidates, 2, simulated_time);
+            if (selected < 0 || selected > 1) {
+                ret = -1;
+                break;
+            }
+            nb_selected[selected]++;
+        }
+        if (ret != 0 || nb_selected[0] != 300 || nb_selected[1] != 100) {
+            DBG_PRINTF("Weighted scheduler selected %d, %d\n", nb_selected[0], nb_selected[1]);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Handovers happen at 12, 27, 42 and 57 seconds past the minute */
+        uint64_t handover_time = 60000000ull + 12000000ull;
+
+        picoquic_set_path_scheduler(cnx, picoquic_handover_path_scheduler);
+        if (picoquic_path_scheduler_select_path(cnx, candidates, 2, handover_time + 20000000ull) != 0) {
+            DBG_PRINTF("%s", "Handover scheduler did not select path 0 between handovers\n");
+            ret = -1;
+        }
+        else if (picoquic_path_scheduler_select_path(cnx, candidates, 2, handover_time - 50000) != 1 ||
+            picoquic_path_scheduler_select_path(cnx, candidates, 2, handover_time + 50000) != 1) {
+            DBG_PRINTF("%s", "Handover scheduler did not avoid the satellite path\n");
+            ret = -1;
+        }
+        else if (picoquic_path_scheduler_select_path(cnx, candidates, 1, handover_time) != 0) {
+            DBG_PRINTF("%s", "Handover scheduler did not fall back to the satellite path\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Path 0 delivers earlier. When it is congestion limited, holding
+         * the data for a short time beats sending it on path 1. */
+        picoquic_set_path_scheduler(cnx, picoquic_arrival_path_scheduler);
+        cnx->path[0]->challenge_verified = 1;
+        cnx->path[0]->send_mtu = 1440;
+        cnx->path[1]->send_mtu = 1440;
+        cnx->path[0]->cwin = 30000;
+        if (picoquic_path_scheduler_select_path(cnx, candidates, 2, simulated_time) != 0 ||
+            cnx->path[0]->scheduler_hold_time != 0) {
+            DBG_PRINTF("%s", "Arrival scheduler did not select path 0\n");
+            ret = -1;
+        }
+        else {
+            cnx->path[0]->bytes_in_transit = 30000;
+            if (picoquic_path_scheduler_select_path(cnx, &candidates[1], 1, simulated_time) != 0 ||
+                cnx->path[1]->scheduler_hold_time != simulated_time + 480) {
+                DBG_PRINTF("Arrival scheduler hold until %" PRIu64 "\n", cnx->path[1]->scheduler_hold_time);
+                ret = -1;
+            }
+            else if (picoquic_path_scheduler_select_path(cnx, &candidates[1], 1, simulated_time + 100) != 0 ||
+                cnx->path[1]->scheduler_hold_time != simulated_time + 480) {
+                DBG_PRINTF("%s", "Arrival scheduler did not keep the hold\n");
+                ret = -1;
+            }
+            else if (picoquic_path_scheduler_select_path(cnx, &candidates[1], 1, simulated_time + 500) != 0 ||
+                cnx->path[1]->scheduler_hold_time != 0) {
+                DBG_PRINTF("%s", "Arrival scheduler renewed an expired hold\n");
+                ret = -1;
+            }
+            else {
+                /* If the faster path is blocked for too long, send on path 1 */
+                cnx->path[0]->bytes_in_transit = 90000;
+                if (picoquic_path_scheduler_select_path(cnx, &candidates[1], 1, simulated_time + 600) != 0 ||
+                    cnx->path[1]->scheduler_hold_time != 0) {
+                    DBG_PRINTF("%s", "Arrival scheduler held data for a blocked path\n");
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
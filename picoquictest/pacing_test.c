@@ -339,4 +339,72 @@ int pacing_repeat_test()
         }
     }
     return ret;
-}
\ No newline at end of file
+}
+
+/* Test of the txtime mode: packets are authorized until the departure time
+ * reaches the horizon, and each packet is scheduled one packet time after
+ * the previous one.
+ */
+int pacing_txtime_test()
+{
+    int ret = 0;
+    picoquic_pacing_t pacing = { 0 };
+    uint64_t current_time = 1000;
+    uint64_t next_time = UINT64_MAX;
+    uint64_t last_departure = 0;
+    const uint64_t horizon = 1000;
+    const size_t send_mtu = 1000;
+    int nb_sent = 0;
+
+    /* 10 MB/s, 100 microseconds per packet, quantum of 2 packets */
+    picoquic_update_pacing_parameters(&pacing, 10000000.0, 2000, send_mtu, 100000, NULL);
+    pacing.txtime_horizon_nanosec = (int64_t)(horizon * 1000);
+
+    while (ret == 0 && picoquic_is_authorized_by_pacing(&pacing, current_time, &next_time, 0, NULL)) {
+        picoquic_update_pacing_data_after_send(&pacing, send_mtu, send_mtu, current_time);
+        if (pacing.departure_time < last_departure || pacing.departure_time > current_time + horizon ||
+            (nb_sent > 1 && pacing.departure_time != last_departure + 100)) {
+            DBG_PRINTF("Packet %d, unexpected departure time %" PRIu64, nb_sent, pacing.departure_time);
+            ret = -1;
+        }
+        last_departure = pacing.departure_time;
+        nb_sent++;
+        if (nb_sent > 100) {
+            DBG_PRINTF("%s", "Pacing does not stop at horizon");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && nb_sent != 12) {
+        DBG_PRINTF("Expected 12 packets, got %d", nb_sent);
+        ret = -1;
+    }
+
+    if (ret == 0 && next_time != current_time + 101) {
+        DBG_PRINTF("Expected next time %" PRIu64 ", got %" PRIu64, current_time + 101, next_time);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        /* One packet time later, exactly one more packet can be scheduled */
+        current_time = next_time;
+        next_time = UINT64_MAX;
+        if (!picoquic_is_authorized_by_pacing(&pacing, current_time, &next_time, 0, NULL)) {
+            DBG_PRINTF("%s", "Packet not authorized after one packet time");
+            ret = -1;
+        }
+        else {
+            picoquic_update_pacing_data_after_send(&pacing, send_mtu, send_mtu, current_time);
+            if (pacing.departure_time > current_time + horizon || pacing.departure_time <= last_departure) {
+                DBG_PRINTF("Unexpected departure time %" PRIu64, pacing.departure_time);
+                ret = -1;
+            }
+            else if (picoquic_is_authorized_by_pacing(&pacing, current_time, &next_time, 0, NULL)) {
+                DBG_PRINTF("%s", "Second packet should not be authorized");
+                ret = -1;
+            }
+        }
+    }
+
+    return ret;
+}
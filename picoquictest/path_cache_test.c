@@ -0,0 +1,232 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2024, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/*
+* Test of the cross connection path state cache.
+*/
+
+#include "picoquic_internal.h"
+#include "picoquic_utils.h"
+#include "picoquictest_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Writer thread, used to check that readers never see a partial update */
+typedef struct st_path_cache_test_writer_t {
+    picoquic_path_cache_t* cache;
+    struct sockaddr_in addr;
+    int nb_updates;
+} path_cache_test_writer_t;
+
+static picoquic_thread_return_t path_cache_test_writer(void* arg)
+{
+    path_cache_test_writer_t* writer = (path_cache_test_writer_t*)arg;
+
+    for (int i = 0; i < writer->nb_updates; i++) {
+        uint64_t rtt = ((i & 1) == 0) ? 1000 : 1000000;
+        (void)picoquic_path_cache_update(writer->cache, (struct sockaddr*)&writer->addr, rtt, 1000 * rtt, 0, 1000 + i);
+    }
+
+    picoquic_thread_do_return;
+}
+
+static void path_cache_test_addr(struct sockaddr_in* addr, uint32_t ipv4)
+{
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(4433);
+    picoformat_32((uint8_t*)&addr->sin_addr, ipv4);
+}
+
+int path_cache_test()
+{
+    int ret = 0;
+    uint64_t simulated_time = 1000000;
+    picoquic_path_cache_entry_t entry;
+    struct sockaddr_in addr;
+    struct sockaddr_in6 addr6;
+    picoquic_quic_t* quic = NULL;
+    picoquic_path_cache_t* cache = picoquic_path_cache_create(16, PICOQUIC_PATH_CACHE_PREFIX_V4_DEFAULT,
+        PICOQUIC_PATH_CACHE_PREFIX_V6_DEFAULT, 1000000, 10000000);
+
+    memset(&addr6, 0, sizeof(struct sockaddr_in6));
+    addr6.sin6_family = AF_INET6;
+    addr6.sin6_addr.s6_addr[0] = 10;
+
+    if (cache == NULL) {
+        DBG_PRINTF("%s", "Cannot create path cache\n");
+        ret = -1;
+    }
+
+    /* Addresses in the same /24 share the entry */
+    if (ret == 0) {
+        path_cache_test_addr(&addr, 0x0A000105);
+        if (picoquic_path_cache_update(cache, (struct sockaddr*)&addr, 20000, 10000000, 0, simulated_time) != 0) {
+            ret = -1;
+        }
+        path_cache_test_addr(&addr, 0x0A0001C8);
+        if (ret != 0 || picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time, &entry) != 0 ||
+            entry.rtt_min != 20000 || entry.bandwidth != 10000000 || entry.loss_ppm != 0 || entry.nb_updates != 1) {
+            DBG_PRINTF("%s", "Cannot find the entry for the same prefix\n");
+            ret = -1;
+        }
+        path_cache_test_addr(&addr, 0x0A000205);
+        if (ret == 0 && (picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time, &entry) == 0 ||
+            picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr6, simulated_time, &entry) == 0)) {
+            DBG_PRINTF("%s", "Unexpected entry for another prefix\n");
+            ret = -1;
+        }
+    }
+
+    /* Recent values weigh 7/8, values one half life old weigh 1/2 */
+    if (ret == 0) {
+        path_cache_test_addr(&addr, 0x0A000107);
+        (void)picoquic_path_cache_update(cache, (struct sockaddr*)&addr, 40000, 10000000, 0, simulated_time);
+        if (picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time, &entry) != 0 ||
+            entry.rtt_min != 22500 || entry.nb_updates != 2) {
+            DBG_PRINTF("Unexpected RTT after recent update: %" PRIu64 "\n", entry.rtt_min);
+            ret = -1;
+        }
+        else {
+            simulated_time += 1000000;
+            (void)picoquic_path_cache_update(cache, (struct sockaddr*)&addr, 40000, 10000000, 0, simulated_time);
+            if (picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time, &entry) != 0 ||
+                entry.rtt_min != 31250 || entry.nb_updates != 3) {
+                DBG_PRINTF("Unexpected RTT after one half life: %" PRIu64 "\n", entry.rtt_min);
+                ret = -1;
+            }
+            else if (picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time + 10000001, &entry) == 0) {
+                DBG_PRINTF("%s", "Entry older than max age was found\n");
+                ret = -1;
+            }
+        }
+    }
+
+    /* The cache does not grow beyond its size, and the last update is kept */
+    if (ret == 0) {
+        int nb_found = 0;
+
+        for (uint32_t i = 0; i < 64; i++) {
+            path_cache_test_addr(&addr, 0x0B000001 + (i << 8));
+            (void)picoquic_path_cache_update(cache, (struct sockaddr*)&addr, 1000 + i, 1000000, 0, simulated_time + i);
+        }
+        for (uint32_t i = 0; ret == 0 && i < 64; i++) {
+            path_cache_test_addr(&addr, 0x0B000001 + (i << 8));
+            if (picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time + 64, &entry) == 0) {
+                nb_found++;
+                if (entry.rtt_min != 1000 + i) {
+                    DBG_PRINTF("Wrong entry for prefix %u\n", i);
+                    ret = -1;
+                }
+            }
+            else if (i == 63) {
+                DBG_PRINTF("%s", "Last update was evicted\n");
+                ret = -1;
+            }
+        }
+        if (ret == 0 && nb_found > 16) {
+            DBG_PRINTF("Found %d entries in a cache of 16\n", nb_found);
+            ret = -1;
+        }
+    }
+
+    /* New connections are seeded from the cache, and update it when deleted */
+    if (ret == 0) {
+        quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+            NULL, NULL, NULL, NULL, simulated_time, &simulated_time, NULL, NULL, 0);
+        if (quic == NULL) {
+            DBG_PRINTF("%s", "Cannot create QUIC context\n");
+            ret = -1;
+        }
+        else {
+            picoquic_connection_id_t initial_cid = { { 1, 2, 3, 4, 5, 6, 7, 8 }, 8 };
+            picoquic_connection_id_t dest_cid = { { 5, 6, 7, 8 }, 4 };
+            picoquic_cnx_t* cnx;
+
+            picoquic_set_path_cache(quic, cache);
+            path_cache_test_addr(&addr, 0x0C000001);
+            (void)picoquic_path_cache_update(cache, (struct sockaddr*)&addr, 50000, 2000000, 100000, simulated_time);
+            path_cache_test_addr(&addr, 0x0C000002);
+            if ((cnx = picoquic_create_cnx(quic, initial_cid, dest_cid, (struct sockaddr*)&addr,
+                simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+                DBG_PRINTF("%s", "Cannot create connection\n");
+                ret = -1;
+            }
+            else {
+                if (cnx->seed_rtt_min != 50000 || cnx->seed_cwin != 90000 || cnx->seed_ip_addr_length != 4 ||
+                    memcmp(cnx->seed_ip_addr, &addr.sin_addr, 4) != 0) {
+                    DBG_PRINTF("Unexpected seed, rtt %" PRIu64 ", cwin %" PRIu64 "\n", cnx->seed_rtt_min, cnx->seed_cwin);
+                    ret = -1;
+                }
+                cnx->path[0]->rtt_min = 50000;
+                cnx->path[0]->bandwidth_estimate_max = 2000000;
+                cnx->nb_packets_sent = 100;
+                cnx->nb_retransmission_total = 10;
+                picoquic_delete_cnx(cnx);
+                if (ret == 0 && (picoquic_path_cache_lookup(cache, (struct sockaddr*)&addr, simulated_time, &entry) != 0 ||
+                    entry.nb_updates != 2 || entry.rtt_min != 50000 || entry.loss_ppm != 100000)) {
+                    DBG_PRINTF("%s", "Cache not updated when deleting the connection\n");
+                    ret = -1;
+                }
+            }
+        }
+    }
+
+    /* Readers never see a partial update. Rounding errors accumulate in the
+     * blended values, but stay well below the difference between two
+     * successive updates. */
+    if (ret == 0) {
+        path_cache_test_writer_t writer;
+        picoquic_thread_t thread;
+
+        memset(&writer, 0, sizeof(writer));
+        writer.cache = cache;
+        writer.nb_updates = 100000;
+        path_cache_test_addr(&writer.addr, 0x0D000001);
+        (void)picoquic_path_cache_update(cache, (struct sockaddr*)&writer.addr, 1000, 1000000, 0, 1000);
+        if (picoquic_create_thread(&thread, path_cache_test_writer, &writer) != 0) {
+            DBG_PRINTF("%s", "Cannot create the writer thread\n");
+            ret = -1;
+        }
+        else {
+            for (int i = 0; i < 100000; i++) {
+                if (picoquic_path_cache_lookup(cache, (struct sockaddr*)&writer.addr, 1000, &entry) == 0 &&
+                    (entry.bandwidth + 16000 < 1000 * entry.rtt_min || entry.bandwidth > 1000 * entry.rtt_min + 16000)) {
+                    DBG_PRINTF("Inconsistent entry, rtt %" PRIu64 ", bandwidth %" PRIu64 "\n", entry.rtt_min, entry.bandwidth);
+                    ret = -1;
+                    break;
+                }
+            }
+            (void)picoquic_wait_thread(thread);
+#ifdef _WINDOWS
+            CloseHandle(thread);
+#endif
+        }
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+    picoquic_path_cache_delete(cache);
+
+    return ret;
+}
@@ -39,6 +39,7 @@ int util_connection_id_parse_test();
 int util_sprintf_test();
 int util_memcmp_test();
 int util_threading_test();
+int util_hdr_histogram_test();
 int picohash_test();
 int picohash_embedded_test();
 int bytestream_test();
@@ -94,10 +95,12 @@ int ackrange_test();
 int ack_of_ack_test();
 int ack_disorder_test();
 int ack_horizon_test();
+int ack_cache_test();
 int tls_api_two_connections_test();
 int cleartext_aead_test();
 int tls_api_multiple_versions_test();
 int varint_test();
+int varint_bulk_test();
 int sqrt_for_test_test();
 int tls_api_client_losses_test();
 int tls_api_server_losses_test();
@@ -105,6 +108,16 @@ int skip_frame_test();
 int keep_alive_test();
 int logger_test();
 int binlog_test();
+int binlog_async_test();
+int binlog_index_test();
+int columnar_test();
+int log_sampling_test();
+int live_metrics_test();
+int cc_telemetry_test();
+int path_cache_test();
+int cc_plugin_test();
+int experiment_arm_test();
+int cc_fixed_point_test();
 int app_message_overflow_test();
 int socket_test();
 int test_stateless_blowback();
@@ -176,6 +189,8 @@ int sockloop_migration_test();
 int sockloop_nat_test();
 int sockloop_thread_test();
 int sockloop_thread_name_test();
+int sockloop_batch_test();
+int send_batch_test();
 int splay_test();
 int TlsStreamFrameTest();
 int draft17_vector_test();
@@ -209,6 +224,7 @@ int new_rotated_key_test();
 int key_rotation_test();
 int key_rotation_auto_server();
 int key_rotation_auto_client();
+int crypto_offload_test();
 int false_migration_test();
 int nat_handshake_test();
 int key_rotation_vector_test();
@@ -245,6 +261,7 @@ int reset_extra_stop_test();
 int reset_need_max_test();
 int reset_need_reset_test();
 int reset_need_stop_test();
+int selective_repeat_test();
 int ready_to_send_test();
 int ready_to_skip_test();
 int ready_to_zero_test();
@@ -317,6 +334,11 @@ int bad_coalesce_test();
 int bad_cnxid_test();
 int stream_splay_test();
 int stream_output_test();
+int stream_by_reference_test();
+int stream_file_test();
+int stream_delivery_latency_test();
+int memory_budget_test();
+int stream_reorder_stats_test();
 int stream_rank_test();
 int provide_stream_buffer_test();
 int not_before_cnxid_test();
@@ -341,6 +363,7 @@ int l4s_prague_test();
 int l4s_prague_updown_test();
 int l4s_bbr_test();
 int l4s_bbr_updown_test();
+int cc_bench_test();
 int large_client_hello_test();
 int limited_reno_test();
 int limited_cubic_test();
@@ -357,6 +380,9 @@ int datagram_size_test();
 int datagram_small_test();
 int datagram_small_new_test();
 int datagram_small_packet_test();
+int datagram_queue_test();
+int fec_repair_test();
+int fec_loss_test();
 int datagram_wifi_test();
 int ddos_amplification_test();
 int ddos_amplification_0rtt_test();
@@ -377,6 +403,7 @@ int cwin_max_test();
 int initial_race_test();
 int pacing_test();
 int pacing_repeat_test();
+int pacing_txtime_test();
 int chacha20_test();
 int cnx_limit_test();
 int cert_verify_bad_cert_test();
@@ -445,6 +472,8 @@ int multipath_standby_test();
 int multipath_standup_test();
 int multipath_qlog_test();
 int multipath_tunnel_test();
+int multipath_redundant_test();
+int path_scheduler_test();
 int simple_multipath_basic_test();
 int simple_multipath_drop_first_test();
 int simple_multipath_drop_second_test();
@@ -471,6 +500,7 @@ int red_fast_test();
 int red_newreno_test();
 int multi_segment_test();
 int pacing_bbr_test();
+int cc_fixed_point_sim_test();
 int pacing_cubic_test();
 int pacing_dcubic_test();
 int pacing_fast_test();
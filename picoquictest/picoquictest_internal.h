@@ -378,6 +378,50 @@ int picoquic_test_set_minimal_cnx(picoquic_quic_t** quic, picoquic_cnx_t** cnx);
 int picoquic_test_reset_minimal_cnx(picoquic_quic_t* quic, picoquic_cnx_t** cnx);
 void picoquic_test_delete_minimal_cnx(picoquic_quic_t** quic, picoquic_cnx_t** cnx);
 
+/* Congestion control evaluation harness, see cc_bench.c */
+#define CC_BENCH_MAX_FLOWS 64
+#define CC_BENCH_MAX_THREADS 64
+
+typedef struct st_cc_bench_link_t {
+    char const* name;
+    double mbps;
+    uint64_t rtt;
+    uint64_t loss_ppm; /* random losses, per million packets */
+    uint64_t buffer_delay; /* max queue delay at the bottleneck */
+    uint64_t handover_offset; /* time of first handover, if handover_period > 0 */
+    uint64_t handover_period;
+    uint64_t handover_duration;
+    uint64_t start_time; /* start of the simulation, e.g., to align with a handover schedule */
+} cc_bench_link_t;
+
+typedef struct st_cc_bench_scenario_t {
+    picoquic_congestion_algorithm_t const* ccalgo;
+    const cc_bench_link_t* link;
+    int nb_flows;
+    size_t flow_size;
+    uint64_t max_duration;
+    uint64_t seed;
+} cc_bench_scenario_t;
+
+typedef struct st_cc_bench_result_t {
+    int ret;
+    int nb_completed;
+    uint64_t duration;
+    double goodput_mbps;
+    uint64_t rtt_p50;
+    uint64_t rtt_p99;
+    double retransmit_ratio;
+    double fairness; /* Jain's index of per flow throughput */
+} cc_bench_result_t;
+
+extern const cc_bench_link_t cc_bench_default_links[];
+extern const size_t cc_bench_nb_default_links;
+
+int cc_bench_run_one(const cc_bench_scenario_t* scenario, cc_bench_result_t* result);
+int cc_bench_run_matrix(const cc_bench_scenario_t* scenarios, size_t nb_scenarios, cc_bench_result_t* results, int nb_threads);
+void cc_bench_print_header(FILE* F);
+void cc_bench_print_result(FILE* F, const cc_bench_scenario_t* scenario, const cc_bench_result_t* result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -787,3 +787,133 @@ int ack_horizon_test()
     int ret = ack_disorder_test_one(ACK_HORIZON_LOG, 1000000, 196.0);
     return ret;
 }
+
+/* Check that the incremental ACK encoding produces the same frames as the
+ * full encoding. Two connections receive the same packets and the same
+ * acks of acks; the ACK cache is invalidated before each ACK on the second
+ * one. Packets are received in order with some losses, old holes are
+ * sometimes filled, and some ranges are acknowledged.
+ */
+static int ack_cache_compare_lists(picoquic_sack_list_t* sack_a, picoquic_sack_list_t* sack_b)
+{
+    int ret = 0;
+    picoquic_sack_item_t* item_a = picoquic_sack_first_item(sack_a);
+    picoquic_sack_item_t* item_b = picoquic_sack_first_item(sack_b);
+
+    while (ret == 0 && item_a != NULL && item_b != NULL) {
+        if (item_a->start_of_sack_range != item_b->start_of_sack_range ||
+            item_a->end_of_sack_range != item_b->end_of_sack_range ||
+            item_a->nb_times_sent[0] != item_b->nb_times_sent[0] ||
+            item_a->nb_times_sent[1] != item_b->nb_times_sent[1]) {
+            ret = -1;
+        }
+        item_a = picoquic_sack_next_item(item_a);
+        item_b = picoquic_sack_next_item(item_b);
+    }
+    if (item_a != NULL || item_b != NULL) {
+        ret = -1;
+    }
+    return ret;
+}
+
+int ack_cache_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx[2] = { NULL, NULL };
+    picoquic_packet_context_enum pc = picoquic_packet_context_application;
+    uint64_t random_ctx = 0xdeadbeefcafe;
+    uint64_t next_pn = 0;
+    uint64_t current_time = 0;
+    uint64_t nb_full = 0;
+    uint8_t bytes[2][1024];
+    uint8_t* bytes_next[2];
+
+    if (picoquic_test_set_minimal_cnx(&quic, &cnx[0]) != 0 ||
+        (cnx[1] = picoquic_create_cnx(quic, picoquic_null_connection_id, picoquic_null_connection_id,
+            NULL, 0, 0, PICOQUIC_TEST_SNI, "minimal", 1)) == NULL) {
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < 2000; i++) {
+        uint64_t r = picoquic_test_uniform_random(&random_ctx, 100);
+
+        current_time += 1000;
+        for (int x = 0; x < 2; x++) {
+            cnx[x]->sending_ecn_ack = 0;
+        }
+        if (r < 10) {
+            /* Lose a packet, creating a new hole */
+            next_pn++;
+        }
+        else if (r < 15 && next_pn > 100) {
+            /* Fill an old hole, if the packet was not received yet */
+            uint64_t pn = next_pn - 1 - picoquic_test_uniform_random(&random_ctx, 100);
+            if (picoquic_is_pn_already_received(cnx[0], pc, cnx[0]->first_local_cnxid_list->local_cnxid_first, pn) == 0) {
+                for (int x = 0; ret == 0 && x < 2; x++) {
+                    ret = picoquic_record_pn_received(cnx[x], pc, cnx[x]->first_local_cnxid_list->local_cnxid_first, pn, current_time);
+                }
+            }
+        }
+        else if (r < 20) {
+            /* Acknowledge the first range */
+            picoquic_sack_item_t* first = picoquic_sack_first_item(&cnx[0]->ack_ctx[pc].sack_list);
+            if (first != NULL) {
+                uint64_t range_min = first->start_of_sack_range;
+                uint64_t range_max = first->end_of_sack_range;
+                for (int x = 0; x < 2; x++) {
+                    (void)picoquic_process_ack_of_ack_range(&cnx[x]->ack_ctx[pc].sack_list, NULL, range_min, range_max);
+                }
+            }
+        }
+        for (int x = 0; ret == 0 && x < 2; x++) {
+            ret = picoquic_record_pn_received(cnx[x], pc, cnx[x]->first_local_cnxid_list->local_cnxid_first, next_pn, current_time);
+        }
+        next_pn++;
+
+        if (ret == 0) {
+            int more_data[2] = { 0, 0 };
+            /* Use a small buffer from time to time, to test truncated ACKs */
+            size_t length = (r >= 95) ? 48 : sizeof(bytes[0]);
+
+            for (int x = 0; x < 2; x++) {
+                if (x == 1 && cnx[x]->ack_ctx[pc].ack_cache != NULL) {
+                    cnx[x]->ack_ctx[pc].ack_cache->is_valid = 0;
+                }
+                bytes_next[x] = picoquic_format_ack_frame(cnx[x], bytes[x], bytes[x] + length, &more_data[x],
+                    current_time, pc, 0);
+            }
+            if (bytes_next[0] - bytes[0] != bytes_next[1] - bytes[1] ||
+                memcmp(bytes[0], bytes[1], bytes_next[0] - bytes[0]) != 0 || more_data[0] != more_data[1]) {
+                DBG_PRINTF("ACK differs at step %d", i);
+                ret = -1;
+            }
+            else if (ack_cache_compare_lists(&cnx[0]->ack_ctx[pc].sack_list, &cnx[1]->ack_ctx[pc].sack_list) != 0) {
+                DBG_PRINTF("SACK lists differ at step %d", i);
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        /* Most ACKs should reuse the cached ranges */
+        if (cnx[0]->ack_ctx[pc].ack_cache == NULL) {
+            DBG_PRINTF("%s", "ACK cache not created");
+            ret = -1;
+        }
+        else {
+            nb_full = 2000 - cnx[0]->ack_ctx[pc].ack_cache->nb_reused;
+            if (nb_full > 1000) {
+                DBG_PRINTF("Only %" PRIu64 " ACKs out of 2000 reused the cache", 2000 - nb_full);
+                ret = -1;
+            }
+        }
+    }
+
+    if (cnx[1] != NULL) {
+        picoquic_delete_cnx(cnx[1]);
+    }
+    picoquic_test_delete_minimal_cnx(&quic, &cnx[0]);
+
+    return ret;
+}
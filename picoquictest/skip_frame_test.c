@@ -1661,6 +1661,184 @@ int binlog_test()
     return ret;
 }
 
+/* Test of the asynchronous binary log writer. The packets of the binlog
+ * test are logged through the asynchronous writer, and the resulting file
+ * must be identical to the reference produced by synchronous writes.
+ */
+int binlog_async_test()
+{
+    int ret = 0;
+    const picoquic_connection_id_t initial_cid = {
+        { 1, 2, 3, 4 }, 4
+    };
+    const picoquic_connection_id_t dest_cid = {
+        { 5, 6, 7, 8 }, 4
+    };
+    char log_test_ref[512];
+    uint64_t simulated_time = 0;
+    uint64_t nb_dropped = 0;
+    picoquic_quic_t* quic = NULL;
+
+    if (picoquic_get_input_path(log_test_ref, sizeof(log_test_ref), picoquic_solution_dir, BINLOG_TEST_REF) != 0) {
+        DBG_PRINTF("%s", "Cannot set the log ref file name.\n");
+        ret = -1;
+    }
+    else if ((quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time, &simulated_time, NULL, NULL, 0)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if (picoquic_set_binlog_async(quic, 0x10000) != 0) {
+        DBG_PRINTF("%s", "Cannot start the binlog writer\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_binlog(quic, ".");
+        picoquic_set_default_spinbit_policy(quic, picoquic_spinbit_null);
+
+        struct sockaddr_in saddr;
+        memset(&saddr, 0, sizeof(struct sockaddr_in));
+        picoquic_cnx_t* cnx = picoquic_create_cnx(quic, initial_cid, dest_cid, (struct sockaddr*)&saddr,
+            simulated_time, 0, "test-sni", "test-alpn", 1);
+
+        if (cnx == NULL) {
+            DBG_PRINTF("%s", "Cannot create QUIC CNX context\n");
+            ret = -1;
+        }
+        else {
+            picoquic_log_new_connection(cnx);
+            for (int pass = 0; pass < 2; pass++) {
+                const test_skip_frames_t* list = (pass == 0) ? test_skip_list : test_frame_error_list;
+                size_t nb_list = (pass == 0) ? nb_test_skip_list : nb_test_frame_error_list;
+
+                for (size_t i = 0; i < nb_list; i++) {
+                    picoquic_packet_header ph;
+                    memset(&ph, 0, sizeof(ph));
+
+                    ph.ptype = picoquic_packet_1rtt_protected;
+                    ph.pn64 = i;
+                    ph.dest_cnx_id = initial_cid;
+                    ph.srce_cnx_id = dest_cid;
+                    ph.offset = 0;
+                    ph.payload_length = list[i].len;
+
+                    picoquic_log_packet(cnx, cnx->path[0], 0, 0, &ph, list[i].val, list[i].len);
+                }
+            }
+            picoquic_delete_cnx(cnx);
+        }
+        nb_dropped = picoquic_get_binlog_async_dropped(quic);
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    if (ret == 0 && nb_dropped != 0) {
+        DBG_PRINTF("%" PRIu64 " events dropped by the binlog writer\n", nb_dropped);
+        ret = -1;
+    }
+
+    if (ret == 0 && picoquic_test_compare_binary_files(binlog_test_file, log_test_ref) != 0) {
+        DBG_PRINTF("%s", "Unexpected content in binary log file.\n");
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Test of the memory mapped and indexed binary log. Each event of the
+ * reference log is written twice, once for the original connection and
+ * once for a second connection, followed by a truncated event. The index
+ * must separate the two connections, and the conversion of the first
+ * connection must match the reference QLOG.
+ */
+#define BINLOG_INDEX_TEST_FILE "binlog_index_test.log"
+#define BINLOG_INDEX_TEST_QLOG "binlog_index_test.qlog"
+
+static int binlog_index_test_write(char const* log_test_ref, size_t * nb_events)
+{
+    int ret = 0;
+    FILE* F_ref = picoquic_file_open(log_test_ref, "rb");
+    FILE* F = picoquic_file_open(BINLOG_INDEX_TEST_FILE, "wb");
+    uint8_t buffer[2048];
+
+    *nb_events = 0;
+    if (F_ref == NULL || F == NULL || fread(buffer, 16, 1, F_ref) != 1 || fwrite(buffer, 16, 1, F) != 1) {
+        ret = -1;
+    }
+    while (ret == 0 && fread(buffer, 4, 1, F_ref) == 1) {
+        uint32_t len = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+        if (len + 4 > sizeof(buffer) || len < 5 || fread(buffer + 4, len, 1, F_ref) != 1 ||
+            fwrite(buffer, len + 4, 1, F) != 1) {
+            ret = -1;
+        }
+        else {
+            /* Change the last byte of the 4 bytes connection ID */
+            buffer[8] ^= 0xff;
+            if (fwrite(buffer, len + 4, 1, F) != 1) {
+                ret = -1;
+            }
+            (*nb_events)++;
+        }
+    }
+    if (ret == 0) {
+        uint8_t truncated[8] = { 0, 0, 0, 100, 4, 1, 2, 3 };
+        if (fwrite(truncated, sizeof(truncated), 1, F) != 1) {
+            ret = -1;
+        }
+    }
+    (void)picoquic_file_close(F_ref);
+    (void)picoquic_file_close(F);
+
+    return ret;
+}
+
+int binlog_index_test()
+{
+    int ret = 0;
+    const picoquic_connection_id_t initial_cid = {
+        { 1, 2, 3, 4 }, 4
+    };
+    char log_test_ref[512];
+    char qlog_test_ref[512];
+    size_t nb_events = 0;
+    binlog_map_t* map = NULL;
+
+    if (picoquic_get_input_path(log_test_ref, sizeof(log_test_ref), picoquic_solution_dir, BINLOG_TEST_REF) != 0 ||
+        picoquic_get_input_path(qlog_test_ref, sizeof(qlog_test_ref), picoquic_solution_dir, QLOG_TEST_REF) != 0) {
+        DBG_PRINTF("%s", "Cannot set the log ref file names.\n");
+        ret = -1;
+    }
+    else if (binlog_index_test_write(log_test_ref, &nb_events) != 0) {
+        DBG_PRINTF("%s", "Cannot write the test log.\n");
+        ret = -1;
+    }
+    else if ((map = binlog_map_open(BINLOG_INDEX_TEST_FILE)) == NULL) {
+        DBG_PRINTF("%s", "Cannot map the test log.\n");
+        ret = -1;
+    }
+    else if (map->nb_entries != 2 || picoquic_compare_connection_id(&map->entries[0]->cid, &initial_cid) != 0 ||
+        map->entries[0]->nb_events != nb_events || map->entries[1]->nb_events != nb_events ||
+        binlog_map_find(map, &initial_cid) != map->entries[0]) {
+        DBG_PRINTF("%s", "Unexpected index of the test log.\n");
+        ret = -1;
+    }
+    else if (qlog_convert_indexed(map, map->entries[0], BINLOG_INDEX_TEST_FILE, BINLOG_INDEX_TEST_QLOG, NULL) != 0 ||
+        picoquic_test_compare_text_files(BINLOG_INDEX_TEST_QLOG, qlog_test_ref) != 0) {
+        DBG_PRINTF("%s", "Unexpected QLOG conversion of the first connection.\n");
+        ret = -1;
+    }
+    else if (qlog_convert_indexed(map, map->entries[1], BINLOG_INDEX_TEST_FILE, BINLOG_INDEX_TEST_QLOG, NULL) != 0) {
+        DBG_PRINTF("%s", "Cannot convert the second connection.\n");
+        ret = -1;
+    }
+
+    binlog_map_close(map);
+
+    return ret;
+}
+
 /* Basic test of connection ID stash, part of migration support  */
 static const picoquic_remote_cnxid_t stash_test_case[] = {
     { NULL,  1,{ { 0, 1, 2, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, 4 },
@@ -2810,7 +2988,7 @@ int send_stream_blocked_test()
 }
 
 int picoquic_queue_network_input(picoquic_quic_t * quic, picosplay_tree_t* tree, uint64_t consumed_offset,
-    uint64_t stream_ofs, const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data, int* new_data_available);
+    uint64_t stream_ofs, const uint8_t* bytes, size_t length, picoquic_stream_data_node_t* received_data, size_t* new_bytes);
 
 int64_t picoquic_stream_data_node_compare(void* l, void* r);
 picosplay_node_t* picoquic_stream_data_node_create(void* value);
@@ -2834,7 +3012,7 @@ int queue_network_input_test()
     };
 
     const uint8_t data[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
-    int new_data_available = 0;
+    size_t new_bytes = 0;
 
     picosplay_tree_t* tree = picosplay_new_tree(
         picoquic_stream_data_node_compare,
@@ -2848,48 +3026,48 @@ int queue_network_input_test()
 
     /* Fill 0..3 */
     if (ret == 0) {
-        new_data_available = 0;
+        new_bytes = 0;
         if ((ret = picoquic_queue_network_input(quic, tree, 0, 0, data, 4, NULL,
-            &new_data_available)) != 0) {
+            &new_bytes)) != 0) {
             DBG_PRINTF("picoquic_queue_network_input(0, 0, 4) failed (%d)", ret);
         }
-        else if (new_data_available == 0) {
-            DBG_PRINTF("new_data_available doesn't signal new data (%d)", new_data_available);
+        else if (new_bytes != 4) {
+            DBG_PRINTF("new_bytes is %zu instead of 4", new_bytes);
             ret = 1;
         }
     }
 
     /* Fill 6..9 */
     if (ret == 0) {
-        new_data_available = 0;
-        if ((ret = picoquic_queue_network_input(quic, tree, 0, 6, data + 6, 4, NULL, &new_data_available)) != 0) {
+        new_bytes = 0;
+        if ((ret = picoquic_queue_network_input(quic, tree, 0, 6, data + 6, 4, NULL, &new_bytes)) != 0) {
             DBG_PRINTF("picoquic_queue_network_input(0, 6, 4) failed (%d)", ret);
-        } else if (new_data_available == 0) {
-            DBG_PRINTF("new_data_available doesn't signal new data (%d)", new_data_available);
+        } else if (new_bytes != 4) {
+            DBG_PRINTF("new_bytes is %zu instead of 4", new_bytes);
             ret = 1;
         }
     }
 
     /* Fill the gap from 4..5 with a chunk from 2..7 */
     if (ret == 0) {
-        new_data_available = 0;
-        if ((ret = picoquic_queue_network_input(quic, tree, 0, 2, data + 2, 6, NULL, &new_data_available)) != 0) {
+        new_bytes = 0;
+        if ((ret = picoquic_queue_network_input(quic, tree, 0, 2, data + 2, 6, NULL, &new_bytes)) != 0) {
             DBG_PRINTF("picoquic_queue_network_input(0, 2, 6) failed (%d)", ret);
-        } else if (new_data_available == 0) {
-            DBG_PRINTF("new_data_available signals new data (%d)", new_data_available);
+        } else if (new_bytes != 2) {
+            DBG_PRINTF("new_bytes is %zu instead of 2", new_bytes);
             ret = 1;
         }
     }
 
     /* No new data delivered by chunk 2..7 */
     if (ret == 0) {
-        new_data_available = 0;
-        if ((ret = picoquic_queue_network_input(quic, tree, 0, 2, data, 6, NULL, &new_data_available)) != 0) {
+        new_bytes = 0;
+        if ((ret = picoquic_queue_network_input(quic, tree, 0, 2, data, 6, NULL, &new_bytes)) != 0) {
             DBG_PRINTF("picoquic_queue_network_input(0, 2, 6) failed (%d)", ret);
         }
 
-        if (new_data_available != 0) {
-            DBG_PRINTF("new_data_available signals new data (%d)", new_data_available);
+        if (new_bytes != 0) {
+            DBG_PRINTF("new_bytes signals new data (%zu)", new_bytes);
             ret = 1;
         }
     }
@@ -61,6 +61,7 @@ typedef struct st_sockloop_test_spec_t {
     int double_bind;
     int extra_socket_required;
     int force_migration;
+    size_t send_batch_max;
 } sockloop_test_spec_t;
 
 typedef struct st_sockloop_test_cb_t {
@@ -488,6 +489,7 @@ int sockloop_test_one(sockloop_test_spec_t *spec)
             param.do_not_use_gso = spec->do_not_use_gso;
             param.simulate_eio = spec->simulate_eio;
             param.extra_socket_required = spec->extra_socket_required;
+            param.send_batch_max = spec->send_batch_max;
 
             loop_cb.force_migration = spec->force_migration;
             loop_cb.param = &param;
@@ -694,4 +696,166 @@ int sockloop_thread_name_test()
     spec.thread_name = "picoquic loop";
 
     return(sockloop_test_one(&spec));
-}
\ No newline at end of file
+}
+int sockloop_batch_test()
+{
+    sockloop_test_spec_t spec;
+    sockloop_test_set_spec(&spec, 9);
+    spec.socket_buffer_size = 0xffff;
+    spec.scenario = sockloop_test_scenario_1M;
+    spec.scenario_size = sizeof(sockloop_test_scenario_1M);
+    spec.send_batch_max = 16;
+
+    return(sockloop_test_one(&spec));
+}
+
+/* Test of picoquic_prepare_next_packets and picoquic_sendmmsg, using
+ * stateless packets queued in the QUIC context. Packets sent to the
+ * same destination are grouped in GSO trains if their sizes allow it.
+ */
+static void send_batch_test_queue(picoquic_quic_t* quic, struct sockaddr* addr_to, size_t length, uint8_t fill)
+{
+    picoquic_stateless_packet_t* sp = picoquic_create_stateless_packet(quic);
+
+    if (sp != NULL) {
+        memset(sp, 0, sizeof(picoquic_stateless_packet_t));
+        picoquic_store_addr(&sp->addr_to, addr_to);
+        sp->length = length;
+        memset(sp->bytes, fill, length);
+        picoquic_queue_stateless_packet(quic, sp);
+    }
+}
+
+typedef struct st_send_batch_test_expected_t {
+    int dest;
+    size_t length;
+    size_t send_msg_size;
+} send_batch_test_expected_t;
+
+int send_batch_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, 0, NULL, NULL, NULL, 0);
+    struct sockaddr_storage addr[2];
+    uint8_t send_buffer[16 * PICOQUIC_MAX_PACKET_SIZE];
+    picoquic_send_batch_t batch[16];
+    size_t nb_batch = 0;
+    const size_t lengths[6] = { 1200, 1200, 1000, 1200, 1200, 1200 };
+    const int dests[6] = { 0, 0, 0, 0, 1, 0 };
+    const send_batch_test_expected_t expected[4] = {
+        { 0, 3400, 1200 }, { 0, 1200, 0 }, { 1, 1200, 0 }, { 0, 1200, 0 } };
+    picoquic_server_sockets_t server_sockets;
+    int server_sockets_open = 0;
+    SOCKET_TYPE fd = INVALID_SOCKET;
+    uint16_t test_port = 12349;
+
+    if (quic == NULL) {
+        ret = -1;
+    }
+    else {
+        for (int i = 0; i < 2; i++) {
+            memset(&addr[i], 0, sizeof(struct sockaddr_storage));
+            ((struct sockaddr_in*)&addr[i])->sin_family = AF_INET;
+            ((struct sockaddr_in*)&addr[i])->sin_addr.s_addr = htonl(0x7F000001);
+            ((struct sockaddr_in*)&addr[i])->sin_port = htons((uint16_t)(test_port + i));
+        }
+    }
+    /* Check the grouping of packets in GSO trains */
+    for (int gso = 1; ret == 0 && gso >= 0; gso--) {
+        size_t nb_expected = (gso) ? 4 : 6;
+
+        for (int i = 0; i < 6; i++) {
+            send_batch_test_queue(quic, (struct sockaddr*)&addr[dests[i]], lengths[i], (uint8_t)(i + 1));
+        }
+        ret = picoquic_prepare_next_packets(quic, 0, send_buffer, sizeof(send_buffer), PICOQUIC_MAX_PACKET_SIZE, gso,
+            batch, 16, &nb_batch);
+        if (ret == 0 && nb_batch != nb_expected) {
+            DBG_PRINTF("GSO=%d, expected %zu messages, got %zu", gso, nb_expected, nb_batch);
+            ret = -1;
+        }
+        for (size_t i = 0; ret == 0 && i < nb_batch; i++) {
+            int dest = (gso) ? expected[i].dest : dests[i];
+            size_t length = (gso) ? expected[i].length : lengths[i];
+            size_t send_msg_size = (gso) ? expected[i].send_msg_size : 0;
+
+            if (batch[i].length != length || batch[i].send_msg_size != send_msg_size ||
+                batch[i].cnx != NULL || batch[i].departure_time != 0 ||
+                picoquic_compare_addr((struct sockaddr*)&batch[i].addr_to, (struct sockaddr*)&addr[dest]) != 0) {
+                DBG_PRINTF("GSO=%d, unexpected message %zu", gso, i);
+                ret = -1;
+            }
+        }
+        if (ret == 0 && (batch[0].bytes[0] != 1 || batch[0].bytes[3399] != 3 || batch[nb_batch - 1].bytes[0] != 6)) {
+            DBG_PRINTF("GSO=%d, unexpected content", gso);
+            ret = -1;
+        }
+    }
+    /* Check the limit on the number of messages */
+    if (ret == 0) {
+        for (int i = 0; i < 3; i++) {
+            send_batch_test_queue(quic, (struct sockaddr*)&addr[i & 1], 1200, (uint8_t)(i + 1));
+        }
+        if (picoquic_prepare_next_packets(quic, 0, send_buffer, sizeof(send_buffer), PICOQUIC_MAX_PACKET_SIZE, 1,
+            batch, 2, &nb_batch) != 0 || nb_batch != 2 ||
+            picoquic_prepare_next_packets(quic, 0, send_buffer, sizeof(send_buffer), PICOQUIC_MAX_PACKET_SIZE, 1,
+                batch, 2, &nb_batch) != 0 || nb_batch != 1 || batch[0].bytes[0] != 3) {
+            DBG_PRINTF("%s", "Batch size limit not respected");
+            ret = -1;
+        }
+    }
+    /* Send a batch through a loopback socket */
+    if (ret == 0) {
+        if (picoquic_open_server_sockets(&server_sockets, test_port) != 0) {
+            ret = -1;
+        }
+        else {
+            server_sockets_open = 1;
+            fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (fd == INVALID_SOCKET) {
+                ret = -1;
+            }
+        }
+    }
+    if (ret == 0) {
+        int sock_err = 0;
+
+        for (int i = 0; i < 6; i++) {
+            send_batch_test_queue(quic, (struct sockaddr*)&addr[0], lengths[i], (uint8_t)(i + 1));
+        }
+        if (picoquic_prepare_next_packets(quic, 0, send_buffer, sizeof(send_buffer), PICOQUIC_MAX_PACKET_SIZE, 0,
+            batch, 16, &nb_batch) != 0 || nb_batch != 6 ||
+            picoquic_sendmmsg(fd, batch, nb_batch, NULL, &sock_err) != nb_batch) {
+            DBG_PRINTF("Cannot send the batch, err=%d", sock_err);
+            ret = -1;
+        }
+    }
+    for (int i = 0; ret == 0 && i < 6; i++) {
+        uint8_t buffer[1536];
+        struct sockaddr_storage addr_from;
+        struct sockaddr_storage addr_dest;
+        int dest_if = 0;
+        unsigned char received_ecn;
+        uint64_t current_time;
+        int bytes_recv = picoquic_select(server_sockets.s_socket, PICOQUIC_NB_SERVER_SOCKETS,
+            &addr_from, &addr_dest, &dest_if, &received_ecn,
+            buffer, sizeof(buffer), 1000000, &current_time);
+
+        if (bytes_recv != (int)lengths[i] || buffer[0] != (uint8_t)(i + 1)) {
+            DBG_PRINTF("Received %d bytes for message %d, expected %zu", bytes_recv, i, lengths[i]);
+            ret = -1;
+        }
+    }
+
+    if (fd != INVALID_SOCKET) {
+        SOCKET_CLOSE(fd);
+    }
+    if (server_sockets_open) {
+        picoquic_close_server_sockets(&server_sockets);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
@@ -853,6 +853,688 @@ int stream_output_test()
     return ret;
 }
 
+/* Test that data queued by reference is sent without copy in the
+ * transport queue, and released after it is fully acknowledged or
+ * when the stream is reset.
+ */
+
+typedef struct st_stream_by_reference_test_ctx_t {
+    int nb_released;
+    const uint8_t* data_released;
+    size_t length_released;
+} stream_by_reference_test_ctx_t;
+
+static void stream_by_reference_test_release(picoquic_cnx_t* cnx, uint64_t stream_id,
+    const uint8_t* data, size_t length, void* release_ctx)
+{
+    stream_by_reference_test_ctx_t* ctx = (stream_by_reference_test_ctx_t*)release_ctx;
+#ifdef _WINDOWS
+    UNREFERENCED_PARAMETER(cnx);
+    UNREFERENCED_PARAMETER(stream_id);
+#endif
+    ctx->nb_released++;
+    ctx->data_released = data;
+    ctx->length_released = length;
+}
+
+static int stream_by_reference_test_one(picoquic_cnx_t* cnx, uint64_t stream_id, int do_reset)
+{
+    int ret = 0;
+    uint8_t data[2048];
+    uint8_t frames[2][1500];
+    size_t frame_length[2] = { 0, 0 };
+    stream_by_reference_test_ctx_t ctx = { 0 };
+    picoquic_stream_head_t* stream = NULL;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i + stream_id);
+    }
+
+    if (picoquic_add_to_stream_by_reference(cnx, stream_id, data, sizeof(data), !do_reset, NULL,
+        stream_by_reference_test_release, &ctx) != 0 ||
+        (stream = picoquic_find_stream(cnx, stream_id)) == NULL) {
+        DBG_PRINTF("Cannot queue data by reference on stream %d\n", (int)stream_id);
+        ret = -1;
+    }
+    else if (stream->send_queue == NULL || stream->send_queue->bytes != data) {
+        DBG_PRINTF("Data on stream %d was copied\n", (int)stream_id);
+        ret = -1;
+    }
+
+    /* Format the data in two frames */
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        int more_data = 0;
+        int is_pure_ack = 1;
+        int is_still_active = 0;
+        uint8_t* bytes_next = picoquic_format_stream_frame(cnx, stream, frames[i], frames[i] + sizeof(frames[i]),
+            &more_data, &is_pure_ack, &is_still_active, &ret);
+
+        if (ret == 0 && bytes_next != NULL) {
+            uint64_t f_stream_id;
+            uint64_t f_offset;
+            size_t f_length;
+            int f_fin;
+            size_t consumed;
+
+            frame_length[i] = bytes_next - frames[i];
+            if (picoquic_parse_stream_header(frames[i], frame_length[i], &f_stream_id, &f_offset, &f_length, &f_fin, &consumed) != 0 ||
+                f_stream_id != stream_id || f_offset + f_length > sizeof(data) ||
+                memcmp(frames[i] + consumed, data + f_offset, f_length) != 0) {
+                DBG_PRINTF("Unexpected content in frame %d\n", i);
+                ret = -1;
+            }
+        }
+        else {
+            DBG_PRINTF("Cannot format frame %d\n", i);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && (stream->send_queue != NULL || stream->release_queue == NULL || ctx.nb_released != 0)) {
+        DBG_PRINTF("%s", "Data released before it was acknowledged\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && do_reset) {
+        int more_data = 0;
+        int is_pure_ack = 1;
+        int is_still_active = 0;
+        uint8_t reset_frame[64];
+
+        if (picoquic_reset_stream(cnx, stream_id, 0) != 0 ||
+            picoquic_format_stream_frame(cnx, stream, reset_frame, reset_frame + sizeof(reset_frame),
+                &more_data, &is_pure_ack, &is_still_active, &ret) == reset_frame ||
+            ret != 0 || ctx.nb_released != 1) {
+            DBG_PRINTF("Data not released after reset, nb released: %d\n", ctx.nb_released);
+            ret = -1;
+        }
+    }
+    else if (ret == 0) {
+        /* Acknowledge the last frame first, which should not release the data */
+        for (int i = 1; ret == 0 && i >= 0; i--) {
+            size_t consumed = 0;
+            if (picoquic_process_ack_of_stream_frame(cnx, frames[i], frame_length[i], &consumed) != 0) {
+                DBG_PRINTF("Cannot process ack of frame %d\n", i);
+                ret = -1;
+            }
+            else if (ctx.nb_released != ((i == 0) ? 1 : 0)) {
+                DBG_PRINTF("After ack of frame %d, nb released: %d\n", i, ctx.nb_released);
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0 && (ctx.data_released != data || ctx.length_released != sizeof(data))) {
+        DBG_PRINTF("%s", "Released data does not match queued data\n");
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int stream_by_reference_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time,
+        &simulated_time, NULL, NULL, 0);
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else {
+        cnx = picoquic_create_cnx(quic,
+            picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+            simulated_time, 0, "test-sni", "test-alpn", 1);
+
+        if (cnx == NULL) {
+            DBG_PRINTF("%s", "Cannot create connection\n");
+            ret = -1;
+        }
+        else {
+            picoquic_set_callback(cnx, stream_output_test_callback, NULL);
+            /* Set parameter data to a plausible value so tests can run */
+            cnx->maxdata_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+            cnx->remote_parameters.initial_max_stream_data_bidi_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+            cnx->remote_parameters.initial_max_stream_data_uni = PICOQUIC_DEFAULT_0RTT_WINDOW;
+            cnx->max_stream_id_bidir_remote = 8;
+            cnx->max_stream_id_unidir_remote = 10;
+
+            ret = stream_by_reference_test_one(cnx, 4, 0);
+
+            if (ret == 0) {
+                ret = stream_by_reference_test_one(cnx, 8, 1);
+            }
+
+            picoquic_delete_cnx(cnx);
+            cnx = NULL;
+        }
+
+        picoquic_free(quic);
+        quic = NULL;
+    }
+
+    return ret;
+}
+
+/* Test that data queued from a file is read directly into the stream
+ * frames, and that the transport closes the file after sending it.
+ */
+#define STREAM_FILE_TEST_NAME "stream_file_test.bin"
+
+int stream_file_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+    uint8_t file_data[5000];
+    uint8_t received[5000];
+    uint64_t file_offset = 100;
+    uint64_t file_length = 4000;
+    uint64_t stream_id = 4;
+    FILE* F = NULL;
+
+    for (size_t i = 0; i < sizeof(file_data); i++) {
+        file_data[i] = (uint8_t)(i * 7 + 3);
+    }
+    memset(received, 0, sizeof(received));
+
+    if ((F = picoquic_file_open(STREAM_FILE_TEST_NAME, "wb")) == NULL) {
+        DBG_PRINTF("Cannot create file %s\n", STREAM_FILE_TEST_NAME);
+        ret = -1;
+    }
+    else {
+        if (fwrite(file_data, 1, sizeof(file_data), F) != sizeof(file_data)) {
+            DBG_PRINTF("Cannot write file %s\n", STREAM_FILE_TEST_NAME);
+            ret = -1;
+        }
+        F = picoquic_file_close(F);
+    }
+
+    if (ret == 0) {
+        quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+            NULL, NULL, NULL, NULL, simulated_time,
+            &simulated_time, NULL, NULL, 0);
+
+        memset(&saddr, 0, sizeof(struct sockaddr_in));
+        saddr.sin_family = AF_INET;
+        saddr.sin_port = 1000;
+
+        if (quic == NULL) {
+            DBG_PRINTF("%s", "Cannot create QUIC context\n");
+            ret = -1;
+        }
+        else if ((cnx = picoquic_create_cnx(quic,
+            picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+            simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+            DBG_PRINTF("%s", "Cannot create connection\n");
+            ret = -1;
+        }
+        else {
+            picoquic_set_callback(cnx, stream_output_test_callback, NULL);
+            cnx->maxdata_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+            cnx->remote_parameters.initial_max_stream_data_bidi_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+            cnx->max_stream_id_bidir_remote = 4;
+        }
+    }
+
+    if (ret == 0) {
+        if ((F = picoquic_file_open(STREAM_FILE_TEST_NAME, "rb")) == NULL ||
+            picoquic_add_file_to_stream(cnx, stream_id, F, file_offset, file_length, 1, NULL) != 0) {
+            DBG_PRINTF("%s", "Cannot queue file on stream\n");
+            F = picoquic_file_close(F);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_stream_head_t* stream = picoquic_find_stream(cnx, stream_id);
+        int nb_frames = 0;
+        int fin_seen = 0;
+
+        while (ret == 0 && !fin_seen && nb_frames < 10) {
+            uint8_t frame[1500];
+            int more_data = 0;
+            int is_pure_ack = 1;
+            int is_still_active = 0;
+            uint8_t* bytes_next = picoquic_format_stream_frame(cnx, stream, frame, frame + sizeof(frame),
+                &more_data, &is_pure_ack, &is_still_active, &ret);
+            uint64_t f_stream_id;
+            uint64_t f_offset;
+            size_t f_length;
+            size_t consumed;
+
+            nb_frames++;
+            if (ret != 0 || bytes_next == NULL || bytes_next == frame ||
+                picoquic_parse_stream_header(frame, bytes_next - frame, &f_stream_id, &f_offset, &f_length, &fin_seen, &consumed) != 0 ||
+                f_offset + f_length > file_length) {
+                DBG_PRINTF("Cannot format frame %d\n", nb_frames);
+                ret = -1;
+            }
+            else {
+                memcpy(received + f_offset, frame + consumed, f_length);
+            }
+        }
+
+        if (ret == 0 && (!fin_seen || stream->sent_offset != file_length || stream->send_queue != NULL)) {
+            DBG_PRINTF("File not fully sent after %d frames\n", nb_frames);
+            ret = -1;
+        }
+
+        if (ret == 0 && memcmp(received, file_data + file_offset, (size_t)file_length) != 0) {
+            DBG_PRINTF("%s", "Stream content does not match file content\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    if (ret == 0 && picoquic_file_delete(STREAM_FILE_TEST_NAME, NULL) != 0) {
+        DBG_PRINTF("Cannot delete file %s\n", STREAM_FILE_TEST_NAME);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Test of the stream delivery latency: the time between queuing a segment
+ * and the acknowledgement of its last byte is recorded once the whole
+ * segment is acknowledged, not when the last frame is.
+ */
+int stream_delivery_latency_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    picoquic_stream_head_t* stream = NULL;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+    uint8_t data[2048];
+    uint8_t frames[2][1500];
+    size_t frame_length[2] = { 0, 0 };
+    const picoquic_hdr_hist_t* hist = NULL;
+
+    memset(data, 0x5a, sizeof(data));
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time,
+        &simulated_time, NULL, NULL, 0);
+
+    if (quic == NULL || picoquic_set_latency_histograms(quic, 1) != 0) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if ((cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        cnx->maxdata_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+        cnx->remote_parameters.initial_max_stream_data_bidi_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+        cnx->max_stream_id_bidir_remote = 8;
+
+        simulated_time = 10000;
+        if (picoquic_add_to_stream(cnx, 4, data, sizeof(data), 1) != 0 ||
+            (stream = picoquic_find_stream(cnx, 4)) == NULL || !stream->is_delivery_probe_set ||
+            stream->delivery_probe_offset != sizeof(data)) {
+            DBG_PRINTF("%s", "Delivery probe not set\n");
+            ret = -1;
+        }
+    }
+
+    for (int i = 0; ret == 0 && i < 2; i++) {
+        int more_data = 0;
+        int is_pure_ack = 1;
+        int is_still_active = 0;
+        uint8_t* bytes_next = picoquic_format_stream_frame(cnx, stream, frames[i], frames[i] + sizeof(frames[i]),
+            &more_data, &is_pure_ack, &is_still_active, &ret);
+        if (ret != 0 || bytes_next == NULL) {
+            DBG_PRINTF("Cannot format frame %d\n", i);
+            ret = -1;
+        }
+        else {
+            frame_length[i] = bytes_next - frames[i];
+        }
+    }
+
+    /* Acknowledge the last frame first, then the first one */
+    for (int i = 1; ret == 0 && i >= 0; i--) {
+        size_t consumed = 0;
+        simulated_time += 20000;
+        hist = picoquic_get_latency_histogram(quic, picoquic_latency_stream_delivery);
+        if (picoquic_process_ack_of_stream_frame(cnx, frames[i], frame_length[i], &consumed) != 0) {
+            DBG_PRINTF("Cannot process ack of frame %d\n", i);
+            ret = -1;
+        }
+        else if (hist == NULL || hist->count != ((i == 0) ? 1 : 0)) {
+            DBG_PRINTF("Unexpected count of delivery samples after ack of frame %d\n", i);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        const picoquic_hdr_hist_t* path_hist = picoquic_get_path_latency_histogram(cnx, 0, picoquic_latency_stream_delivery);
+        if (hist->max != 40000 || path_hist == NULL || path_hist->count != 1 ||
+            picoquic_hdr_hist_percentile(path_hist, 99.0) != 40000 || stream->is_delivery_probe_set) {
+            DBG_PRINTF("%s", "Unexpected delivery latency\n");
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/* Test of the memory budget: data queued for sending and out of order
+ * data received are accounted per connection and per context, and the
+ * budget is released when the data is sent or the connection deleted.
+ */
+int memory_budget_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+    uint8_t data[4000];
+    uint64_t stream_id = 4;
+    size_t expected = sizeof(picoquic_stream_queue_node_t) + 1000;
+
+    memset(data, 0x5a, sizeof(data));
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time,
+        &simulated_time, NULL, NULL, 0);
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if ((cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_callback(cnx, stream_output_test_callback, NULL);
+        cnx->maxdata_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+        cnx->remote_parameters.initial_max_stream_data_bidi_remote = PICOQUIC_DEFAULT_0RTT_WINDOW;
+        cnx->max_stream_id_bidir_remote = 4;
+        picoquic_set_memory_limits(quic, 4096, 0);
+    }
+
+    if (ret == 0 && (picoquic_get_cnx_memory_used(cnx) != 0 || picoquic_get_quic_memory_used(quic) != 0)) {
+        DBG_PRINTF("%s", "Memory used before queuing data\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && picoquic_add_to_stream(cnx, stream_id, data, 1000, 0) != 0) {
+        DBG_PRINTF("%s", "Cannot queue data on stream\n");
+        ret = -1;
+    }
+
+    if (ret == 0 && (picoquic_get_cnx_memory_used(cnx) != expected ||
+        picoquic_get_quic_memory_used(quic) != expected || picoquic_is_memory_constrained(cnx))) {
+        DBG_PRINTF("Memory used %" PRIu64 " instead of %zu\n", picoquic_get_cnx_memory_used(cnx), expected);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        expected += sizeof(picoquic_stream_queue_node_t) + 4000;
+        if (picoquic_add_to_stream(cnx, stream_id, data, 4000, 1) != 0) {
+            DBG_PRINTF("%s", "Cannot queue data on stream\n");
+            ret = -1;
+        }
+        else if (picoquic_get_cnx_memory_used(cnx) != expected || !picoquic_is_memory_constrained(cnx)) {
+            DBG_PRINTF("Budget not exceeded, memory used %" PRIu64 "\n", picoquic_get_cnx_memory_used(cnx));
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Send all the queued data, which releases the queued nodes */
+        picoquic_stream_head_t* stream = picoquic_find_stream(cnx, stream_id);
+        int nb_frames = 0;
+
+        while (ret == 0 && stream->send_queue != NULL && nb_frames < 10) {
+            uint8_t frame[1500];
+            int more_data = 0;
+            int is_pure_ack = 1;
+            int is_still_active = 0;
+
+            (void)picoquic_format_stream_frame(cnx, stream, frame, frame + sizeof(frame),
+                &more_data, &is_pure_ack, &is_still_active, &ret);
+            nb_frames++;
+        }
+
+        if (ret == 0 && (picoquic_get_cnx_memory_used(cnx) != 0 || picoquic_is_memory_constrained(cnx))) {
+            DBG_PRINTF("Memory used %" PRIu64 " after sending\n", picoquic_get_cnx_memory_used(cnx));
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Receive out of order data, which is held for reassembly */
+        uint8_t frame[128];
+        uint8_t* bytes = frame;
+
+        *bytes++ = picoquic_frame_type_stream_range_min | 6; /* offset and length present */
+        bytes = picoquic_frames_varint_encode(bytes, frame + sizeof(frame), stream_id);
+        bytes = picoquic_frames_varint_encode(bytes, frame + sizeof(frame), 1000);
+        bytes = picoquic_frames_varint_encode(bytes, frame + sizeof(frame), 100);
+        memset(bytes, 0xa5, 100);
+        bytes += 100;
+
+        if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL) {
+            DBG_PRINTF("%s", "Cannot decode stream frame\n");
+            ret = -1;
+        }
+        else if (picoquic_get_cnx_memory_used(cnx) != sizeof(picoquic_stream_data_node_t)) {
+            DBG_PRINTF("Memory used %" PRIu64 " after receiving out of order data\n", picoquic_get_cnx_memory_used(cnx));
+            ret = -1;
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+
+    if (ret == 0 && picoquic_get_quic_memory_used(quic) != 0) {
+        DBG_PRINTF("Memory used %" PRIu64 " after deleting connection\n", picoquic_get_quic_memory_used(quic));
+        ret = -1;
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
+/* Test of the reordering statistics: out of order data received on a
+ * stream is counted in the reordering buffer, and the stream is stalled
+ * until the missing data arrives.
+ */
+static uint8_t* stream_reorder_stats_frame(uint8_t* frame, size_t frame_max, uint64_t stream_id, uint64_t offset, size_t length)
+{
+    uint8_t* bytes = frame;
+
+    *bytes++ = picoquic_frame_type_stream_range_min | 6; /* offset and length present */
+    bytes = picoquic_frames_varint_encode(bytes, frame + frame_max, stream_id);
+    bytes = picoquic_frames_varint_encode(bytes, frame + frame_max, offset);
+    bytes = picoquic_frames_varint_encode(bytes, frame + frame_max, length);
+    memset(bytes, 0xa5, length);
+
+    return bytes + length;
+}
+
+int stream_reorder_stats_test()
+{
+    int ret = 0;
+    picoquic_quic_t* quic = NULL;
+    picoquic_cnx_t* cnx = NULL;
+    uint64_t simulated_time = 0;
+    struct sockaddr_in saddr;
+    uint64_t stream_id = 4;
+    uint8_t frame[1500];
+    uint8_t* bytes;
+    picoquic_path_quality_t quality;
+
+    quic = picoquic_create(8, NULL, NULL, NULL, NULL, NULL,
+        NULL, NULL, NULL, NULL, simulated_time,
+        &simulated_time, NULL, NULL, 0);
+
+    memset(&saddr, 0, sizeof(struct sockaddr_in));
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = 1000;
+
+    if (quic == NULL) {
+        DBG_PRINTF("%s", "Cannot create QUIC context\n");
+        ret = -1;
+    }
+    else if ((cnx = picoquic_create_cnx(quic,
+        picoquic_null_connection_id, picoquic_null_connection_id, (struct sockaddr*)&saddr,
+        simulated_time, 0, "test-sni", "test-alpn", 1)) == NULL) {
+        DBG_PRINTF("%s", "Cannot create connection\n");
+        ret = -1;
+    }
+    else if (picoquic_create_stream(cnx, stream_id) == NULL) {
+        DBG_PRINTF("%s", "Cannot create stream\n");
+        ret = -1;
+    }
+    else {
+        picoquic_set_callback(cnx, stream_output_test_callback, NULL);
+    }
+
+    if (ret == 0) {
+        /* Two chunks of 100 bytes arrive before the beginning of the stream */
+        simulated_time = 10000;
+        bytes = stream_reorder_stats_frame(frame, sizeof(frame), stream_id, 1000, 100);
+        if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL) {
+            ret = -1;
+        }
+        else {
+            simulated_time = 15000;
+            bytes = stream_reorder_stats_frame(frame, sizeof(frame), stream_id, 1200, 100);
+            if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL) {
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("%s", "Cannot decode stream frame\n");
+        }
+        else if (picoquic_get_path_quality(cnx, 0, &quality) != 0 ||
+            quality.reorder_buffer_bytes != 200 || quality.hol_stalls != 1 || quality.hol_stall_time != 0) {
+            DBG_PRINTF("Reorder buffer %" PRIu64 ", stalls %" PRIu64 " after receiving out of order data\n",
+                quality.reorder_buffer_bytes, quality.hol_stalls);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The beginning of the stream arrives, the first chunk is delivered, but a gap remains */
+        simulated_time = 30000;
+        bytes = stream_reorder_stats_frame(frame, sizeof(frame), stream_id, 0, 1000);
+        if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL) {
+            DBG_PRINTF("%s", "Cannot decode stream frame\n");
+            ret = -1;
+        }
+        else if (picoquic_get_path_quality(cnx, 0, &quality) != 0 ||
+            quality.reorder_buffer_bytes != 100 || quality.reorder_buffer_max != 200 || quality.hol_stalls != 1) {
+            DBG_PRINTF("Reorder buffer %" PRIu64 " after receiving the first bytes\n", quality.reorder_buffer_bytes);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The gap is filled, the stall ends */
+        simulated_time = 40000;
+        bytes = stream_reorder_stats_frame(frame, sizeof(frame), stream_id, 1100, 100);
+        if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL) {
+            DBG_PRINTF("%s", "Cannot decode stream frame\n");
+            ret = -1;
+        }
+        else if (picoquic_get_path_quality(cnx, 0, &quality) != 0 ||
+            quality.reorder_buffer_bytes != 0 || quality.reorder_buffer_max != 200 ||
+            quality.hol_stalls != 1 || quality.hol_stall_time != 30000) {
+            DBG_PRINTF("Reorder buffer %" PRIu64 ", stall time %" PRIu64 " after filling the gap\n",
+                quality.reorder_buffer_bytes, quality.hol_stall_time);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* A chunk is queued after a gap, then in sequence data covers the gap and half the chunk */
+        simulated_time = 50000;
+        bytes = stream_reorder_stats_frame(frame, sizeof(frame), stream_id, 1400, 100);
+        if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL) {
+            ret = -1;
+        }
+        else if (picoquic_get_path_quality(cnx, 0, &quality) != 0 ||
+            quality.reorder_buffer_bytes != 100 || quality.hol_stalls != 2) {
+            ret = -1;
+        }
+        else {
+            simulated_time = 60000;
+            bytes = stream_reorder_stats_frame(frame, sizeof(frame), stream_id, 1300, 150);
+            if (picoquic_decode_stream_frame(cnx, frame, bytes, NULL, simulated_time) == NULL ||
+                picoquic_get_path_quality(cnx, 0, &quality) != 0 ||
+                quality.reorder_buffer_bytes != 0 || quality.reorder_buffer_max != 200 ||
+                quality.hol_stall_time != 40000) {
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Reorder buffer %" PRIu64 ", stall time %" PRIu64 " after overlapping data\n",
+                quality.reorder_buffer_bytes, quality.hol_stall_time);
+        }
+    }
+
+    if (cnx != NULL) {
+        picoquic_delete_cnx(cnx);
+    }
+
+    if (quic != NULL) {
+        picoquic_free(quic);
+    }
+
+    return ret;
+}
+
 /* Test the STREAM ID and STREAM RANK macros
  */
 
@@ -7715,6 +7715,52 @@ int key_rotation_auto_client()
     return key_rotation_auto_one(400, 1);
 }
 
+/*
+ * Crypto offload: run a long transfer with the 1-RTT packet protection
+ * performed by the offload thread on both client and server, with key
+ * rotations happening while packets are queued for protection.
+ */
+int crypto_offload_test()
+{
+    uint64_t simulated_time = 0;
+    picoquic_test_tls_api_ctx_t* test_ctx = NULL;
+    int ret = tls_api_init_ctx(&test_ctx, PICOQUIC_INTERNAL_TEST_VERSION_1,
+        PICOQUIC_TEST_SNI, PICOQUIC_TEST_ALPN, &simulated_time, NULL, NULL, 0, 1, 0);
+
+    if (ret == 0 && test_ctx == NULL) {
+        ret = PICOQUIC_ERROR_MEMORY;
+    }
+
+    if (ret == 0) {
+        ret = picoquic_set_crypto_offload(test_ctx->qclient, 1);
+        if (ret == 0) {
+            ret = picoquic_set_crypto_offload(test_ctx->qserver, 1);
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Cannot start crypto offload, ret = 0x%x\n", ret);
+        }
+    }
+
+    if (ret == 0) {
+        picoquic_set_default_crypto_epoch_length(test_ctx->qserver, 300);
+
+        ret = tls_api_one_scenario_body(test_ctx, &simulated_time,
+            test_scenario_key_rotation, sizeof(test_scenario_key_rotation), 0, 0, 0, 0, 2000000);
+    }
+
+    if (ret == 0 && test_ctx->cnx_server != NULL && test_ctx->cnx_server->nb_crypto_key_rotations == 0) {
+        DBG_PRINTF("%s", "No key rotation with crypto offload\n");
+        ret = -1;
+    }
+
+    if (test_ctx != NULL) {
+        tls_api_delete_ctx(test_ctx);
+        test_ctx = NULL;
+    }
+
+    return ret;
+}
+
 /*
  * Key rotation stress: mimic a client that rotates its keys very rapidly.
  * Expected results: the server should survive. The server connection should be
@@ -395,4 +395,63 @@ int util_threading_test()
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+/* Check that the HDR histogram reports percentiles within the expected
+ * precision, and that merged histograms combine the counts.
+ */
+int util_hdr_histogram_test()
+{
+    int ret = 0;
+    picoquic_hdr_hist_t* hist = (picoquic_hdr_hist_t*)malloc(2 * sizeof(picoquic_hdr_hist_t));
+
+    if (hist == NULL) {
+        ret = -1;
+    }
+    else {
+        picoquic_hdr_hist_reset(&hist[0]);
+        picoquic_hdr_hist_reset(&hist[1]);
+
+        if (picoquic_hdr_hist_percentile(&hist[0], 50.0) != 0) {
+            DBG_PRINTF("%s", "Empty histogram does not return 0");
+            ret = -1;
+        }
+
+        /* 1 to 10000 microseconds in the first histogram, plus a tail in the second */
+        for (uint64_t v = 1; v <= 10000; v++) {
+            picoquic_hdr_hist_record(&hist[0], v);
+        }
+        for (uint64_t v = 0; v < 100; v++) {
+            picoquic_hdr_hist_record(&hist[1], 1000000 + v * 10000);
+        }
+        picoquic_hdr_hist_record(&hist[1], UINT64_MAX);
+
+        if (ret == 0) {
+            uint64_t p50 = picoquic_hdr_hist_percentile(&hist[0], 50.0);
+            uint64_t p99 = picoquic_hdr_hist_percentile(&hist[0], 99.0);
+            if (p50 < 5000 || p50 > 5000 + 5000 / 16 || p99 < 9900 || p99 > 10000 ||
+                picoquic_hdr_hist_percentile(&hist[0], 100.0) != 10000 ||
+                picoquic_hdr_hist_percentile(&hist[0], 0.0) != 1 ||
+                picoquic_hdr_hist_percentile(&hist[0], 0.05) != 5) {
+                DBG_PRINTF("Unexpected percentiles, p50: %" PRIu64 ", p99: %" PRIu64, p50, p99);
+                ret = -1;
+            }
+        }
+
+        if (ret == 0) {
+            uint64_t p999;
+            picoquic_hdr_hist_merge(&hist[0], &hist[1]);
+            p999 = picoquic_hdr_hist_percentile(&hist[0], 99.9);
+            if (hist[0].count != 10101 || hist[0].min != 1 || hist[0].max != UINT64_MAX ||
+                p999 < 1900000 || p999 > 1900000 + 1900000 / 16 ||
+                picoquic_hdr_hist_percentile(&hist[0], 100.0) != UINT64_MAX) {
+                DBG_PRINTF("Unexpected merged histogram, p99.9: %" PRIu64, p999);
+                ret = -1;
+            }
+        }
+
+        free(hist);
+    }
+
+    return ret;
+}